@@ -0,0 +1,368 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "bench_cluster.h"
+
+// Opciones del benchmark (configurables por línea de comandos)
+typedef struct {
+    int clients;            // Flecks concurrentes
+    int jobs;               // Distorsiones por Fleck
+    int enigmas;            // Instancias de Enigma
+    int harleys;            // Instancias de Harley
+    long text_size;         // Bytes de cada archivo de texto
+    long wav_size;          // Bytes de cada archivo WAV
+    int png_side;           // Lado en píxeles de cada imagen PNG
+    int kinds[TIMINGS_NUM_KINDS];
+    int num_kinds;
+    int base_port;          // Primer puerto (Gotham-Flecks); el resto son consecutivos
+    char* work_dir;         // Directorio donde se genera el entorno del benchmark
+    char* output;           // Archivo JSON de salida (NULL = stdout)
+} BenchOptions;
+
+// Resultado de una distorsión, enviado por cada cliente al proceso principal por pipe
+typedef struct {
+    int kind;
+    int ok;
+    long bytes;
+    double latency_ms;
+} JobRecord;
+
+// Procesos lanzados por el benchmark (para poder pararlos al acabar)
+static BenchCluster cluster;
+
+
+/***********************************************
+*
+* @Finalitat: Mostrar l’ús del benchmark.
+* @Parametres: ---
+* @Retorn: ---
+*
+************************************************/
+static void print_usage(void) {
+    dprintf(2, "Uso: ./bench.exe [opciones]\n"
+               "  -c, --clients N      Flecks concurrentes (4)\n"
+               "  -j, --jobs N         Distorsiones por Fleck (5)\n"
+               "      --enigma N       Instancias de Enigma (1)\n"
+               "      --harley N       Instancias de Harley (1)\n"
+               "      --kinds LISTA    Tipos de archivo: text,png,wav (text)\n"
+               "      --text-size B    Bytes por archivo de texto (16384)\n"
+               "      --wav-size B     Bytes por archivo WAV (65536)\n"
+               "      --png-side PX    Lado de las imágenes PNG (64)\n"
+               "      --port P         Primer puerto en loopback (9400)\n"
+               "      --dir DIR        Directorio de trabajo (bench_run)\n"
+               "  -o, --output FILE    Resultado JSON (stdout)\n");
+}
+
+/***********************************************
+*
+* @Finalitat: Llegir les opcions de línia de comandes.
+* @Parametres:
+*   in:  argc, argv = arguments del programa.
+*   out: opt        = opcions llegides.
+* @Retorn: 0 en èxit, -1 si hi ha opcions invàlides.
+*
+************************************************/
+static int parse_options(int argc, char* argv[], BenchOptions* opt) {
+    static struct option long_options[] = {
+        {"clients", required_argument, 0, 'c'},
+        {"jobs", required_argument, 0, 'j'},
+        {"enigma", required_argument, 0, 'E'},
+        {"harley", required_argument, 0, 'H'},
+        {"kinds", required_argument, 0, 'k'},
+        {"text-size", required_argument, 0, 't'},
+        {"wav-size", required_argument, 0, 'w'},
+        {"png-side", required_argument, 0, 'p'},
+        {"port", required_argument, 0, 'P'},
+        {"dir", required_argument, 0, 'd'},
+        {"output", required_argument, 0, 'o'},
+        {0, 0, 0, 0}
+    };
+
+    *opt = (BenchOptions){ .clients = 4, .jobs = 5, .enigmas = 1, .harleys = 1,
+                           .text_size = 16384, .wav_size = 65536, .png_side = 64,
+                           .kinds = {TIMING_KIND_TEXT}, .num_kinds = 1,
+                           .base_port = 9400, .work_dir = "bench_run", .output = NULL };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "c:j:o:", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'c': opt->clients = atoi(optarg); break;
+            case 'j': opt->jobs = atoi(optarg); break;
+            case 'E': opt->enigmas = atoi(optarg); break;
+            case 'H': opt->harleys = atoi(optarg); break;
+            case 't': opt->text_size = atol(optarg); break;
+            case 'w': opt->wav_size = atol(optarg); break;
+            case 'p': opt->png_side = atoi(optarg); break;
+            case 'P': opt->base_port = atoi(optarg); break;
+            case 'd': opt->work_dir = optarg; break;
+            case 'o': opt->output = optarg; break;
+            case 'k': {
+                opt->num_kinds = 0;
+                for (char* kind = strtok(optarg, ","); kind != NULL; kind = strtok(NULL, ",")) {
+                    int found = bench_kind(kind);
+                    if (found < 0 || opt->num_kinds == TIMINGS_NUM_KINDS) return -1;
+                    opt->kinds[opt->num_kinds++] = found;
+                }
+                break;
+            }
+            default: return -1;
+        }
+    }
+
+    if (opt->clients < 1 || opt->jobs < 1 || opt->num_kinds < 1 || opt->enigmas < 0 || opt->harleys < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalitat: Preparar el directori de treball (bench_prepare_cluster_dir) i el corpus sintètic.
+* @Parametres:
+*   in: opt = opcions del benchmark.
+* @Retorn: 0 en èxit, -1 en error.
+*
+************************************************/
+static int prepare_work_dir(BenchOptions* opt) {
+    int ret = bench_prepare_cluster_dir(opt->work_dir, opt->base_port, opt->enigmas, opt->harleys);
+    if (ret < 0) return -1;
+
+    // Corpus: un archivo base por tipo y un enlace duro por distorsión (nombres únicos para cada trabajo)
+    for (int k = 0; k < opt->num_kinds; k++) {
+        int kind = opt->kinds[k];
+        char* base;
+        asprintf(&base, "users%s/base%s", BENCH_USER_DIR, BENCH_KIND_EXTENSIONS[kind]);
+
+        if (kind == TIMING_KIND_TEXT) ret = bench_write_text(base, opt->text_size, 1);
+        else if (kind == TIMING_KIND_AUDIO) ret = bench_write_wav(base, opt->wav_size, 2);
+        else ret = bench_write_png(base, opt->png_side, 3);
+
+        for (int c = 0; ret == 0 && c < opt->clients; c++) {
+            for (int j = 0; j < opt->jobs; j++) {
+                char* path;
+                asprintf(&path, "users%s/c%d_j%d%s", BENCH_USER_DIR, c, j, BENCH_KIND_EXTENSIONS[kind]);
+                unlink(path);
+                if (link(base, path) < 0) {
+                    perror("Error creando archivo del corpus");
+                    ret = -1;
+                }
+                free(path);
+            }
+        }
+        free(base);
+        if (ret < 0) return -1;
+    }
+
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalitat: Cos d’un client del benchmark (procés fill): es connecta a Gotham i executa les seves
+*             distorsions una darrere l’altra, enviant el resultat de cadascuna pel pipe.
+* @Parametres:
+*   in: opt    = opcions del benchmark.
+*   in: id     = índex del client.
+*   in: out_fd = extrem d’escriptura del pipe de resultats.
+* @Retorn: No retorna (acaba el procés).
+*
+************************************************/
+static void run_client(BenchOptions* opt, int id, int out_fd) {
+    FleckConfig* config = bench_fleck_config(opt->base_port);
+    int sock = bench_connect_gotham_retry(config);
+
+    for (int j = 0; j < opt->jobs; j++) {
+        int kind = opt->kinds[(id + j) % opt->num_kinds];
+        JobRecord record = { .kind = kind, .ok = 0, .bytes = 0, .latency_ms = 0 };
+
+        char* filename;
+        asprintf(&filename, "c%d_j%d%s", id, j, BENCH_KIND_EXTENSIONS[kind]);
+        char* path;
+        asprintf(&path, "users%s/%s", BENCH_USER_DIR, filename);
+        struct stat st;
+        if (stat(path, &st) == 0) record.bytes = st.st_size;
+        free(path);
+
+        if (sock >= 0) {
+            WorkerFleck* worker = NULL;
+            int text_finished = 0, media_finished = 0;
+
+            DistortInfo* distortInfo = bench_new_distort(sock, filename, kind, &worker, &text_finished, &media_finished);
+
+            uint64_t start = timings_now_ns();
+            if (request_distort_gotham(sock, file_type(filename), &worker, distortInfo) > 0) {
+                handle_distort_worker(distortInfo);
+            } else {
+                freeDistortInfo(distortInfo);
+            }
+            record.latency_ms = (timings_now_ns() - start) / 1e6;
+            record.ok = text_finished || media_finished;
+        }
+        free(filename);
+
+        if (write(out_fd, &record, sizeof(record)) != sizeof(record)) {
+            perror("Error enviando resultado del cliente");
+        }
+    }
+
+    FLECK_pool_close_all();
+    bench_disconnect_gotham(sock);
+    bench_free_fleck_config(config);
+    close(out_fd);
+    exit(EXIT_SUCCESS);
+}
+
+/***********************************************
+*
+* @Finalitat: Escriure les estadístiques de latència d’un conjunt de mostres en format JSON.
+* @Parametres:
+*   in: fd        = descriptor de sortida.
+*   in: latencies = latències en ms (s’ordenen).
+*   in: n         = nombre de mostres.
+* @Retorn: ---
+*
+************************************************/
+static void print_latency_json(int fd, double* latencies, int n) {
+    qsort(latencies, n, sizeof(double), bench_compare_double);
+    dprintf(fd, "{\"p50\": %.3f, \"p99\": %.3f, \"p999\": %.3f, \"max\": %.3f}",
+            bench_percentile(latencies, n, 50), bench_percentile(latencies, n, 99),
+            bench_percentile(latencies, n, 99.9), (n > 0) ? latencies[n - 1] : 0.0);
+}
+
+/***********************************************
+*
+* @Finalitat: Calcular i escriure l’informe final en JSON (jobs/s, MB/s i percentils de latència).
+* @Parametres:
+*   in: fd      = descriptor de sortida.
+*   in: opt     = opcions del benchmark.
+*   in: records = resultats de tots els treballs.
+*   in: n       = nombre de resultats.
+*   in: elapsed = durada total en segons.
+* @Retorn: ---
+*
+************************************************/
+static void print_report(int fd, BenchOptions* opt, JobRecord* records, int n, double elapsed) {
+    double* latencies = malloc(sizeof(double) * (n > 0 ? n : 1));
+    int ok = 0;
+    long bytes = 0;
+
+    for (int i = 0; i < n; i++) {
+        if (records[i].ok) {
+            latencies[ok++] = records[i].latency_ms;
+            bytes += records[i].bytes;
+        }
+    }
+
+    dprintf(fd, "{\n  \"config\": {\"clients\": %d, \"jobs_per_client\": %d, \"enigma\": %d, \"harley\": %d, "
+                "\"text_size\": %ld, \"wav_size\": %ld, \"png_side\": %d},\n",
+            opt->clients, opt->jobs, opt->enigmas, opt->harleys, opt->text_size, opt->wav_size, opt->png_side);
+    dprintf(fd, "  \"jobs\": %d,\n  \"ok\": %d,\n  \"failed\": %d,\n  \"elapsed_s\": %.3f,\n", n, ok, n - ok, elapsed);
+    dprintf(fd, "  \"jobs_per_s\": %.3f,\n  \"mb_per_s\": %.3f,\n",
+            (elapsed > 0) ? ok / elapsed : 0.0, (elapsed > 0) ? bytes / 1e6 / elapsed : 0.0);
+    dprintf(fd, "  \"latency_ms\": ");
+    print_latency_json(fd, latencies, ok);
+    dprintf(fd, ",\n  \"per_kind\": {");
+
+    for (int k = 0; k < opt->num_kinds; k++) {
+        int kind = opt->kinds[k];
+        int count = 0;
+        for (int i = 0; i < n; i++) {
+            if (records[i].ok && records[i].kind == kind) latencies[count++] = records[i].latency_ms;
+        }
+        dprintf(fd, "%s\n    \"%s\": {\"ok\": %d, \"latency_ms\": ", (k > 0) ? "," : "", BENCH_KIND_NAMES[kind], count);
+        print_latency_json(fd, latencies, count);
+        dprintf(fd, "}");
+    }
+    dprintf(fd, "\n  }\n}\n");
+
+    free(latencies);
+}
+
+
+int main(int argc, char *argv[]) {
+    BenchOptions opt;
+    if (parse_options(argc, argv, &opt) < 0) {
+        print_usage();
+        return -1;
+    }
+
+    // El JSON se escribe en la salida original; los mensajes de las librerías van al log del driver
+    int json_fd = (opt.output != NULL) ? open(opt.output, O_WRONLY | O_CREAT | O_TRUNC, 0644) : dup(STDOUT_FILENO);
+    if (json_fd < 0) {
+        perror("Error abriendo el archivo de salida");
+        return -1;
+    }
+
+    if (prepare_work_dir(&opt) < 0) {
+        return -1;
+    }
+    int err_fd = dup(STDERR_FILENO);
+    int log_fd = open("logs/driver.log", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (log_fd >= 0) {
+        dup2(log_fd, STDOUT_FILENO);
+        dup2(log_fd, STDERR_FILENO);
+        close(log_fd);
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    // ---- Levantar el sistema: Gotham (con Arkham) y los Workers ----
+    int control_sock = bench_cluster_start(&cluster, opt.base_port, opt.enigmas, opt.harleys, err_fd, opt.work_dir);
+    if (control_sock < 0) {
+        return -1;
+    }
+
+    // ---- Lanzar los clientes ----
+    int pipe_fd[2];
+    if (pipe(pipe_fd) < 0) {
+        dprintf(err_fd, "Error al crear el pipe de resultados.\n");
+        bench_cluster_stop(&cluster);
+        return -1;
+    }
+
+    pid_t* client_pids = calloc(opt.clients, sizeof(pid_t));
+    uint64_t start = timings_now_ns();
+    for (int c = 0; c < opt.clients; c++) {
+        client_pids[c] = fork();
+        if (client_pids[c] == 0) {
+            close(pipe_fd[0]);
+            run_client(&opt, c, pipe_fd[1]);
+        } else if (client_pids[c] < 0) {
+            perror("Error al crear cliente");
+        }
+    }
+    close(pipe_fd[1]);
+
+    // Recoger resultados hasta que todos los clientes cierren el pipe
+    int total = opt.clients * opt.jobs;
+    JobRecord* records = calloc(total, sizeof(JobRecord));
+    int n = 0;
+    JobRecord record;
+    while (n < total && read(pipe_fd[0], &record, sizeof(record)) == sizeof(record)) {
+        records[n++] = record;
+    }
+    close(pipe_fd[0]);
+    for (int c = 0; c < opt.clients; c++) {
+        while (client_pids[c] > 0 && waitpid(client_pids[c], NULL, 0) < 0 && errno == EINTR) {
+            // Reintentar si una señal interrumpe la espera
+        }
+    }
+    free(client_pids);
+    double elapsed = (timings_now_ns() - start) / 1e9;
+
+    print_report(json_fd, &opt, records, n, elapsed);
+    close(json_fd);
+
+    // ---- Parar el sistema ----
+    close(control_sock);
+    free(records);
+
+    bench_cluster_stop(&cluster);
+    return 0;
+}
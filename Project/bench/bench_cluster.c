@@ -0,0 +1,373 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <limits.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "bench_cluster.h"
+
+const char* const BENCH_KIND_EXTENSIONS[TIMINGS_NUM_KINDS] = {".txt", ".png", ".wav"};
+const char* const BENCH_KIND_FACTORS[TIMINGS_NUM_KINDS] = {"3", "2", "100"};
+const char* const BENCH_KIND_NAMES[TIMINGS_NUM_KINDS] = {"text", "png", "wav"};
+
+
+/***********************************************
+*
+* @Finalitat: Escriure un fitxer de configuració amb les línies indicades.
+* @Parametres:
+*   in: path    = ruta del fitxer.
+*   in: content = contingut complet.
+* @Retorn: 0 en èxit, -1 en error.
+*
+************************************************/
+int bench_write_config(const char* path, const char* content) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("Error creando archivo de configuración del benchmark");
+        return -1;
+    }
+    ssize_t written = write(fd, content, strlen(content));
+    close(fd);
+    return (written == (ssize_t)strlen(content)) ? 0 : -1;
+}
+
+/***********************************************
+*
+* @Finalitat: Preparar el directori de treball i entrar-hi: subdirectoris, enllaços als executables
+*             i fitxers de configuració en loopback de Gotham i dels Workers.
+* @Parametres:
+*   in: work_dir  = directori de treball (es crea si no existeix).
+*   in: base_port = port de Gotham per a Flecks (la resta són consecutius).
+*   in: enigmas   = instàncies d’Enigma.
+*   in: harleys   = instàncies de Harley.
+* @Retorn: 0 en èxit, -1 en error.
+*
+************************************************/
+int bench_prepare_cluster_dir(const char* work_dir, int base_port, int enigmas, int harleys) {
+    char project_dir[PATH_MAX];
+    if (getcwd(project_dir, sizeof(project_dir)) == NULL) {
+        perror("Error obteniendo el directorio actual");
+        return -1;
+    }
+
+    mkdir(work_dir, 0755);
+    if (chdir(work_dir) < 0) {
+        perror("Error accediendo al directorio de trabajo");
+        return -1;
+    }
+    mkdir("data", 0755);
+    mkdir("logs", 0755);
+    mkdir("arkham", 0755);
+    mkdir("uploads", 0755);
+    mkdir("users", 0755);
+    mkdir("users" BENCH_USER_DIR, 0755);
+
+    // Gotham ejecuta ./arkham.exe, por lo que todos los ejecutables se enlazan en el directorio de trabajo
+    const char* executables[] = {"gotham.exe", "arkham.exe", "enigma.exe", "harley.exe", NULL};
+    for (int i = 0; executables[i] != NULL; i++) {
+        char* target;
+        asprintf(&target, "%s/%s", project_dir, executables[i]);
+        unlink(executables[i]);
+        if (symlink(target, executables[i]) < 0) {
+            perror("Error enlazando ejecutable");
+            free(target);
+            return -1;
+        }
+        free(target);
+    }
+
+    // Configuración de Gotham: puerto base para Flecks y base+1 para Workers
+    char* content;
+    asprintf(&content, "127.0.0.1\n%d\n127.0.0.1\n%d\n", base_port, base_port + 1);
+    int ret = bench_write_config("data/gotham.dat", content);
+    free(content);
+
+    for (int i = 0; ret == 0 && i < enigmas + harleys; i++) {
+        char* path;
+        int is_enigma = i < enigmas;
+        asprintf(&path, "data/%s_%d.dat", is_enigma ? "enigma" : "harley", i);
+        asprintf(&content, "127.0.0.1\n%d\n127.0.0.1\n%d\n%s\n%s\n",
+                 base_port + 1, base_port + 2 + i, BENCH_USER_DIR, is_enigma ? TEXT : MEDIA);
+        ret = bench_write_config(path, content);
+        free(content);
+        free(path);
+    }
+    return ret;
+}
+
+/***********************************************
+*
+* @Finalitat: Trobar el tipus de fitxer pel seu nom al JSON (text, png o wav).
+* @Parametres:
+*   in: name = nom del tipus (sense distingir majúscules).
+* @Retorn: TIMING_KIND_* o -1 si no existeix.
+*
+************************************************/
+int bench_kind(const char* name) {
+    for (int i = 0; i < TIMINGS_NUM_KINDS; i++) {
+        if (strcasecmp(name, BENCH_KIND_NAMES[i]) == 0) return i;
+    }
+    return -1;
+}
+
+/***********************************************
+*
+* @Finalitat: Llançar un executable del sistema redirigint la seva sortida a un fitxer de log.
+* @Parametres:
+*   in: exe       = executable a llançar (dins del directori de treball).
+*   in: config    = fitxer de configuració que rep com a argument.
+*   in: log       = fitxer on es redirigeix stdout i stderr.
+*   in: log_flags = O_TRUNC per començar el log o O_APPEND per continuar-lo.
+* @Retorn: PID del procés fill, o -1 en error.
+*
+************************************************/
+static pid_t spawn_component(const char* exe, const char* config, const char* log, int log_flags) {
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("Error al hacer fork");
+        return -1;
+    }
+
+    if (pid == 0) {
+        int fd = open(log, O_WRONLY | O_CREAT | log_flags, 0644);
+        if (fd >= 0) {
+            dup2(fd, STDOUT_FILENO);
+            dup2(fd, STDERR_FILENO);
+            close(fd);
+        }
+        execl(exe, exe, config, (char*)NULL);
+        perror("Error al ejecutar componente");
+        exit(EXIT_FAILURE);
+    }
+
+    return pid;
+}
+
+pid_t bench_spawn_component(const char* exe, const char* config, const char* log) {
+    return spawn_component(exe, config, log, O_TRUNC);
+}
+
+/***********************************************
+*
+* @Finalitat: Aturar un procés amb SIGINT (tancament net) i forçar-lo amb SIGKILL si no acaba a temps.
+* @Parametres:
+*   in: pid = procés a aturar.
+* @Retorn: ---
+*
+************************************************/
+void bench_stop_component(pid_t pid) {
+    if (pid <= 0) return;
+
+    kill(pid, SIGINT);
+    for (int waited = 0; waited < BENCH_STOP_TIMEOUT_MS; waited += 50) {
+        if (waitpid(pid, NULL, WNOHANG) == pid) return;
+        usleep(50000);
+    }
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+}
+
+/***********************************************
+*
+* @Finalitat: Llançar el Worker indicat del clúster amb la seva configuració i el seu log (si ja
+*             s’havia llançat abans, el log continua).
+* @Parametres:
+*   in/out: cluster = clúster.
+*   in:     index   = índex del Worker.
+* @Retorn: PID del Worker, o -1 en error.
+*
+************************************************/
+pid_t bench_cluster_spawn_worker(BenchCluster* cluster, int index) {
+    int is_enigma = index < cluster->enigmas;
+    char *path, *log;
+    asprintf(&path, "data/%s_%d.dat", is_enigma ? "enigma" : "harley", index);
+    asprintf(&log, "logs/%s_%d.log", is_enigma ? "enigma" : "harley", index);
+    cluster->worker_pids[index] = spawn_component(is_enigma ? "./enigma.exe" : "./harley.exe", path, log,
+                                                  cluster->worker_pids[index] != 0 ? O_APPEND : O_TRUNC);
+    free(path);
+    free(log);
+    return cluster->worker_pids[index];
+}
+
+/***********************************************
+*
+* @Finalitat: Aixecar el clúster: Gotham (amb Arkham) i els Workers en ordre, i esperar que tots
+*             s’hagin registrat. Els logs de cada component van a logs/ del directori de treball.
+* @Parametres:
+*   out: cluster   = clúster.
+*   in:  base_port = port de Gotham per a Flecks.
+*   in:  enigmas   = instàncies d’Enigma.
+*   in:  harleys   = instàncies de Harley.
+*   in:  err_fd    = descriptor on s’informa dels errors.
+*   in:  work_dir  = directori de treball (per als missatges).
+* @Retorn: Socket de control connectat amb Gotham com a Fleck, o -1 en error (el clúster queda aturat).
+*
+************************************************/
+int bench_cluster_start(BenchCluster* cluster, int base_port, int enigmas, int harleys, int err_fd, const char* work_dir) {
+    cluster->base_port = base_port;
+    cluster->enigmas = enigmas;
+    cluster->num_workers = enigmas + harleys;
+    cluster->worker_pids = calloc(cluster->num_workers > 0 ? cluster->num_workers : 1, sizeof(pid_t));
+    cluster->gotham_pid = bench_spawn_component("./gotham.exe", "data/gotham.dat", "logs/gotham.log");
+
+    FleckConfig* config = bench_fleck_config(base_port);
+    int control_sock = bench_connect_gotham_retry(config);
+    bench_free_fleck_config(config);
+    if (control_sock < 0) {
+        dprintf(err_fd, "Gotham no responde (ver %s/logs).\n", work_dir);
+        bench_cluster_stop(cluster);
+        return -1;
+    }
+
+    for (int i = 0; i < cluster->num_workers; i++) {
+        bench_cluster_spawn_worker(cluster, i);
+        usleep(100000);     // Registrar los Workers en orden (el primero de cada tipo es el principal)
+    }
+    if (bench_wait_workers(control_sock, cluster->num_workers) < 0) {
+        dprintf(err_fd, "Los Workers no se han registrado en Gotham (ver %s/logs).\n", work_dir);
+        close(control_sock);
+        bench_cluster_stop(cluster);
+        return -1;
+    }
+    return control_sock;
+}
+
+/***********************************************
+*
+* @Finalitat: Trobar el Worker del clúster que escolta Flecks al port indicat.
+* @Parametres:
+*   in: cluster = clúster.
+*   in: port    = port del Worker.
+* @Retorn: Índex del Worker, o -1 si no és del clúster.
+*
+************************************************/
+int bench_cluster_worker_by_port(BenchCluster* cluster, int port) {
+    int index = port - (cluster->base_port + 2);
+    return (index >= 0 && index < cluster->num_workers) ? index : -1;
+}
+
+/***********************************************
+*
+* @Finalitat: Aturar tots els components llançats: primer els Workers i després Gotham (que tanca Arkham).
+* @Parametres:
+*   in/out: cluster = clúster.
+* @Retorn: ---
+*
+************************************************/
+void bench_cluster_stop(BenchCluster* cluster) {
+    for (int i = 0; i < cluster->num_workers; i++) {
+        bench_stop_component(cluster->worker_pids[i]);
+    }
+    bench_stop_component(cluster->gotham_pid);
+    free(cluster->worker_pids);
+    cluster->worker_pids = NULL;
+    cluster->num_workers = 0;
+    cluster->gotham_pid = -1;
+}
+
+/***********************************************
+*
+* @Finalitat: Crear una configuració de Fleck per al benchmark.
+* @Parametres:
+*   in: port = port de Gotham per a Flecks.
+* @Retorn: Configuració dinàmica (cal alliberar-la amb bench_free_fleck_config).
+*
+************************************************/
+FleckConfig* bench_fleck_config(int port) {
+    FleckConfig* config = malloc(sizeof(FleckConfig));
+    config->username = strdup(BENCH_USER);
+    config->user_dir = strdup(BENCH_USER_DIR);
+    config->gotham_ip = strdup("127.0.0.1");
+    config->gotham_port = port;
+    return config;
+}
+
+void bench_free_fleck_config(FleckConfig* config) {
+    free(config->username);
+    free(config->user_dir);
+    free(config->gotham_ip);
+    free(config);
+}
+
+/***********************************************
+*
+* @Finalitat: Connectar com a Fleck amb Gotham, reintentant fins que accepti connexions.
+* @Parametres:
+*   in: config = configuració del Fleck del benchmark.
+* @Retorn: Socket connectat, o -1 si s’esgota el temps.
+*
+************************************************/
+int bench_connect_gotham_retry(FleckConfig* config) {
+    for (int waited = 0; waited < BENCH_STARTUP_TIMEOUT_MS; waited += 100) {
+        int sock = FLECK_connect_to_gotham(config);
+        if (sock >= 0) return sock;
+        usleep(100000);
+    }
+    return -1;
+}
+
+/***********************************************
+*
+* @Finalitat: Esperar fins que Gotham tingui registrats el nombre de Workers indicat.
+* @Parametres:
+*   in: sock     = connexió Fleck amb Gotham.
+*   in: expected = nombre de Workers esperat.
+* @Retorn: 0 si s’arriba al nombre esperat, -1 si s’esgota el temps.
+*
+************************************************/
+int bench_wait_workers(int sock, int expected) {
+    long stats[BENCH_STATS_FIELDS];
+    for (int waited = 0; waited < BENCH_STARTUP_TIMEOUT_MS; waited += 100) {
+        if (bench_query_stats(sock, stats) == BENCH_STATS_FIELDS && stats[BENCH_STAT_WORKERS] >= expected) {
+            return 0;
+        }
+        usleep(100000);
+    }
+    return -1;
+}
+
+/***********************************************
+*
+* @Finalitat: Preparar la informació d’una distorsió del benchmark (users/bench/<fitxer>).
+* @Parametres:
+*   in:  sock           = connexió Fleck amb Gotham.
+*   in:  filename       = fitxer a distorsionar.
+*   in:  kind           = tipus de fitxer (TIMING_KIND_*).
+*   in:  worker         = punter on es guardarà el Worker assignat.
+*   out: text_finished  = indicador de distorsió Text acabada.
+*   out: media_finished = indicador de distorsió Media acabada.
+* @Retorn: Informació dinàmica per a request_distort_gotham i handle_distort_worker.
+*
+************************************************/
+DistortInfo* bench_new_distort(int sock, const char* filename, int kind, WorkerFleck** worker,
+                               int* text_finished, int* media_finished) {
+    DistortInfo* distortInfo = calloc(1, sizeof(DistortInfo));
+    distortInfo->username = strdup(BENCH_USER);
+    distortInfo->user_dir = strdup(BENCH_USER_DIR);
+    distortInfo->filename = strdup(filename);
+    distortInfo->distortion_factor = strdup(BENCH_KIND_FACTORS[kind]);
+    distortInfo->worker_ptr = worker;
+    distortInfo->flag_distort_text_finished = text_finished;
+    distortInfo->flag_distort_media_finished = media_finished;
+    distortInfo->socket_gotham = sock;
+    return distortInfo;
+}
+
+/***********************************************
+*
+* @Finalitat: Tancar la sessió de Fleck amb Gotham (LOGOUT) i el socket.
+* @Parametres:
+*   in: sock = connexió Fleck amb Gotham (no fa res si és negatiu).
+* @Retorn: ---
+*
+************************************************/
+void bench_disconnect_gotham(int sock) {
+    if (sock < 0) return;
+    unsigned char* trama = crear_trama(TYPE_DISCONNECTION, (unsigned char*)"LOGOUT", strlen("LOGOUT"));
+    if (trama != NULL) {
+        write(sock, trama, BUFFER_SIZE);
+        free(trama);
+    }
+    close(sock);
+}
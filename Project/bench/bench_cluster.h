@@ -0,0 +1,50 @@
+#ifndef BENCH_CLUSTER_H
+#define BENCH_CLUSTER_H
+
+#define _GNU_SOURCE
+#include <sys/types.h>
+
+#include "bench_utils.h"
+#include "../fleck/flecklib.h"
+#include "../fleck/flecklib_distort.h"
+
+// Clúster local (Gotham, Arkham y Workers en loopback) compartido por los benchmarks de extremo a extremo
+#define BENCH_USER "bench"
+#define BENCH_USER_DIR "/bench"
+#define BENCH_STARTUP_TIMEOUT_MS 10000
+#define BENCH_STOP_TIMEOUT_MS 3000
+
+extern const char* const BENCH_KIND_EXTENSIONS[TIMINGS_NUM_KINDS];
+extern const char* const BENCH_KIND_FACTORS[TIMINGS_NUM_KINDS];
+extern const char* const BENCH_KIND_NAMES[TIMINGS_NUM_KINDS];
+
+// Procesos del clúster (para pararlos, matarlos o volver a lanzarlos)
+typedef struct {
+    int base_port;          // Gotham-Flecks; base+1 Gotham-Workers; base+2+i el Worker i
+    int enigmas;            // Los Workers 0..enigmas-1 son Enigma y el resto Harley
+    int num_workers;
+    pid_t gotham_pid;
+    pid_t* worker_pids;
+} BenchCluster;
+
+
+int bench_write_config(const char* path, const char* content);
+int bench_prepare_cluster_dir(const char* work_dir, int base_port, int enigmas, int harleys);
+int bench_kind(const char* name);
+
+pid_t bench_spawn_component(const char* exe, const char* config, const char* log);
+void bench_stop_component(pid_t pid);
+int bench_cluster_start(BenchCluster* cluster, int base_port, int enigmas, int harleys, int err_fd, const char* work_dir);
+pid_t bench_cluster_spawn_worker(BenchCluster* cluster, int index);
+int bench_cluster_worker_by_port(BenchCluster* cluster, int port);
+void bench_cluster_stop(BenchCluster* cluster);
+
+FleckConfig* bench_fleck_config(int port);
+void bench_free_fleck_config(FleckConfig* config);
+int bench_connect_gotham_retry(FleckConfig* config);
+int bench_wait_workers(int sock, int expected);
+DistortInfo* bench_new_distort(int sock, const char* filename, int kind, WorkerFleck** worker,
+                               int* text_finished, int* media_finished);
+void bench_disconnect_gotham(int sock);
+
+#endif
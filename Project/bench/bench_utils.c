@@ -0,0 +1,395 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <math.h>
+
+#include "bench_utils.h"
+
+/***********************************************
+*
+* @Finalitat: Escriure tot el buffer al descriptor, repetint mentre write() escrigui parcialment.
+* @Parametres:
+*   in: fd     = descriptor de fitxer.
+*   in: buffer = dades a escriure.
+*   in: length = nombre de bytes.
+* @Retorn: 0 en èxit, -1 en error.
+*
+************************************************/
+static int write_all(int fd, const void* buffer, size_t length) {
+    const unsigned char* p = buffer;
+    while (length > 0) {
+        ssize_t written = write(fd, p, length);
+        if (written <= 0) {
+            perror("Error escribiendo archivo del corpus");
+            return -1;
+        }
+        p += written;
+        length -= written;
+    }
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalitat: Generar un fitxer de text sintètic amb paraules aleatòries de 1 a 10 lletres.
+* @Parametres:
+*   in: path  = ruta del fitxer a crear.
+*   in: bytes = mida del fitxer.
+*   in: seed  = llavor del generador aleatori.
+* @Retorn: 0 en èxit, -1 en error.
+*
+************************************************/
+int bench_write_text(const char* path, long bytes, unsigned int seed) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("Error creando archivo de texto del corpus");
+        return -1;
+    }
+
+    char buffer[4096];
+    int used = 0;
+    int word_left = 1 + rand_r(&seed) % 10;
+
+    for (long i = 0; i < bytes; i++) {
+        if (word_left > 0) {
+            buffer[used++] = 'a' + rand_r(&seed) % 26;
+            word_left--;
+        } else {
+            // Separador entre palabras (espacios, puntuación y saltos de línea)
+            int r = rand_r(&seed) % 16;
+            buffer[used++] = (r == 0) ? '\n' : (r == 1) ? ',' : (r == 2) ? '.' : ' ';
+            word_left = 1 + rand_r(&seed) % 10;
+        }
+
+        if (used == (int)sizeof(buffer)) {
+            if (write_all(fd, buffer, used) < 0) {
+                close(fd);
+                return -1;
+            }
+            used = 0;
+        }
+    }
+
+    int ret = write_all(fd, buffer, used);
+    close(fd);
+    return ret;
+}
+
+// Escribe un entero little-endian de 'size' bytes en 'p'
+static void put_le(unsigned char* p, uint32_t value, int size) {
+    for (int i = 0; i < size; i++) {
+        p[i] = (value >> (8 * i)) & 0xFF;
+    }
+}
+
+// Escribe un entero big-endian de 4 bytes en 'p'
+static void put_be32(unsigned char* p, uint32_t value) {
+    p[0] = (value >> 24) & 0xFF;
+    p[1] = (value >> 16) & 0xFF;
+    p[2] = (value >> 8) & 0xFF;
+    p[3] = value & 0xFF;
+}
+
+/***********************************************
+*
+* @Finalitat: Generar un fitxer WAV PCM de 16 bits mono a 44.1 kHz amb un to sinusoidal i soroll.
+* @Parametres:
+*   in: path  = ruta del fitxer a crear.
+*   in: bytes = mida total del fitxer (inclosa la capçalera de 44 bytes).
+*   in: seed  = llavor del generador aleatori.
+* @Retorn: 0 en èxit, -1 en error.
+*
+************************************************/
+int bench_write_wav(const char* path, long bytes, unsigned int seed) {
+    long data_size = (bytes > 46) ? ((bytes - 44) & ~1L) : 2;
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("Error creando archivo WAV del corpus");
+        return -1;
+    }
+
+    // Cabecera RIFF/WAVE
+    unsigned char header[44];
+    memcpy(header, "RIFF", 4);
+    put_le(header + 4, 36 + data_size, 4);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    put_le(header + 16, 16, 4);         // Tamaño del bloque fmt
+    put_le(header + 20, 1, 2);          // PCM
+    put_le(header + 22, 1, 2);          // Mono
+    put_le(header + 24, 44100, 4);      // Frecuencia de muestreo
+    put_le(header + 28, 44100 * 2, 4);  // Bytes por segundo
+    put_le(header + 32, 2, 2);          // Bytes por muestra
+    put_le(header + 34, 16, 2);         // Bits por muestra
+    memcpy(header + 36, "data", 4);
+    put_le(header + 40, data_size, 4);
+
+    if (write_all(fd, header, sizeof(header)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    unsigned char buffer[4096];
+    int used = 0;
+    for (long i = 0; i < data_size / 2; i++) {
+        double sample = 12000.0 * sin(2.0 * M_PI * 440.0 * i / 44100.0) + (rand_r(&seed) % 2001 - 1000);
+        put_le(buffer + used, (uint16_t)(int16_t)sample, 2);
+        used += 2;
+
+        if (used == (int)sizeof(buffer)) {
+            if (write_all(fd, buffer, used) < 0) {
+                close(fd);
+                return -1;
+            }
+            used = 0;
+        }
+    }
+
+    int ret = write_all(fd, buffer, used);
+    close(fd);
+    return ret;
+}
+
+// CRC-32 (polinomio 0xEDB88320) utilizado por los chunks PNG
+static uint32_t crc32_update(uint32_t crc, const unsigned char* data, size_t length) {
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ (0xEDB88320U & (-(crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+/***********************************************
+*
+* @Finalitat: Escriure un chunk PNG (longitud, tipus, dades i CRC).
+* @Parametres:
+*   in: fd     = descriptor del fitxer PNG.
+*   in: type   = tipus del chunk (4 caràcters).
+*   in: data   = contingut del chunk.
+*   in: length = longitud del contingut.
+* @Retorn: 0 en èxit, -1 en error.
+*
+************************************************/
+static int write_png_chunk(int fd, const char* type, const unsigned char* data, uint32_t length) {
+    unsigned char header[8];
+    unsigned char footer[4];
+
+    put_be32(header, length);
+    memcpy(header + 4, type, 4);
+
+    uint32_t crc = crc32_update(0, (const unsigned char*)type, 4);
+    crc = crc32_update(crc, data, length);
+    put_be32(footer, crc);
+
+    if (write_all(fd, header, sizeof(header)) < 0) return -1;
+    if (length > 0 && write_all(fd, data, length) < 0) return -1;
+    return write_all(fd, footer, sizeof(footer));
+}
+
+/***********************************************
+*
+* @Finalitat: Generar una imatge PNG RGB quadrada amb un degradat i soroll. Les dades es guarden amb
+*             blocs deflate sense comprimir, de manera que la mida del fitxer és proporcional als píxels.
+* @Parametres:
+*   in: path = ruta del fitxer a crear.
+*   in: side = amplada i alçada en píxels.
+*   in: seed = llavor del generador aleatori.
+* @Retorn: 0 en èxit, -1 en error.
+*
+************************************************/
+int bench_write_png(const char* path, int side, unsigned int seed) {
+    if (side < 1) side = 1;
+
+    // Datos de imagen sin comprimir: un byte de filtro (0) + RGB por fila
+    size_t row_size = 1 + 3 * (size_t)side;
+    size_t raw_size = row_size * side;
+    unsigned char* raw = malloc(raw_size);
+    if (raw == NULL) {
+        perror("Error en malloc para imagen del corpus");
+        return -1;
+    }
+    for (int y = 0; y < side; y++) {
+        unsigned char* row = raw + y * row_size;
+        row[0] = 0;
+        for (int x = 0; x < side; x++) {
+            row[1 + 3 * x] = (x * 255 / side + rand_r(&seed) % 16) & 0xFF;
+            row[2 + 3 * x] = (y * 255 / side + rand_r(&seed) % 16) & 0xFF;
+            row[3 + 3 * x] = ((x + y) * 127 / side + rand_r(&seed) % 16) & 0xFF;
+        }
+    }
+
+    // Flujo zlib con bloques "stored" de como máximo 65535 bytes
+    size_t blocks = raw_size / 65535 + 1;
+    size_t zlib_size = 2 + raw_size + blocks * 5 + 4;
+    unsigned char* zlib = malloc(zlib_size);
+    if (zlib == NULL) {
+        perror("Error en malloc para imagen del corpus");
+        free(raw);
+        return -1;
+    }
+
+    size_t pos = 0;
+    zlib[pos++] = 0x78;
+    zlib[pos++] = 0x01;
+    uint32_t adler_a = 1, adler_b = 0;
+    size_t offset = 0;
+    for (size_t b = 0; b < blocks; b++) {
+        uint32_t length = (raw_size - offset > 65535) ? 65535 : raw_size - offset;
+        zlib[pos++] = (b == blocks - 1) ? 0x01 : 0x00;  // BFINAL en el último bloque
+        put_le(zlib + pos, length, 2);
+        put_le(zlib + pos + 2, ~length & 0xFFFF, 2);
+        pos += 4;
+        memcpy(zlib + pos, raw + offset, length);
+        pos += length;
+
+        for (uint32_t i = 0; i < length; i++) {
+            adler_a = (adler_a + raw[offset + i]) % 65521;
+            adler_b = (adler_b + adler_a) % 65521;
+        }
+        offset += length;
+    }
+    put_be32(zlib + pos, (adler_b << 16) | adler_a);
+    pos += 4;
+    free(raw);
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("Error creando archivo PNG del corpus");
+        free(zlib);
+        return -1;
+    }
+
+    unsigned char ihdr[13];
+    put_be32(ihdr, side);
+    put_be32(ihdr + 4, side);
+    ihdr[8] = 8;    // Bits por canal
+    ihdr[9] = 2;    // RGB
+    ihdr[10] = 0;   // Compresión deflate
+    ihdr[11] = 0;   // Filtro estándar
+    ihdr[12] = 0;   // Sin entrelazado
+
+    int ret = 0;
+    if (write_all(fd, "\x89PNG\r\n\x1a\n", 8) < 0 ||
+        write_png_chunk(fd, "IHDR", ihdr, sizeof(ihdr)) < 0 ||
+        write_png_chunk(fd, "IDAT", zlib, pos) < 0 ||
+        write_png_chunk(fd, "IEND", NULL, 0) < 0) {
+        ret = -1;
+    }
+
+    free(zlib);
+    close(fd);
+    return ret;
+}
+
+// Comparador para qsort de doubles
+int bench_compare_double(const void* a, const void* b) {
+    double da = *(const double*)a;
+    double db = *(const double*)b;
+    return (da > db) - (da < db);
+}
+
+/***********************************************
+*
+* @Finalitat: Calcular un percentil (mètode del rang més proper) sobre mostres ja ordenades.
+* @Parametres:
+*   in: sorted     = mostres ordenades de menor a major.
+*   in: n          = nombre de mostres.
+*   in: percentile = percentil desitjat (0-100).
+* @Retorn: Valor del percentil, o 0 si no hi ha mostres.
+*
+************************************************/
+double bench_percentile(const double* sorted, int n, double percentile) {
+    if (n <= 0) return 0;
+
+    int rank = (int)ceil(percentile / 100.0 * n);
+    if (rank < 1) rank = 1;
+    if (rank > n) rank = n;
+    return sorted[rank - 1];
+}
+
+/***********************************************
+*
+* @Finalitat: Calcular la mediana d’un conjunt de mostres (les ordena in situ).
+* @Parametres:
+*   in/out: values = mostres.
+*   in:     n      = nombre de mostres.
+* @Retorn: Mediana, o 0 si no hi ha mostres.
+*
+************************************************/
+double bench_median(double* values, int n) {
+    if (n <= 0) return 0;
+
+    qsort(values, n, sizeof(double), bench_compare_double);
+    return (n % 2 == 1) ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2.0;
+}
+
+/***********************************************
+*
+* @Finalitat: Calcular la desviació absoluta mediana (MAD): mediana de |x - mediana|. És robusta davant
+*             de mostres aïllades molt lentes (interrupcions, canvis de context), a diferència de la
+*             desviació típica.
+* @Parametres:
+*   in: values = mostres.
+*   in: n      = nombre de mostres.
+*   in: median = mediana de les mostres.
+* @Retorn: MAD, o 0 si no hi ha mostres.
+*
+************************************************/
+double bench_mad(const double* values, int n, double median) {
+    if (n <= 0) return 0;
+
+    double* deviations = malloc(sizeof(double) * n);
+    if (deviations == NULL) return 0;
+    for (int i = 0; i < n; i++) {
+        deviations[i] = fabs(values[i] - median);
+    }
+    double mad = bench_median(deviations, n);
+    free(deviations);
+    return mad;
+}
+
+/***********************************************
+*
+* @Finalitat: Demanar a Gotham els seus comptadors amb una trama TYPE_STATS i guardar-los en un array.
+* @Parametres:
+*   in:  socket_gotham = socket d’una connexió Fleck ja establerta amb Gotham.
+*   out: values        = array de BENCH_STATS_FIELDS posicions.
+* @Retorn: Nombre de camps llegits, o -1 en error.
+*
+************************************************/
+int bench_query_stats(int socket_gotham, long* values) {
+    unsigned char *trama = crear_trama(TYPE_STATS, (unsigned char*)"", strlen(""));
+    if (trama == NULL) {
+        return -1;
+    }
+    if (write(socket_gotham, trama, BUFFER_SIZE) < 0) {
+        free(trama);
+        return -1;
+    }
+    free(trama);
+
+    unsigned char response[BUFFER_SIZE];
+    if (recv(socket_gotham, response, BUFFER_SIZE, MSG_WAITALL) != BUFFER_SIZE) {
+        return -1;
+    }
+
+    TramaResult *result = leer_trama(response);
+    if (result == NULL || result->type != TYPE_STATS) {
+        if (result) free_tramaResult(result);
+        return -1;
+    }
+
+    // strtok_r: el driver puede consultar los contadores mientras otro hilo usa la librería de Fleck
+    int fields = 0;
+    char* saveptr;
+    char* value = strtok_r(result->data, "&", &saveptr);
+    while (value != NULL && fields < BENCH_STATS_FIELDS) {
+        values[fields++] = atol(value);
+        value = strtok_r(NULL, "&", &saveptr);
+    }
+
+    free_tramaResult(result);
+    return fields;
+}
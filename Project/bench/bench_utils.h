@@ -0,0 +1,34 @@
+#ifndef BENCH_UTILS_H
+#define BENCH_UTILS_H
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+
+#include "../config/config.h"
+#include "../config/connections.h"
+#include "../config/timings.h"
+
+// Número de campos de la trama TYPE_STATS de Gotham
+#define BENCH_STATS_FIELDS 15
+#define BENCH_STAT_DISTORT 1
+#define BENCH_STAT_FAILOVERS 4
+#define BENCH_STAT_HB_MISSED 6
+#define BENCH_STAT_FLECKS 7
+#define BENCH_STAT_WORKERS 8
+
+// Generación de corpus sintéticos
+int bench_write_text(const char* path, long bytes, unsigned int seed);
+int bench_write_wav(const char* path, long bytes, unsigned int seed);
+int bench_write_png(const char* path, int side, unsigned int seed);
+
+// Estadística sobre muestras
+int bench_compare_double(const void* a, const void* b);
+double bench_percentile(const double* sorted, int n, double percentile);
+double bench_median(double* values, int n);
+double bench_mad(const double* values, int n, double median);
+
+// Consulta de los contadores de Gotham (TYPE_STATS)
+int bench_query_stats(int socket_gotham, long* values);
+
+#endif
@@ -0,0 +1,788 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <math.h>
+#include <getopt.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "bench_cluster.h"
+
+// Escalabilidad de conexiones de Gotham: miles de Flecks (inactivos y activos) y de Workers simulados
+// por niveles crecientes; unos pocos hilos con epoll responden a los HEARTBEAT y piden distorsiones
+#define SCALE_MAX_LEVELS 16
+#define SCALE_MAX_THREADS 64
+#define SCALE_EPOLL_EVENTS 64
+#define SCALE_EPOLL_WAIT_MS 5
+#define SCALE_HANDSHAKE_TIMEOUT_S 5     // Máximo para la respuesta al CONNECT (Gotham saturado no responde)
+#define SCALE_SETTLE_MS 1000            // Espera tras abrir las conexiones de un nivel antes de medir
+#define SCALE_WORKER_LOAD "0&0&16&0.00&100000&0.0"  // Respuesta a HEARTBEAT: Worker sin carga
+
+#define SCALE_CONN_WORKER 0
+#define SCALE_CONN_IDLE 1
+#define SCALE_CONN_ACTIVE 2
+
+// Opciones del benchmark (configurables por línea de comandos)
+typedef struct {
+    int flecks[SCALE_MAX_LEVELS];       // Flecks totales de cada nivel
+    int workers[SCALE_MAX_LEVELS];      // Workers simulados de cada nivel
+    int num_levels;
+    int active;                         // Flecks que piden distorsiones (el resto solo mantiene la conexión)
+    int interval_ms;                    // Espera de cada Fleck activo entre una respuesta y el siguiente DISTORT
+    int threads;                        // Hilos con epoll que atienden las conexiones
+    int connectors;                     // Hilos que abren conexiones en paralelo
+    int window_s;                       // Ventana de medida de cada nivel
+    int base_port;
+    char* work_dir;
+    char* output;
+    char* options[SCALE_MAX_LEVELS];    // Líneas <clave>=<valor> añadidas a gotham.dat
+    int num_options;
+} ScaleOptions;
+
+// Muestras de una ventana de medida
+typedef struct {
+    double* values;
+    int count;
+    int capacity;
+} Samples;
+
+// Conexión simulada con Gotham
+typedef struct {
+    int fd;
+    int kind;                           // SCALE_CONN_*
+    int thread;                         // Hilo con epoll que la atiende
+    uint64_t last_heartbeat_ns;         // Workers: último HEARTBEAT recibido
+    uint64_t next_send_ns;              // Flecks activos: próximo DISTORT
+    uint64_t sent_ns;                   // Flecks activos: DISTORT pendiente de respuesta (0 si no hay)
+} ScaleConn;
+
+// Hilo con epoll y lo que ha medido en la ventana actual
+typedef struct {
+    pthread_t thread;
+    int epoll_fd;
+    pthread_mutex_t mutex;
+    ScaleConn** active;                 // Flecks activos de este hilo
+    int num_active;
+    int capacity_active;
+    Samples distort_ms;                 // Latencia de las respuestas a DISTORT
+    Samples jitter_ms;                  // Desviación del intervalo entre HEARTBEAT respecto al nominal
+    long assigned;
+    long busy;
+    long rejected;
+    long closed;                        // Conexiones cerradas por Gotham
+} ScaleThread;
+
+// Apertura en paralelo de las conexiones de un nivel
+typedef struct {
+    int kind;
+    int first;                          // Índice global de la primera conexión (usuario o puerto)
+    int count;
+    atomic_int next;
+    atomic_int failed;
+    pthread_mutex_t mutex;
+    Samples handshake_ms;
+} ConnectBatch;
+
+// Resultado de un nivel
+typedef struct {
+    int flecks;
+    int workers;
+    double fleck_accept_per_s;
+    double worker_accept_per_s;
+    double handshake_p50, handshake_p99, handshake_max;
+    int failed;
+    long requests, assigned, busy, rejected, closed;
+    double distort_p50, distort_p99, distort_p999, distort_max;
+    int heartbeats;
+    double jitter_p50, jitter_p99, jitter_max;
+    long heartbeats_missed;
+    long gotham_flecks, gotham_workers;
+    long rss_kb, threads;
+    double kb_per_conn;
+} LevelResult;
+
+static BenchCluster cluster;
+static ScaleOptions opt;
+static ScaleThread threads[SCALE_MAX_THREADS];
+static atomic_int running = 1;
+static atomic_int measuring = 0;
+
+
+/***********************************************
+*
+* @Finalitat: Mostrar l’ús del benchmark.
+* @Parametres: ---
+* @Retorn: ---
+*
+************************************************/
+static void print_usage(void) {
+    dprintf(2, "Uso: ./connscale.exe [opciones]\n"
+               "  -f, --flecks LISTA      Flecks por nivel (500,1000,2000,4000)\n"
+               "  -w, --workers LISTA     Workers simulados por nivel (250,500,1000,2000)\n"
+               "  -a, --active N          Flecks que piden distorsiones (200)\n"
+               "      --interval-ms MS    Espera de cada Fleck activo entre DISTORTs (1000)\n"
+               "  -t, --threads N         Hilos con epoll (4)\n"
+               "      --connectors N      Hilos que abren conexiones (4)\n"
+               "  -d, --window S          Segundos de medida por nivel (12)\n"
+               "  -g clave=valor          Opción de gotham.dat, repetible (routing=affinity)\n"
+               "      --port P            Primer puerto en loopback (9600)\n"
+               "      --dir DIR           Directorio de trabajo (connscale_run)\n"
+               "  -o, --output FILE       Resultado JSON (stdout)\n");
+}
+
+/***********************************************
+*
+* @Finalitat: Llegir una llista de valors enters positius separats per comes.
+* @Parametres:
+*   in:  list   = cadena a llegir (es modifica).
+*   out: values = valors llegits.
+* @Retorn: Nombre de valors, o -1 si n’hi ha d’invàlids o massa.
+*
+************************************************/
+static int parse_list(char* list, int* values) {
+    int count = 0;
+    for (char* value = strtok(list, ","); value != NULL; value = strtok(NULL, ",")) {
+        if (count == SCALE_MAX_LEVELS || atoi(value) < 0) return -1;
+        values[count++] = atoi(value);
+    }
+    return count;
+}
+
+/***********************************************
+*
+* @Finalitat: Llegir les opcions de línia de comandes.
+* @Parametres:
+*   in: argc, argv = arguments del programa.
+* @Retorn: 0 en èxit, -1 si hi ha opcions invàlides.
+*
+************************************************/
+static int parse_options(int argc, char* argv[]) {
+    static struct option long_options[] = {
+        {"flecks", required_argument, 0, 'f'},
+        {"workers", required_argument, 0, 'w'},
+        {"active", required_argument, 0, 'a'},
+        {"interval-ms", required_argument, 0, 'I'},
+        {"threads", required_argument, 0, 't'},
+        {"connectors", required_argument, 0, 'C'},
+        {"window", required_argument, 0, 'd'},
+        {"port", required_argument, 0, 'P'},
+        {"dir", required_argument, 0, 'D'},
+        {"output", required_argument, 0, 'o'},
+        {0, 0, 0, 0}
+    };
+
+    opt = (ScaleOptions){ .flecks = {500, 1000, 2000, 4000}, .workers = {250, 500, 1000, 2000}, .num_levels = 4,
+                          .active = 200, .interval_ms = 1000, .threads = 4, .connectors = 4, .window_s = 12,
+                          .base_port = 9600, .work_dir = "connscale_run", .output = NULL,
+                          .options = {"routing=affinity"}, .num_options = 1 };
+    int num_flecks = opt.num_levels, num_workers = opt.num_levels, custom_options = 0;
+
+    int c;
+    while ((c = getopt_long(argc, argv, "f:w:a:t:d:g:o:", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'f': num_flecks = parse_list(optarg, opt.flecks); break;
+            case 'w': num_workers = parse_list(optarg, opt.workers); break;
+            case 'a': opt.active = atoi(optarg); break;
+            case 'I': opt.interval_ms = atoi(optarg); break;
+            case 't': opt.threads = atoi(optarg); break;
+            case 'C': opt.connectors = atoi(optarg); break;
+            case 'd': opt.window_s = atoi(optarg); break;
+            case 'g':
+                if (!custom_options) opt.num_options = 0;
+                custom_options = 1;
+                if (opt.num_options == SCALE_MAX_LEVELS) return -1;
+                opt.options[opt.num_options++] = optarg;
+                break;
+            case 'P': opt.base_port = atoi(optarg); break;
+            case 'D': opt.work_dir = optarg; break;
+            case 'o': opt.output = optarg; break;
+            default: return -1;
+        }
+    }
+
+    // Con una sola cifra en una de las listas se repite en todos los niveles de la otra
+    if (num_flecks == 1 && num_workers > 1) {
+        for (int i = 1; i < num_workers; i++) opt.flecks[i] = opt.flecks[0];
+        num_flecks = num_workers;
+    } else if (num_workers == 1 && num_flecks > 1) {
+        for (int i = 1; i < num_flecks; i++) opt.workers[i] = opt.workers[0];
+        num_workers = num_flecks;
+    }
+    opt.num_levels = num_flecks;
+    for (int i = 1; i < opt.num_levels; i++) {
+        if (opt.flecks[i] < opt.flecks[i - 1] || opt.workers[i] < opt.workers[i - 1]) return -1;
+    }
+
+    // La ventana debe abarcar al menos un intervalo completo entre HEARTBEATs
+    if (num_flecks < 1 || num_flecks != num_workers || opt.active < 0 || opt.interval_ms < 0
+        || opt.threads < 1 || opt.threads > SCALE_MAX_THREADS || opt.connectors < 1
+        || opt.window_s <= HEARTBEAT_SLEEP_TIME) {
+        return -1;
+    }
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalitat: Afegir una mostra.
+* @Parametres:
+*   in/out: samples = conjunt de mostres.
+*   in:     value   = valor a afegir.
+* @Retorn: ---
+*
+************************************************/
+static void samples_push(Samples* samples, double value) {
+    if (samples->count == samples->capacity) {
+        int capacity = samples->capacity ? samples->capacity * 2 : 1024;
+        double* values = realloc(samples->values, capacity * sizeof(double));
+        if (values == NULL) return;
+        samples->values = values;
+        samples->capacity = capacity;
+    }
+    samples->values[samples->count++] = value;
+}
+
+/***********************************************
+*
+* @Finalitat: Afegir totes les mostres d’un conjunt a un altre i buidar l’origen.
+* @Parametres:
+*   in/out: dst = conjunt de destí.
+*   in/out: src = conjunt d’origen.
+* @Retorn: ---
+*
+************************************************/
+static void samples_move(Samples* dst, Samples* src) {
+    for (int i = 0; i < src->count; i++) {
+        samples_push(dst, src->values[i]);
+    }
+    src->count = 0;
+}
+
+/***********************************************
+*
+* @Finalitat: Ordenar les mostres i obtenir-ne percentils.
+* @Parametres:
+*   in/out: samples = conjunt de mostres (s’ordena).
+*   out:    p50, p99, p999, max = percentils (0 si no hi ha mostres; p999 pot ser NULL).
+* @Retorn: ---
+*
+************************************************/
+static void samples_summary(Samples* samples, double* p50, double* p99, double* p999, double* max) {
+    qsort(samples->values, samples->count, sizeof(double), bench_compare_double);
+    *p50 = bench_percentile(samples->values, samples->count, 50);
+    *p99 = bench_percentile(samples->values, samples->count, 99);
+    if (p999) *p999 = bench_percentile(samples->values, samples->count, 99.9);
+    *max = (samples->count > 0) ? samples->values[samples->count - 1] : 0;
+}
+
+/***********************************************
+*
+* @Finalitat: Llegir un camp numèric (en kB o unitats) de /proc/<pid>/status.
+* @Parametres:
+*   in: pid   = procés.
+*   in: field = nom del camp amb els dos punts ("VmRSS:", "Threads:").
+* @Retorn: Valor del camp, o -1 si no es pot llegir.
+*
+************************************************/
+static long proc_status_field(pid_t pid, const char* field) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/status", (int)pid);
+    FILE* file = fopen(path, "r");
+    if (file == NULL) return -1;
+
+    long value = -1;
+    char line[256];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (strncmp(line, field, strlen(field)) == 0) {
+            value = atol(line + strlen(field));
+            break;
+        }
+    }
+    fclose(file);
+    return value;
+}
+
+/***********************************************
+*
+* @Finalitat: Enviar una trama amb el tipus i les dades indicades.
+* @Parametres:
+*   in: fd   = connexió.
+*   in: type = tipus de trama.
+*   in: data = dades (cadena).
+* @Retorn: BUFFER_SIZE en èxit, -1 en error.
+*
+************************************************/
+static int send_text_frame(int fd, int type, const char* data) {
+    unsigned char* trama = crear_trama(type, (unsigned char*)data, strlen(data));
+    if (trama == NULL) return -1;
+    int sent = transport_send_frame(fd, trama);
+    free(trama);
+    return sent;
+}
+
+/***********************************************
+*
+* @Finalitat: Obrir una connexió amb Gotham i fer la presentació com a Worker (tipus Text, port fictici)
+*             o com a Fleck.
+* @Parametres:
+*   in: kind  = SCALE_CONN_*.
+*   in: index = índex global de la connexió (port del Worker o nom d’usuari del Fleck).
+* @Retorn: Descriptor de la connexió, o -1 si Gotham la rebutja o no respon.
+*
+************************************************/
+static int open_connection(int kind, int index) {
+    int is_worker = (kind == SCALE_CONN_WORKER);
+    int fd = connect_to_server("127.0.0.1", is_worker ? opt.base_port + 1 : opt.base_port);
+    if (fd < 0) return -1;
+
+    // Sin respuesta en SCALE_HANDSHAKE_TIMEOUT_S se da la conexión por fallida (luego se lee con epoll)
+    struct timeval timeout = { .tv_sec = SCALE_HANDSHAKE_TIMEOUT_S, .tv_usec = 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    char data[64];
+    if (is_worker) {
+        // Los Flecks nunca se conectan al puerto declarado: basta con que sea único
+        snprintf(data, sizeof(data), "%s&127.0.0.1&%d", TEXT, opt.base_port + 2 + index);
+    } else {
+        snprintf(data, sizeof(data), "scale%d&127.0.0.1&%d", index, opt.base_port);
+    }
+    unsigned char response[BUFFER_SIZE];
+    if (send_text_frame(fd, is_worker ? TYPE_CONNECT_WORKER_GOTHAM : TYPE_CONNECT_FLECK_GOTHAM, data) != BUFFER_SIZE
+        || transport_recv_frame(fd, response) != BUFFER_SIZE) {
+        close(fd);
+        return -1;
+    }
+
+    TramaResult* result = leer_trama(response);
+    int ok = result != NULL && (is_worker ? (result->type == TYPE_PRINCIPAL_WORKER || result->type == TYPE_CONNECT_WORKER_GOTHAM)
+                                          : (result->type == TYPE_CONNECT_FLECK_GOTHAM && result->data[0] == '\0'));
+    if (result) free_tramaResult(result);
+    if (!ok) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/***********************************************
+*
+* @Finalitat: Repartir una connexió presentada a un dels fils amb epoll.
+* @Parametres:
+*   in: fd    = connexió.
+*   in: kind  = SCALE_CONN_*.
+*   in: index = índex global (reparteix les connexions entre fils).
+* @Retorn: ---
+*
+************************************************/
+static void add_connection(int fd, int kind, int index) {
+    ScaleConn* conn = calloc(1, sizeof(ScaleConn));
+    conn->fd = fd;
+    conn->kind = kind;
+    conn->thread = index % opt.threads;
+    ScaleThread* thread = &threads[conn->thread];
+
+    if (kind == SCALE_CONN_ACTIVE) {
+        // Los primeros DISTORT se reparten a lo largo de un intervalo
+        conn->next_send_ns = timings_now_ns() + (uint64_t)(rand() % (opt.interval_ms + 1)) * 1000000ULL;
+        pthread_mutex_lock(&thread->mutex);
+        if (thread->num_active == thread->capacity_active) {
+            thread->capacity_active = thread->capacity_active ? thread->capacity_active * 2 : 64;
+            thread->active = realloc(thread->active, thread->capacity_active * sizeof(ScaleConn*));
+        }
+        thread->active[thread->num_active++] = conn;
+        pthread_mutex_unlock(&thread->mutex);
+    }
+
+    struct epoll_event event = { .events = EPOLLIN, .data.ptr = conn };
+    epoll_ctl(thread->epoll_fd, EPOLL_CTL_ADD, fd, &event);
+}
+
+/***********************************************
+*
+* @Finalitat: Cos dels fils que obren connexions: agafen índexs del lot fins a esgotar-lo i
+*             mesuren el temps de cada presentació.
+* @Parametres:
+*   in/out: arg = ConnectBatch del lot.
+* @Retorn: NULL.
+*
+************************************************/
+static void* run_connector(void* arg) {
+    ConnectBatch* batch = (ConnectBatch*)arg;
+    Samples local = {0};
+    int index;
+    while ((index = atomic_fetch_add(&batch->next, 1)) < batch->count) {
+        uint64_t start = timings_now_ns();
+        int fd = open_connection(batch->kind, batch->first + index);
+        if (fd < 0) {
+            atomic_fetch_add(&batch->failed, 1);
+            continue;
+        }
+        samples_push(&local, (timings_now_ns() - start) / 1e6);
+        add_connection(fd, batch->kind, batch->first + index);
+    }
+
+    pthread_mutex_lock(&batch->mutex);
+    samples_move(&batch->handshake_ms, &local);
+    pthread_mutex_unlock(&batch->mutex);
+    free(local.values);
+    return NULL;
+}
+
+/***********************************************
+*
+* @Finalitat: Obrir en paral·lel un lot de connexions del mateix tipus.
+* @Parametres:
+*   in:     kind      = SCALE_CONN_*.
+*   in:     first     = índex global de la primera connexió.
+*   in:     count     = nombre de connexions.
+*   in/out: handshake = mostres del temps de presentació (s’hi afegeixen).
+*   out:    failed    = connexions fallides (s’hi sumen).
+* @Retorn: Connexions acceptades per segon (0 si el lot és buit).
+*
+************************************************/
+static double open_batch(int kind, int first, int count, Samples* handshake, int* failed) {
+    if (count <= 0) return 0;
+
+    ConnectBatch batch = { .kind = kind, .first = first, .count = count, .mutex = PTHREAD_MUTEX_INITIALIZER };
+    atomic_init(&batch.next, 0);
+    atomic_init(&batch.failed, 0);
+
+    uint64_t start = timings_now_ns();
+    pthread_t connectors[SCALE_MAX_THREADS];
+    int num_connectors = (opt.connectors < SCALE_MAX_THREADS) ? opt.connectors : SCALE_MAX_THREADS;
+    for (int i = 0; i < num_connectors; i++) {
+        pthread_create(&connectors[i], NULL, run_connector, &batch);
+    }
+    for (int i = 0; i < num_connectors; i++) {
+        pthread_join(connectors[i], NULL);
+    }
+    double elapsed_s = (timings_now_ns() - start) / 1e9;
+
+    samples_move(handshake, &batch.handshake_ms);
+    free(batch.handshake_ms.values);
+    *failed += atomic_load(&batch.failed);
+    return (count - atomic_load(&batch.failed)) / elapsed_s;
+}
+
+/***********************************************
+*
+* @Finalitat: Processar una trama rebuda de Gotham en una connexió simulada: respondre els HEARTBEAT
+*             (i mesurar-ne el jitter) o recollir la resposta a un DISTORT (i tancar-lo si s’ha assignat).
+* @Parametres:
+*   in:     thread = fil que atén la connexió.
+*   in/out: conn   = connexió.
+*   in:     trama  = trama rebuda.
+*   in:     now    = instant de recepció.
+* @Retorn: ---
+*
+************************************************/
+static void handle_frame(ScaleThread* thread, ScaleConn* conn, unsigned char* trama, uint64_t now) {
+    TramaResult* result = leer_trama(trama);
+    if (result == NULL) return;
+    int measure = atomic_load(&measuring);
+
+    if (conn->kind == SCALE_CONN_WORKER && result->type == TYPE_HEARTBEAT) {
+        send_text_frame(conn->fd, TYPE_HEARTBEAT, SCALE_WORKER_LOAD);
+        if (measure && conn->last_heartbeat_ns != 0) {
+            double interval_ms = (now - conn->last_heartbeat_ns) / 1e6;
+            pthread_mutex_lock(&thread->mutex);
+            samples_push(&thread->jitter_ms, fabs(interval_ms - HEARTBEAT_SLEEP_TIME * 1000.0));
+            pthread_mutex_unlock(&thread->mutex);
+        }
+        conn->last_heartbeat_ns = now;
+
+    } else if (conn->kind == SCALE_CONN_ACTIVE && result->type == TYPE_DISTORT_FLECK_GOTHAM && conn->sent_ns != 0) {
+        // <IP>&<Port>&<job_id> si se asigna Worker; DISTORT_BUSY&<ms>, DISTORT_LIMIT&<ms>, DISTORT_KO o MEDIA_KO si no
+        int busy = strncmp(result->data, "DISTORT_BUSY", strlen("DISTORT_BUSY")) == 0;
+        int rejected = !busy && (strncmp(result->data, "DISTORT_", strlen("DISTORT_")) == 0
+                                 || strcmp(result->data, "MEDIA_KO") == 0);
+        if (!busy && !rejected) {
+            // La distorsión no llega al Worker: se da por acabada para que no cuente en su carga
+            char* job_id = strrchr(result->data, '&');
+            char data[64];
+            snprintf(data, sizeof(data), "%s&done", job_id ? job_id + 1 : "0");
+            send_text_frame(conn->fd, TYPE_JOB_STATUS, data);
+        }
+        if (measure) {
+            pthread_mutex_lock(&thread->mutex);
+            samples_push(&thread->distort_ms, (now - conn->sent_ns) / 1e6);
+            thread->assigned += !busy && !rejected;
+            thread->busy += busy;
+            thread->rejected += rejected;
+            pthread_mutex_unlock(&thread->mutex);
+        }
+        conn->sent_ns = 0;
+        conn->next_send_ns = now + (uint64_t)opt.interval_ms * 1000000ULL;
+    }
+    free_tramaResult(result);
+}
+
+/***********************************************
+*
+* @Finalitat: Cos dels fils amb epoll: llegir les trames de les seves connexions i enviar els DISTORT
+*             dels Flecks actius quan toca.
+* @Parametres:
+*   in/out: arg = ScaleThread del fil.
+* @Retorn: NULL.
+*
+************************************************/
+static void* run_epoll_thread(void* arg) {
+    ScaleThread* thread = (ScaleThread*)arg;
+    struct epoll_event events[SCALE_EPOLL_EVENTS];
+    unsigned char trama[BUFFER_SIZE];
+
+    while (atomic_load(&running)) {
+        int ready = epoll_wait(thread->epoll_fd, events, SCALE_EPOLL_EVENTS, SCALE_EPOLL_WAIT_MS);
+        uint64_t now = timings_now_ns();
+        for (int i = 0; i < ready; i++) {
+            ScaleConn* conn = (ScaleConn*)events[i].data.ptr;
+            if (conn->fd < 0) continue;
+            if (transport_recv_frame(conn->fd, trama) != BUFFER_SIZE) {
+                // Gotham ha cerrado la conexión (p. ej. un Worker dado por caído)
+                epoll_ctl(thread->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+                close(conn->fd);
+                conn->fd = -1;
+                pthread_mutex_lock(&thread->mutex);
+                thread->closed++;
+                pthread_mutex_unlock(&thread->mutex);
+                continue;
+            }
+            handle_frame(thread, conn, trama, now);
+        }
+
+        // DISTORT de los Flecks activos sin petición pendiente cuyo turno ha llegado
+        pthread_mutex_lock(&thread->mutex);
+        int num_active = thread->num_active;
+        pthread_mutex_unlock(&thread->mutex);
+        now = timings_now_ns();
+        for (int i = 0; i < num_active; i++) {
+            ScaleConn* conn = thread->active[i];
+            if (conn->fd < 0 || conn->sent_ns != 0 || now < conn->next_send_ns) continue;
+            if (send_text_frame(conn->fd, TYPE_DISTORT_FLECK_GOTHAM, "Text&scale.txt&65536&0&0") == BUFFER_SIZE) {
+                conn->sent_ns = now;
+            }
+        }
+    }
+    return NULL;
+}
+
+/***********************************************
+*
+* @Finalitat: Recollir i buidar el que han mesurat els fils amb epoll durant la finestra.
+* @Parametres:
+*   out: result   = resultat del nivell (comptadors de DISTORT i connexions tancades).
+*   out: distort  = latències de DISTORT.
+*   out: jitter   = desviacions del interval entre HEARTBEAT.
+* @Retorn: ---
+*
+************************************************/
+static void collect_thread_samples(LevelResult* result, Samples* distort, Samples* jitter) {
+    for (int i = 0; i < opt.threads; i++) {
+        ScaleThread* thread = &threads[i];
+        pthread_mutex_lock(&thread->mutex);
+        samples_move(distort, &thread->distort_ms);
+        samples_move(jitter, &thread->jitter_ms);
+        result->assigned += thread->assigned;
+        result->busy += thread->busy;
+        result->rejected += thread->rejected;
+        result->closed += thread->closed;
+        thread->assigned = thread->busy = thread->rejected = thread->closed = 0;
+        pthread_mutex_unlock(&thread->mutex);
+    }
+}
+
+/***********************************************
+*
+* @Finalitat: Escriure el resultat d’un nivell en JSON.
+* @Parametres:
+*   in: fd     = descriptor de sortida.
+*   in: r      = resultat del nivell.
+*   in: first  = 1 si és el primer nivell.
+* @Retorn: ---
+*
+************************************************/
+static void print_level_json(int fd, LevelResult* r, int first) {
+    dprintf(fd, "%s\n    {\"flecks\": %d, \"workers\": %d, \"connections\": %d,\n", first ? "" : ",",
+            r->flecks, r->workers, r->flecks + r->workers);
+    dprintf(fd, "     \"accept\": {\"flecks_per_s\": %.1f, \"workers_per_s\": %.1f, \"failed\": %d, "
+                "\"handshake_ms\": {\"p50\": %.3f, \"p99\": %.3f, \"max\": %.3f}},\n",
+            r->fleck_accept_per_s, r->worker_accept_per_s, r->failed, r->handshake_p50, r->handshake_p99, r->handshake_max);
+    dprintf(fd, "     \"distort\": {\"replies\": %ld, \"per_s\": %.1f, \"assigned\": %ld, \"busy\": %ld, \"rejected\": %ld, "
+                "\"latency_ms\": {\"p50\": %.3f, \"p99\": %.3f, \"p999\": %.3f, \"max\": %.3f}},\n",
+            r->requests, r->requests / (double)opt.window_s, r->assigned, r->busy, r->rejected,
+            r->distort_p50, r->distort_p99, r->distort_p999, r->distort_max);
+    dprintf(fd, "     \"heartbeat\": {\"intervals\": %d, \"missed\": %ld, \"closed\": %ld, "
+                "\"jitter_ms\": {\"p50\": %.1f, \"p99\": %.1f, \"max\": %.1f}},\n",
+            r->heartbeats, r->heartbeats_missed, r->closed, r->jitter_p50, r->jitter_p99, r->jitter_max);
+    dprintf(fd, "     \"gotham\": {\"flecks\": %ld, \"workers\": %ld, \"rss_kb\": %ld, \"threads\": %ld, \"kb_per_conn\": %.1f}}",
+            r->gotham_flecks, r->gotham_workers, r->rss_kb, r->threads, r->kb_per_conn);
+}
+
+/***********************************************
+*
+* @Finalitat: Pujar el límit de descriptors oberts al màxim permès (Gotham l’hereta en llançar-lo).
+* @Parametres:
+*   in: needed = descriptors que calen.
+* @Retorn: 0 si n’hi ha prou, -1 si no.
+*
+************************************************/
+static int raise_fd_limit(long needed) {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) < 0) return -1;
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    return (limit.rlim_cur == RLIM_INFINITY || (long)limit.rlim_cur >= needed) ? 0 : -1;
+}
+
+
+int main(int argc, char* argv[]) {
+    if (parse_options(argc, argv) < 0) {
+        print_usage();
+        return -1;
+    }
+
+    // El JSON se escribe en la salida original; los mensajes de las librerías van al log del driver
+    int json_fd = (opt.output != NULL) ? open(opt.output, O_WRONLY | O_CREAT | O_TRUNC, 0644) : dup(STDOUT_FILENO);
+    if (json_fd < 0) {
+        perror("Error abriendo el archivo de salida");
+        return -1;
+    }
+    int max_flecks = opt.flecks[opt.num_levels - 1];
+    int max_workers = opt.workers[opt.num_levels - 1];
+    if (raise_fd_limit(max_flecks + max_workers + 64) < 0) {
+        dprintf(2, "El límite de descriptores abiertos (ulimit -n) no permite %d conexiones.\n", max_flecks + max_workers);
+        return -1;
+    }
+
+    if (bench_prepare_cluster_dir(opt.work_dir, opt.base_port, 0, 0) < 0) {
+        return -1;
+    }
+    int config_fd = open("data/gotham.dat", O_WRONLY | O_APPEND);
+    dprintf(config_fd, "max_workers=%d\n", max_workers > 0 ? max_workers : 1);
+    for (int i = 0; i < opt.num_options; i++) {
+        dprintf(config_fd, "%s\n", opt.options[i]);
+    }
+    close(config_fd);
+
+    int err_fd = dup(STDERR_FILENO);
+    int log_fd = open("logs/driver.log", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (log_fd >= 0) {
+        dup2(log_fd, STDOUT_FILENO);
+        dup2(log_fd, STDERR_FILENO);
+        close(log_fd);
+    }
+    signal(SIGPIPE, SIG_IGN);
+    srand(1);
+
+    int control_sock = bench_cluster_start(&cluster, opt.base_port, 0, 0, err_fd, opt.work_dir);
+    if (control_sock < 0) {
+        return -1;
+    }
+    long base_rss = proc_status_field(cluster.gotham_pid, "VmRSS:");
+
+    for (int i = 0; i < opt.threads; i++) {
+        threads[i].epoll_fd = epoll_create1(0);
+        pthread_mutex_init(&threads[i].mutex, NULL);
+        pthread_create(&threads[i].thread, NULL, run_epoll_thread, &threads[i]);
+    }
+
+    dprintf(json_fd, "{\n  \"config\": {\"flecks\": [");
+    for (int i = 0; i < opt.num_levels; i++) dprintf(json_fd, "%s%d", i ? ", " : "", opt.flecks[i]);
+    dprintf(json_fd, "], \"workers\": [");
+    for (int i = 0; i < opt.num_levels; i++) dprintf(json_fd, "%s%d", i ? ", " : "", opt.workers[i]);
+    dprintf(json_fd, "], \"active\": %d, \"interval_ms\": %d, \"threads\": %d, \"connectors\": %d, \"window_s\": %d, \"options\": [",
+            opt.active, opt.interval_ms, opt.threads, opt.connectors, opt.window_s);
+    for (int i = 0; i < opt.num_options; i++) dprintf(json_fd, "%s\"%s\"", i ? ", " : "", opt.options[i]);
+    dprintf(json_fd, "]},\n  \"levels\": [");
+
+    // ---- Niveles: abrir las conexiones que faltan, esperar y medir durante la ventana ----
+    int flecks = 0, workers = 0;
+    const char* fell_over = NULL;
+    long stats[BENCH_STATS_FIELDS];
+    long missed_before = (bench_query_stats(control_sock, stats) == BENCH_STATS_FIELDS) ? stats[BENCH_STAT_HB_MISSED] : 0;
+    for (int level = 0; level < opt.num_levels && fell_over == NULL; level++) {
+        LevelResult result = { .flecks = opt.flecks[level], .workers = opt.workers[level] };
+        Samples handshake = {0}, distort = {0}, jitter = {0};
+
+        // Primero los Workers (los DISTORT necesitan Worker) y, de los Flecks, primero los activos
+        result.worker_accept_per_s = open_batch(SCALE_CONN_WORKER, workers, opt.workers[level] - workers,
+                                                &handshake, &result.failed);
+        int active = (opt.active < opt.flecks[level]) ? opt.active : opt.flecks[level];
+        int new_active = (flecks < active) ? active - flecks : 0;
+        uint64_t start = timings_now_ns();
+        open_batch(SCALE_CONN_ACTIVE, flecks, new_active, &handshake, &result.failed);
+        open_batch(SCALE_CONN_IDLE, flecks + new_active, opt.flecks[level] - flecks - new_active,
+                   &handshake, &result.failed);
+        int new_flecks = opt.flecks[level] - flecks;
+        result.fleck_accept_per_s = (new_flecks > 0) ? new_flecks / ((timings_now_ns() - start) / 1e9) : 0;
+        workers = opt.workers[level];
+        flecks = opt.flecks[level];
+
+        // Ventana de medida
+        usleep(SCALE_SETTLE_MS * 1000);
+        collect_thread_samples(&result, &distort, &jitter);
+        result.assigned = result.busy = result.rejected = result.closed = 0;
+        distort.count = jitter.count = 0;
+        atomic_store(&measuring, 1);
+        sleep(opt.window_s);
+        atomic_store(&measuring, 0);
+        collect_thread_samples(&result, &distort, &jitter);
+
+        result.requests = distort.count;
+        result.heartbeats = jitter.count;
+        samples_summary(&handshake, &result.handshake_p50, &result.handshake_p99, NULL, &result.handshake_max);
+        samples_summary(&distort, &result.distort_p50, &result.distort_p99, &result.distort_p999, &result.distort_max);
+        samples_summary(&jitter, &result.jitter_p50, &result.jitter_p99, NULL, &result.jitter_max);
+
+        if (bench_query_stats(control_sock, stats) == BENCH_STATS_FIELDS) {
+            result.gotham_flecks = stats[BENCH_STAT_FLECKS] - 1;    // Sin la conexión de control
+            result.gotham_workers = stats[BENCH_STAT_WORKERS];
+            result.heartbeats_missed = stats[BENCH_STAT_HB_MISSED] - missed_before;
+            missed_before = stats[BENCH_STAT_HB_MISSED];
+        }
+        result.rss_kb = proc_status_field(cluster.gotham_pid, "VmRSS:");
+        result.threads = proc_status_field(cluster.gotham_pid, "Threads:");
+        if (flecks + workers > 0) {
+            result.kb_per_conn = (result.rss_kb - base_rss) / (double)(flecks + workers);
+        }
+        print_level_json(json_fd, &result, level == 0);
+
+        // Gotham deja de escalar cuando no acepta conexiones, pierde alguna o deja de responder
+        if (result.rss_kb < 0) {
+            fell_over = "Gotham ha terminado";
+        } else if (result.failed > 0) {
+            fell_over = "conexiones rechazadas o sin respuesta al CONNECT";
+        } else if (result.closed > 0 || result.gotham_workers < workers) {
+            fell_over = "Workers dados por caídos";
+        } else if (result.gotham_flecks < flecks) {
+            fell_over = "Flecks perdidos";
+        }
+        free(handshake.values);
+        free(distort.values);
+        free(jitter.values);
+    }
+    dprintf(json_fd, "\n  ],\n  \"fell_over\": ");
+    if (fell_over != NULL) {
+        dprintf(json_fd, "\"%s\"\n}\n", fell_over);
+    } else {
+        dprintf(json_fd, "null\n}\n");
+    }
+    close(json_fd);
+
+    // ---- Parar: hilos, conexiones simuladas y clúster ----
+    atomic_store(&running, 0);
+    for (int i = 0; i < opt.threads; i++) {
+        pthread_join(threads[i].thread, NULL);
+        close(threads[i].epoll_fd);
+        free(threads[i].active);
+        free(threads[i].distort_ms.values);
+        free(threads[i].jitter_ms.values);
+    }
+    bench_disconnect_gotham(control_sock);
+    bench_cluster_stop(&cluster);
+    return 0;
+}
@@ -0,0 +1,570 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "bench_cluster.h"
+#include "../config/files.h"
+
+// Benchmark de failover: un Fleck distorsiona archivos uno tras otro contra un clúster local y el
+// driver mata (SIGKILL) o congela (SIGSTOP) al Worker que le atiende en mitad de una fase
+#define FAILOVER_PHASE_UPLOAD 0
+#define FAILOVER_PHASE_DISTORT 1
+#define FAILOVER_PHASE_DOWNLOAD 2
+#define FAILOVER_NUM_PHASES 3
+#define FAILOVER_BASELINE -1        // Distorsión sin fallo (referencia de tramas y duración)
+
+#define FAILOVER_POLL_US 100        // Espera entre lecturas de los contadores del cliente hasta el fallo
+#define FAILOVER_STATS_POLL_MS 5    // Espera entre consultas de contadores a Gotham tras el fallo
+#define FAILOVER_MAX_RUNS 64
+#define FAILOVER_FRAME_DATA 247      // Bytes útiles de cada trama de datos
+
+static const char* const PHASE_NAMES[FAILOVER_NUM_PHASES] = {"upload", "distort", "download"};
+
+// Opciones del benchmark (configurables por línea de comandos)
+typedef struct {
+    int signal;                         // SIGKILL o SIGSTOP
+    int phases[FAILOVER_NUM_PHASES];
+    int num_phases;
+    int runs;                           // Ejecuciones por fase
+    int kind;                           // TIMING_KIND_TEXT (Enigma) o TIMING_KIND_AUDIO (Harley)
+    long size;                          // Bytes de cada archivo
+    int workers;                        // Workers del tipo (el principal y los que lo sustituyen)
+    int stall_ms;                       // Con SIGSTOP: espera tras la detección antes de matar al Worker
+    int timeout_s;                      // Máximo por ejecución
+    int base_port;
+    char* work_dir;
+    char* output;
+} FailoverOptions;
+
+// Distorsión en curso (hilo del cliente) vigilada por el hilo principal
+typedef struct {
+    int sock;                           // Conexión Fleck con Gotham
+    char filename[64];
+    int kind;
+    TransportCounters* counters;        // Contadores de tramas del hilo del cliente
+    atomic_int worker_port;             // Puerto del Worker asignado (0 hasta la asignación, -1 si no hay)
+    atomic_long base_sent;              // Contadores en el momento de la asignación
+    atomic_long base_received;
+    atomic_int finished;
+    int ok;
+    long frames;                        // Tramas enviadas y recibidas desde la asignación hasta el final
+    int resumes;                        // Descargas del resultado reanudadas por Fleck
+    long resume_offset;                 // Byte desde el que se reanudó la última
+    uint64_t end_ns;
+} ClientJob;
+
+// Resultado de una ejecución
+typedef struct {
+    int phase;                          // Fase en la que se pretendía provocar el fallo
+    int hit;                            // Fase en la que el cliente estaba al provocarlo (-1 si acabó antes)
+    int worker;                         // Índice del Worker afectado
+    int ok;
+    int stalled;                        // 1 si Fleck no ha reaccionado y se ha tenido que matar al Worker
+    int timed_out;
+    double detect_ms;                   // Desde el fallo hasta que Gotham saca al Worker (-1 si no lo hace)
+    double reroute_ms;                  // Hasta que Fleck vuelve a pedir Worker a Gotham (-1 si no lo hace)
+    double recover_ms;                  // Hasta que la distorsión acaba
+    long extra_frames;                  // Tramas de más respecto a la distorsión sin fallo
+    int resumes;
+    long resume_offset;
+    char* md5;                          // MD5 del resultado (NULL si la distorsión falla)
+    int intact;                         // 1 si el resultado coincide con el de la referencia
+} RunResult;
+
+static BenchCluster cluster;
+
+
+/***********************************************
+*
+* @Finalitat: Mostrar l’ús del benchmark.
+* @Parametres: ---
+* @Retorn: ---
+*
+************************************************/
+static void print_usage(void) {
+    dprintf(2, "Uso: ./failover.exe [opciones]\n"
+               "  -s, --signal kill|stop  Señal al Worker: SIGKILL o SIGSTOP (kill)\n"
+               "  -p, --phases LISTA      Fases: upload,distort,download (todas)\n"
+               "  -r, --runs N            Ejecuciones por fase (2)\n"
+               "      --kind text|wav     Tipo de archivo: Enigma o Harley (text)\n"
+               "      --size B            Bytes de cada archivo (1048576)\n"
+               "      --workers N         Workers del tipo (2)\n"
+               "      --stall-ms MS       Con stop: espera tras la detección antes de matar al Worker (5000)\n"
+               "      --timeout S         Máximo por ejecución (60)\n"
+               "      --port P            Primer puerto en loopback (9500)\n"
+               "      --dir DIR           Directorio de trabajo (failover_run)\n"
+               "  -o, --output FILE       Resultado JSON (stdout)\n");
+}
+
+/***********************************************
+*
+* @Finalitat: Llegir les opcions de línia de comandes.
+* @Parametres:
+*   in:  argc, argv = arguments del programa.
+*   out: opt        = opcions llegides.
+* @Retorn: 0 en èxit, -1 si hi ha opcions invàlides.
+*
+************************************************/
+static int parse_options(int argc, char* argv[], FailoverOptions* opt) {
+    static struct option long_options[] = {
+        {"signal", required_argument, 0, 's'},
+        {"phases", required_argument, 0, 'p'},
+        {"runs", required_argument, 0, 'r'},
+        {"kind", required_argument, 0, 'k'},
+        {"size", required_argument, 0, 'z'},
+        {"workers", required_argument, 0, 'w'},
+        {"stall-ms", required_argument, 0, 'S'},
+        {"timeout", required_argument, 0, 'T'},
+        {"port", required_argument, 0, 'P'},
+        {"dir", required_argument, 0, 'd'},
+        {"output", required_argument, 0, 'o'},
+        {0, 0, 0, 0}
+    };
+
+    *opt = (FailoverOptions){ .signal = SIGKILL,
+                              .phases = {FAILOVER_PHASE_UPLOAD, FAILOVER_PHASE_DISTORT, FAILOVER_PHASE_DOWNLOAD},
+                              .num_phases = FAILOVER_NUM_PHASES, .runs = 2, .kind = TIMING_KIND_TEXT,
+                              .size = 1048576, .workers = 2, .stall_ms = 5000, .timeout_s = 60,
+                              .base_port = 9500, .work_dir = "failover_run", .output = NULL };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "s:p:r:o:", long_options, NULL)) != -1) {
+        switch (c) {
+            case 's':
+                if (strcmp(optarg, "kill") == 0) opt->signal = SIGKILL;
+                else if (strcmp(optarg, "stop") == 0) opt->signal = SIGSTOP;
+                else return -1;
+                break;
+            case 'p':
+                opt->num_phases = 0;
+                for (char* phase = strtok(optarg, ","); phase != NULL; phase = strtok(NULL, ",")) {
+                    int found = -1;
+                    for (int i = 0; i < FAILOVER_NUM_PHASES; i++) {
+                        if (strcmp(phase, PHASE_NAMES[i]) == 0) found = i;
+                    }
+                    if (found < 0 || opt->num_phases == FAILOVER_NUM_PHASES) return -1;
+                    opt->phases[opt->num_phases++] = found;
+                }
+                break;
+            case 'r': opt->runs = atoi(optarg); break;
+            case 'k': opt->kind = bench_kind(optarg); break;
+            case 'z': opt->size = atol(optarg); break;
+            case 'w': opt->workers = atoi(optarg); break;
+            case 'S': opt->stall_ms = atoi(optarg); break;
+            case 'T': opt->timeout_s = atoi(optarg); break;
+            case 'P': opt->base_port = atoi(optarg); break;
+            case 'd': opt->work_dir = optarg; break;
+            case 'o': opt->output = optarg; break;
+            default: return -1;
+        }
+    }
+
+    if ((opt->kind != TIMING_KIND_TEXT && opt->kind != TIMING_KIND_AUDIO) || opt->num_phases < 1 || opt->runs < 1
+        || opt->num_phases * opt->runs > FAILOVER_MAX_RUNS || opt->size < 1 || opt->workers < 2
+        || opt->stall_ms < 0 || opt->timeout_s < 1) {
+        return -1;
+    }
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalitat: Generar el fitxer base i un enllaç dur per execució (noms únics per a cada distorsió).
+* @Parametres:
+*   in: opt   = opcions del benchmark.
+*   in: count = nombre d’execucions (incloent-hi la de referència).
+* @Retorn: 0 en èxit, -1 en error.
+*
+************************************************/
+static int prepare_corpus(FailoverOptions* opt, int count) {
+    char* base;
+    asprintf(&base, "users%s/base%s", BENCH_USER_DIR, BENCH_KIND_EXTENSIONS[opt->kind]);
+    int ret = (opt->kind == TIMING_KIND_TEXT) ? bench_write_text(base, opt->size, 1) : bench_write_wav(base, opt->size, 2);
+
+    for (int i = 0; ret == 0 && i < count; i++) {
+        char* path;
+        asprintf(&path, "users%s/f%d%s", BENCH_USER_DIR, i, BENCH_KIND_EXTENSIONS[opt->kind]);
+        unlink(path);
+        if (link(base, path) < 0) {
+            perror("Error creando archivo del corpus");
+            ret = -1;
+        }
+        free(path);
+    }
+    free(base);
+    return ret;
+}
+
+/***********************************************
+*
+* @Finalitat: Cos del fil client: demana Worker a Gotham, publica el Worker assignat i els comptadors
+*             de trames en aquell moment, i fa la distorsió completa (amb el failover de Fleck).
+* @Parametres:
+*   in/out: arg = ClientJob de la distorsió.
+* @Retorn: NULL.
+*
+************************************************/
+static void* run_client_job(void* arg) {
+    ClientJob* job = (ClientJob*)arg;
+    job->counters = transport_thread_counters();
+
+    WorkerFleck* worker = NULL;
+    int text_finished = 0, media_finished = 0;
+    DistortInfo* distortInfo = bench_new_distort(job->sock, job->filename, job->kind, &worker,
+                                                 &text_finished, &media_finished);
+    // Resultado de Fleck: indica si la descarga se reanudó y desde qué byte
+    FleckJob* fleck_job = newFleckJob(job->filename, BENCH_KIND_FACTORS[job->kind], file_type(job->filename));
+    distortInfo->job = fleck_job;
+    long sent = 0, received = 0;
+    if (request_distort_gotham(job->sock, file_type(job->filename), &worker, distortInfo) > 0) {
+        sent = atomic_load(&job->counters->frames_sent);
+        received = atomic_load(&job->counters->frames_received);
+        atomic_store(&job->base_sent, sent);
+        atomic_store(&job->base_received, received);
+        atomic_store(&job->worker_port, atoi(worker->Port));
+        handle_distort_worker(distortInfo);
+    } else {
+        freeDistortInfo(distortInfo);
+        atomic_store(&job->worker_port, -1);
+    }
+
+    job->ok = text_finished || media_finished;
+    if (fleck_job != NULL) {
+        job->resumes = fleck_job->resumes;
+        job->resume_offset = fleck_job->resume_offset;
+        freeFleckJob(fleck_job);
+    }
+    job->frames = atomic_load(&job->counters->frames_sent) - sent + atomic_load(&job->counters->frames_received) - received;
+    job->end_ns = timings_now_ns();
+
+    // La siguiente ejecución empieza con conexiones nuevas (el Worker de esta puede haber caído)
+    FLECK_pool_close_all();
+    atomic_store(&job->finished, 1);
+    return NULL;
+}
+
+/***********************************************
+*
+* @Finalitat: Classificar en quina fase estava el client segons les trames rebudes des de l’assignació.
+* @Parametres:
+*   in: received    = trames rebudes.
+*   in: data_frames = trames de dades del fitxer original.
+* @Retorn: FAILOVER_PHASE_*.
+*
+************************************************/
+static int phase_of(long received, long data_frames) {
+    // ACK de la trama inicial y de cada trama de datos, confirmación del MD5 y trama inicial del resultado
+    if (received < 1 + data_frames) return FAILOVER_PHASE_UPLOAD;
+    if (received < 1 + data_frames + 2) return FAILOVER_PHASE_DISTORT;
+    return FAILOVER_PHASE_DOWNLOAD;
+}
+
+/***********************************************
+*
+* @Finalitat: Executar una distorsió i, si cal, provocar el fallo del seu Worker quan el client arriba
+*             al llindar de trames rebudes, mesurant la detecció a Gotham (el Worker desapareix dels
+*             seus comptadors), la reassignació (la distorsió torna a estar en curs) i el final.
+* @Parametres:
+*   in:  opt          = opcions del benchmark.
+*   in:  control_sock = connexió de control amb Gotham (TYPE_STATS).
+*   in:  sock         = connexió Fleck del client amb Gotham.
+*   in:  index        = número d’execució (fitxer f<index>).
+*   in:  phase        = fase objectiu, o FAILOVER_BASELINE per no provocar cap fallo.
+*   in:  threshold    = trames rebudes des de l’assignació a partir de les quals es provoca el fallo.
+*   in:  data_frames  = trames de dades del fitxer original.
+*   out: result       = resultat de l’execució.
+* @Retorn: 0 en èxit, -1 si no s’ha pogut executar.
+*
+************************************************/
+static int run_once(FailoverOptions* opt, int control_sock, int sock, int index, int phase, long threshold,
+                    long data_frames, RunResult* result) {
+    ClientJob* job = calloc(1, sizeof(ClientJob));
+    job->sock = sock;
+    job->kind = opt->kind;
+    snprintf(job->filename, sizeof(job->filename), "f%d%s", index, BENCH_KIND_EXTENSIONS[opt->kind]);
+
+    *result = (RunResult){ .phase = phase, .hit = -1, .worker = -1, .detect_ms = -1, .reroute_ms = -1, .recover_ms = -1 };
+    long stats[BENCH_STATS_FIELDS];
+    if (bench_query_stats(control_sock, stats) != BENCH_STATS_FIELDS) {
+        free(job);
+        return -1;
+    }
+    long workers_before = stats[BENCH_STAT_WORKERS];
+    long distorts_before = stats[BENCH_STAT_DISTORT] + 1;    // Más la petición inicial de esta ejecución
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, run_client_job, job) != 0) {
+        perror("Error al crear el hilo del cliente");
+        free(job);
+        return -1;
+    }
+
+    uint64_t start = timings_now_ns();
+    uint64_t deadline = start + (uint64_t)opt->timeout_s * 1000000000ULL;
+    while (atomic_load(&job->worker_port) == 0 && timings_now_ns() < deadline) {
+        usleep(FAILOVER_POLL_US);
+    }
+    int port = atomic_load(&job->worker_port);
+    result->worker = (port > 0) ? bench_cluster_worker_by_port(&cluster, port) : -1;
+    pid_t victim = (result->worker >= 0 && phase != FAILOVER_BASELINE) ? cluster.worker_pids[result->worker] : -1;
+
+    // ---- Esperar al umbral y provocar el fallo ----
+    uint64_t fault_ns = 0;
+    while (victim > 0 && !atomic_load(&job->finished) && timings_now_ns() < deadline) {
+        long received = atomic_load(&job->counters->frames_received) - atomic_load(&job->base_received);
+        if (received >= threshold) {
+            kill(victim, opt->signal);
+            fault_ns = timings_now_ns();
+            result->hit = phase_of(received, data_frames);
+            break;
+        }
+        usleep(FAILOVER_POLL_US);
+    }
+
+    // ---- Seguir la recuperación con los contadores de Gotham ----
+    int killed = (fault_ns != 0 && opt->signal == SIGKILL);
+    while (fault_ns != 0 && !atomic_load(&job->finished)) {
+        uint64_t now = timings_now_ns();
+        if (bench_query_stats(control_sock, stats) == BENCH_STATS_FIELDS) {
+            if (result->detect_ms < 0 && stats[BENCH_STAT_WORKERS] < workers_before) {
+                result->detect_ms = (now - fault_ns) / 1e6;
+            }
+            // Fleck vuelve a pedir Worker a Gotham (único cliente: cualquier DISTORT nuevo es el suyo)
+            if (result->reroute_ms < 0 && stats[BENCH_STAT_DISTORT] > distorts_before) {
+                result->reroute_ms = (now - fault_ns) / 1e6;
+            }
+        }
+
+        // Fleck no detecta un Worker congelado: pasado stall_ms desde la detección se mata
+        int stall = !killed && result->detect_ms >= 0 && result->reroute_ms < 0
+                    && now - fault_ns > (uint64_t)((result->detect_ms + opt->stall_ms) * 1e6);
+        if (stall || (!killed && now > deadline)) {
+            kill(victim, SIGKILL);
+            killed = 1;
+            result->stalled = stall;
+            result->timed_out = !stall;
+        }
+        usleep(FAILOVER_STATS_POLL_MS * 1000);
+    }
+
+    pthread_join(thread, NULL);
+    result->ok = job->ok;
+    result->extra_frames = job->frames;     // Se resta la referencia al acabar todas las ejecuciones
+    result->resumes = job->resumes;
+    result->resume_offset = job->resume_offset;
+    if (job->ok) {
+        char* path;
+        asprintf(&path, "users%s/%s_distorted", BENCH_USER_DIR, job->filename);
+        result->md5 = calculate_md5sum(path);
+        free(path);
+    }
+    if (fault_ns != 0) {
+        result->recover_ms = (job->end_ns - fault_ns) / 1e6;
+    } else {
+        result->recover_ms = (job->end_ns - start) / 1e6;
+    }
+    free(job);
+
+    // ---- Volver a lanzar el Worker caído (se registra como secundario) ----
+    if (fault_ns != 0) {
+        if (!killed) kill(victim, SIGKILL);
+        waitpid(victim, NULL, 0);
+        bench_cluster_spawn_worker(&cluster, result->worker);
+        if (bench_wait_workers(control_sock, cluster.num_workers) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalitat: Escriure la mediana i el màxim d’un conjunt de mostres en JSON (ignora les negatives).
+* @Parametres:
+*   in: fd     = descriptor de sortida.
+*   in: values = mostres (s’ordenen).
+*   in: n      = nombre de mostres.
+* @Retorn: ---
+*
+************************************************/
+static void print_summary_json(int fd, double* values, int n) {
+    int valid = 0;
+    for (int i = 0; i < n; i++) {
+        if (values[i] >= 0) values[valid++] = values[i];
+    }
+    qsort(values, valid, sizeof(double), bench_compare_double);
+    dprintf(fd, "{\"n\": %d, \"p50\": %.1f, \"max\": %.1f}", valid,
+            bench_percentile(values, valid, 50), (valid > 0) ? values[valid - 1] : 0.0);
+}
+
+/***********************************************
+*
+* @Finalitat: Escriure l’informe en JSON: referència, resum per fase i detall de cada execució.
+* @Parametres:
+*   in: fd       = descriptor de sortida.
+*   in: opt      = opcions del benchmark.
+*   in: baseline = execució sense fallo.
+*   in: results  = execucions amb fallo.
+*   in: n        = nombre d’execucions.
+* @Retorn: ---
+*
+************************************************/
+static void print_report(int fd, FailoverOptions* opt, RunResult* baseline, RunResult* results, int n) {
+    dprintf(fd, "{\n  \"config\": {\"signal\": \"%s\", \"kind\": \"%s\", \"size\": %ld, \"workers\": %d, "
+                "\"runs_per_phase\": %d, \"stall_ms\": %d},\n",
+            opt->signal == SIGKILL ? "kill" : "stop", BENCH_KIND_NAMES[opt->kind], opt->size, opt->workers,
+            opt->runs, opt->stall_ms);
+    dprintf(fd, "  \"baseline\": {\"ok\": %d, \"duration_ms\": %.1f, \"frames\": %ld},\n",
+            baseline->ok, baseline->recover_ms, baseline->extra_frames);
+
+    double* values = malloc(sizeof(double) * (n > 0 ? n : 1));
+    dprintf(fd, "  \"phases\": {");
+    for (int p = 0; p < opt->num_phases; p++) {
+        int phase = opt->phases[p];
+        int runs = 0, ok = 0, stalled = 0, missed = 0, resumed = 0, intact = 0;
+        for (int i = 0; i < n; i++) {
+            if (results[i].phase != phase) continue;
+            runs++;
+            ok += results[i].ok;
+            stalled += results[i].stalled;
+            missed += (results[i].hit != phase);
+            resumed += (results[i].resumes > 0);
+            intact += results[i].intact;
+        }
+        dprintf(fd, "%s\n    \"%s\": {\"runs\": %d, \"ok\": %d, \"stalled\": %d, \"missed\": %d, \"resumed\": %d, "
+                    "\"intact\": %d",
+                p ? "," : "", PHASE_NAMES[phase], runs, ok, stalled, missed, resumed, intact);
+
+        const char* names[] = {"detect_ms", "reroute_ms", "recover_ms", "wasted_bytes"};
+        for (int m = 0; m < 4; m++) {
+            int count = 0;
+            for (int i = 0; i < n; i++) {
+                if (results[i].phase != phase) continue;
+                RunResult* r = &results[i];
+                values[count++] = (m == 0) ? r->detect_ms : (m == 1) ? r->reroute_ms : (m == 2) ? r->recover_ms
+                                : r->ok ? (double)r->extra_frames * BUFFER_SIZE : -1;
+            }
+            dprintf(fd, ", \"%s\": ", names[m]);
+            print_summary_json(fd, values, count);
+        }
+        dprintf(fd, "}");
+    }
+    free(values);
+
+    dprintf(fd, "\n  },\n  \"runs\": [");
+    for (int i = 0; i < n; i++) {
+        RunResult* r = &results[i];
+        dprintf(fd, "%s\n    {\"phase\": \"%s\", \"hit\": \"%s\", \"worker\": %d, \"ok\": %d, \"stalled\": %d, "
+                    "\"timed_out\": %d, \"detect_ms\": %.1f, \"reroute_ms\": %.1f, \"recover_ms\": %.1f, "
+                    "\"extra_frames\": %ld, \"wasted_bytes\": %ld, \"resumes\": %d, \"resume_offset\": %ld, "
+                    "\"intact\": %d}",
+                i ? "," : "", PHASE_NAMES[r->phase], r->hit >= 0 ? PHASE_NAMES[r->hit] : "none", r->worker, r->ok,
+                r->stalled, r->timed_out, r->detect_ms, r->reroute_ms, r->recover_ms, r->extra_frames,
+                r->extra_frames * BUFFER_SIZE, r->resumes, r->resume_offset, r->intact);
+    }
+    dprintf(fd, "\n  ]\n}\n");
+}
+
+
+int main(int argc, char* argv[]) {
+    FailoverOptions opt;
+    if (parse_options(argc, argv, &opt) < 0) {
+        print_usage();
+        return -1;
+    }
+
+    // El JSON se escribe en la salida original; los mensajes de las librerías van al log del driver
+    int json_fd = (opt.output != NULL) ? open(opt.output, O_WRONLY | O_CREAT | O_TRUNC, 0644) : dup(STDOUT_FILENO);
+    if (json_fd < 0) {
+        perror("Error abriendo el archivo de salida");
+        return -1;
+    }
+
+    int enigmas = (opt.kind == TIMING_KIND_TEXT) ? opt.workers : 0;
+    int harleys = (opt.kind == TIMING_KIND_TEXT) ? 0 : opt.workers;
+    int total_runs = opt.num_phases * opt.runs;
+    if (bench_prepare_cluster_dir(opt.work_dir, opt.base_port, enigmas, harleys) < 0
+        || prepare_corpus(&opt, total_runs + 1) < 0) {
+        return -1;
+    }
+    int err_fd = dup(STDERR_FILENO);
+    int log_fd = open("logs/driver.log", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (log_fd >= 0) {
+        dup2(log_fd, STDOUT_FILENO);
+        dup2(log_fd, STDERR_FILENO);
+        close(log_fd);
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    int control_sock = bench_cluster_start(&cluster, opt.base_port, enigmas, harleys, err_fd, opt.work_dir);
+    if (control_sock < 0) {
+        return -1;
+    }
+    FleckConfig* config = bench_fleck_config(opt.base_port);
+    int sock = bench_connect_gotham_retry(config);
+
+    // ---- Referencia: tramas de una distorsión sin fallo (ACK por trama en la subida y en la bajada) ----
+    RunResult baseline;
+    long data_frames = (opt.size + FAILOVER_FRAME_DATA - 1) / FAILOVER_FRAME_DATA;
+    if (sock < 0 || run_once(&opt, control_sock, sock, 0, FAILOVER_BASELINE, 0, data_frames, &baseline) < 0 || !baseline.ok
+        || baseline.md5 == NULL) {
+        dprintf(err_fd, "La distorsión de referencia ha fallado (ver %s/logs).\n", opt.work_dir);
+        bench_disconnect_gotham(sock);
+        close(control_sock);
+        bench_cluster_stop(&cluster);
+        return -1;
+    }
+    // Recibidas: ACK inicial, un ACK por trama de datos, MD5, trama inicial, resultado y confirmación final
+    long result_frames = baseline.extra_frames / 2 - data_frames - 3;
+    long thresholds[FAILOVER_NUM_PHASES] = { 1 + data_frames / 2, 1 + data_frames + 1,
+                                             1 + data_frames + 2 + (result_frames > 1 ? result_frames / 2 : 0) };
+
+    // ---- Ejecuciones con fallo ----
+    RunResult* results = calloc(total_runs, sizeof(RunResult));
+    int n = 0;
+    for (int p = 0; p < opt.num_phases; p++) {
+        for (int r = 0; r < opt.runs; r++) {
+            int phase = opt.phases[p];
+            if (run_once(&opt, control_sock, sock, n + 1, phase, thresholds[phase], data_frames, &results[n]) < 0) {
+                dprintf(err_fd, "El clúster no se ha recuperado del fallo (ver %s/logs).\n", opt.work_dir);
+                p = opt.num_phases;
+                break;
+            }
+            results[n].extra_frames -= baseline.extra_frames;
+            results[n].intact = results[n].md5 != NULL && strcmp(results[n].md5, baseline.md5) == 0;
+            n++;
+        }
+    }
+
+    print_report(json_fd, &opt, &baseline, results, n);
+    close(json_fd);
+
+    // Un resultado correcto debe coincidir con la referencia, y una caída en mitad de la descarga debe
+    // reanudarse desde el byte que indica el nuevo Worker (no desde el principio)
+    int failed = 0;
+    for (int i = 0; i < n; i++) {
+        RunResult* r = &results[i];
+        int not_resumed = (r->hit == FAILOVER_PHASE_DOWNLOAD && (r->resumes < 1 || r->resume_offset <= 0));
+        if (r->ok && (!r->intact || not_resumed)) {
+            dprintf(err_fd, "Ejecución %d (%s): %s.\n", i + 1, PHASE_NAMES[r->phase],
+                    r->intact ? "la descarga no se ha reanudado desde el último byte" : "resultado distinto de la referencia");
+            failed = 1;
+        }
+    }
+
+    bench_disconnect_gotham(sock);
+    bench_free_fleck_config(config);
+    close(control_sock);
+    for (int i = 0; i < total_runs; i++) {
+        free(results[i].md5);
+    }
+    free(results);
+    free(baseline.md5);
+    bench_cluster_stop(&cluster);
+    return failed;
+}
@@ -0,0 +1,299 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <sys/stat.h>
+
+#include "bench_utils.h"
+#include "../config/files.h"
+#include "../config/transport.h"
+#include "../worker/enigma/enigmalib.h"
+
+#define MICRO_MAX_SAMPLES 1000
+#define MICRO_MAX_ITERATIONS (1L << 30)
+
+// Opciones de la medición
+typedef struct {
+    int repeats;            // Muestras medidas por caso
+    int warmups;            // Muestras descartadas antes de medir
+    int sample_ms;          // Duración mínima de cada muestra
+    const char* filter;     // Sólo se ejecutan los casos cuyo nombre contiene este texto
+} MicroOptions;
+
+// Contexto de un caso: entrada preparada y tamaño procesado por operación
+typedef struct {
+    unsigned char* trama;   // Trama ya construida (checksum, leer_trama)
+    unsigned char* data;    // Datos de la trama (crear_trama)
+    size_t data_length;
+    char* path;             // Archivo de entrada (read_until, md5sum, distorsión)
+    char* output_path;      // Archivo de salida (distorsión)
+    int fd;                 // Descriptor abierto sobre 'path' (read_until)
+    int conns[2];           // Conexión cuyos extremos envían y reciben la trama (transport)
+    long bytes;             // Bytes procesados por operación (para MB/s)
+} MicroCase;
+
+// Cada caso ejecuta 'iterations' operaciones en un bucle propio (sin llamada indirecta por operación)
+typedef void (*MicroFn)(MicroCase* c, long iterations);
+
+// Evita que el compilador elimine las operaciones medidas
+static volatile unsigned long sink;
+
+
+static void run_checksum(MicroCase* c, long iterations) {
+    for (long i = 0; i < iterations; i++) {
+        c->trama[0] = (unsigned char)i;     // El resultado depende de la iteración
+        sink += calcular_checksum(c->trama);
+    }
+}
+
+static void run_crear_trama(MicroCase* c, long iterations) {
+    for (long i = 0; i < iterations; i++) {
+        unsigned char* trama = crear_trama(0x01, c->data, c->data_length);
+        sink += trama[250];
+        free(trama);
+    }
+}
+
+static void run_leer_trama(MicroCase* c, long iterations) {
+    for (long i = 0; i < iterations; i++) {
+        TramaResult* result = leer_trama(c->trama);
+        sink += result->data_length;
+        free_tramaResult(result);
+    }
+}
+
+static void run_read_until(MicroCase* c, long iterations) {
+    for (long i = 0; i < iterations; i++) {
+        char* line = read_until(c->fd, '\n');
+        if (line == NULL) {     // EOF: volver al inicio del archivo
+            lseek(c->fd, 0, SEEK_SET);
+            line = read_until(c->fd, '\n');
+        }
+        sink += line[0];
+        free(line);
+    }
+}
+
+static void run_md5sum(MicroCase* c, long iterations) {
+    for (long i = 0; i < iterations; i++) {
+        char* md5 = calculate_md5sum(c->path);
+        sink += (md5 != NULL) ? md5[0] : 0;
+        free(md5);
+    }
+}
+
+static void run_distort_text(MicroCase* c, long iterations) {
+    for (long i = 0; i < iterations; i++) {
+        char* output_path = strdup(c->output_path);     // distort_file_text lo libera si falla
+        if (distort_file_text(c->path, output_path, 3) == 0) {
+            free(output_path);
+        }
+        sink++;
+    }
+}
+
+static void run_transport(MicroCase* c, long iterations) {
+    unsigned char received[BUFFER_SIZE];
+    for (long i = 0; i < iterations; i++) {
+        transport_send_frame(c->conns[0], c->trama);
+        transport_recv_frame(c->conns[1], received);
+        sink += received[3];
+    }
+}
+
+/***********************************************
+*
+* @Finalitat: Mesurar la durada d’una mostra de 'iterations' operacions.
+* @Parametres:
+*   in: fn         = bucle del cas.
+*   in: c          = context del cas.
+*   in: iterations = nombre d’operacions.
+* @Retorn: Durada en nanosegons.
+*
+************************************************/
+static double time_sample(MicroFn fn, MicroCase* c, long iterations) {
+    uint64_t start = timings_now_ns();
+    fn(c, iterations);
+    return (double)(timings_now_ns() - start);
+}
+
+/***********************************************
+*
+* @Finalitat: Executar un cas: calibrar les iteracions per mostra, escalfar, repetir les mostres i
+*             escriure la mediana i la MAD dels ns per operació i el throughput resultant.
+* @Parametres:
+*   in: name = nom del cas.
+*   in: size = descripció de la mida d’entrada.
+*   in: fn   = bucle del cas.
+*   in: c    = context del cas.
+*   in: opt  = opcions de mesura.
+* @Retorn: ---
+*
+************************************************/
+static void run_case(const char* name, const char* size, MicroFn fn, MicroCase* c, MicroOptions* opt) {
+    if (opt->filter != NULL && strstr(name, opt->filter) == NULL) return;
+
+    // Calibración: duplicar las iteraciones hasta que una muestra dure al menos sample_ms (también calienta cachés)
+    long iterations = 1;
+    double target_ns = opt->sample_ms * 1e6;
+    while (iterations < MICRO_MAX_ITERATIONS && time_sample(fn, c, iterations) < target_ns) {
+        iterations *= 2;
+    }
+
+    for (int i = 0; i < opt->warmups; i++) {
+        time_sample(fn, c, iterations);
+    }
+
+    double samples[MICRO_MAX_SAMPLES];
+    for (int i = 0; i < opt->repeats; i++) {
+        samples[i] = time_sample(fn, c, iterations) / iterations;
+    }
+
+    double median = bench_median(samples, opt->repeats);
+    double mad = bench_mad(samples, opt->repeats, median);
+    double mb_per_s = (median > 0) ? c->bytes / median * 1e3 : 0;      // bytes/ns * 1e9 / 1e6
+
+    printf("%-14s %-8s %10ld %14.1f %10.1f %6.1f%% %10.1f\n", name, size, iterations,
+           median, mad, (median > 0) ? mad * 100.0 / median : 0.0, mb_per_s);
+    fflush(stdout);
+}
+
+/***********************************************
+*
+* @Finalitat: Crear un fitxer amb línies de la mida indicada (per mesurar read_until).
+* @Parametres:
+*   in: path        = ruta del fitxer.
+*   in: line_length = bytes per línia (inclòs el '\n').
+*   in: lines       = nombre de línies.
+* @Retorn: 0 en èxit, -1 en error.
+*
+************************************************/
+static int write_lines(const char* path, int line_length, int lines) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return -1;
+
+    char* line = malloc(line_length);
+    memset(line, 'a', line_length - 1);
+    line[line_length - 1] = '\n';
+
+    int ret = 0;
+    for (int i = 0; i < lines && ret == 0; i++) {
+        if (write(fd, line, line_length) != line_length) ret = -1;
+    }
+    free(line);
+    close(fd);
+    return ret;
+}
+
+static void print_usage(void) {
+    dprintf(2, "Uso: ./microbench.exe [opciones]\n"
+               "  -r N    Muestras medidas por caso (15)\n"
+               "  -w N    Muestras de calentamiento (3)\n"
+               "  -t MS   Duración mínima de cada muestra en ms (50)\n"
+               "  -f TXT  Ejecutar sólo los casos cuyo nombre contiene TXT\n");
+}
+
+
+int main(int argc, char *argv[]) {
+    MicroOptions opt = { .repeats = 15, .warmups = 3, .sample_ms = 50, .filter = NULL };
+
+    int option;
+    while ((option = getopt(argc, argv, "r:w:t:f:")) != -1) {
+        switch (option) {
+            case 'r': opt.repeats = atoi(optarg); break;
+            case 'w': opt.warmups = atoi(optarg); break;
+            case 't': opt.sample_ms = atoi(optarg); break;
+            case 'f': opt.filter = optarg; break;
+            default:
+                print_usage();
+                return -1;
+        }
+    }
+    if (opt.repeats < 1 || opt.repeats > MICRO_MAX_SAMPLES || opt.warmups < 0 || opt.sample_ms < 1) {
+        print_usage();
+        return -1;
+    }
+
+    char work_dir[] = "/tmp/microbench_XXXXXX";
+    if (mkdtemp(work_dir) == NULL) {
+        perror("Error creando directorio temporal");
+        return -1;
+    }
+
+    printf("%-14s %-8s %10s %14s %10s %7s %10s\n", "Caso", "Tamaño", "iter", "ns/op", "MAD", "MAD%", "MB/s");
+
+    // ---- Tramas: checksum, crear_trama y leer_trama con distintos tamaños de datos ----
+    const size_t data_lengths[] = {0, 64, 247};
+    unsigned char data[247];
+    for (size_t i = 0; i < sizeof(data); i++) data[i] = (unsigned char)('a' + i % 26);
+
+    MicroCase c = { .fd = -1 };
+    c.trama = crear_trama(0x01, data, sizeof(data));
+    c.bytes = BUFFER_SIZE;
+    run_case("checksum", "256B", run_checksum, &c, &opt);
+    free(c.trama);
+
+    for (size_t i = 0; i < sizeof(data_lengths) / sizeof(data_lengths[0]); i++) {
+        char size[16];
+        snprintf(size, sizeof(size), "%zuB", data_lengths[i]);
+
+        c = (MicroCase){ .data = data, .data_length = data_lengths[i], .bytes = BUFFER_SIZE, .fd = -1 };
+        run_case("crear_trama", size, run_crear_trama, &c, &opt);
+
+        c.trama = crear_trama(0x01, data, data_lengths[i]);
+        run_case("leer_trama", size, run_leer_trama, &c, &opt);
+        free(c.trama);
+    }
+
+    // ---- Transporte: enviar y recibir una trama por un socket Unix y por una conexión en memoria ----
+    c = (MicroCase){ .bytes = BUFFER_SIZE, .fd = -1 };
+    c.trama = crear_trama(0x01, data, sizeof(data));
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, c.conns) == 0) {
+        run_case("transport_unix", "256B", run_transport, &c, &opt);
+        transport_close(c.conns[0]);
+        transport_close(c.conns[1]);
+    }
+    if (transport_mem_pair(c.conns) == 0) {
+        run_case("transport_mem", "256B", run_transport, &c, &opt);
+        transport_close(c.conns[0]);
+        transport_close(c.conns[1]);
+    }
+    free(c.trama);
+
+    // ---- read_until: lectura de líneas de distinta longitud ----
+    const int line_lengths[] = {16, 256, 4096};
+    for (size_t i = 0; i < sizeof(line_lengths) / sizeof(line_lengths[0]); i++) {
+        char size[16];
+        snprintf(size, sizeof(size), "%dB", line_lengths[i]);
+
+        c = (MicroCase){ .bytes = line_lengths[i] };
+        asprintf(&c.path, "%s/lines_%d.txt", work_dir, line_lengths[i]);
+        if (write_lines(c.path, line_lengths[i], 256) == 0 && (c.fd = open(c.path, O_RDONLY)) >= 0) {
+            run_case("read_until", size, run_read_until, &c, &opt);
+            close(c.fd);
+        }
+        unlink(c.path);
+        free(c.path);
+    }
+
+    // ---- MD5SUM y distorsión de texto sobre archivos de distinto tamaño ----
+    const long file_sizes[] = {1024, 64 * 1024, 1024 * 1024};
+    const char* file_size_names[] = {"1KB", "64KB", "1MB"};
+    for (size_t i = 0; i < sizeof(file_sizes) / sizeof(file_sizes[0]); i++) {
+        c = (MicroCase){ .bytes = file_sizes[i], .fd = -1 };
+        asprintf(&c.path, "%s/text_%ld.txt", work_dir, file_sizes[i]);
+        asprintf(&c.output_path, "%s/text_%ld.txt_distorted", work_dir, file_sizes[i]);
+
+        if (bench_write_text(c.path, file_sizes[i], 1) == 0) {
+            run_case("md5sum", file_size_names[i], run_md5sum, &c, &opt);
+            run_case("distort_text", file_size_names[i], run_distort_text, &c, &opt);
+        }
+        unlink(c.path);
+        unlink(c.output_path);
+        free(c.path);
+        free(c.output_path);
+    }
+
+    rmdir(work_dir);
+    return 0;
+}
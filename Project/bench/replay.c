@@ -0,0 +1,544 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/epoll.h>
+
+#include "bench_utils.h"
+#include "../config/transport.h"
+
+// Reproducción de una captura de tramas (capture=<archivo> en Gotham o en un Worker, --capture en Fleck):
+// cada conexión capturada se vuelve a abrir contra el destino y se le envían sus tramas con el ritmo original
+#define REPLAY_MAX_TARGETS 16
+#define REPLAY_EPOLL_EVENTS 64
+#define REPLAY_LINGER_MS 1000       // Espera de respuestas tras la última trama
+#define REPLAY_REPLY_WINDOW_MS 1000 // Respuesta máxima en la captura para medir la de una trama
+
+#define REPLAY_CONN_PENDING 0       // Aún no se ha enviado ninguna trama
+#define REPLAY_CONN_OPEN 1
+#define REPLAY_CONN_CLOSED 2        // Cerrada por la captura o por el destino
+#define REPLAY_CONN_FAILED 3        // No se ha podido conectar
+#define REPLAY_CONN_SKIPPED 4       // Sin destino
+
+// Destino de las conexiones cuya primera trama es de un tipo (o de todas si type es -1)
+typedef struct {
+    int type;
+    char* address;                  // IP o unix:/ruta (NULL para no reproducir esas conexiones)
+    int port;
+    char* spec;                     // Texto de la opción, para el JSON
+} ReplayTarget;
+
+// Opciones del benchmark (configurables por línea de comandos)
+typedef struct {
+    char* input;
+    ReplayTarget targets[REPLAY_MAX_TARGETS];
+    int num_targets;
+    int direction;                  // Tramas a enviar: TRANSPORT_CAPTURE_RECEIVED o TRANSPORT_CAPTURE_SENT
+    double speed;                   // 1 ritmo original, 2 el doble de rápido, 0 sin esperas
+    int linger_ms;
+    int reply_window_ms;
+    char* output;
+} ReplayOptions;
+
+// Conexión capturada y su reproducción
+typedef struct {
+    int state;                      // REPLAY_CONN_*
+    int fd;
+    const ReplayTarget* target;
+    unsigned char buffer[BUFFER_SIZE];  // Trama recibida a medias
+    int buffered;
+    uint64_t waiting_ns;            // Envío más antiguo sin respuesta (0 si no hay)
+    long expected;                  // Tramas en sentido contrario en la captura
+    long received;
+    int next_direction;             // Al preparar la reproducción: sentido del siguiente registro (-1 si no hay)
+    uint64_t next_ns;               // y su instante
+} ReplayConn;
+
+static ReplayOptions opt;
+static ReplayConn* conns;           // Indexadas por el identificador de la captura
+static int epoll_fd;
+static double* lag_ms;              // Retraso de cada envío respecto al ritmo programado
+static int num_lag;
+static double* reply_ms;            // Tiempo hasta la primera trama de respuesta
+static int num_reply;
+static double* captured_reply_ms;   // Lo mismo para esas tramas en la captura
+static int num_captured_reply;
+static long frames_received, closed_by_peer;
+
+
+/***********************************************
+*
+* @Finalitat: Mostrar l’ús del benchmark.
+* @Parametres: ---
+* @Retorn: ---
+*
+************************************************/
+static void print_usage(void) {
+    dprintf(2, "Uso: ./replay.exe -i CAPTURA -t [TIPO=]DESTINO [opciones]\n"
+               "  -i, --input FILE        Captura (capture=<archivo> de Gotham o Worker, --capture de Fleck)\n"
+               "  -t, --target [T=]DEST   Destino IP:puerto o unix:/ruta; con T (p. ej. 0x02) solo para las\n"
+               "                          conexiones cuya primera trama es de ese tipo; DEST 'skip' las descarta\n"
+               "  -d, --direction DIR     Tramas a enviar: received (las que recibió el capturado) o sent (received)\n"
+               "  -x, --speed F           1 ritmo original, 10 diez veces más rápido, 0 sin esperas (1)\n"
+               "      --linger-ms MS      Espera de respuestas tras la última trama (1000)\n"
+               "      --reply-window-ms MS Solo se mide la respuesta de las tramas respondidas en la captura\n"
+               "                          antes de MS (1000)\n"
+               "  -o, --output FILE       Resultado JSON (stdout)\n");
+}
+
+/***********************************************
+*
+* @Finalitat: Llegir un destí [TIPUS=]IP:port, [TIPUS=]unix:/ruta o [TIPUS=]skip.
+* @Parametres:
+*   in:  spec   = text de l’opció (es modifica).
+*   out: target = destí llegit.
+* @Retorn: 0 en èxit, -1 si és invàlid.
+*
+************************************************/
+static int parse_target(char* spec, ReplayTarget* target) {
+    target->spec = strdup(spec);
+    target->type = -1;
+    char* destination = spec;
+    char* equals = strchr(spec, '=');
+    if (equals != NULL) {
+        *equals = '\0';
+        char* end;
+        target->type = strtol(spec, &end, 0);
+        if (*spec == '\0' || *end != '\0' || target->type < 0 || target->type > 0xFF) return -1;
+        destination = equals + 1;
+    }
+
+    if (strcmp(destination, "skip") == 0) {
+        target->address = NULL;
+        target->port = 0;
+        return 0;
+    }
+    if (strncmp(destination, UNIX_ADDR_PREFIX, strlen(UNIX_ADDR_PREFIX)) == 0) {
+        target->address = destination;
+        target->port = 0;
+        return 0;
+    }
+    char* colon = strrchr(destination, ':');
+    if (colon == NULL || atoi(colon + 1) <= 0) return -1;
+    *colon = '\0';
+    target->address = destination;
+    target->port = atoi(colon + 1);
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalitat: Llegir les opcions de línia de comandes.
+* @Parametres:
+*   in: argc, argv = arguments del programa.
+* @Retorn: 0 en èxit, -1 si hi ha opcions invàlides.
+*
+************************************************/
+static int parse_options(int argc, char* argv[]) {
+    static struct option long_options[] = {
+        {"input", required_argument, 0, 'i'},
+        {"target", required_argument, 0, 't'},
+        {"direction", required_argument, 0, 'd'},
+        {"speed", required_argument, 0, 'x'},
+        {"linger-ms", required_argument, 0, 'L'},
+        {"reply-window-ms", required_argument, 0, 'W'},
+        {"output", required_argument, 0, 'o'},
+        {0, 0, 0, 0}
+    };
+
+    opt = (ReplayOptions){ .input = NULL, .num_targets = 0, .direction = TRANSPORT_CAPTURE_RECEIVED,
+                           .speed = 1, .linger_ms = REPLAY_LINGER_MS,
+                           .reply_window_ms = REPLAY_REPLY_WINDOW_MS, .output = NULL };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "i:t:d:x:o:", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'i': opt.input = optarg; break;
+            case 't':
+                if (opt.num_targets == REPLAY_MAX_TARGETS || parse_target(optarg, &opt.targets[opt.num_targets]) < 0) {
+                    return -1;
+                }
+                opt.num_targets++;
+                break;
+            case 'd':
+                if (strcmp(optarg, "received") == 0) {
+                    opt.direction = TRANSPORT_CAPTURE_RECEIVED;
+                } else if (strcmp(optarg, "sent") == 0) {
+                    opt.direction = TRANSPORT_CAPTURE_SENT;
+                } else {
+                    return -1;
+                }
+                break;
+            case 'x': opt.speed = atof(optarg); break;
+            case 'L': opt.linger_ms = atoi(optarg); break;
+            case 'W': opt.reply_window_ms = atoi(optarg); break;
+            case 'o': opt.output = optarg; break;
+            default: return -1;
+        }
+    }
+    if (opt.input == NULL || opt.num_targets == 0 || opt.speed < 0 || opt.linger_ms < 0
+        || opt.reply_window_ms < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalitat: Llegir tota una captura.
+* @Parametres:
+*   in:  path     = fitxer de captura.
+*   out: records  = registres llegits (memòria dinàmica).
+*   out: start_ns = inici de la captura (ns des de l’epoch).
+* @Retorn: Nombre de registres, o -1 en error.
+*
+************************************************/
+static int load_capture(const char* path, CaptureRecord** records, uint64_t* start_ns) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("Error abriendo la captura");
+        return -1;
+    }
+    if (transport_capture_read_header(fd, start_ns) < 0) {
+        dprintf(2, "%s no es una captura de tramas válida.\n", path);
+        close(fd);
+        return -1;
+    }
+
+    int count = 0, capacity = 0, rc;
+    *records = NULL;
+    CaptureRecord record;
+    while ((rc = transport_capture_read(fd, &record)) == 1) {
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 4096;
+            *records = realloc(*records, capacity * sizeof(CaptureRecord));
+        }
+        (*records)[count++] = record;
+    }
+    close(fd);
+    if (rc < 0) {
+        // Un proceso terminado a mitad de un registro deja la captura truncada: se reproduce lo leído
+        dprintf(2, "Aviso: captura truncada tras %d registros.\n", count);
+    }
+    return count;
+}
+
+/***********************************************
+*
+* @Finalitat: Comparar dos registres per instant de captura (i, si empaten, per posició al fitxer).
+* @Parametres:
+*   in: a, b = punters a CaptureRecord*.
+* @Retorn: <0, 0 o >0 com qsort.
+*
+************************************************/
+static int compare_records(const void* a, const void* b) {
+    const CaptureRecord* ra = *(const CaptureRecord* const*)a;
+    const CaptureRecord* rb = *(const CaptureRecord* const*)b;
+    if (ra->time_ns != rb->time_ns) return (ra->time_ns < rb->time_ns) ? -1 : 1;
+    return (ra < rb) ? -1 : (ra > rb);
+}
+
+/***********************************************
+*
+* @Finalitat: Triar el destí d’una connexió pel tipus de la seva primera trama.
+* @Parametres:
+*   in: type = tipus de la primera trama a enviar.
+* @Retorn: Destí, o NULL si cap opció no la cobreix.
+*
+************************************************/
+static const ReplayTarget* choose_target(int type) {
+    const ReplayTarget* fallback = NULL;
+    for (int i = 0; i < opt.num_targets; i++) {
+        if (opt.targets[i].type == type) return &opt.targets[i];
+        if (opt.targets[i].type == -1 && fallback == NULL) fallback = &opt.targets[i];
+    }
+    return fallback;
+}
+
+/***********************************************
+*
+* @Finalitat: Tancar la connexió reproduïda.
+* @Parametres:
+*   in/out: conn = connexió.
+* @Retorn: ---
+*
+************************************************/
+static void close_conn(ReplayConn* conn) {
+    if (conn->state != REPLAY_CONN_OPEN) return;
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    transport_close(conn->fd);
+    conn->fd = -1;
+    conn->state = REPLAY_CONN_CLOSED;
+}
+
+/***********************************************
+*
+* @Finalitat: Llegir les respostes disponibles del destí durant com a molt timeout_ms.
+* @Parametres:
+*   in: timeout_ms = temps màxim d’espera.
+* @Retorn: ---
+*
+************************************************/
+static void drain_replies(int timeout_ms) {
+    struct epoll_event events[REPLAY_EPOLL_EVENTS];
+    int ready = epoll_wait(epoll_fd, events, REPLAY_EPOLL_EVENTS, timeout_ms);
+    uint64_t now = timings_now_ns();
+    for (int i = 0; i < ready; i++) {
+        ReplayConn* conn = (ReplayConn*)events[i].data.ptr;
+        ssize_t n = recv(conn->fd, conn->buffer + conn->buffered, BUFFER_SIZE - conn->buffered, MSG_DONTWAIT);
+        if (n < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+        if (n <= 0) {
+            closed_by_peer++;
+            close_conn(conn);
+            continue;
+        }
+        conn->buffered += n;
+        if (conn->buffered < BUFFER_SIZE) continue;
+
+        // Trama completa: se descarta, solo cuenta y da la latencia de respuesta
+        conn->buffered = 0;
+        conn->received++;
+        frames_received++;
+        if (conn->waiting_ns != 0) {
+            reply_ms[num_reply++] = (now - conn->waiting_ns) / 1e6;
+            conn->waiting_ns = 0;
+        }
+    }
+}
+
+/***********************************************
+*
+* @Finalitat: Tancar una connexió en arribar al seu tancament a la captura. Abans s’espera (com a molt
+*             --reply-window-ms) que arribin les respostes que la captura va veure abans del tancament,
+*             que altrament es perdrien en reproduir més ràpid que la captura.
+* @Parametres:
+*   in/out: conn = connexió.
+* @Retorn: ---
+*
+************************************************/
+static void close_conn_captured(ReplayConn* conn) {
+    uint64_t deadline = timings_now_ns() + (uint64_t)opt.reply_window_ms * 1000000ULL;
+    while (conn->state == REPLAY_CONN_OPEN && conn->received < conn->expected && timings_now_ns() < deadline) {
+        drain_replies(1);
+    }
+    close_conn(conn);
+}
+
+/***********************************************
+*
+* @Finalitat: Esperar fins a un instant llegint mentrestant les respostes.
+* @Parametres:
+*   in: deadline_ns = instant (timings_now_ns()).
+* @Retorn: ---
+*
+************************************************/
+static void wait_until(uint64_t deadline_ns) {
+    uint64_t now;
+    while ((now = timings_now_ns()) < deadline_ns) {
+        uint64_t remaining = deadline_ns - now;
+        if (remaining >= 1000000ULL) {
+            drain_replies(remaining / 1000000ULL);
+        } else {
+            struct timespec pause = { .tv_sec = 0, .tv_nsec = remaining };
+            nanosleep(&pause, NULL);
+        }
+    }
+}
+
+/***********************************************
+*
+* @Finalitat: Ordenar unes mostres i escriure’n els percentils en JSON.
+* @Parametres:
+*   in:     fd      = descriptor de sortida.
+*   in:     name    = nom del camp.
+*   in/out: samples = mostres (s’ordenen).
+*   in:     count   = nombre de mostres.
+* @Retorn: ---
+*
+************************************************/
+static void print_samples_json(int fd, const char* name, double* samples, int count) {
+    qsort(samples, count, sizeof(double), bench_compare_double);
+    dprintf(fd, "\"%s\": {\"count\": %d, \"p50\": %.3f, \"p99\": %.3f, \"p999\": %.3f, \"max\": %.3f}", name, count,
+            bench_percentile(samples, count, 50), bench_percentile(samples, count, 99),
+            bench_percentile(samples, count, 99.9), count > 0 ? samples[count - 1] : 0);
+}
+
+
+int main(int argc, char* argv[]) {
+    if (parse_options(argc, argv) < 0) {
+        print_usage();
+        return -1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    // El JSON se escribe en la salida original; los mensajes de connect_to_server van a stderr
+    int json_fd = (opt.output != NULL) ? open(opt.output, O_WRONLY | O_CREAT | O_TRUNC, 0644) : dup(STDOUT_FILENO);
+    if (json_fd < 0) {
+        perror("Error abriendo el archivo de salida");
+        return -1;
+    }
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+
+    CaptureRecord* records;
+    uint64_t capture_start_ns;
+    int num_records = load_capture(opt.input, &records, &capture_start_ns);
+    if (num_records < 0) {
+        return -1;
+    }
+
+    // Los hilos del proceso capturado escriben sin orden global: se ordena por instant de captura
+    CaptureRecord** order = malloc((num_records + 1) * sizeof(CaptureRecord*));
+    uint32_t max_id = 0;
+    for (int i = 0; i < num_records; i++) {
+        order[i] = &records[i];
+        if (records[i].conn_id > max_id) max_id = records[i].conn_id;
+    }
+    qsort(order, num_records, sizeof(CaptureRecord*), compare_records);
+
+    // Destino de cada conexión según la primera trama a enviar y tramas esperadas en sentido contrario
+    conns = calloc(max_id + 1, sizeof(ReplayConn));
+    int num_frames = 0, num_conns = 0, skipped = 0;
+    for (int i = 0; i < num_records; i++) {
+        ReplayConn* conn = &conns[order[i]->conn_id];
+        if (order[i]->direction == opt.direction) {
+            if (conn->target == NULL && conn->state == REPLAY_CONN_PENDING) {
+                conn->target = choose_target((unsigned char)order[i]->trama[0]);
+                num_conns++;
+                if (conn->target == NULL || conn->target->address == NULL) {
+                    conn->state = REPLAY_CONN_SKIPPED;
+                    skipped++;
+                }
+            }
+            num_frames++;
+        } else if (order[i]->direction != TRANSPORT_CAPTURE_CLOSED) {
+            conn->expected++;
+        }
+    }
+    // Solo se mide la respuesta de las tramas a las que en la captura siguió una del otro extremo antes de
+    // --reply-window-ms (así no cuenta, p. ej., la respuesta de un Worker a un HEARTBEAT, a la que sigue el
+    // HEARTBEAT siguiente de Gotham)
+    char* answered = calloc(num_records + 1, 1);
+    captured_reply_ms = malloc((num_frames + 1) * sizeof(double));
+    for (uint32_t id = 0; id <= max_id; id++) {
+        conns[id].next_direction = -1;
+    }
+    for (int i = num_records - 1; i >= 0; i--) {
+        ReplayConn* conn = &conns[order[i]->conn_id];
+        if (order[i]->direction == TRANSPORT_CAPTURE_CLOSED) continue;
+        if (order[i]->direction == opt.direction && conn->next_direction != -1 && conn->next_direction != opt.direction
+            && conn->next_ns - order[i]->time_ns <= (uint64_t)opt.reply_window_ms * 1000000ULL) {
+            answered[i] = 1;
+            if (conn->state != REPLAY_CONN_SKIPPED) {
+                captured_reply_ms[num_captured_reply++] = (conn->next_ns - order[i]->time_ns) / 1e6;
+            }
+        }
+        conn->next_direction = order[i]->direction;
+        conn->next_ns = order[i]->time_ns;
+    }
+    lag_ms = malloc((num_frames + 1) * sizeof(double));
+    reply_ms = malloc((num_frames + 1) * sizeof(double));
+    epoll_fd = epoll_create1(0);
+
+    // ---- Reproducción: cada trama en su instant (escalado por --speed) ----
+    long frames_sent = 0, send_errors = 0, fd_frames = 0, expected = 0;
+    int opened = 0, failed = 0;
+    uint64_t capture_ns = num_records > 0 ? order[num_records - 1]->time_ns - order[0]->time_ns : 0;
+    uint64_t start = timings_now_ns();
+    for (int i = 0; i < num_records; i++) {
+        CaptureRecord* record = order[i];
+        ReplayConn* conn = &conns[record->conn_id];
+        int is_close = record->direction == TRANSPORT_CAPTURE_CLOSED;
+        if ((!is_close && record->direction != opt.direction) || conn->state == REPLAY_CONN_SKIPPED
+            || conn->state == REPLAY_CONN_FAILED || (is_close && conn->state != REPLAY_CONN_OPEN)) {
+            continue;
+        }
+
+        uint64_t due = start;
+        if (opt.speed > 0) {
+            due += (uint64_t)((record->time_ns - order[0]->time_ns) / opt.speed);
+            wait_until(due);
+        }
+        if (is_close) {
+            close_conn_captured(conn);
+            continue;
+        }
+
+        if (conn->state == REPLAY_CONN_PENDING) {
+            conn->fd = connect_to_server(conn->target->address, conn->target->port);
+            if (conn->fd < 0) {
+                conn->state = REPLAY_CONN_FAILED;
+                failed++;
+                continue;
+            }
+            conn->state = REPLAY_CONN_OPEN;
+            opened++;
+            expected += conn->expected;
+            struct epoll_event event = { .events = EPOLLIN, .data.ptr = conn };
+            epoll_ctl(epoll_fd, EPOLL_CTL_ADD, conn->fd, &event);
+        }
+        if (conn->state != REPLAY_CONN_OPEN) continue;
+
+        // El descriptor que acompañaba a la trama no está en la captura: esa trama no se puede reproducir
+        if (record->carried_fd) {
+            fd_frames++;
+            continue;
+        }
+        uint64_t now = timings_now_ns();
+        if (opt.speed > 0) {
+            lag_ms[num_lag++] = (now > due) ? (now - due) / 1e6 : 0;
+        }
+        if (transport_send_frame(conn->fd, record->trama) != BUFFER_SIZE) {
+            send_errors++;
+            close_conn(conn);
+            continue;
+        }
+        frames_sent++;
+        if (answered[i] && conn->waiting_ns == 0) conn->waiting_ns = now;
+        drain_replies(0);
+    }
+    uint64_t replay_ns = timings_now_ns() - start;
+
+    uint64_t linger_end = timings_now_ns() + (uint64_t)opt.linger_ms * 1000000ULL;
+    wait_until(linger_end);
+    for (uint32_t id = 0; id <= max_id; id++) {
+        close_conn(&conns[id]);
+    }
+    close(epoll_fd);
+
+    // ---- Resultado ----
+    dprintf(json_fd, "{\n  \"capture\": {\"file\": \"%s\", \"start_epoch_ms\": %llu, \"records\": %d, \"connections\": %d, "
+                     "\"duration_ms\": %.1f},\n",
+            opt.input, (unsigned long long)(capture_start_ns / 1000000ULL), num_records, num_conns, capture_ns / 1e6);
+    dprintf(json_fd, "  \"config\": {\"direction\": \"%s\", \"speed\": %g, \"linger_ms\": %d, \"reply_window_ms\": %d, "
+                     "\"targets\": [",
+            opt.direction == TRANSPORT_CAPTURE_RECEIVED ? "received" : "sent", opt.speed, opt.linger_ms, opt.reply_window_ms);
+    for (int i = 0; i < opt.num_targets; i++) dprintf(json_fd, "%s\"%s\"", i ? ", " : "", opt.targets[i].spec);
+    dprintf(json_fd, "]},\n");
+    dprintf(json_fd, "  \"connections\": {\"opened\": %d, \"failed\": %d, \"skipped\": %d, \"closed_by_peer\": %ld},\n",
+            opened, failed, skipped, closed_by_peer);
+    dprintf(json_fd, "  \"frames\": {\"sent\": %ld, \"send_errors\": %ld, \"fd_frames\": %ld, \"received\": %ld, "
+                     "\"captured_replies\": %ld},\n",
+            frames_sent, send_errors, fd_frames, frames_received, expected);
+    dprintf(json_fd, "  \"timing\": {\"duration_ms\": %.1f, \"speedup\": %.2f, ",
+            replay_ns / 1e6, replay_ns > 0 ? (double)capture_ns / replay_ns : 0);
+    print_samples_json(json_fd, "lag_ms", lag_ms, num_lag);
+    dprintf(json_fd, ", ");
+    print_samples_json(json_fd, "reply_ms", reply_ms, num_reply);
+    dprintf(json_fd, ", ");
+    print_samples_json(json_fd, "captured_reply_ms", captured_reply_ms, num_captured_reply);
+    dprintf(json_fd, "}\n}\n");
+    close(json_fd);
+
+    for (int i = 0; i < opt.num_targets; i++) free(opt.targets[i].spec);
+    free(lag_ms);
+    free(reply_ms);
+    free(captured_reply_ms);
+    free(answered);
+    free(conns);
+    free(order);
+    free(records);
+    return 0;
+}
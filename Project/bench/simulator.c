@@ -0,0 +1,1073 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "../gotham/gothamlib.h"
+#include "../worker/worker_pool.h"
+#include "../fleck/flecklib_distort.h"
+
+// Simulador de eventos discretos de un clúster: un único hilo ejecuta el encaminamiento, el registro
+// de Workers, el registro de distorsiones y el detector de fallos reales de Gotham con un reloj virtual,
+// mientras los Workers y los Flecks son modelos que responden a los eventos programados
+#define SIM_START_NS 1000000000ULL          // Origen del reloj virtual (0 significa "fase no alcanzada" en el registro)
+#define SIM_REGISTER_SPREAD_MS 1000         // Los Workers se registran repartidos en este intervalo
+#define SIM_FLECK_RECONNECT_MS 8000         // Espera de Fleck antes de pedir otro Worker tras una caída (sleep(8))
+#define SIM_MAX_CRASHES 64
+#define SIM_MAX_GOTHAM_OPTIONS 32
+
+// Estado de un Worker simulado
+#define SIM_WORKER_IDLE 0                   // Todavía no se ha registrado
+#define SIM_WORKER_UP 1
+#define SIM_WORKER_HUNG 2                   // Congelado (SIGSTOP): no responde ni avanza, la conexión sigue abierta
+#define SIM_WORKER_DEAD 3                   // Matado o dado por caído por Gotham
+
+// Tipos de evento
+#define EV_REGISTER 0       // Worker: conexión y registro en Gotham
+#define EV_WATCH 1          // Worker: iteración del hilo de Gotham que lo vigila (HEARTBEAT y phi)
+#define EV_HB_REPLY 2       // Worker: respuesta al HEARTBEAT con su carga
+#define EV_SUBMIT 3         // Fleck: nueva distorsión
+#define EV_DISTORT 4        // Fleck: petición DISTORT a Gotham (nueva o para pedir otro Worker)
+#define EV_ARRIVE 5         // Worker: conexión del Fleck asignado (entra en la cola o responde BUSY)
+#define EV_DISTORTING 6     // Worker: archivo recibido, empieza a distorsionar
+#define EV_DOWNLOADING 7    // Worker: empieza a devolver el archivo distorsionado
+#define EV_DONE 8           // Worker y Fleck: archivo devuelto y verificado
+#define EV_CRASH 9          // Fallo programado (kill o hang)
+
+// Distribución del tamaño de los archivos (KB)
+#define SIM_SIZE_FIXED 0
+#define SIM_SIZE_UNIFORM 1
+#define SIM_SIZE_EXP 2
+#define SIM_SIZE_PARETO 3
+
+typedef struct {
+    int type;
+    double a;
+    double b;
+} SizeDistribution;
+
+// Fallo programado
+typedef struct {
+    double at_s;
+    int hang;                       // 0 = kill (SIGKILL), 1 = hang (SIGSTOP)
+    int target;                     // Índice del Worker, o -1 para el Worker principal de Text
+    // Resultados
+    int worker;                     // Worker afectado (-1 si no se ha producido)
+    uint64_t crash_ns;
+    uint64_t removed_ns;            // Gotham lo saca de su lista (0 si no lo ha hecho)
+    int affected;                   // Distorsiones en curso en el Worker
+    int pending;                    // Distorsiones afectadas que aún no se han reasignado
+    int unfinished;                 // Distorsiones afectadas que aún no han acabado
+    int failed;
+    uint64_t rerouted_ns;           // Última distorsión afectada reasignada
+    uint64_t recovered_ns;          // Última distorsión afectada acabada
+} SimCrash;
+
+// Opciones del simulador (configurables por línea de comandos)
+typedef struct {
+    int workers;
+    int flecks;
+    double duration_s;
+    unsigned long seed;
+    double think_ms;                // Espera media de un Fleck entre distorsiones (exponencial)
+    SizeDistribution size;
+    double service_base_ms;         // Tiempo de distorsión: fijo + por KB
+    double service_ms_per_kb;
+    int slots;                      // Distorsiones a la vez en un Worker
+    int queue;                      // Conexiones en cola en un Worker (BUSY con la cola llena)
+    double net_ms;                  // Latencia de red en un sentido
+    double bandwidth_mbs;           // Ancho de banda Fleck-Worker
+    int ledger;                     // Capacidad del registro de distorsiones de Gotham
+    SimCrash crashes[SIM_MAX_CRASHES];
+    int num_crashes;
+    char* gotham_options[SIM_MAX_GOTHAM_OPTIONS];
+    int num_gotham_options;
+    char* log;
+    char* output;
+} SimOptions;
+
+typedef struct {
+    uint64_t time_ns;
+    uint64_t seq;                   // Orden de programación (desempata los eventos simultáneos)
+    int type;
+    int target;                     // Worker o Fleck, según el tipo
+    int arg;                        // Fleck de los eventos de Worker
+    int generation;                 // Intento del Fleck al programarlo (descarta los eventos obsoletos)
+} SimEvent;
+
+typedef struct {
+    char ip[16];                    // 10.<índice>: identifica al Worker en las respuestas de Gotham
+    int state;
+    int conn;                       // Extremo de Gotham de la conexión en memoria
+    int peer;                       // Extremo del Worker
+    WorkerWatch watch;
+    int* queue;                     // Flecks en cola (anillo de 'queue' posiciones)
+    int queue_head;
+    int queued;
+    int active;
+    double service_ms;              // Media móvil del tiempo de servicio (se informa en los HEARTBEAT)
+    long jobs;
+} SimWorker;
+
+typedef struct {
+    char username[16];
+    char ip[16];
+    unsigned long job_id;           // Id de Gotham de la distorsión en curso (0 hasta la primera asignación)
+    char filename[32];
+    long size;                      // Bytes del archivo
+    int worker;                     // Worker asignado (-1 si no tiene)
+    int generation;
+    int gotham_retries;             // DISTORT_BUSY o DISTORT_LIMIT seguidos
+    int worker_retries;             // BUSY del Worker seguidos
+    int crash;                      // Fallo que ha afectado a la distorsión (-1 si ninguno)
+    int busy;                       // 1 mientras tiene una distorsión en curso
+    uint64_t submit_ns;
+    uint64_t service_ns;            // Inicio de la distorsión en un hilo del Worker
+    long jobs;
+} SimFleck;
+
+// Resultados globales
+typedef struct {
+    long submitted;
+    long completed;
+    long failed;
+    long reassigned;                // Distorsiones que han pedido otro Worker tras una caída
+    long gotham_busy;               // DISTORT_BUSY y DISTORT_LIMIT recibidos
+    long worker_busy;               // BUSY de un Worker con la cola llena
+    long bytes;
+    long events;
+    long route_calls;
+    uint64_t route_wall_ns;         // Tiempo real dentro de GOTHAM_route_distort
+    Histogram queue_delay;          // Desde la petición hasta que un hilo del Worker la atiende
+    Histogram latency;              // Desde la petición hasta el archivo verificado
+} SimResults;
+
+static SimOptions opt;
+static GlobalInfoGotham* gotham = NULL;
+static SimWorker* workers = NULL;
+static SimFleck* flecks = NULL;
+static SimResults results;
+
+static uint64_t sim_now_ns = SIM_START_NS;
+static uint64_t rng_state;
+static SimEvent* heap = NULL;
+static int heap_len = 0;
+static int heap_cap = 0;
+static uint64_t next_seq = 0;
+
+
+/***********************************************
+*
+* @Finalitat: Rellotge virtual que Gotham llegeix a través de timings_now_ns.
+* @Parametres: ---
+* @Retorn: Temps virtual en nanosegons.
+*
+************************************************/
+static uint64_t sim_clock(void) {
+    return sim_now_ns;
+}
+
+/***********************************************
+*
+* @Finalitat: Obtenir el temps real del rellotge monòton (per mesurar el cost de l’encaminament).
+* @Parametres: ---
+* @Retorn: Temps en nanosegons.
+*
+************************************************/
+static uint64_t wall_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/***********************************************
+*
+* @Finalitat: Generar un nombre pseudoaleatori (splitmix64): la mateixa llavor dona la mateixa simulació.
+* @Parametres: ---
+* @Retorn: Nombre uniforme a [0, 1).
+*
+************************************************/
+static double rng_uniform(void) {
+    uint64_t z = (rng_state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z ^= z >> 31;
+    return (z >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/***********************************************
+*
+* @Finalitat: Generar una mostra exponencial.
+* @Parametres:
+*   in: mean = mitjana.
+* @Retorn: Mostra (>= 0).
+*
+************************************************/
+static double rng_exponential(double mean) {
+    return -mean * log(1.0 - rng_uniform());
+}
+
+/***********************************************
+*
+* @Finalitat: Generar la mida d’un fitxer segons la distribució configurada.
+* @Parametres:
+*   in: dist = distribució de mides en KB.
+* @Retorn: Mida en bytes (com a mínim 1).
+*
+************************************************/
+static long sample_size(const SizeDistribution* dist) {
+    double kb;
+    switch (dist->type) {
+        case SIM_SIZE_UNIFORM: kb = dist->a + (dist->b - dist->a) * rng_uniform(); break;
+        case SIM_SIZE_EXP: kb = rng_exponential(dist->a); break;
+        case SIM_SIZE_PARETO: kb = dist->a / pow(1.0 - rng_uniform(), 1.0 / dist->b); break;
+        default: kb = dist->a; break;
+    }
+    long bytes = (long)(kb * 1024);
+    return (bytes > 0) ? bytes : 1;
+}
+
+/***********************************************
+*
+* @Finalitat: Programar un esdeveniment (heap binari ordenat per temps i ordre de programació).
+* @Parametres:
+*   in: at_ns      = instant virtual.
+*   in: type       = tipus d’esdeveniment (EV_*).
+*   in: target     = Worker o Fleck.
+*   in: arg        = Fleck dels esdeveniments de Worker.
+*   in: generation = intent del Fleck en programar-lo.
+* @Retorn: ---
+*
+************************************************/
+static void schedule(uint64_t at_ns, int type, int target, int arg, int generation) {
+    if (heap_len == heap_cap) {
+        heap_cap = heap_cap ? heap_cap * 2 : 1024;
+        heap = realloc(heap, heap_cap * sizeof(SimEvent));
+        if (heap == NULL) {
+            perror("Error al ampliar la cola de eventos");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    SimEvent ev = { .time_ns = at_ns, .seq = next_seq++, .type = type, .target = target, .arg = arg, .generation = generation };
+    int i = heap_len++;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        SimEvent* p = &heap[parent];
+        if (p->time_ns < ev.time_ns || (p->time_ns == ev.time_ns && p->seq < ev.seq)) {
+            break;
+        }
+        heap[i] = *p;
+        i = parent;
+    }
+    heap[i] = ev;
+}
+
+/***********************************************
+*
+* @Finalitat: Treure el proper esdeveniment.
+* @Parametres:
+*   out: ev = esdeveniment.
+* @Retorn: 1 si n’hi havia, 0 si la cua és buida.
+*
+************************************************/
+static int next_event(SimEvent* ev) {
+    if (heap_len == 0) {
+        return 0;
+    }
+    *ev = heap[0];
+    SimEvent last = heap[--heap_len];
+    int i = 0;
+    while (1) {
+        int child = 2 * i + 1;
+        if (child >= heap_len) {
+            break;
+        }
+        if (child + 1 < heap_len && (heap[child + 1].time_ns < heap[child].time_ns
+            || (heap[child + 1].time_ns == heap[child].time_ns && heap[child + 1].seq < heap[child].seq))) {
+            child++;
+        }
+        if (last.time_ns < heap[child].time_ns || (last.time_ns == heap[child].time_ns && last.seq < heap[child].seq)) {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = last;
+    return 1;
+}
+
+/***********************************************
+*
+* @Finalitat: Convertir mil·lisegons virtuals a nanosegons.
+* @Parametres:
+*   in: ms = mil·lisegons.
+* @Retorn: Nanosegons.
+*
+************************************************/
+static uint64_t ms_to_ns(double ms) {
+    return (ms > 0) ? (uint64_t)(ms * 1e6) : 0;
+}
+
+/***********************************************
+*
+* @Finalitat: Trobar el Worker simulat a partir de la IP que Gotham respon a Fleck (10.<a>.<b>.<c>).
+* @Parametres:
+*   in: ip = IP del Worker.
+* @Retorn: Índex del Worker o -1.
+*
+************************************************/
+static int worker_from_ip(const char* ip) {
+    int a, b, c;
+    if (sscanf(ip, "10.%d.%d.%d", &a, &b, &c) != 3) {
+        return -1;
+    }
+    int index = (a << 16) | (b << 8) | c;
+    return (index < opt.workers) ? index : -1;
+}
+
+/***********************************************
+*
+* @Finalitat: Enviar a Gotham una trama TYPE_JOB_STATUS en nom d’un Fleck o d’un Worker.
+* @Parametres:
+*   in: fleck  = Fleck de la distorsió.
+*   in: phase  = fase (JOB_STATUS_*).
+*   in: worker = Worker que informa (-1 si informa el Fleck).
+* @Retorn: ---
+*
+************************************************/
+static void report_status(SimFleck* fleck, const char* phase, int worker) {
+    if (fleck->job_id == 0) {
+        return;
+    }
+    char data[64];
+    snprintf(data, sizeof(data), "%lu&%s", fleck->job_id, phase);
+    if (worker < 0) {
+        handle_job_status(gotham, data, NULL);
+        return;
+    }
+
+    // Los Workers informan por su conexión con Gotham (misma ruta que en el hilo de vigilancia)
+    unsigned char* trama = crear_trama(TYPE_JOB_STATUS, (unsigned char*)data, strlen(data));
+    if (trama != NULL) {
+        GOTHAM_watch_frame(gotham, &workers[worker].watch, workers[worker].conn, trama, sim_now_ns);
+        free(trama);
+    }
+}
+
+/***********************************************
+*
+* @Finalitat: Acabar la distorsió en curs d’un Fleck i programar-ne la següent.
+* @Parametres:
+*   in: f  = índex del Fleck.
+*   in: ok = 1 si s’ha completat, 0 si el Fleck l’abandona.
+* @Retorn: ---
+*
+************************************************/
+static void finish_job(int f, int ok) {
+    SimFleck* fleck = &flecks[f];
+    report_status(fleck, ok ? JOB_STATUS_DONE : JOB_STATUS_FAILED, -1);
+    if (ok) {
+        results.completed++;
+        results.bytes += fleck->size;
+        histogram_record_us(&results.latency, (long)((sim_now_ns - fleck->submit_ns) / 1000));
+    } else {
+        results.failed++;
+    }
+
+    if (fleck->crash >= 0) {
+        SimCrash* crash = &opt.crashes[fleck->crash];
+        crash->unfinished--;
+        crash->failed += !ok;
+        crash->recovered_ns = sim_now_ns;
+    }
+    fleck->busy = 0;
+    fleck->worker = -1;
+    fleck->crash = -1;
+    fleck->generation++;
+    schedule(sim_now_ns + ms_to_ns(rng_exponential(opt.think_ms)), EV_SUBMIT, f, 0, 0);
+}
+
+/***********************************************
+*
+* @Finalitat: Enviar la petició DISTORT d’un Fleck a Gotham (GOTHAM_route_distort) i actuar segons la
+*             resposta, com ho fa request_distort_gotham: connectar amb el Worker assignat, o esperar
+*             el temps indicat (amb jitter) i tornar-ho a provar, o abandonar la distorsió.
+* @Parametres:
+*   in: f = índex del Fleck.
+* @Retorn: ---
+*
+************************************************/
+static void request_distort(int f) {
+    SimFleck* fleck = &flecks[f];
+    DistortRequest request = { .owner = f + 1, .username = fleck->username, .source_ip = fleck->ip,
+                               .media_type = TEXT, .file_name = fleck->filename, .file_size = fleck->size,
+                               .job_id = fleck->job_id, .priority = 0 };
+    DistortRoute route;
+
+    uint64_t start = wall_now_ns();
+    GOTHAM_route_distort(gotham, &request, &route);
+    results.route_wall_ns += wall_now_ns() - start;
+    results.route_calls++;
+
+    if (route.status == GOTHAM_ROUTE_ASSIGNED) {
+        char ip[BUFFER_SIZE];
+        snprintf(ip, sizeof(ip), "%s", route.reply);
+        *strchrnul(ip, '&') = '\0';
+        fleck->job_id = route.job_id;
+        fleck->worker = worker_from_ip(ip);
+        fleck->gotham_retries = 0;
+        if (fleck->crash >= 0 && fleck->worker >= 0) {
+            SimCrash* crash = &opt.crashes[fleck->crash];
+            crash->pending--;
+            crash->rerouted_ns = sim_now_ns;
+            results.reassigned++;
+        }
+        schedule(sim_now_ns + ms_to_ns(opt.net_ms), EV_ARRIVE, fleck->worker, f, fleck->generation);
+        return;
+    }
+
+    if (route.status == GOTHAM_ROUTE_MEDIA_KO || route.status == GOTHAM_ROUTE_NO_WORKERS
+        || fleck->gotham_retries == FLECK_BUSY_RETRIES) {
+        if (fleck->crash >= 0) {
+            opt.crashes[fleck->crash].pending--;
+        }
+        finish_job(f, 0);
+        return;
+    }
+
+    // DISTORT_BUSY o DISTORT_LIMIT: esperar lo indicado más un jitter que crece con cada intento
+    results.gotham_busy++;
+    long retry_ms = route.retry_ms;
+    retry_ms += (long)(rng_uniform() * (retry_ms * (fleck->gotham_retries + 1) / 2 + 1));
+    fleck->gotham_retries++;
+    schedule(sim_now_ns + ms_to_ns(retry_ms), EV_DISTORT, f, 0, fleck->generation);
+}
+
+/***********************************************
+*
+* @Finalitat: Començar a atendre una connexió en un fil lliure d’un Worker: el Fleck envia el fitxer,
+*             el Worker el distorsiona i el retorna (el fil queda ocupat fins al final).
+* @Parametres:
+*   in: w = índex del Worker.
+*   in: f = índex del Fleck.
+* @Retorn: ---
+*
+************************************************/
+static void start_job(int w, int f) {
+    SimWorker* worker = &workers[w];
+    SimFleck* fleck = &flecks[f];
+    worker->active++;
+    fleck->service_ns = sim_now_ns;
+    histogram_record_us(&results.queue_delay, (long)((sim_now_ns - fleck->submit_ns) / 1000));
+    report_status(fleck, JOB_STATUS_UPLOADING, -1);
+
+    double transfer_ms = fleck->size / (opt.bandwidth_mbs * 1024.0 * 1024.0) * 1000.0;
+    schedule(sim_now_ns + ms_to_ns(transfer_ms), EV_DISTORTING, w, f, fleck->generation);
+}
+
+/***********************************************
+*
+* @Finalitat: Alliberar el fil d’un Worker i començar la següent connexió en cua.
+* @Parametres:
+*   in: w = índex del Worker.
+* @Retorn: ---
+*
+************************************************/
+static void release_slot(int w) {
+    SimWorker* worker = &workers[w];
+    worker->active--;
+    if (worker->queued > 0) {
+        int f = worker->queue[worker->queue_head];
+        worker->queue_head = (worker->queue_head + 1) % opt.queue;
+        worker->queued--;
+        start_job(w, f);
+    }
+}
+
+/***********************************************
+*
+* @Finalitat: Treure un Worker caigut de Gotham (remove_worker) i fer que els Flecks amb distorsions
+*             en curs hi demanin un altre Worker després de SIM_FLECK_RECONNECT_MS.
+* @Parametres:
+*   in: w     = índex del Worker.
+*   in: crash = fallo que l’ha fet caure (-1 si no és un fallo programat).
+* @Retorn: ---
+*
+************************************************/
+static void drop_worker(int w, int crash_index) {
+    SimWorker* worker = &workers[w];
+    worker->state = SIM_WORKER_DEAD;
+    remove_worker(gotham, worker->conn);    // Cierra el extremo de Gotham
+    transport_close(worker->peer);
+
+    // Descartar las tramas TYPE_PRINCIPAL_WORKER enviadas a los Workers promocionados
+    unsigned char trama[BUFFER_SIZE];
+    for (int i = 0; i < opt.workers; i++) {
+        if (workers[i].state == SIM_WORKER_UP || workers[i].state == SIM_WORKER_HUNG) {
+            while (transport_poll(workers[i].peer, 0) > 0 && transport_recv_frame(workers[i].peer, trama) > 0);
+        }
+    }
+
+    SimCrash* crash = (crash_index >= 0) ? &opt.crashes[crash_index] : NULL;
+    if (crash != NULL) {
+        crash->removed_ns = sim_now_ns;
+    }
+    for (int f = 0; f < opt.flecks; f++) {
+        SimFleck* fleck = &flecks[f];
+        if (!fleck->busy || fleck->worker != w) {
+            continue;
+        }
+        fleck->worker = -1;
+        fleck->generation++;
+        fleck->gotham_retries = 0;
+        if (crash != NULL && fleck->crash < 0) {
+            fleck->crash = crash_index;
+            crash->affected++;
+            crash->pending++;
+            crash->unfinished++;
+        }
+        schedule(sim_now_ns + ms_to_ns(SIM_FLECK_RECONNECT_MS), EV_DISTORT, f, 0, fleck->generation);
+    }
+    worker->queued = 0;
+    worker->active = 0;
+}
+
+/***********************************************
+*
+* @Finalitat: Processar un esdeveniment d’un Worker.
+* @Parametres:
+*   in: ev = esdeveniment.
+* @Retorn: ---
+*
+************************************************/
+static void handle_worker_event(SimEvent* ev) {
+    int w = ev->target;
+    SimWorker* worker = &workers[w];
+
+    if (ev->type == EV_REGISTER) {
+        int conns[2];
+        if (transport_mem_pair(conns) < 0) {
+            perror("Error al crear la conexión del Worker");
+            return;
+        }
+        char data[64];
+        snprintf(data, sizeof(data), "%s&%s&%d", TEXT, worker->ip, 8000);
+        unsigned char* trama = crear_trama(TYPE_CONNECT_WORKER_GOTHAM, (unsigned char*)data, strlen(data));
+        TramaResult* result = leer_trama(trama);
+        free(trama);
+        unsigned char* reply = GOTHAM_register_worker(gotham, result, conns[0]);
+        free_tramaResult(result);
+        if (reply == NULL) {
+            // max_workers alcanzado: no se vuelve a intentar
+            transport_close(conns[0]);
+            transport_close(conns[1]);
+            return;
+        }
+        free(reply);
+        worker->conn = conns[0];
+        worker->peer = conns[1];
+        worker->state = SIM_WORKER_UP;
+        GOTHAM_watch_init(gotham, &worker->watch, sim_now_ns);
+        schedule(sim_now_ns, EV_WATCH, w, 0, 0);
+        return;
+    }
+
+    if (ev->type == EV_WATCH || ev->type == EV_HB_REPLY) {
+        if (worker->state == SIM_WORKER_DEAD) {
+            return;
+        }
+        if (ev->type == EV_HB_REPLY && worker->state == SIM_WORKER_UP) {
+            char data[128];
+            snprintf(data, sizeof(data), "%d&%d&%d&%.2f&%ld&%.1f", worker->queued, worker->active, opt.queue,
+                     0.0, 100000L, worker->service_ms);
+            unsigned char* trama = crear_trama(TYPE_HEARTBEAT, (unsigned char*)data, strlen(data));
+            GOTHAM_watch_frame(gotham, &worker->watch, worker->conn, trama, sim_now_ns);
+            free(trama);
+        }
+        if (ev->type == EV_WATCH) {
+            if (GOTHAM_watch_heartbeat_due(gotham, &worker->watch, sim_now_ns) && worker->state == SIM_WORKER_UP) {
+                schedule(sim_now_ns + ms_to_ns(2 * opt.net_ms), EV_HB_REPLY, w, 0, 0);
+            }
+            schedule(sim_now_ns + ms_to_ns(GOTHAM_PHI_CHECK_MS), EV_WATCH, w, 0, 0);
+        }
+        if (GOTHAM_watch_check(gotham, &worker->watch, worker->conn, sim_now_ns)) {
+            int crash_index = -1;
+            for (int c = 0; c < opt.num_crashes; c++) {
+                if (opt.crashes[c].worker == w) {
+                    crash_index = c;
+                }
+            }
+            drop_worker(w, crash_index);
+        }
+        return;
+    }
+
+    // Conexiones de Fleck: se descartan las de intentos anteriores y un Worker congelado no avanza
+    int f = ev->arg;
+    SimFleck* fleck = &flecks[f];
+    if (ev->generation != fleck->generation || worker->state != SIM_WORKER_UP) {
+        return;
+    }
+
+    if (ev->type == EV_ARRIVE) {
+        if (worker->active < opt.slots) {
+            start_job(w, f);
+        } else if (worker->queued < opt.queue) {
+            worker->queue[(worker->queue_head + worker->queued) % opt.queue] = f;
+            worker->queued++;
+        } else {
+            // BUSY: Fleck vuelve a pedir Worker a Gotham tras FLECK_BUSY_BACKOFF_MS * intento
+            results.worker_busy++;
+            fleck->worker_retries++;
+            if (fleck->worker_retries > FLECK_BUSY_RETRIES) {
+                finish_job(f, 0);
+                return;
+            }
+            fleck->gotham_retries = 0;
+            schedule(sim_now_ns + ms_to_ns(FLECK_BUSY_BACKOFF_MS * fleck->worker_retries), EV_DISTORT, f, 0, fleck->generation);
+        }
+    } else if (ev->type == EV_DISTORTING) {
+        report_status(fleck, JOB_STATUS_DISTORTING, w);
+        double service_ms = opt.service_base_ms + opt.service_ms_per_kb * fleck->size / 1024.0;
+        schedule(sim_now_ns + ms_to_ns(service_ms), EV_DOWNLOADING, w, f, fleck->generation);
+    } else if (ev->type == EV_DOWNLOADING) {
+        report_status(fleck, JOB_STATUS_DOWNLOADING, w);
+        double transfer_ms = fleck->size / (opt.bandwidth_mbs * 1024.0 * 1024.0) * 1000.0;
+        schedule(sim_now_ns + ms_to_ns(transfer_ms + opt.net_ms), EV_DONE, w, f, fleck->generation);
+    } else if (ev->type == EV_DONE) {
+        double service_ms = (sim_now_ns - fleck->service_ns) / 1e6;
+        worker->service_ms = worker->jobs ? 0.8 * worker->service_ms + 0.2 * service_ms : service_ms;
+        worker->jobs++;
+        finish_job(f, 1);
+        release_slot(w);
+    }
+}
+
+/***********************************************
+*
+* @Finalitat: Provocar un fallo programat: kill tanca la connexió (Gotham ho veu de seguida) i hang
+*             congela el Worker fins que el detector de fallos de Gotham el dona per caigut.
+* @Parametres:
+*   in: c = índex del fallo.
+* @Retorn: ---
+*
+************************************************/
+static void handle_crash(int c) {
+    SimCrash* crash = &opt.crashes[c];
+    int w = crash->target;
+    if (w < 0) {
+        // Worker principal de Text en este momento
+        int class_index = GOTHAM_add_worker_class(gotham, TEXT);
+        int index = (class_index >= 0) ? gotham->worker_classes[class_index].pworker_index : -1;
+        w = (index >= 0) ? worker_from_ip(gotham->workers[index].IP) : -1;
+    }
+    if (w < 0 || w >= opt.workers || workers[w].state != SIM_WORKER_UP) {
+        return;
+    }
+
+    crash->worker = w;
+    crash->crash_ns = sim_now_ns;
+    if (crash->hang) {
+        workers[w].state = SIM_WORKER_HUNG;
+    } else {
+        drop_worker(w, c);
+    }
+}
+
+/***********************************************
+*
+* @Finalitat: Processar un esdeveniment d’un Fleck.
+* @Parametres:
+*   in: ev = esdeveniment.
+* @Retorn: ---
+*
+************************************************/
+static void handle_fleck_event(SimEvent* ev) {
+    int f = ev->target;
+    SimFleck* fleck = &flecks[f];
+
+    if (ev->type == EV_SUBMIT) {
+        fleck->busy = 1;
+        fleck->job_id = 0;
+        fleck->size = sample_size(&opt.size);
+        fleck->worker = -1;
+        fleck->gotham_retries = 0;
+        fleck->worker_retries = 0;
+        fleck->crash = -1;
+        fleck->submit_ns = sim_now_ns;
+        snprintf(fleck->filename, sizeof(fleck->filename), "f%d_%ld.txt", f, fleck->jobs++);
+        results.submitted++;
+        request_distort(f);
+    } else if (ev->type == EV_DISTORT && ev->generation == fleck->generation && fleck->busy) {
+        request_distort(f);
+    }
+}
+
+/***********************************************
+*
+* @Finalitat: Llegir una distribució de mides: fixed:K, uniform:A:B, exp:MITJANA o pareto:MÍNIM:ALFA (KB).
+* @Parametres:
+*   in:  text = opció.
+*   out: dist = distribució.
+* @Retorn: 0 en èxit, -1 si no és vàlida.
+*
+************************************************/
+static int parse_size(const char* text, SizeDistribution* dist) {
+    char name[16];
+    dist->b = 0;
+    int n = sscanf(text, "%15[a-z]:%lf:%lf", name, &dist->a, &dist->b);
+    if (n >= 2 && strcmp(name, "fixed") == 0 && dist->a > 0) {
+        dist->type = SIM_SIZE_FIXED;
+    } else if (n == 3 && strcmp(name, "uniform") == 0 && dist->a > 0 && dist->b >= dist->a) {
+        dist->type = SIM_SIZE_UNIFORM;
+    } else if (n >= 2 && strcmp(name, "exp") == 0 && dist->a > 0) {
+        dist->type = SIM_SIZE_EXP;
+    } else if (n == 3 && strcmp(name, "pareto") == 0 && dist->a > 0 && dist->b > 0) {
+        dist->type = SIM_SIZE_PARETO;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalitat: Afegir un fallo programat: <segons>[:<worker>|:principal].
+* @Parametres:
+*   in: text = opció.
+*   in: hang = 1 per congelar el Worker, 0 per matar-lo.
+* @Retorn: 0 en èxit, -1 si no és vàlida.
+*
+************************************************/
+static int parse_crash(const char* text, int hang) {
+    if (opt.num_crashes == SIM_MAX_CRASHES) {
+        return -1;
+    }
+    SimCrash* crash = &opt.crashes[opt.num_crashes];
+    memset(crash, 0, sizeof(SimCrash));
+    crash->hang = hang;
+    crash->target = -1;
+    crash->worker = -1;
+    crash->at_s = atof(text);
+    const char* target = strchr(text, ':');
+    if (target != NULL && strcmp(target + 1, "principal") != 0) {
+        crash->target = atoi(target + 1);
+    }
+    if (crash->at_s < 0 || (target != NULL && crash->target < 0 && strcmp(target + 1, "principal") != 0)) {
+        return -1;
+    }
+    opt.num_crashes++;
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalitat: Mostrar l’ús del simulador.
+* @Parametres: ---
+* @Retorn: ---
+*
+************************************************/
+static void print_usage(void) {
+    dprintf(2, "Uso: ./simulator.exe [opciones]\n"
+               "  -w, --workers N        Workers (1000)\n"
+               "  -f, --flecks N         Flecks (2000)\n"
+               "  -d, --duration S       Segundos virtuales simulados (60)\n"
+               "  -s, --seed N           Semilla (1)\n"
+               "      --think-ms MS      Espera media de cada Fleck entre distorsiones (1000, exponencial)\n"
+               "      --size DIST        Tamaño en KB: fixed:K, uniform:A:B, exp:MEDIA, pareto:MIN:ALFA (exp:64)\n"
+               "      --service MS:MSKB  Tiempo de distorsión: ms fijos y ms por KB (20:2)\n"
+               "      --slots N          Distorsiones a la vez por Worker (%d)\n"
+               "      --queue N          Conexiones en cola por Worker (%d)\n"
+               "      --net-ms MS        Latencia de red en un sentido (0.5)\n"
+               "      --bandwidth MBS    Ancho de banda Fleck-Worker en MB/s (100)\n"
+               "      --ledger N         Distorsiones recordadas por Gotham (2 * Flecks)\n"
+               "      --kill S[:W]       Matar el Worker W (o el principal) a los S segundos (repetible)\n"
+               "      --hang S[:W]       Congelar el Worker W (o el principal) a los S segundos (repetible)\n"
+               "  -g, --gotham K=V       Opción de gotham.dat (repetible; por defecto routing=affinity)\n"
+               "      --log FILE         Mensajes de Gotham (/dev/null)\n"
+               "  -o, --output FILE      Resultado JSON (stdout)\n", WORKER_POOL_THREADS, WORKER_POOL_QUEUE);
+}
+
+/***********************************************
+*
+* @Finalitat: Llegir les opcions de línia de comandes.
+* @Parametres:
+*   in: argc, argv = arguments del programa.
+* @Retorn: 0 en èxit, -1 si hi ha opcions invàlides.
+*
+************************************************/
+static int parse_options(int argc, char* argv[]) {
+    static struct option long_options[] = {
+        {"workers", required_argument, 0, 'w'},
+        {"flecks", required_argument, 0, 'f'},
+        {"duration", required_argument, 0, 'd'},
+        {"seed", required_argument, 0, 's'},
+        {"think-ms", required_argument, 0, 'T'},
+        {"size", required_argument, 0, 'z'},
+        {"service", required_argument, 0, 'S'},
+        {"slots", required_argument, 0, 'l'},
+        {"queue", required_argument, 0, 'q'},
+        {"net-ms", required_argument, 0, 'n'},
+        {"bandwidth", required_argument, 0, 'b'},
+        {"ledger", required_argument, 0, 'L'},
+        {"kill", required_argument, 0, 'K'},
+        {"hang", required_argument, 0, 'H'},
+        {"gotham", required_argument, 0, 'g'},
+        {"log", required_argument, 0, 'G'},
+        {"output", required_argument, 0, 'o'},
+        {0, 0, 0, 0}
+    };
+
+    opt = (SimOptions){ .workers = 1000, .flecks = 2000, .duration_s = 60, .seed = 1, .think_ms = 1000,
+                        .size = { SIM_SIZE_EXP, 64, 0 }, .service_base_ms = 20, .service_ms_per_kb = 2,
+                        .slots = WORKER_POOL_THREADS, .queue = WORKER_POOL_QUEUE, .net_ms = 0.5,
+                        .bandwidth_mbs = 100, .ledger = 0, .num_crashes = 0, .num_gotham_options = 0,
+                        .log = "/dev/null", .output = NULL };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "w:f:d:s:g:o:", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'w': opt.workers = atoi(optarg); break;
+            case 'f': opt.flecks = atoi(optarg); break;
+            case 'd': opt.duration_s = atof(optarg); break;
+            case 's': opt.seed = strtoul(optarg, NULL, 10); break;
+            case 'T': opt.think_ms = atof(optarg); break;
+            case 'z': if (parse_size(optarg, &opt.size) < 0) return -1; break;
+            case 'S':
+                if (sscanf(optarg, "%lf:%lf", &opt.service_base_ms, &opt.service_ms_per_kb) != 2) return -1;
+                break;
+            case 'l': opt.slots = atoi(optarg); break;
+            case 'q': opt.queue = atoi(optarg); break;
+            case 'n': opt.net_ms = atof(optarg); break;
+            case 'b': opt.bandwidth_mbs = atof(optarg); break;
+            case 'L': opt.ledger = atoi(optarg); break;
+            case 'K': if (parse_crash(optarg, 0) < 0) return -1; break;
+            case 'H': if (parse_crash(optarg, 1) < 0) return -1; break;
+            case 'g':
+                if (opt.num_gotham_options == SIM_MAX_GOTHAM_OPTIONS) return -1;
+                opt.gotham_options[opt.num_gotham_options++] = optarg;
+                break;
+            case 'G': opt.log = optarg; break;
+            case 'o': opt.output = optarg; break;
+            default: return -1;
+        }
+    }
+
+    if (opt.workers < 1 || opt.workers > TRANSPORT_MEM_MAX / 2 || opt.flecks < 1 || opt.duration_s <= 0
+        || opt.think_ms < 0 || opt.slots < 1 || opt.queue < 1 || opt.net_ms < 0 || opt.bandwidth_mbs <= 0
+        || opt.service_base_ms < 0 || opt.service_ms_per_kb < 0 || opt.ledger < 0) {
+        return -1;
+    }
+    if (opt.ledger == 0) {
+        opt.ledger = (2 * opt.flecks > JOB_LEDGER_SIZE) ? 2 * opt.flecks : JOB_LEDGER_SIZE;
+    }
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalitat: Crear l’estat de Gotham com ho fa el seu main (sense servidors, fils ni Arkham).
+* @Parametres:
+*   in: log_fd = descriptor on s’escriuen les trames de log.
+* @Retorn: 0 en èxit, -1 en cas d’error.
+*
+************************************************/
+static int create_gotham(int log_fd) {
+    gotham = aligned_alloc(_Alignof(GlobalInfoGotham), sizeof(GlobalInfoGotham));
+    GothamConfig* config = calloc(1, sizeof(GothamConfig));
+    if (gotham == NULL || config == NULL) {
+        return -1;
+    }
+    memset(gotham, 0, sizeof(GlobalInfoGotham));
+
+    GOTHAM_default_options(config);
+    config->routing = GOTHAM_ROUTING_AFFINITY;
+    config->max_workers = opt.workers;
+    for (int i = 0; i < opt.num_gotham_options; i++) {
+        if (!GOTHAM_set_option(config, opt.gotham_options[i])) {
+            return -1;
+        }
+    }
+    if (config->routing == GOTHAM_ROUTING_PULL) {
+        // La cola de routing=pull espera a los Workers con pthread_cond_timedwait en tiempo real
+        dprintf(2, "routing=pull no se puede simular.\n");
+        return -1;
+    }
+    if (config->phi_dead < config->phi_suspect) {
+        config->phi_dead = config->phi_suspect;
+    }
+    gotham->config = config;
+
+    GOTHAM_add_worker_class(gotham, TEXT);
+    GOTHAM_add_worker_class(gotham, IMAGE);
+    GOTHAM_add_worker_class(gotham, AUDIO);
+    if (job_ledger_init(&gotham->jobs, opt.ledger) < 0) {
+        return -1;
+    }
+    sched_model_init(&gotham->sched);
+    rate_limiter_init(&gotham->user_limits, config->rate_user, config->rate_user_kb);
+    rate_limiter_init(&gotham->ip_limits, config->rate_ip, config->rate_ip_kb);
+    pthread_mutex_init(&gotham->worker_mutex, NULL);
+    pthread_cond_init(&gotham->pull_cond, NULL);
+    gotham->log_fd = log_fd;
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalitat: Escriure un histograma de latències en JSON (ms).
+* @Parametres:
+*   in: fd = descriptor de sortida.
+*   in: h  = histograma en microsegons.
+* @Retorn: ---
+*
+************************************************/
+static void print_histogram_json(int fd, Histogram* h) {
+    long total = atomic_load(&h->total);
+    dprintf(fd, "{\"mean\": %.3f, \"p50\": %.3f, \"p99\": %.3f, \"p999\": %.3f, \"max\": %.3f}",
+            total ? atomic_load(&h->sum_us) / 1000.0 / total : 0.0,
+            histogram_percentile_us(h, 50) / 1000.0, histogram_percentile_us(h, 99) / 1000.0,
+            histogram_percentile_us(h, 99.9) / 1000.0, atomic_load(&h->max_us) / 1000.0);
+}
+
+/***********************************************
+*
+* @Finalitat: Escriure el resultat de la simulació en JSON.
+* @Parametres:
+*   in: fd     = descriptor de sortida.
+*   in: wall_s = temps real de la simulació.
+* @Retorn: ---
+*
+************************************************/
+static void print_results_json(int fd, double wall_s) {
+    GothamStats* st = &gotham->stats;
+    const char* routing_names[] = { "principal", "affinity", "pull" };
+
+    dprintf(fd, "{\n  \"config\": {\"workers\": %d, \"flecks\": %d, \"duration_s\": %.1f, \"seed\": %lu, "
+                "\"routing\": \"%s\", \"think_ms\": %.1f, \"slots\": %d, \"queue\": %d},\n",
+            opt.workers, opt.flecks, opt.duration_s, opt.seed, routing_names[gotham->config->routing],
+            opt.think_ms, opt.slots, opt.queue);
+    dprintf(fd, "  \"submitted\": %ld,\n  \"completed\": %ld,\n  \"failed\": %ld,\n  \"in_flight\": %ld,\n",
+            results.submitted, results.completed, results.failed, results.submitted - results.completed - results.failed);
+    dprintf(fd, "  \"jobs_per_s\": %.3f,\n  \"mb_per_s\": %.3f,\n", results.completed / opt.duration_s,
+            results.bytes / (1024.0 * 1024.0) / opt.duration_s);
+    dprintf(fd, "  \"queue_delay_ms\": ");
+    print_histogram_json(fd, &results.queue_delay);
+    dprintf(fd, ",\n  \"latency_ms\": ");
+    print_histogram_json(fd, &results.latency);
+    dprintf(fd, ",\n  \"retries\": {\"gotham_busy\": %ld, \"worker_busy\": %ld, \"reassigned\": %ld},\n",
+            results.gotham_busy, results.worker_busy, results.reassigned);
+    dprintf(fd, "  \"gotham\": {\"distort\": %ld, \"busy\": %ld, \"limited\": %ld, \"affinity_hits\": %ld, "
+                "\"affinity_spills\": %ld, \"failovers\": %ld, \"jobs_lost\": %ld, \"heartbeats_sent\": %ld, "
+                "\"heartbeats_missed\": %ld, \"workers\": %ld},\n",
+            results.route_calls, STATS_GET(st->distort_busy), STATS_GET(st->distort_limited),
+            STATS_GET(st->affinity_hits), STATS_GET(st->affinity_spills), STATS_GET(st->failovers),
+            STATS_GET(st->jobs_lost), STATS_GET(st->heartbeats_sent), STATS_GET(st->heartbeats_missed),
+            STATS_GET(st->current_workers));
+
+    // Recuperación de cada fallo: detección (Gotham lo saca de su lista), reasignación de la última
+    // distorsión afectada y final de la última distorsión afectada (-1 si no ha ocurrido)
+    dprintf(fd, "  \"crashes\": [");
+    for (int c = 0; c < opt.num_crashes; c++) {
+        SimCrash* crash = &opt.crashes[c];
+        double detect_ms = crash->removed_ns ? (crash->removed_ns - crash->crash_ns) / 1e6 : -1;
+        double reroute_ms = (crash->removed_ns && crash->pending == 0)
+            ? ((crash->rerouted_ns > crash->crash_ns ? crash->rerouted_ns : crash->removed_ns) - crash->crash_ns) / 1e6 : -1;
+        double recover_ms = (crash->removed_ns && crash->unfinished == 0)
+            ? ((crash->recovered_ns > crash->crash_ns ? crash->recovered_ns : crash->removed_ns) - crash->crash_ns) / 1e6 : -1;
+        dprintf(fd, "%s\n    {\"at_s\": %.3f, \"mode\": \"%s\", \"worker\": %d, \"detect_ms\": %.1f, "
+                    "\"affected\": %d, \"failed\": %d, \"reroute_ms\": %.1f, \"recover_ms\": %.1f}",
+                c ? "," : "", crash->at_s, crash->hang ? "hang" : "kill", crash->worker, detect_ms,
+                crash->affected, crash->failed, reroute_ms, recover_ms);
+    }
+    dprintf(fd, "%s],\n", opt.num_crashes ? "\n  " : "");
+
+    // Coste real de la simulación (lo único que cambia entre ejecuciones con la misma semilla)
+    dprintf(fd, "  \"runtime\": {\"wall_s\": %.3f, \"events\": %ld, \"route_us\": %.3f}\n}\n",
+            wall_s, results.events, results.route_calls ? results.route_wall_ns / 1000.0 / results.route_calls : 0.0);
+}
+
+
+int main(int argc, char* argv[]) {
+    if (parse_options(argc, argv) < 0) {
+        print_usage();
+        return 1;
+    }
+
+    int json_fd = (opt.output != NULL) ? open(opt.output, O_WRONLY | O_CREAT | O_TRUNC, 0644) : dup(STDOUT_FILENO);
+    int log_fd = open(opt.log, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (json_fd < 0 || log_fd < 0) {
+        perror("Error al abrir la salida");
+        return 1;
+    }
+    // Los mensajes de Gotham (printF) van a la salida estándar: se redirigen al log
+    dup2(log_fd, STDOUT_FILENO);
+
+    timings_set_clock(sim_clock);
+    rng_state = opt.seed;
+    if (create_gotham(log_fd) < 0) {
+        dprintf(2, "Error al crear el estado de Gotham.\n");
+        return 1;
+    }
+
+    workers = calloc(opt.workers, sizeof(SimWorker));
+    flecks = calloc(opt.flecks, sizeof(SimFleck));
+    if (workers == NULL || flecks == NULL) {
+        perror("Error al asignar memoria para la simulación");
+        return 1;
+    }
+    for (int w = 0; w < opt.workers; w++) {
+        snprintf(workers[w].ip, sizeof(workers[w].ip), "10.%d.%d.%d", (w >> 16) & 0xff, (w >> 8) & 0xff, w & 0xff);
+        workers[w].queue = malloc(opt.queue * sizeof(int));
+        if (workers[w].queue == NULL) {
+            perror("Error al asignar memoria para la simulación");
+            return 1;
+        }
+        schedule(SIM_START_NS + ms_to_ns(rng_uniform() * SIM_REGISTER_SPREAD_MS), EV_REGISTER, w, 0, 0);
+    }
+    for (int f = 0; f < opt.flecks; f++) {
+        snprintf(flecks[f].username, sizeof(flecks[f].username), "user%d", f);
+        snprintf(flecks[f].ip, sizeof(flecks[f].ip), "172.16.%d.%d", (f >> 8) & 0xff, f & 0xff);
+        flecks[f].worker = -1;
+        flecks[f].crash = -1;
+        uint64_t start = SIM_START_NS + ms_to_ns(SIM_REGISTER_SPREAD_MS + rng_exponential(opt.think_ms));
+        schedule(start, EV_SUBMIT, f, 0, 0);
+    }
+    for (int c = 0; c < opt.num_crashes; c++) {
+        schedule(SIM_START_NS + ms_to_ns(opt.crashes[c].at_s * 1000), EV_CRASH, c, 0, 0);
+    }
+
+    // Bucle de eventos hasta el final del tiempo simulado
+    uint64_t end_ns = SIM_START_NS + ms_to_ns(opt.duration_s * 1000);
+    uint64_t wall_start = wall_now_ns();
+    SimEvent ev;
+    while (next_event(&ev) && ev.time_ns <= end_ns) {
+        sim_now_ns = ev.time_ns;
+        results.events++;
+        if (ev.type == EV_SUBMIT || ev.type == EV_DISTORT) {
+            handle_fleck_event(&ev);
+        } else if (ev.type == EV_CRASH) {
+            handle_crash(ev.target);
+        } else {
+            handle_worker_event(&ev);
+        }
+    }
+    sim_now_ns = end_ns;
+
+    print_results_json(json_fd, (wall_now_ns() - wall_start) / 1e9);
+    close(json_fd);
+    close(log_fd);
+
+    for (int w = 0; w < opt.workers; w++) {
+        free(workers[w].queue);
+    }
+    free(workers);
+    free(flecks);
+    free(heap);
+    return 0;
+}
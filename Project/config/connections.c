@@ -3,17 +3,228 @@
 #include <stdio.h>
 #include <time.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <errno.h>
 #include <pthread.h>
 #include <stdint.h>
 
 #include "connections.h"
+#include "transport.h"
 
 
 /***********************************************
 *
-* @Finalitat: Crear i configurar un servidor TCP en l’adreça i port indicats, preparant-lo per acceptar connexions.
+* @Finalitat: Indicar si una adreça de la configuració és un socket Unix ("unix:/ruta").
 * @Parametres:
-*   in:  ip_addr         = cadena amb l’adreça IP on escoltar.
+*   in: ip_addr = adreça llegida de la configuració.
+* @Retorn: 1 si és un socket Unix, 0 si no.
+*
+************************************************/
+int is_unix_address(const char* ip_addr) {
+    return ip_addr != NULL && strncmp(ip_addr, UNIX_ADDR_PREFIX, strlen(UNIX_ADDR_PREFIX)) == 0;
+}
+
+/***********************************************
+*
+* @Finalitat: Omplir l’adreça de socket d’una adreça de la configuració: "unix:/ruta" o IPv4 i port.
+* @Parametres:
+*   in:  ip_addr = adreça IP o "unix:/ruta".
+*   in:  port    = port (com el guarda la configuració; no s’usa amb sockets Unix).
+*   out: address = adreça de socket.
+* @Retorn: Mida de l’adreça, o 0 si no és vàlida (errno = EINVAL).
+*
+************************************************/
+static socklen_t fill_address(const char* ip_addr, int port, struct sockaddr_storage* address) {
+    memset(address, 0, sizeof(*address));
+
+    if (is_unix_address(ip_addr)) {
+        struct sockaddr_un* unix_addr = (struct sockaddr_un*)address;
+        const char* path = ip_addr + strlen(UNIX_ADDR_PREFIX);
+        size_t len = strlen(path);
+        while (len > 0 && isspace((unsigned char)path[len - 1])) {
+            len--;      // Configuraciones con saltos de línea \r\n
+        }
+        if (len == 0 || len >= sizeof(unix_addr->sun_path)) {
+            errno = EINVAL;
+            return 0;
+        }
+        unix_addr->sun_family = AF_UNIX;
+        memcpy(unix_addr->sun_path, path, len);
+        return sizeof(struct sockaddr_un);
+    }
+
+    struct sockaddr_in* inet_addr_in = (struct sockaddr_in*)address;
+    inet_addr_in->sin_family = AF_INET;      // IPv4
+    inet_addr_in->sin_port = port;           // Puerto tal y como lo guarda la configuración
+    if (ip_addr == NULL || inet_aton(ip_addr, &inet_addr_in->sin_addr) == 0) {
+        errno = EINVAL;
+        return 0;
+    }
+    return sizeof(struct sockaddr_in);
+}
+
+/***********************************************
+*
+* @Finalitat: Connectar amb un servidor a una adreça de la configuració: un socket Unix
+*             ("unix:/ruta") si els dos processos són al mateix host, o TCP sobre IPv4.
+* @Parametres:
+*   in: ip_addr = adreça IP o "unix:/ruta".
+*   in: port    = port del servidor (no s’usa amb sockets Unix).
+* @Retorn: Descriptor del socket connectat, o -1 en error (amb errno del pas que ha fallat).
+*
+************************************************/
+int connect_to_server(const char* ip_addr, int port) {
+    struct sockaddr_storage address;
+    socklen_t address_len = fill_address(ip_addr, port, &address);
+    if (address_len == 0) {
+        return -1;
+    }
+
+    int sock_fd = socket(address.ss_family, SOCK_STREAM, 0);
+    if (sock_fd < 0) {
+        return -1;
+    }
+    if (connect(sock_fd, (struct sockaddr*)&address, address_len) < 0) {
+        int saved_errno = errno;
+        close(sock_fd);
+        errno = saved_errno;
+        return -1;
+    }
+    return sock_fd;
+}
+
+/***********************************************
+*
+* @Finalitat: Indicar si un socket connectat és un socket Unix (l’altre extrem és al mateix host).
+* @Parametres:
+*   in: socket_fd = socket connectat.
+* @Retorn: 1 si és AF_UNIX, 0 si no.
+*
+************************************************/
+int is_unix_socket(int socket_fd) {
+    struct sockaddr_storage address;
+    socklen_t address_len = sizeof(address);
+    if (getsockname(socket_fd, (struct sockaddr*)&address, &address_len) < 0) {
+        return 0;
+    }
+    return address.ss_family == AF_UNIX;
+}
+
+/***********************************************
+*
+* @Finalitat: Enviar una trama acompanyada d’un descriptor de fitxer (SCM_RIGHTS). Només funciona
+*             amb sockets Unix: l’altre procés rep un descriptor obert al mateix fitxer.
+* @Parametres:
+*   in: socket_fd = socket Unix connectat.
+*   in: trama     = trama de BUFFER_SIZE bytes.
+*   in: fd        = descriptor a passar.
+* @Retorn: Bytes enviats, o -1 en error.
+*
+************************************************/
+int send_trama_fd(int socket_fd, unsigned char* trama, int fd) {
+    struct iovec iov = { .iov_base = trama, .iov_len = BUFFER_SIZE };
+    union {
+        char buffer[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    struct msghdr msg = { 0 };
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buffer;
+    msg.msg_controllen = sizeof(control.buffer);
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+    return sendmsg(socket_fd, &msg, MSG_NOSIGNAL);
+}
+
+/***********************************************
+*
+* @Finalitat: Rebre una trama i, si n’hi ha, el descriptor de fitxer que l’acompanya (SCM_RIGHTS).
+*             Amb sockets TCP equival a recv() amb MSG_WAITALL. Si arriben diversos descriptors només
+*             es queda el primer; si el control arriba truncat (MSG_CTRUNC) es rebutja la trama.
+* @Parametres:
+*   in:  socket_fd = socket connectat.
+*   out: trama     = buffer de BUFFER_SIZE bytes.
+*   out: fd        = descriptor rebut (-1 si la trama no en porta). Qui crida l’ha de tancar.
+* @Retorn: Bytes rebuts (menys de BUFFER_SIZE si l’altre extrem tanca a mitja trama, 0 si ha tancat),
+*          o -1 en error.
+*
+************************************************/
+int recv_trama_fd(int socket_fd, unsigned char* trama, int* fd) {
+    struct iovec iov = { .iov_base = trama, .iov_len = BUFFER_SIZE };
+    union {
+        char buffer[CMSG_SPACE(FD_PASSING_MAX_FDS * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+
+    struct msghdr msg = { 0 };
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buffer;
+    msg.msg_controllen = sizeof(control.buffer);
+
+    *fd = -1;
+    int bytes = recvmsg(socket_fd, &msg, MSG_CMSG_CLOEXEC);
+    if (bytes <= 0) {
+        return bytes;
+    }
+    // Quedarse con el primer descriptor y cerrar los que sobren (si no, quedarían abiertos)
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+            continue;
+        }
+        int count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (int i = 0; i < count; i++) {
+            int received;
+            memcpy(&received, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+            if (*fd < 0) {
+                *fd = received;
+            } else {
+                close(received);
+            }
+        }
+    }
+    // Con el control truncado el kernel ha descartado descriptores: la trama no es fiable
+    if (msg.msg_flags & MSG_CTRUNC) {
+        if (*fd >= 0) {
+            close(*fd);
+            *fd = -1;
+        }
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    // Completar la trama si ha llegado a trozos (el descriptor viaja con el primero)
+    while (bytes < BUFFER_SIZE) {
+        int rest = recv(socket_fd, trama + bytes, BUFFER_SIZE - bytes, MSG_WAITALL);
+        if (rest < 0 && errno == EINTR) {
+            continue;
+        }
+        if (rest <= 0) {
+            if (*fd >= 0) {
+                close(*fd);
+                *fd = -1;
+            }
+            return (rest < 0) ? -1 : bytes;
+        }
+        bytes += rest;
+    }
+    return bytes;
+}
+
+/***********************************************
+*
+* @Finalitat: Crear i configurar un servidor TCP en l’adreça i port indicats (o un socket Unix si
+*             l’adreça és "unix:/ruta"), preparant-lo per acceptar connexions.
+* @Parametres:
+*   in:  ip_addr         = cadena amb l’adreça IP on escoltar, o "unix:/ruta".
 *   in:  port            = port en format host.
 *   in:  max_connections = nombre màxim de connexions en cua.
 * @Retorn: Punter a una estructura Server inicialitzada, o interromp l’execució en cas d’error greu.
@@ -26,8 +237,19 @@ Server* create_server(char* ip_addr, int port, int max_connections) {
         exit(EXIT_FAILURE);
     }
 
-    // Crear el socket (IPv4 y TCP)
-    if ((server->server_fd = socket(AF_INET, SOCK_STREAM, 0)) == 0) {
+    // Configurar la dirección del servidor (IPv4 o socket Unix)
+    server->address_len = fill_address(ip_addr, port, &server->address);
+    if (server->address_len == 0) {
+        perror("Dirección del servidor no válida");
+        free(server);
+        exit(EXIT_FAILURE);
+    }
+    server->port = port;
+    server->max_connections = max_connections;
+    server->unix_path[0] = '\0';
+
+    // Crear el socket (IPv4 o Unix, de tipo stream)
+    if ((server->server_fd = socket(server->address.ss_family, SOCK_STREAM, 0)) < 0) {
         perror("Error al crear el socket");
         exit(EXIT_FAILURE);
     }
@@ -41,16 +263,17 @@ Server* create_server(char* ip_addr, int port, int max_connections) {
         exit(EXIT_FAILURE);
     }
 
-    // Configurar la dirección del servidor
-    memset(&server->address, 0, sizeof(server->address));
-    server->address.sin_family = AF_INET;        // IPv4
-    server->address.sin_addr.s_addr = inet_addr(ip_addr); // Aceptar conexiones en cualquier interfaz
-    server->address.sin_port = port;     // Puerto en formato de red
-    server->port = port;
-    server->max_connections = max_connections;
+    // Socket Unix: borrar el de una ejecución anterior que no se cerró (sólo si es un socket)
+    if (server->address.ss_family == AF_UNIX) {
+        snprintf(server->unix_path, sizeof(server->unix_path), "%s", ((struct sockaddr_un*)&server->address)->sun_path);
+        struct stat st;
+        if (stat(server->unix_path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+            unlink(server->unix_path);
+        }
+    }
 
     // Enlazar el file descriptor del socket a la dirección y puerto
-    if (bind(server->server_fd, (struct sockaddr *)&server->address, sizeof(server->address)) < 0) {
+    if (bind(server->server_fd, (struct sockaddr *)&server->address, server->address_len) < 0) {
         perror("Error al enlazar el socket servidor");
         close(server->server_fd);
         exit(EXIT_FAILURE);
@@ -82,7 +305,11 @@ void start_server(Server *server) {
         exit(EXIT_FAILURE);
     }
 
-    asprintf(&buffer, "Servidor escuchando en el puerto %d..\n", server->port);
+    if (server->unix_path[0] != '\0') {
+        asprintf(&buffer, "Servidor escuchando en %s%s..\n", UNIX_ADDR_PREFIX, server->unix_path);
+    } else {
+        asprintf(&buffer, "Servidor escuchando en el puerto %d..\n", server->port);
+    }
     printF(buffer);
     free(buffer);
 }
@@ -101,6 +328,9 @@ void close_server(Server *server) {
     if (server->server_fd >= 0) {
         close(server->server_fd);
     }
+    if (server->unix_path[0] != '\0') {
+        unlink(server->unix_path);
+    }
     printF("Servidor cerrado.\n");
 }
 
@@ -113,13 +343,15 @@ void close_server(Server *server) {
 *
 ************************************************/
 int accept_connection(Server *server) {
-    socklen_t addrlen = sizeof(server->address);
     if (server == NULL) {
         perror( "Error: servidor no inicializado.\n");
         return -1;
     }
 
-    int new_socket = accept(server->server_fd, (struct sockaddr *)&server->address, &addrlen);
+    // Dirección del cliente (no se usa, pero no debe sobrescribir la del servidor)
+    struct sockaddr_storage client_address;
+    socklen_t addrlen = sizeof(client_address);
+    int new_socket = accept(server->server_fd, (struct sockaddr *)&client_address, &addrlen);
     if (new_socket < 0) {
         perror("Error al aceptar la conexión");
         return -1;
@@ -128,6 +360,26 @@ int accept_connection(Server *server) {
     return new_socket;
 }
 
+/***********************************************
+*
+* @Finalitat: Calcular el checksum de 16 bits d’una trama: suma dels bytes 0-249 i 252-255
+*             (tots excepte els 2 bytes on es guarda el propi checksum).
+* @Parametres:
+*   in: trama = buffer de mida BUFFER_SIZE.
+* @Retorn: Checksum de 16 bits.
+*
+************************************************/
+unsigned short calcular_checksum(const unsigned char* trama) {
+    unsigned short checksum = 0; // 2 bytes (16 bits): el desbordamiento equivale al módulo 65536
+    for (int i = 0; i < 250; i++) {
+        checksum += trama[i];
+    }
+    for (int i = 252; i < 256; i++) {
+        checksum += trama[i];
+    }
+    return checksum;
+}
+
 // POST: se debe hacer free() de la trama devuelta
 /***********************************************
 *
@@ -169,15 +421,8 @@ unsigned char* crear_trama(int TYPE, unsigned char* data, size_t data_length) {
     trama[254] = (timestamp >> 8) & 0xFF;
     trama[255] = timestamp & 0xFF;         // Byte menos significativo
     
-    // Cálculo del checksum (suma de los bytes de trama[0] hasta trama[249])
-    unsigned short checksum = 0; // Usamos 2 bytes (16 bits) para el checksum
-    for (int i = 0; i < 250; i++) {
-        checksum += trama[i]; // Sumamos cada byte
-    }
-    for (int i = 252; i < 256; i++) {
-        checksum += trama[i]; // Sumamos cada byte
-    }
-    checksum %= 65536;  // Por si el resultado supera 16 bits
+    // Cálculo del checksum (todos los bytes excepto los 2 del propio checksum)
+    unsigned short checksum = calcular_checksum(trama);
     trama[250] = (checksum >> 8) & 0xFF; // Parte alta del checksum
     trama[251] = checksum & 0xFF;        // Parte baja del checksum
 
@@ -197,13 +442,7 @@ TramaResult* leer_trama(unsigned char *trama) {
     if (trama == NULL) return NULL;
     
     // Comprobar CHECKSUM
-    unsigned short checksum_calculado = 0;
-    for (int i = 0; i < 250; i++) {
-        checksum_calculado += trama[i]; // Sumar cada byte
-    }
-    for (int i = 252; i < 256; i++) {
-        checksum_calculado += trama[i]; // Sumar cada byte
-    }
+    unsigned short checksum_calculado = calcular_checksum(trama);
     unsigned short checksum_enviado = (trama[250] << 8) | trama[251]; // Reconstruir el checksum 
 
     /* Para DEBUGGING: Comparar checksums */
@@ -299,15 +538,15 @@ void enviar_heartbeat_constantemente(int socket_fd) {
     while (1) {
         // Enviar el mensaje de heartbeat
         tramaEnviar = crear_trama(TYPE_HEARTBEAT, (unsigned char*)"HEARTBEAT", strlen("HEARTBEAT"));
-        if (write(socket_fd, tramaEnviar, BUFFER_SIZE) < 0) {
+        if (transport_send_frame(socket_fd, tramaEnviar) < 0) {
             perror("Error enviando heartbeat");
-            close(socket_fd);
+            transport_close(socket_fd);
             return;
         }
         free(tramaEnviar);
 
         // Esperar la respuesta del cliente
-        int bytes_read = recv(socket_fd, buffer, BUFFER_SIZE, 0);
+        int bytes_read = transport_recv_frame(socket_fd, buffer);
         if (bytes_read <= 0) {
             if (bytes_read == 0) {
                 printF("El cliente ha cerrado la conexión..\n");
@@ -355,7 +594,7 @@ void* responder_heartbeat_constantemente(void *arg) {
 
     while (1) {
         // Leer el mensaje del servidor
-        int bytes_read = recv(socket_fd, buffer, BUFFER_SIZE, 0);
+        int bytes_read = transport_recv_frame(socket_fd, buffer);
 
         if (bytes_read <= 0) {
             if (bytes_read == 0) {
@@ -365,7 +604,7 @@ void* responder_heartbeat_constantemente(void *arg) {
                 // Error en recv
                 perror("Error leyendo mensaje del servidor");
             }
-            close(socket_fd);
+            transport_close(socket_fd);
             pthread_exit(NULL);  // Terminar el thread si ocurre un error
         }
 
@@ -376,9 +615,9 @@ void* responder_heartbeat_constantemente(void *arg) {
             //Si la trama es un mensaje HEARTBEAT responder con OK
             // Responder al servidor
             tramaEnviar = crear_trama(TYPE_HEARTBEAT, (unsigned char*)"", strlen(""));
-            if (write(socket_fd, tramaEnviar, BUFFER_SIZE) < 0) {
+            if (transport_send_frame(socket_fd, tramaEnviar) < 0) {
                 perror("Error enviando respuesta al servidor");
-                close(socket_fd);
+                transport_close(socket_fd);
                 pthread_exit(NULL);  // Terminar el hilo si ocurre un error
             }
         }
@@ -8,7 +8,10 @@
 #include <ctype.h>
 #include <dirent.h>
 #include <signal.h>
+#include <errno.h>
 #include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 #include "config.h"
 
@@ -18,7 +21,19 @@
 #define OK_MSG "OK"
 #define CHECK_OK "CHECK_OK"
 #define CHECK_KO "CHECK_KO"
+#define BUSY_MSG "BUSY"             // Respuesta de un Worker saturado a la trama inicial de distorsión
+#define DISTORT_LIMIT_MSG "DISTORT_LIMIT"   // Respuesta de Gotham a un DISTORT por encima del límite (&<ms>)
+#define PULL_MODE "PULL"            // Datos de TYPE_PRINCIPAL_WORKER al registrarse si Gotham usa routing=pull
+// Fases de las tramas TYPE_JOB_STATUS
+#define JOB_STATUS_UPLOADING "uploading"        // Fleck empieza a enviar el archivo
+#define JOB_STATUS_DISTORTING "distorting"      // El Worker ha recibido el archivo y lo distorsiona
+#define JOB_STATUS_DOWNLOADING "downloading"    // El Worker empieza a devolver el archivo distorsionado
+#define JOB_STATUS_DONE "done"                  // Fleck ha verificado el archivo distorsionado
+#define JOB_STATUS_FAILED "failed"              // Fleck ha abandonado la distorsión
 #define BUFFER_SIZE 256
+#define UNIX_ADDR_PREFIX "unix:"    // Dirección de la configuración que indica un socket Unix: unix:/ruta
+#define FD_PASSING_MSG "FD"         // Campo de la trama inicial (y de su ACK) si el otro extremo acepta archivos por descriptor
+#define FD_PASSING_MAX_FDS 4        // Descriptores que caben en el control al recibir una trama (sólo se usa el primero)
 
 /* CONNECTION TYPEs */
 #define TYPE_CONNECT_FLECK_GOTHAM 0x01          // Conexiones entre Fleck y Gotham
@@ -34,14 +49,20 @@
 #define TYPE_PRINCIPAL_WORKER 0x08              // Asignación de un nuevo Worker principal
 #define TYPE_ERROR 0x09                         // Error recibiendo la trama
 #define TYPE_HEARTBEAT 0x12                     // Conexiones HEARTBEAT
+#define TYPE_STATS 0x14                         // Petición de estadísticas de Gotham (de Fleck a Gotham)
+#define TYPE_JOB_STATUS 0x15                    // Estado de una distorsión (de Fleck o Worker a Gotham): <job_id>&<fase>
+#define TYPE_JOB_REQUEST 0x16                   // Worker libre que reclama distorsiones (de Worker a Gotham): <huecos libres>
+#define TYPE_FILE_FD 0x17                       // Archivo pasado como descriptor (SCM_RIGHTS) en vez de en tramas TYPE_FILE_DATA
 #define TYPE_LOG 0x20
 
 
 // Estructura para guardar información de un servidor
 typedef struct {
     int server_fd;                  // File escriptor del socket del servidor
-    struct sockaddr_in address;     // Dirección del servidor
-    int port;                       // Puerto del servidor
+    struct sockaddr_storage address;    // Dirección del servidor (IPv4 o socket Unix)
+    socklen_t address_len;
+    int port;                       // Puerto del servidor (no se usa con sockets Unix)
+    char unix_path[sizeof(((struct sockaddr_un*)0)->sun_path)];  // Ruta del socket Unix ("" si es TCP)
     int max_connections;            // Número máximo de conexiones en espera
 } Server;
 
@@ -59,8 +80,16 @@ void start_server(Server *server);
 void close_server(Server *server);
 // Funcion para escuchar conexiones de un servidor
 int accept_connection(Server *server);
+// Direcciones "unix:/ruta" (mismo host) o IPv4
+int is_unix_address(const char* ip_addr);
+int connect_to_server(const char* ip_addr, int port);
+// Paso de descriptores de archivo entre procesos del mismo host (sockets Unix)
+int is_unix_socket(int socket_fd);
+int send_trama_fd(int socket_fd, unsigned char* trama, int fd);
+int recv_trama_fd(int socket_fd, unsigned char* trama, int* fd);
 
 // Funciones para trabajar con tramas
+unsigned short calcular_checksum(const unsigned char* trama);
 unsigned char* crear_trama(int TYPE, unsigned char* data, size_t data_length);
 TramaResult* leer_trama(unsigned char *trama);  // Comprueba que el checksum sea correcto y devuelve la data del mensaje
 // Libera la memoria de TramaResult
@@ -115,4 +115,58 @@ char* calculate_md5sum(const char* filename) {
     md5sum[32] = '\0'; // Asegurarse de que la cadena termine en '\0'
 
     return md5sum;
-}
\ No newline at end of file
+}
+/***********************************************
+*
+* @Finalitat: Copiar una part d’un fitxer rebut com a descriptor al fitxer de destí sense passar
+*             les dades per cap socket. Es prova copy_file_range (el kernel copia o comparteix els
+*             blocs, reflink, sense passar per l’espai d’usuari) i, si no es pot (fitxer obert
+*             amb O_APPEND, sistemes de fitxers diferents...), s’escriu des d’un mmap de l’origen.
+* @Parametres:
+*   in: src_fd = descriptor del fitxer d’origen.
+*   in: offset = posició de l’origen des d’on copiar.
+*   in: dst_fd = descriptor del fitxer de destí (s’escriu a la seva posició actual).
+*   in: length = bytes a copiar.
+* @Retorn: Bytes copiats, o -1 en error.
+*
+************************************************/
+long copy_file_fd(int src_fd, long offset, int dst_fd, long length) {
+    long copied = 0;
+    loff_t src_offset = offset;
+    while (copied < length) {
+        ssize_t bytes = copy_file_range(src_fd, &src_offset, dst_fd, NULL, length - copied, 0);
+        if (bytes <= 0) {
+            break;
+        }
+        copied += bytes;
+    }
+    if (copied == length) {
+        return copied;
+    }
+
+    // mmap debe empezar en un múltiplo del tamaño de página
+    long page = sysconf(_SC_PAGESIZE);
+    long start = offset + copied;
+    long map_start = start - (start % page);
+    long map_length = offset + length - map_start;
+    unsigned char* map = mmap(NULL, map_length, PROT_READ, MAP_PRIVATE, src_fd, map_start);
+    if (map == MAP_FAILED) {
+        perror("Error al mapear el archivo recibido");
+        return -1;
+    }
+    long pending = length - copied;
+    unsigned char* data = map + (start - map_start);
+    while (pending > 0) {
+        ssize_t bytes = write(dst_fd, data, pending);
+        if (bytes <= 0) {
+            perror("Error al copiar el archivo recibido");
+            munmap(map, map_length);
+            return -1;
+        }
+        data += bytes;
+        pending -= bytes;
+        copied += bytes;
+    }
+    munmap(map, map_length);
+    return copied;
+}
@@ -6,6 +6,7 @@
 
 #include <sys/types.h>
 #include <sys/wait.h>   // waitpid
+#include <sys/mman.h>   // mmap
 
 #include "../config/config.h"
 #include "../config/connections.h"
@@ -16,6 +17,7 @@
 
 char* get_string_file_size(const char* filename);
 char* calculate_md5sum(const char* filename);
+long copy_file_fd(int src_fd, long offset, int dst_fd, long length);
 
 
 
@@ -0,0 +1,112 @@
+#include <errno.h>
+#include <stdlib.h>
+
+#include "sched.h"
+
+/***********************************************
+*
+* @Finalitat: Inicialitzar el model de cost amb els valors per defecte de cada tipus.
+* @Parametres:
+*   out: model = model a inicialitzar.
+* @Retorn: ---
+*
+************************************************/
+void sched_model_init(SchedModel* model) {
+    model->ms_per_kb[TIMING_KIND_TEXT] = SCHED_TEXT_MS_PER_KB;
+    model->ms_per_kb[TIMING_KIND_IMAGE] = SCHED_IMAGE_MS_PER_KB;
+    model->ms_per_kb[TIMING_KIND_AUDIO] = SCHED_AUDIO_MS_PER_KB;
+    pthread_mutex_init(&model->mutex, NULL);
+}
+
+/***********************************************
+*
+* @Finalitat: Alliberar els recursos del model de cost.
+* @Parametres:
+*   in/out: model = model.
+* @Retorn: ---
+*
+************************************************/
+void sched_model_destroy(SchedModel* model) {
+    pthread_mutex_destroy(&model->mutex);
+}
+
+/***********************************************
+*
+* @Finalitat: Actualitzar el cost per KB d’un tipus amb la durada d’una distorsió acabada.
+* @Parametres:
+*   in/out: model = model de cost.
+*   in: kind = TIMING_KIND_* del fitxer.
+*   in: size = mida del fitxer original en bytes (les distorsions sense mida s’ignoren).
+*   in: elapsed_ms = durada de la distorsió.
+* @Retorn: ---
+*
+************************************************/
+void sched_model_record(SchedModel* model, int kind, long size, double elapsed_ms) {
+    if (kind < 0 || kind >= TIMINGS_NUM_KINDS || size <= 0 || elapsed_ms <= 0) {
+        return;
+    }
+    double sample = elapsed_ms / (size / 1024.0);
+
+    pthread_mutex_lock(&model->mutex);
+    model->ms_per_kb[kind] += SCHED_EWMA_ALPHA * (sample - model->ms_per_kb[kind]);
+    pthread_mutex_unlock(&model->mutex);
+}
+
+/***********************************************
+*
+* @Finalitat: Estimar la durada d’una distorsió a partir del tipus i la mida del fitxer.
+* @Parametres:
+*   in: model = model de cost.
+*   in: kind = TIMING_KIND_* del fitxer.
+*   in: size = mida del fitxer en bytes (0 si no se sap).
+* @Retorn: Durada esperada en ms.
+*
+************************************************/
+double sched_expected_ms(SchedModel* model, int kind, long size) {
+    if (kind < 0 || kind >= TIMINGS_NUM_KINDS || size <= 0) {
+        return 0;
+    }
+    pthread_mutex_lock(&model->mutex);
+    double ms_per_kb = model->ms_per_kb[kind];
+    pthread_mutex_unlock(&model->mutex);
+    return ms_per_kb * (size / 1024.0);
+}
+
+/***********************************************
+*
+* @Finalitat: Llegir la mida d’un fitxer declarada en una trama.
+* @Parametres:
+*   in: text = camp de la trama.
+* @Retorn: Mida en bytes, o -1 si el camp no és un enter no negatiu.
+*
+************************************************/
+long sched_parse_size(const char* text) {
+    if (text == NULL) {
+        return -1;
+    }
+    char* end;
+    errno = 0;
+    long size = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || errno == ERANGE || size < 0) {
+        return -1;
+    }
+    return size;
+}
+
+/***********************************************
+*
+* @Finalitat: Calcular la puntuació d’una distorsió en espera: es serveix primer la de menor
+*             puntuació. El cost esperat es divideix per la prioritat i es redueix amb el temps
+*             d’espera, de manera que les distorsions grans no esperen indefinidament.
+* @Parametres:
+*   in: expected_ms = durada esperada.
+*   in: priority = prioritat (0 a SCHED_MAX_PRIORITY).
+*   in: enqueued_ns = instant en què ha començat a esperar.
+*   in: now_ns = instant actual.
+* @Retorn: Puntuació (ms).
+*
+************************************************/
+double sched_score(double expected_ms, int priority, uint64_t enqueued_ns, uint64_t now_ns) {
+    double waited_ms = (now_ns > enqueued_ns) ? (now_ns - enqueued_ns) / 1e6 : 0;
+    return expected_ms / (1 + priority) - SCHED_AGING_FACTOR * waited_ms;
+}
@@ -0,0 +1,34 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "timings.h"
+
+// Planificación por coste esperado (SEJF: shortest-expected-job-first) con envejecimiento
+#define SCHED_MAX_PRIORITY 9            // Prioridad de una distorsión: 0 (normal) a 9 (la más urgente)
+#define SCHED_AGING_FACTOR 1.0          // ms de coste esperado que se descuentan por cada ms de espera
+#define SCHED_SMALL_JOB_MS 1000         // Coste esperado máximo de una distorsión "pequeña" (carril rápido)
+#define SCHED_EWMA_ALPHA 0.2            // Peso de la última distorsión en el coste por KB de su tipo
+
+// Coste inicial por KB de cada tipo, hasta que se haya medido alguna distorsión
+#define SCHED_TEXT_MS_PER_KB 1.0
+#define SCHED_IMAGE_MS_PER_KB 100.0
+#define SCHED_AUDIO_MS_PER_KB 500.0
+
+// Coste medido de las distorsiones de cada tipo (ms por KB del archivo original)
+typedef struct {
+    double ms_per_kb[TIMINGS_NUM_KINDS];
+    pthread_mutex_t mutex;
+} SchedModel;
+
+
+void sched_model_init(SchedModel* model);
+void sched_model_destroy(SchedModel* model);
+void sched_model_record(SchedModel* model, int kind, long size, double elapsed_ms);
+double sched_expected_ms(SchedModel* model, int kind, long size);
+long sched_parse_size(const char* text);
+double sched_score(double expected_ms, int priority, uint64_t enqueued_ns, uint64_t now_ns);
+
+#endif
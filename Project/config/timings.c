@@ -0,0 +1,207 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <time.h>
+
+#include "timings.h"
+
+static const char* const KIND_NAMES[TIMINGS_NUM_KINDS] = {TEXT, IMAGE, AUDIO};
+
+static uint64_t (*virtual_clock)(void) = NULL;     // Rellotge del simulador (NULL = rellotge monòton)
+
+/***********************************************
+*
+* @Finalitat: Substituir el rellotge de timings_now_ns per un de virtual (simulador de clúster).
+* @Parametres:
+*   in: clock = funció que retorna el temps virtual en nanosegons (NULL per tornar al rellotge real).
+* @Retorn: ---
+*
+************************************************/
+void timings_set_clock(uint64_t (*clock)(void)) {
+    virtual_clock = clock;
+}
+
+/***********************************************
+*
+* @Finalitat: Obtenir el temps actual del rellotge monòton (no afectat per canvis d’hora del sistema),
+*             o el temps virtual si s’ha instal·lat un rellotge amb timings_set_clock.
+* @Parametres: ---
+* @Retorn: Temps en nanosegons des d’un origen arbitrari.
+*
+************************************************/
+uint64_t timings_now_ns(void) {
+    if (virtual_clock != NULL) {
+        return virtual_clock();
+    }
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/***********************************************
+*
+* @Finalitat: Classificar un fitxer en un dels tipus de mesura (Text, Image o Audio).
+* @Parametres:
+*   in: filename = nom del fitxer.
+* @Retorn: TIMING_KIND_IMAGE, TIMING_KIND_AUDIO o TIMING_KIND_TEXT (per defecte).
+*
+************************************************/
+int timings_kind(const char* filename) {
+    char* media = wich_media(filename);
+
+    if (media != NULL && strcmp(media, IMAGE) == 0) return TIMING_KIND_IMAGE;
+    if (media != NULL && strcmp(media, AUDIO) == 0) return TIMING_KIND_AUDIO;
+    return TIMING_KIND_TEXT;
+}
+
+/***********************************************
+*
+* @Finalitat: Calcular el bucket logarítmic on cau un valor: els valors petits tenen bucket exacte
+*             i a partir d’aquí cada potència de 2 es divideix en sub-buckets lineals.
+* @Parametres:
+*   in: value = valor en microsegons.
+* @Retorn: Índex del bucket [0, TIMINGS_BUCKETS).
+*
+************************************************/
+static int bucket_index(long value) {
+    if (value < 0) value = 0;
+    if (value < (1L << TIMINGS_SUB_BUCKET_BITS)) return (int)value;
+
+    int magnitude = 63 - __builtin_clzl((unsigned long)value);
+    int shift = magnitude - TIMINGS_SUB_BUCKET_BITS;
+    int index = ((shift + 1) << TIMINGS_SUB_BUCKET_BITS) + (int)((value >> shift) - (1L << TIMINGS_SUB_BUCKET_BITS));
+
+    return (index < TIMINGS_BUCKETS) ? index : TIMINGS_BUCKETS - 1;
+}
+
+/***********************************************
+*
+* @Finalitat: Obtenir el valor màxim representat per un bucket (invers de bucket_index).
+* @Parametres:
+*   in: index = índex del bucket.
+* @Retorn: Límit superior del bucket en microsegons.
+*
+************************************************/
+static long bucket_upper_us(int index) {
+    if (index < (1 << TIMINGS_SUB_BUCKET_BITS)) return index;
+
+    int shift = (index >> TIMINGS_SUB_BUCKET_BITS) - 1;
+    long sub_bucket = (index & ((1 << TIMINGS_SUB_BUCKET_BITS) - 1)) + (1L << TIMINGS_SUB_BUCKET_BITS);
+    return ((sub_bucket + 1) << shift) - 1;
+}
+
+/***********************************************
+*
+* @Finalitat: Afegir una mostra a l’histograma (segur entre threads).
+* @Parametres:
+*   in/out: h        = histograma.
+*   in:     value_us = valor a registrar en microsegons.
+* @Retorn: ---
+*
+************************************************/
+void histogram_record_us(Histogram* h, long value_us) {
+    atomic_fetch_add_explicit(&h->counts[bucket_index(value_us)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->total, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->sum_us, value_us, memory_order_relaxed);
+
+    long max = atomic_load_explicit(&h->max_us, memory_order_relaxed);
+    while (value_us > max && !atomic_compare_exchange_weak(&h->max_us, &max, value_us)) {
+        // 'max' se actualiza con el valor actual en cada intento fallido
+    }
+}
+
+/***********************************************
+*
+* @Finalitat: Calcular un percentil aproximat de l’histograma.
+* @Parametres:
+*   in: h          = histograma.
+*   in: percentile = percentil desitjat (0-100).
+* @Retorn: Valor del percentil en microsegons (0 si no hi ha mostres).
+*
+************************************************/
+long histogram_percentile_us(Histogram* h, double percentile) {
+    long total = atomic_load_explicit(&h->total, memory_order_relaxed);
+    if (total == 0) return 0;
+
+    long target = (long)(percentile / 100.0 * total + 0.999999);
+    if (target < 1) target = 1;
+
+    long accumulated = 0;
+    for (int i = 0; i < TIMINGS_BUCKETS; i++) {
+        accumulated += atomic_load_explicit(&h->counts[i], memory_order_relaxed);
+        if (accumulated >= target) {
+            long max = atomic_load_explicit(&h->max_us, memory_order_relaxed);
+            long upper = bucket_upper_us(i);
+            return (upper < max) ? upper : max;
+        }
+    }
+    return atomic_load_explicit(&h->max_us, memory_order_relaxed);
+}
+
+/***********************************************
+*
+* @Finalitat: Registrar la durada d’una fase per a un tipus de fitxer.
+* @Parametres:
+*   in/out: table      = taula d’histogrames.
+*   in:     phase      = índex de la fase.
+*   in:     kind       = tipus de fitxer (TIMING_KIND_*).
+*   in:     elapsed_ns = durada en nanosegons.
+* @Retorn: ---
+*
+************************************************/
+void timings_record(TimingTable* table, int phase, int kind, uint64_t elapsed_ns) {
+    if (phase < 0 || phase >= table->num_phases || kind < 0 || kind >= TIMINGS_NUM_KINDS) return;
+    histogram_record_us(&table->hist[phase][kind], (long)(elapsed_ns / 1000));
+}
+
+/***********************************************
+*
+* @Finalitat: Registrar la durada d’una fase des de l’instant indicat fins ara.
+* @Parametres:
+*   in/out: table    = taula d’histogrames.
+*   in:     phase    = índex de la fase.
+*   in:     kind     = tipus de fitxer (TIMING_KIND_*).
+*   in:     start_ns = instant d’inici obtingut amb timings_now_ns().
+* @Retorn: ---
+*
+************************************************/
+void timings_record_since(TimingTable* table, int phase, int kind, uint64_t start_ns) {
+    timings_record(table, phase, kind, timings_now_ns() - start_ns);
+}
+
+/***********************************************
+*
+* @Finalitat: Escriure una taula amb el recompte i els percentils de cada fase i tipus amb mostres.
+* @Parametres:
+*   in: table = taula d’histogrames.
+*   in: fd    = descriptor on escriure.
+* @Retorn: ---
+*
+************************************************/
+void timings_print(TimingTable* table, int fd) {
+    int printed = 0;
+
+    dprintf(fd, "\n========= TIEMPOS POR FASE (ms) =========\n\n");
+    dprintf(fd, "%-14s %-6s %8s %10s %10s %10s %10s %10s\n", "Fase", "Tipo", "n", "p50", "p90", "p99", "max", "media");
+
+    for (int phase = 0; phase < table->num_phases; phase++) {
+        for (int kind = 0; kind < TIMINGS_NUM_KINDS; kind++) {
+            Histogram* h = &table->hist[phase][kind];
+            long total = atomic_load_explicit(&h->total, memory_order_relaxed);
+            if (total == 0) continue;
+
+            dprintf(fd, "%-14s %-6s %8ld %10.3f %10.3f %10.3f %10.3f %10.3f\n",
+                    table->phase_names[phase], KIND_NAMES[kind], total,
+                    histogram_percentile_us(h, 50) / 1000.0,
+                    histogram_percentile_us(h, 90) / 1000.0,
+                    histogram_percentile_us(h, 99) / 1000.0,
+                    atomic_load_explicit(&h->max_us, memory_order_relaxed) / 1000.0,
+                    atomic_load_explicit(&h->sum_us, memory_order_relaxed) / 1000.0 / total);
+            printed = 1;
+        }
+    }
+
+    if (!printed) {
+        dprintf(fd, "Sin distorsiones medidas todavía.\n");
+    }
+    dprintf(fd, "\n=========================================\n\n");
+}
@@ -0,0 +1,47 @@
+#ifndef TIMINGS_H
+#define TIMINGS_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "config.h"
+
+// Histograma logarítmico (estilo HDR): cada potencia de 2 se divide en 2^TIMINGS_SUB_BUCKET_BITS sub-buckets
+#define TIMINGS_SUB_BUCKET_BITS 3           // 8 sub-buckets por potencia de 2 (error relativo < 12.5%)
+#define TIMINGS_MAGNITUDES 40               // Valores hasta 2^40 us (~12 días)
+#define TIMINGS_BUCKETS ((TIMINGS_MAGNITUDES + 1) << TIMINGS_SUB_BUCKET_BITS)
+#define TIMINGS_MAX_PHASES 12
+
+// Tipos de archivo para los que se separan las medidas
+#define TIMING_KIND_TEXT 0
+#define TIMING_KIND_IMAGE 1
+#define TIMING_KIND_AUDIO 2
+#define TIMINGS_NUM_KINDS 3
+
+// Histograma de latencias en microsegundos (se puede actualizar desde varios threads)
+typedef struct {
+    atomic_long counts[TIMINGS_BUCKETS];
+    atomic_long total;      // Número de muestras
+    atomic_long sum_us;     // Suma de todas las muestras
+    atomic_long max_us;     // Máximo registrado
+} Histogram;
+
+// Tabla de histogramas por fase y por tipo de archivo
+typedef struct {
+    const char* const* phase_names;     // Nombre de cada fase (para imprimir)
+    int num_phases;
+    Histogram hist[TIMINGS_MAX_PHASES][TIMINGS_NUM_KINDS];
+} TimingTable;
+
+uint64_t timings_now_ns(void);
+void timings_set_clock(uint64_t (*clock)(void));
+int timings_kind(const char* filename);
+
+void histogram_record_us(Histogram* h, long value_us);
+long histogram_percentile_us(Histogram* h, double percentile);
+
+void timings_record(TimingTable* table, int phase, int kind, uint64_t elapsed_ns);
+void timings_record_since(TimingTable* table, int phase, int kind, uint64_t start_ns);
+void timings_print(TimingTable* table, int fd);
+
+#endif
@@ -0,0 +1,766 @@
+#include <poll.h>
+#include <time.h>
+
+#include "transport.h"
+
+// Un sentido de una conexión en memoria: cola circular de tramas
+typedef struct {
+    unsigned char frames[TRANSPORT_MEM_QUEUE][BUFFER_SIZE];
+    int head;
+    int count;
+} MemQueue;
+
+// Conexión en memoria: el extremo 0 escribe en queues[1] y lee de queues[0] (y al revés el extremo 1)
+typedef struct {
+    MemQueue queues[2];
+    int closed[2];
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;     // Nueva trama, hueco libre o cierre de un extremo
+    int refs;                   // Extremos abiertos más operaciones en curso (protegido por mem_endpoints_mutex)
+} MemChannel;
+
+typedef struct {
+    MemChannel* channel;        // NULL si el extremo está libre
+    int side;
+} MemEndpoint;
+
+static MemEndpoint mem_endpoints[TRANSPORT_MEM_MAX];
+static pthread_mutex_t mem_endpoints_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static _Thread_local TransportCounters thread_counters;
+
+// Captura de tramas (-1 si no está activa) e identificador de cada conexión capturada (0 si no tiene):
+// descriptores por debajo de TRANSPORT_CAPTURE_MAX_FDS y, detrás, los extremos en memoria
+static atomic_int capture_fd = -1;
+static uint64_t capture_start_ns;
+static atomic_uint capture_next_id;
+static atomic_uint capture_ids[TRANSPORT_CAPTURE_MAX_FDS + TRANSPORT_MEM_MAX];
+
+
+/***********************************************
+*
+* @Finalitat: Enviar una trama per un socket (TCP o Unix).
+* @Parametres:
+*   in: conn  = descriptor del socket.
+*   in: trama = trama de BUFFER_SIZE bytes.
+* @Retorn: Bytes enviats, o -1 en error.
+*
+************************************************/
+static int socket_send_frame(int conn, const unsigned char* trama) {
+    return write(conn, trama, BUFFER_SIZE);
+}
+
+/***********************************************
+*
+* @Finalitat: Rebre una trama sencera d’un socket (TCP o Unix).
+* @Parametres:
+*   in:  conn  = descriptor del socket.
+*   out: trama = buffer de BUFFER_SIZE bytes.
+* @Retorn: Bytes rebuts, 0 si l’altre extrem ha tancat, o -1 en error.
+*
+************************************************/
+static int socket_recv_frame(int conn, unsigned char* trama) {
+    return recv(conn, trama, BUFFER_SIZE, MSG_WAITALL);
+}
+
+/***********************************************
+*
+* @Finalitat: Consultar sense consumir-la ni esperar la trama següent d’un socket (TCP o Unix).
+* @Parametres:
+*   in:  conn  = descriptor del socket.
+*   out: trama = buffer de BUFFER_SIZE bytes.
+* @Retorn: BUFFER_SIZE si hi ha una trama sencera, 0 si l’altre extrem ha tancat, o -1 (errno = EAGAIN
+*          si encara no ha arribat sencera).
+*
+************************************************/
+static int socket_peek_frame(int conn, unsigned char* trama) {
+    int bytes = recv(conn, trama, BUFFER_SIZE, MSG_PEEK | MSG_DONTWAIT);
+    if (bytes > 0 && bytes < BUFFER_SIZE) {
+        errno = EAGAIN;
+        return -1;
+    }
+    return bytes;
+}
+
+/***********************************************
+*
+* @Finalitat: Esperar que arribi una trama (o el tancament) per un socket.
+* @Parametres:
+*   in: conn       = descriptor del socket.
+*   in: timeout_ms = temps màxim d’espera (-1 sense límit).
+* @Retorn: >0 si hi ha dades per llegir, 0 si s’ha esgotat el temps, -1 en error.
+*
+************************************************/
+static int socket_poll(int conn, int timeout_ms) {
+    struct pollfd pfd = { .fd = conn, .events = POLLIN };
+    return poll(&pfd, 1, timeout_ms);
+}
+
+/***********************************************
+*
+* @Finalitat: Tancar un socket.
+* @Parametres:
+*   in: conn = descriptor del socket.
+* @Retorn: 0 en èxit, -1 en error.
+*
+************************************************/
+static int socket_close(int conn) {
+    return close(conn);
+}
+
+/***********************************************
+*
+* @Finalitat: Obtenir l’extrem en memòria d’un identificador de connexió i reservar-ne la connexió
+*             perquè un mem_close concurrent no l’alliberi mentre s’usa (cal cridar mem_release).
+* @Parametres:
+*   in:  conn    = identificador (>= TRANSPORT_MEM_BASE).
+*   out: channel = connexió a la qual pertany l’extrem.
+* @Retorn: Costat de l’extrem (0 o 1), o -1 si no està obert (errno = EBADF).
+*
+************************************************/
+static int mem_endpoint(int conn, MemChannel** channel) {
+    int index = conn - TRANSPORT_MEM_BASE;
+    if (index < 0 || index >= TRANSPORT_MEM_MAX) {
+        errno = EBADF;
+        return -1;
+    }
+    pthread_mutex_lock(&mem_endpoints_mutex);
+    *channel = mem_endpoints[index].channel;
+    int side = mem_endpoints[index].side;
+    if (*channel != NULL) {
+        (*channel)->refs++;
+    }
+    pthread_mutex_unlock(&mem_endpoints_mutex);
+    if (*channel == NULL) {
+        errno = EBADF;
+        return -1;
+    }
+    return side;
+}
+
+/***********************************************
+*
+* @Finalitat: Deixar d’usar una connexió en memòria; l’allibera si ja no hi ha extrems oberts ni
+*             operacions en curs.
+* @Parametres:
+*   in: channel = connexió obtinguda amb mem_endpoint (o la referència d’un extrem que es tanca).
+* @Retorn: ---
+*
+************************************************/
+static void mem_release(MemChannel* channel) {
+    pthread_mutex_lock(&mem_endpoints_mutex);
+    int unused = (--channel->refs == 0);
+    pthread_mutex_unlock(&mem_endpoints_mutex);
+    if (unused) {
+        pthread_mutex_destroy(&channel->mutex);
+        pthread_cond_destroy(&channel->changed);
+        free(channel);
+    }
+}
+
+/***********************************************
+*
+* @Finalitat: Encuar una trama cap a l’altre extrem d’una connexió en memòria, esperant si la seva
+*             cua és plena (com un socket amb el buffer ple).
+* @Parametres:
+*   in: conn  = identificador de l’extrem.
+*   in: trama = trama de BUFFER_SIZE bytes.
+* @Retorn: BUFFER_SIZE en èxit, -1 si l’altre extrem ha tancat (errno = EPIPE) o la connexió no existeix.
+*
+************************************************/
+static int mem_send_frame(int conn, const unsigned char* trama) {
+    MemChannel* channel;
+    int side = mem_endpoint(conn, &channel);
+    if (side < 0) {
+        return -1;
+    }
+
+    MemQueue* queue = &channel->queues[1 - side];
+    pthread_mutex_lock(&channel->mutex);
+    while (queue->count == TRANSPORT_MEM_QUEUE && !channel->closed[1 - side] && !channel->closed[side]) {
+        pthread_cond_wait(&channel->changed, &channel->mutex);
+    }
+    int result = BUFFER_SIZE;
+    if (channel->closed[1 - side] || channel->closed[side]) {
+        result = -1;
+    } else {
+        memcpy(queue->frames[(queue->head + queue->count) % TRANSPORT_MEM_QUEUE], trama, BUFFER_SIZE);
+        queue->count++;
+        pthread_cond_broadcast(&channel->changed);
+    }
+    pthread_mutex_unlock(&channel->mutex);
+    mem_release(channel);
+    if (result < 0) {
+        errno = EPIPE;
+    }
+    return result;
+}
+
+/***********************************************
+*
+* @Finalitat: Treure la següent trama de la cua d’un extrem en memòria, esperant si és buida.
+* @Parametres:
+*   in:  conn  = identificador de l’extrem.
+*   out: trama = buffer de BUFFER_SIZE bytes.
+* @Retorn: BUFFER_SIZE, 0 si l’altre extrem ha tancat i no queden trames, -1 en error.
+*
+************************************************/
+static int mem_recv_frame(int conn, unsigned char* trama) {
+    MemChannel* channel;
+    int side = mem_endpoint(conn, &channel);
+    if (side < 0) {
+        return -1;
+    }
+
+    MemQueue* queue = &channel->queues[side];
+    pthread_mutex_lock(&channel->mutex);
+    while (queue->count == 0 && !channel->closed[1 - side] && !channel->closed[side]) {
+        pthread_cond_wait(&channel->changed, &channel->mutex);
+    }
+    int result = 0;
+    if (queue->count > 0) {
+        memcpy(trama, queue->frames[queue->head], BUFFER_SIZE);
+        queue->head = (queue->head + 1) % TRANSPORT_MEM_QUEUE;
+        queue->count--;
+        pthread_cond_broadcast(&channel->changed);
+        result = BUFFER_SIZE;
+    }
+    pthread_mutex_unlock(&channel->mutex);
+    mem_release(channel);
+    return result;
+}
+
+/***********************************************
+*
+* @Finalitat: Consultar sense consumir-la ni esperar la trama següent d’un extrem en memòria.
+* @Parametres:
+*   in:  conn  = identificador de l’extrem.
+*   out: trama = buffer de BUFFER_SIZE bytes.
+* @Retorn: BUFFER_SIZE si hi ha una trama, 0 si l’altre extrem ha tancat i no queden trames, o -1
+*          (errno = EAGAIN si la cua és buida).
+*
+************************************************/
+static int mem_peek_frame(int conn, unsigned char* trama) {
+    MemChannel* channel;
+    int side = mem_endpoint(conn, &channel);
+    if (side < 0) {
+        return -1;
+    }
+
+    MemQueue* queue = &channel->queues[side];
+    int result = BUFFER_SIZE;
+    pthread_mutex_lock(&channel->mutex);
+    if (queue->count > 0) {
+        memcpy(trama, queue->frames[queue->head], BUFFER_SIZE);
+    } else if (channel->closed[1 - side] || channel->closed[side]) {
+        result = 0;
+    } else {
+        result = -1;
+    }
+    pthread_mutex_unlock(&channel->mutex);
+    mem_release(channel);
+    if (result < 0) {
+        errno = EAGAIN;
+    }
+    return result;
+}
+
+/***********************************************
+*
+* @Finalitat: Esperar que un extrem en memòria tingui una trama per llegir o que l’altre extrem tanqui.
+* @Parametres:
+*   in: conn       = identificador de l’extrem.
+*   in: timeout_ms = temps màxim d’espera (-1 sense límit).
+* @Retorn: 1 si recv_frame no bloquejarà, 0 si s’ha esgotat el temps, -1 en error.
+*
+************************************************/
+static int mem_poll(int conn, int timeout_ms) {
+    MemChannel* channel;
+    int side = mem_endpoint(conn, &channel);
+    if (side < 0) {
+        return -1;
+    }
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    if (timeout_ms > 0) {
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    pthread_mutex_lock(&channel->mutex);
+    int ready = channel->queues[side].count > 0 || channel->closed[1 - side] || channel->closed[side];
+    while (!ready && timeout_ms != 0) {
+        int rc = (timeout_ms < 0) ? pthread_cond_wait(&channel->changed, &channel->mutex)
+                                  : pthread_cond_timedwait(&channel->changed, &channel->mutex, &deadline);
+        ready = channel->queues[side].count > 0 || channel->closed[1 - side] || channel->closed[side];
+        if (rc == ETIMEDOUT) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&channel->mutex);
+    mem_release(channel);
+    return ready;
+}
+
+/***********************************************
+*
+* @Finalitat: Tancar un extrem en memòria. L’altre extrem llegeix les trames pendents i després 0;
+*             la connexió s’allibera quan tots dos extrems han tancat i cap operació l’està usant.
+* @Parametres:
+*   in: conn = identificador de l’extrem.
+* @Retorn: 0 en èxit, -1 si no estava obert.
+*
+************************************************/
+static int mem_close(int conn) {
+    int index = conn - TRANSPORT_MEM_BASE;
+    if (index < 0 || index >= TRANSPORT_MEM_MAX) {
+        errno = EBADF;
+        return -1;
+    }
+
+    pthread_mutex_lock(&mem_endpoints_mutex);
+    MemChannel* channel = mem_endpoints[index].channel;
+    int side = mem_endpoints[index].side;
+    mem_endpoints[index].channel = NULL;
+    pthread_mutex_unlock(&mem_endpoints_mutex);
+    if (channel == NULL) {
+        errno = EBADF;
+        return -1;
+    }
+
+    // Despierta a quien espere en este extremo; la referencia del extremo se suelta después
+    pthread_mutex_lock(&channel->mutex);
+    channel->closed[side] = 1;
+    pthread_cond_broadcast(&channel->changed);
+    pthread_mutex_unlock(&channel->mutex);
+    mem_release(channel);
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalitat: Llegir el rellotge monotònic.
+* @Parametres: ---
+* @Retorn: Nanosegons.
+*
+************************************************/
+static uint64_t capture_clock_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/***********************************************
+*
+* @Finalitat: Obtenir la posició d’una connexió a la taula d’identificadors de la captura.
+* @Parametres:
+*   in: conn = identificador de la connexió.
+* @Retorn: Posició, o NULL si la connexió queda fora de la taula.
+*
+************************************************/
+static atomic_uint* capture_slot(int conn) {
+    if (transport_is_mem(conn)) {
+        int index = conn - TRANSPORT_MEM_BASE;
+        return (index < TRANSPORT_MEM_MAX) ? &capture_ids[TRANSPORT_CAPTURE_MAX_FDS + index] : NULL;
+    }
+    return (conn >= 0 && conn < TRANSPORT_CAPTURE_MAX_FDS) ? &capture_ids[conn] : NULL;
+}
+
+/***********************************************
+*
+* @Finalitat: Afegir un registre a la captura, si n’hi ha una d’activa. Les connexions reben un
+*             identificador nou la primera vegada que hi passa una trama i el perden en tancar-se, de
+*             manera que un descriptor reutilitzat compta com una connexió diferent.
+* @Parametres:
+*   in: conn      = identificador de la connexió.
+*   in: direction = TRANSPORT_CAPTURE_SENT, TRANSPORT_CAPTURE_RECEIVED o TRANSPORT_CAPTURE_CLOSED, amb
+*                   TRANSPORT_CAPTURE_FD si la trama anava acompanyada d’un descriptor.
+*   in: trama     = trama de BUFFER_SIZE bytes (NULL en els tancaments).
+* @Retorn: ---
+*
+************************************************/
+static void capture_record(int conn, uint8_t direction, const unsigned char* trama) {
+    int fd = atomic_load_explicit(&capture_fd, memory_order_acquire);
+    atomic_uint* slot = capture_slot(conn);
+    if (fd < 0 || slot == NULL) {
+        return;
+    }
+
+    unsigned int id;
+    if (direction == TRANSPORT_CAPTURE_CLOSED) {
+        id = atomic_exchange_explicit(slot, 0, memory_order_relaxed);
+        if (id == 0) {
+            return;     // Conexión cerrada sin tramas capturadas (o ya cerrada al recibir 0)
+        }
+    } else {
+        id = atomic_load_explicit(slot, memory_order_relaxed);
+        if (id == 0) {
+            unsigned int fresh = atomic_fetch_add_explicit(&capture_next_id, 1, memory_order_relaxed) + 1;
+            id = atomic_compare_exchange_strong(slot, &id, fresh) ? fresh : id;
+        }
+    }
+
+    unsigned char record[TRANSPORT_CAPTURE_RECORD_SIZE + BUFFER_SIZE];
+    uint64_t time_ns = capture_clock_ns() - capture_start_ns;
+    uint32_t conn_id = id;
+    memcpy(record, &time_ns, sizeof(time_ns));
+    memcpy(record + 8, &conn_id, sizeof(conn_id));
+    record[12] = direction;
+    size_t size = TRANSPORT_CAPTURE_RECORD_SIZE;
+    if (trama != NULL) {
+        memcpy(record + TRANSPORT_CAPTURE_RECORD_SIZE, trama, BUFFER_SIZE);
+        size += BUFFER_SIZE;
+    }
+
+    // Un único write por registro en un archivo O_APPEND: los registros de distintos hilos no se mezclan
+    if (write(fd, record, size) != (ssize_t)size) {
+        // Un error de la captura no debe afectar al tráfico
+    }
+}
+
+/***********************************************
+*
+* @Finalitat: Llegir exactament size bytes d’un fitxer.
+* @Parametres:
+*   in:  fd     = descriptor del fitxer.
+*   out: buffer = dades llegides.
+*   in:  size   = bytes a llegir.
+* @Retorn: Bytes llegits (menys de size si s’acaba el fitxer), o -1 en error.
+*
+************************************************/
+static ssize_t capture_read_full(int fd, void* buffer, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = read(fd, (unsigned char*)buffer + done, size - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return (n < 0) ? -1 : (ssize_t)done;
+        }
+        done += n;
+    }
+    return done;
+}
+
+const Transport transport_socket = { "socket", socket_send_frame, socket_recv_frame, socket_peek_frame, socket_poll, socket_close };
+const Transport transport_mem = { "mem", mem_send_frame, mem_recv_frame, mem_peek_frame, mem_poll, mem_close };
+
+/***********************************************
+*
+* @Finalitat: Indicar si una connexió és un extrem en memòria.
+* @Parametres:
+*   in: conn = identificador de la connexió.
+* @Retorn: 1 si és en memòria, 0 si és un descriptor.
+*
+************************************************/
+int transport_is_mem(int conn) {
+    return conn >= TRANSPORT_MEM_BASE;
+}
+
+/***********************************************
+*
+* @Finalitat: Obtenir el transport d’una connexió (totes les operacions transport_* passen per aquí).
+* @Parametres:
+*   in: conn = identificador de la connexió.
+* @Retorn: Transport en memòria o de sockets (TCP i Unix fan servir les mateixes operacions).
+*
+************************************************/
+const Transport* transport_of(int conn) {
+    return transport_is_mem(conn) ? &transport_mem : &transport_socket;
+}
+
+/***********************************************
+*
+* @Finalitat: Enviar una trama pel transport de la connexió.
+* @Parametres:
+*   in: conn  = identificador de la connexió.
+*   in: trama = trama de BUFFER_SIZE bytes.
+* @Retorn: Bytes enviats, o -1 en error.
+*
+************************************************/
+int transport_send_frame(int conn, const unsigned char* trama) {
+    int sent = transport_of(conn)->send_frame(conn, trama);
+    if (sent == BUFFER_SIZE) {
+        atomic_fetch_add_explicit(&thread_counters.frames_sent, 1, memory_order_relaxed);
+        capture_record(conn, TRANSPORT_CAPTURE_SENT, trama);
+    }
+    return sent;
+}
+
+/***********************************************
+*
+* @Finalitat: Rebre una trama pel transport de la connexió.
+* @Parametres:
+*   in:  conn  = identificador de la connexió.
+*   out: trama = buffer de BUFFER_SIZE bytes.
+* @Retorn: Bytes rebuts, 0 si l’altre extrem ha tancat, o -1 en error.
+*
+************************************************/
+int transport_recv_frame(int conn, unsigned char* trama) {
+    int received = transport_of(conn)->recv_frame(conn, trama);
+    if (received == BUFFER_SIZE) {
+        atomic_fetch_add_explicit(&thread_counters.frames_received, 1, memory_order_relaxed);
+        capture_record(conn, TRANSPORT_CAPTURE_RECEIVED, trama);
+    } else if (received == 0) {
+        capture_record(conn, TRANSPORT_CAPTURE_CLOSED, NULL);
+    }
+    return received;
+}
+
+/***********************************************
+*
+* @Finalitat: Enviar una trama acompanyada d’un descriptor de fitxer (només sockets Unix, vegeu
+*             send_trama_fd), comptant-la i afegint-la a la captura com la resta de trames.
+* @Parametres:
+*   in: conn  = socket Unix connectat.
+*   in: trama = trama de BUFFER_SIZE bytes.
+*   in: fd    = descriptor a passar.
+* @Retorn: Bytes enviats, o -1 en error.
+*
+************************************************/
+int transport_send_frame_fd(int conn, unsigned char* trama, int fd) {
+    int sent = send_trama_fd(conn, trama, fd);
+    if (sent == BUFFER_SIZE) {
+        atomic_fetch_add_explicit(&thread_counters.frames_sent, 1, memory_order_relaxed);
+        capture_record(conn, TRANSPORT_CAPTURE_SENT | TRANSPORT_CAPTURE_FD, trama);
+    }
+    return sent;
+}
+
+/***********************************************
+*
+* @Finalitat: Rebre una trama i, si n’hi ha, el descriptor que l’acompanya (vegeu recv_trama_fd),
+*             comptant-la i afegint-la a la captura com la resta de trames.
+* @Parametres:
+*   in:  conn  = socket connectat.
+*   out: trama = buffer de BUFFER_SIZE bytes.
+*   out: fd    = descriptor rebut (-1 si la trama no en porta). Qui crida l’ha de tancar.
+* @Retorn: Bytes rebuts, 0 si l’altre extrem ha tancat, o -1 en error.
+*
+************************************************/
+int transport_recv_frame_fd(int conn, unsigned char* trama, int* fd) {
+    int received = recv_trama_fd(conn, trama, fd);
+    if (received == BUFFER_SIZE) {
+        atomic_fetch_add_explicit(&thread_counters.frames_received, 1, memory_order_relaxed);
+        capture_record(conn, TRANSPORT_CAPTURE_RECEIVED | (*fd >= 0 ? TRANSPORT_CAPTURE_FD : 0), trama);
+    } else if (received == 0) {
+        capture_record(conn, TRANSPORT_CAPTURE_CLOSED, NULL);
+    }
+    return received;
+}
+
+/***********************************************
+*
+* @Finalitat: Consultar sense consumir-la ni esperar la trama següent de la connexió (no es compta ni
+*             es captura: ho farà transport_recv_frame en llegir-la).
+* @Parametres:
+*   in:  conn  = identificador de la connexió.
+*   out: trama = buffer de BUFFER_SIZE bytes.
+* @Retorn: BUFFER_SIZE si hi ha una trama sencera, 0 si l’altre extrem ha tancat, o -1 (errno = EAGAIN
+*          si encara no n’hi ha cap de sencera).
+*
+************************************************/
+int transport_peek_frame(int conn, unsigned char* trama) {
+    return transport_of(conn)->peek_frame(conn, trama);
+}
+
+/***********************************************
+*
+* @Finalitat: Esperar que hi hagi una trama per llegir a la connexió.
+* @Parametres:
+*   in: conn       = identificador de la connexió.
+*   in: timeout_ms = temps màxim d’espera (-1 sense límit).
+* @Retorn: >0 si hi ha dades (o tancament) per llegir, 0 si s’ha esgotat el temps, -1 en error.
+*
+************************************************/
+int transport_poll(int conn, int timeout_ms) {
+    return transport_of(conn)->poll(conn, timeout_ms);
+}
+
+/***********************************************
+*
+* @Finalitat: Tancar una connexió.
+* @Parametres:
+*   in: conn = identificador de la connexió.
+* @Retorn: 0 en èxit, -1 en error.
+*
+************************************************/
+int transport_close(int conn) {
+    capture_record(conn, TRANSPORT_CAPTURE_CLOSED, NULL);
+    return transport_of(conn)->close(conn);
+}
+
+/***********************************************
+*
+* @Finalitat: Crear una connexió en memòria entre dos extrems del mateix procés (com socketpair()).
+*             Permet executar Gotham, Workers i Flecks simulats en un sol procés.
+* @Parametres:
+*   out: conns = identificadors dels dos extrems.
+* @Retorn: 0 en èxit, -1 si no queden extrems lliures (errno = EMFILE).
+*
+************************************************/
+int transport_mem_pair(int conns[2]) {
+    MemChannel* channel = calloc(1, sizeof(MemChannel));
+    if (channel == NULL) {
+        return -1;
+    }
+    pthread_mutex_init(&channel->mutex, NULL);
+    pthread_cond_init(&channel->changed, NULL);
+    channel->refs = 2;
+
+    int found = 0;
+    pthread_mutex_lock(&mem_endpoints_mutex);
+    for (int i = 0; i < TRANSPORT_MEM_MAX && found < 2; i++) {
+        if (mem_endpoints[i].channel == NULL) {
+            mem_endpoints[i].channel = channel;
+            mem_endpoints[i].side = found;
+            conns[found++] = TRANSPORT_MEM_BASE + i;
+        }
+    }
+    if (found < 2) {
+        if (found == 1) {
+            mem_endpoints[conns[0] - TRANSPORT_MEM_BASE].channel = NULL;
+        }
+        pthread_mutex_unlock(&mem_endpoints_mutex);
+        pthread_mutex_destroy(&channel->mutex);
+        pthread_cond_destroy(&channel->changed);
+        free(channel);
+        errno = EMFILE;
+        return -1;
+    }
+    pthread_mutex_unlock(&mem_endpoints_mutex);
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalitat: Obtenir els comptadors de trames del fil que crida (per mesurar retransmissions). El
+*             punter és vàlid mentre el fil existeixi i es pot passar a un altre fil per llegir-los.
+* @Parametres: ---
+* @Retorn: Comptadors del fil.
+*
+************************************************/
+TransportCounters* transport_thread_counters(void) {
+    return &thread_counters;
+}
+
+/***********************************************
+*
+* @Finalitat: Activar la captura de trames: a partir d’ara cada trama enviada o rebuda i cada tancament
+*             de connexió s’afegeixen al fitxer indicat (vegeu el format a transport.h).
+* @Parametres:
+*   in: path = fitxer de captura (es crea o es buida).
+* @Retorn: 0 en èxit, -1 si no es pot crear o ja hi ha una captura activa.
+*
+************************************************/
+int transport_capture_open(const char* path) {
+    if (atomic_load(&capture_fd) >= 0) {
+        errno = EBUSY;
+        return -1;
+    }
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct timespec wall;
+    clock_gettime(CLOCK_REALTIME, &wall);
+    uint64_t wall_ns = (uint64_t)wall.tv_sec * 1000000000ULL + wall.tv_nsec;
+    uint16_t version = TRANSPORT_CAPTURE_VERSION;
+    uint16_t frame_size = BUFFER_SIZE;
+    uint32_t pid = getpid();
+    unsigned char header[TRANSPORT_CAPTURE_HEADER_SIZE];
+    memcpy(header, TRANSPORT_CAPTURE_MAGIC, 8);
+    memcpy(header + 8, &version, sizeof(version));
+    memcpy(header + 10, &frame_size, sizeof(frame_size));
+    memcpy(header + 12, &pid, sizeof(pid));
+    memcpy(header + 16, &wall_ns, sizeof(wall_ns));
+    if (write(fd, header, sizeof(header)) != (ssize_t)sizeof(header)) {
+        close(fd);
+        return -1;
+    }
+
+    capture_start_ns = capture_clock_ns();
+    atomic_store_explicit(&capture_fd, fd, memory_order_release);
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalitat: Aturar la captura de tramas i tancar el fitxer. Cal cridar-la quan ja no queden fils
+*             enviant o rebent tramas (en sortir del programa).
+* @Parametres: ---
+* @Retorn: ---
+*
+************************************************/
+void transport_capture_close(void) {
+    int fd = atomic_exchange(&capture_fd, -1);
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+/***********************************************
+*
+* @Finalitat: Llegir i validar la capçalera d’un fitxer de captura.
+* @Parametres:
+*   in:  fd       = fitxer de captura obert per llegir.
+*   out: start_ns = inici de la captura (ns des de l’epoch).
+* @Retorn: 0 en èxit, -1 si no és una captura vàlida (errno = EINVAL).
+*
+************************************************/
+int transport_capture_read_header(int fd, uint64_t* start_ns) {
+    unsigned char header[TRANSPORT_CAPTURE_HEADER_SIZE];
+    uint16_t version, frame_size;
+    if (capture_read_full(fd, header, sizeof(header)) != (ssize_t)sizeof(header)) {
+        errno = EINVAL;
+        return -1;
+    }
+    memcpy(&version, header + 8, sizeof(version));
+    memcpy(&frame_size, header + 10, sizeof(frame_size));
+    memcpy(start_ns, header + 16, sizeof(*start_ns));
+    if (memcmp(header, TRANSPORT_CAPTURE_MAGIC, 8) != 0 || version != TRANSPORT_CAPTURE_VERSION
+        || frame_size != BUFFER_SIZE) {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalitat: Llegir el següent registre d’un fitxer de captura (després de la capçalera).
+* @Parametres:
+*   in:  fd     = fitxer de captura.
+*   out: record = registre llegit.
+* @Retorn: 1 si s’ha llegit un registre, 0 al final del fitxer, -1 si està truncat o és invàlid.
+*
+************************************************/
+int transport_capture_read(int fd, CaptureRecord* record) {
+    unsigned char header[TRANSPORT_CAPTURE_RECORD_SIZE];
+    ssize_t n = capture_read_full(fd, header, sizeof(header));
+    if (n == 0) {
+        return 0;
+    }
+    if (n != (ssize_t)sizeof(header)) {
+        return -1;
+    }
+    memcpy(&record->time_ns, header, sizeof(record->time_ns));
+    memcpy(&record->conn_id, header + 8, sizeof(record->conn_id));
+    record->direction = header[12] & ~TRANSPORT_CAPTURE_FD;
+    record->carried_fd = (header[12] & TRANSPORT_CAPTURE_FD) != 0;
+    if (record->direction == TRANSPORT_CAPTURE_CLOSED) {
+        return record->carried_fd ? -1 : 1;
+    }
+    if (record->direction > TRANSPORT_CAPTURE_CLOSED
+        || capture_read_full(fd, record->trama, BUFFER_SIZE) != BUFFER_SIZE) {
+        return -1;
+    }
+    return 1;
+}
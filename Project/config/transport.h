@@ -0,0 +1,76 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "connections.h"
+
+// Transporte de tramas de BUFFER_SIZE bytes. Cada conexión es un entero: un descriptor de socket (TCP o
+// Unix) o, a partir de TRANSPORT_MEM_BASE, un extremo de una conexión en memoria dentro del mismo proceso
+#define TRANSPORT_MEM_BASE (1 << 24)    // Primer identificador de las conexiones en memoria (no choca con descriptores)
+#define TRANSPORT_MEM_MAX 16384         // Extremos en memoria abiertos a la vez
+#define TRANSPORT_MEM_QUEUE 32          // Tramas en cola por sentido antes de bloquear al emisor
+
+// Captura de tramas: cabecera del archivo [8B magic][2B versión][2B BUFFER_SIZE][4B pid][8B inicio en ns
+// desde epoch] y, por cada trama enviada o recibida o conexión cerrada, un registro [8B ns monotónicos
+// desde el inicio][4B conexión][1B sentido] seguido de la trama de BUFFER_SIZE bytes (salvo en los
+// cierres). El sentido lleva TRANSPORT_CAPTURE_FD si la trama iba acompañada de un descriptor
+// (SCM_RIGHTS), que no queda en la captura. Enteros en el orden de bytes del equipo que captura
+#define TRANSPORT_CAPTURE_MAGIC "TRAMACAP"
+#define TRANSPORT_CAPTURE_VERSION 1
+#define TRANSPORT_CAPTURE_HEADER_SIZE 24
+#define TRANSPORT_CAPTURE_RECORD_SIZE 13
+#define TRANSPORT_CAPTURE_MAX_FDS 65536     // Descriptores con identificador de conexión propio
+#define TRANSPORT_CAPTURE_SENT 0
+#define TRANSPORT_CAPTURE_RECEIVED 1
+#define TRANSPORT_CAPTURE_CLOSED 2
+#define TRANSPORT_CAPTURE_FD 0x80      // Bit del sentido: la trama llevaba un descriptor
+
+// Operaciones de un transporte (mismo significado de retorno que write/recv/poll/close)
+typedef struct {
+    const char* name;
+    int (*send_frame)(int conn, const unsigned char* trama);    // BUFFER_SIZE en éxito, -1 en error
+    int (*recv_frame)(int conn, unsigned char* trama);          // BUFFER_SIZE, 0 si el otro extremo cerró, -1 en error
+    int (*peek_frame)(int conn, unsigned char* trama);          // Como recv_frame sin consumir ni esperar (-1 y EAGAIN si no hay trama entera)
+    int (*poll)(int conn, int timeout_ms);                      // >0 si hay trama (o cierre) por leer, 0 si timeout
+    int (*close)(int conn);
+} Transport;
+
+// Tramas enviadas y recibidas con éxito por un hilo (cada hilo tiene las suyas; otro hilo puede leerlas)
+typedef struct {
+    atomic_long frames_sent;
+    atomic_long frames_received;
+} TransportCounters;
+
+// Registro leído de un archivo de captura
+typedef struct {
+    uint64_t time_ns;                   // Desde el inicio de la captura (reloj monotónico)
+    uint32_t conn_id;                   // Identificador de la conexión (1, 2, ... en orden de aparición)
+    uint8_t direction;                  // TRANSPORT_CAPTURE_SENT, _RECEIVED o _CLOSED
+    uint8_t carried_fd;                 // 1 si la trama iba acompañada de un descriptor
+    unsigned char trama[BUFFER_SIZE];   // Sin usar en TRANSPORT_CAPTURE_CLOSED
+} CaptureRecord;
+
+extern const Transport transport_socket;
+extern const Transport transport_mem;
+
+
+const Transport* transport_of(int conn);
+int transport_send_frame(int conn, const unsigned char* trama);
+int transport_recv_frame(int conn, unsigned char* trama);
+int transport_send_frame_fd(int conn, unsigned char* trama, int fd);
+int transport_recv_frame_fd(int conn, unsigned char* trama, int* fd);
+int transport_peek_frame(int conn, unsigned char* trama);
+int transport_poll(int conn, int timeout_ms);
+int transport_close(int conn);
+int transport_is_mem(int conn);
+int transport_mem_pair(int conns[2]);
+TransportCounters* transport_thread_counters(void);
+int transport_capture_open(const char* path);
+void transport_capture_close(void);
+int transport_capture_read_header(int fd, uint64_t* start_ns);
+int transport_capture_read(int fd, CaptureRecord* record);
+
+#endif
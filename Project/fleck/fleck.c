@@ -2,6 +2,7 @@
 #include "../config/config.h"
 #include "flecklib.h"
 #include "../config/connections.h"
+#include "../config/transport.h"
 
 #include <stdio.h>
 #include <ctype.h>
@@ -10,13 +11,44 @@
 
 
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        printF("Uso: ./fleck <archivo_config>\n");
+    char* script_file = NULL;   // --script <archivo>: comandos leídos de un archivo
+    char* exec_commands = NULL; // --exec "cmd; cmd": comandos pasados por argumento
+    int json = 0;               // --json: una línea JSON por distorsión en stdout
+    char* capture_file = NULL;  // --capture <archivo>: captura de las tramas enviadas y recibidas
+
+    int valid_args = argc >= 2;
+    for (int i = 2; i < argc && valid_args; i++) {
+        if (strcmp(argv[i], "--script") == 0 && i + 1 < argc && script_file == NULL && exec_commands == NULL) {
+            script_file = argv[++i];
+        } else if (strcmp(argv[i], "--exec") == 0 && i + 1 < argc && script_file == NULL && exec_commands == NULL) {
+            exec_commands = argv[++i];
+        } else if (strcmp(argv[i], "--json") == 0) {
+            json = 1;
+        } else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc && capture_file == NULL) {
+            capture_file = argv[++i];
+        } else {
+            valid_args = 0;
+        }
+    }
+    if (!valid_args || (json && script_file == NULL && exec_commands == NULL)) {
+        printF("Uso: ./fleck <archivo_config> [--script <archivo> | --exec \"cmd; cmd\"] [--json] [--capture <archivo>]\n");
         return -1;
     }
 
+    // En modo JSON stdout queda reservado para los resultados: los mensajes van a stderr
+    int json_fd = -1;
+    if (json) {
+        json_fd = dup(STDOUT_FILENO);
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+    }
+
     signal(SIGINT, FLECK_signal_handler);
 
+    if (capture_file != NULL && transport_capture_open(capture_file) < 0) {
+        perror("Error al abrir el archivo de captura de tramas");
+        return -1;
+    }
+
     // Leer el archivo de configuración
     FleckConfig* config = FLECK_read_config(argv[1]);
     if (!config) {
@@ -44,6 +76,24 @@ int main(int argc, char *argv[]) {
     printF(output);
     free(output);
 
+    // Modo no interactivo: ejecutar los comandos y salir con el resultado
+    if (script_file != NULL || exec_commands != NULL) {
+        int ret;
+        if (script_file != NULL) {
+            ret = FLECK_run_script(config, script_file, json_fd);
+        } else {
+            char* commands = strdup(exec_commands);
+            ret = FLECK_run_commands(config, commands, json_fd);
+            free(commands);
+        }
+
+        free(config->username);
+        free(config->user_dir);
+        free(config->gotham_ip);
+        free(config);
+        return ret;
+    }
+
     // Ejecutar el menú de opciones
     FLECK_handle_menu(config);
 
@@ -77,13 +77,18 @@ FleckConfig* FLECK_read_config(const char *config_file) {
 
 /***********************************************
 *
-* @Finalitat: Gestionar senyal de sortida (SIGINT) imprimint missatge i sortint del procés.
+* @Finalitat: Gestionar senyal de sortida (SIGINT) imprimint missatge, bolcant els temps de les
+*             distorsions i sortint del procés.
 * @Parametres: ---
 * @Retorn: ---
 *
 ************************************************/
 void FLECK_signal_handler() {
     printF("\nSaliendo del programa...\n");
+
+    // Volcar los tiempos de las distorsiones realizadas
+    timings_print(&fleck_timings, 1);
+
     // Salir del programa
     signal(SIGINT, SIG_DFL);
     raise(SIGINT);
@@ -101,35 +106,16 @@ void FLECK_signal_handler() {
 int FLECK_connect_to_gotham(FleckConfig *config) {
     printF("Iniciando conexión de Fleck con Gotham...\n");
 
-    // Crear socket
-    int sock_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock_fd < 0) {
-        perror("Error al crear el socket");
-        return -1;
-    }
-
-    // Configurar la dirección de Gotham
-    struct sockaddr_in gotham_addr;
-    gotham_addr.sin_family = AF_INET;
-    gotham_addr.sin_port = config->gotham_port;
-
     // Eliminar caracteres invisibles de la IP
     eliminar_caracteres(config->gotham_ip); // Asegurarnos de limpiar la IP
 
     // DEBUGGING: Imprimir la IP después de limpiarla
     // printf("Conectando a Gotham en IP: '%s', Puerto: %d\n", config->gotham_ip, config->gotham_port);
 
-    // Convertir IP de Gotham
-    if (inet_pton(AF_INET, config->gotham_ip, &gotham_addr.sin_addr) <= 0) {
-        perror("Dirección IP de Gotham no válida");
-        close(sock_fd);
-        return -1;
-    }
-
-    // Conectar con Gotham
-    if (connect(sock_fd, (struct sockaddr *)&gotham_addr, sizeof(gotham_addr)) < 0) {
-        perror("Error al conectar con Gotham");
-        close(sock_fd);
+    // Conectar con Gotham (IP y puerto, o unix:/ruta si está en el mismo host)
+    int sock_fd = connect_to_server(config->gotham_ip, config->gotham_port);
+    if (sock_fd < 0) {
+        perror(errno == EINVAL ? "Dirección IP de Gotham no válida" : "Error al conectar con Gotham");
         return -1;
     }
 
@@ -143,7 +129,7 @@ int FLECK_connect_to_gotham(FleckConfig *config) {
     unsigned char *trama = crear_trama(TYPE_CONNECT_FLECK_GOTHAM, (unsigned char*)data, strlen(data)); // Crear trama con TYPE = 0x01
     if (trama == NULL) {
         perror("Error al crear la trama");
-        close(sock_fd);
+        transport_close(sock_fd);
         return -1;
     }
 
@@ -151,10 +137,10 @@ int FLECK_connect_to_gotham(FleckConfig *config) {
     // printf("Trama enviada: TYPE=0x%02x, DATA=%s\n", trama[0], &trama[3]);
 
     // Enviar trama a Gotham
-    if (write(sock_fd, trama, BUFFER_SIZE) < 0) {
+    if (transport_send_frame(sock_fd, trama) < 0) {
         perror("Error enviando trama a Gotham");
         free(trama);
-        close(sock_fd);
+        transport_close(sock_fd);
         return -1;
     }
 
@@ -162,17 +148,17 @@ int FLECK_connect_to_gotham(FleckConfig *config) {
 
     // Leer respuesta de Gotham
     unsigned char response[BUFFER_SIZE];
-    int bytes_read = read(sock_fd, response, BUFFER_SIZE);
+    int bytes_read = transport_recv_frame(sock_fd, response);
     if (bytes_read <= 0) {
         perror("Error leyendo respuesta de Gotham");
-        close(sock_fd);
+        transport_close(sock_fd);
         return -1;
     }
 
     TramaResult *result = leer_trama(response); // Procesar la respuesta recibida
     if (result == NULL) {
         printF("Error en la trama recibida de Gotham.\n");
-        close(sock_fd);
+        transport_close(sock_fd);
         return -1;
     }
 
@@ -187,7 +173,7 @@ int FLECK_connect_to_gotham(FleckConfig *config) {
         printF(buffer);
 
         free_tramaResult(result);
-        close(sock_fd);
+        transport_close(sock_fd);
         return -1;
     }
     
@@ -198,12 +184,12 @@ int FLECK_connect_to_gotham(FleckConfig *config) {
     } else if (strcmp(result->data, "CON_KO") == 0) {
         printF("Conexión rechazada por Gotham.\n");
         free_tramaResult(result);
-        close(sock_fd);
+        transport_close(sock_fd);
         return -1;
     } else {
         printF("Respuesta desconocida de Gotham.\n");
         free_tramaResult(result);
-        close(sock_fd);
+        transport_close(sock_fd);
         return -1;
     }
     */
@@ -211,6 +197,69 @@ int FLECK_connect_to_gotham(FleckConfig *config) {
 
 }
 
+/***********************************************
+*
+* @Finalitat: Demanar a Gotham els seus comptadors d’estadístiques (trama TYPE_STATS) i mostrar-los per pantalla.
+* @Parametres:
+*   in: socket_gotham = descriptor del socket amb Gotham.
+* @Retorn: 1 en èxit, -1 en error.
+*
+************************************************/
+int FLECK_request_stats(int socket_gotham) {
+    const char* labels[] = {
+        "Comandos CONNECT", "Peticiones DISTORT", "Respuestas DISTORT_KO", "Respuestas MEDIA_KO",
+        "Failovers", "Heartbeats enviados", "Heartbeats perdidos", "Flecks conectados", "Workers registrados",
+        "Respuestas DISTORT_BUSY", "DISTORT al Worker afín", "DISTORT desviados",
+        "Distorsiones en curso", "Distorsiones perdidas", "Respuestas DISTORT_LIMIT", NULL
+    };
+
+    unsigned char *trama = crear_trama(TYPE_STATS, (unsigned char*)"", strlen(""));
+    if (trama == NULL) {
+        return -1;
+    }
+    // Petición y respuesta bajo el lock del socket con Gotham (puede haber distorsiones en curso)
+    pthread_mutex_lock(&gotham_mutex);
+    if (transport_send_frame(socket_gotham, trama) < 0) {
+        pthread_mutex_unlock(&gotham_mutex);
+        perror("Error enviando petición de estadísticas a Gotham");
+        free(trama);
+        return -1;
+    }
+    free(trama);
+
+    // Leer respuesta de Gotham
+    unsigned char response[BUFFER_SIZE];
+    int bytes_read = transport_recv_frame(socket_gotham, response);
+    pthread_mutex_unlock(&gotham_mutex);
+    if (bytes_read <= 0) {
+        perror("Error leyendo estadísticas de Gotham");
+        return -1;
+    }
+
+    TramaResult *result = leer_trama(response);
+    if (result == NULL || result->type != TYPE_STATS) {
+        printF("Respuesta de estadísticas inesperada de Gotham.\n");
+        if (result) free_tramaResult(result);
+        return -1;
+    }
+
+    // Formato: <connects>&<distort>&<distort_ko>&<media_ko>&<failovers>&<hb_sent>&<hb_missed>&<flecks>&<workers>&<busy>&<hits>&<spills>&<in_flight>&<lost>&<limited>
+    char* buffer;
+    printF("\n========= ESTADÍSTICAS GOTHAM =========\n\n");
+    char* saveptr = NULL;
+    char* value = strtok_r(result->data, "&", &saveptr);
+    for (int i = 0; labels[i] != NULL && value != NULL; i++) {
+        asprintf(&buffer, "%-22s %s\n", labels[i], value);
+        printF(buffer);
+        free(buffer);
+        value = strtok_r(NULL, "&", &saveptr);
+    }
+    printF("\n=======================================\n\n");
+
+    free_tramaResult(result);
+    return 1;
+}
+
 /***********************************************
 *
 * @Finalitat: Mostrar per pantalla l’estat de distorsió dels workers de tipus Text i Media.
@@ -261,250 +310,502 @@ void mostrar_estado_workers(WorkerFleck* worker_text, WorkerFleck* worker_media,
 
 /***********************************************
 *
-* @Finalitat: Processar el menú interactiu de Fleck, acceptant i executant comandes: connect,
-*             list, distort, check status, clear, logout.
+* @Finalitat: Fil d’una distorsió en mode script: executa la distorsió i marca l’instant en què acaba
+*             (el resultat sobreviu a DistortInfo, que s’allibera dins de handle_distort_worker).
 * @Parametres:
-*   in: config = punter a FleckConfig amb dades de sessió.
+*   in: arg = punter a DistortInfo amb 'job' inicialitzat.
+* @Retorn: NULL al finalitzar.
+*
+************************************************/
+static void* run_scripted_distort(void* arg) {
+    FleckJob* job = ((DistortInfo*)arg)->job;
+
+    handle_distort_worker(arg);
+    job->end_ns = timings_now_ns();
+    return NULL;
+}
+
+/***********************************************
+*
+* @Finalitat: Tancar una distorsió acabada en mode script: comptar-la com a correcta o fallida i
+*             escriure la seva línia JSON si està activada.
+* @Parametres:
+*   in/out: session = sessió de Fleck.
+*   in:     job     = resultat de la distorsió (s’allibera).
 * @Retorn: ---
 *
 ************************************************/
-void FLECK_handle_menu(FleckConfig *config) {
-    char input[64];     // Establecemos que el máximo de caracteres que se pueden introducir por terminal son 64
+static void finish_scripted_job(FleckSession* session, FleckJob* job) {
+    if (job->end_ns == 0) job->end_ns = timings_now_ns();
+
+    if (job->ok) session->jobs_ok++;
+    else session->jobs_failed++;
+
+    if (session->json_fd >= 0) {
+        print_fleck_job_json(job, session->json_fd);
+    }
+    freeFleckJob(job);
+}
+
+/***********************************************
+*
+* @Finalitat: Esperar (mode script) que acabi la distorsió en curs d’un tipus, si n’hi ha.
+* @Parametres:
+*   in/out: session    = sessió de Fleck.
+*   in:     media_type = TEXT o MEDIA.
+* @Retorn: ---
+*
+************************************************/
+static void wait_scripted_distort(FleckSession* session, const char* media_type) {
+    int is_media = strcmp(media_type, MEDIA) == 0;
+    FleckJob** job = is_media ? &session->job_media : &session->job_text;
+
+    if (*job == NULL) return;
+
+    pthread_join(is_media ? session->thread_media : session->thread_text, NULL);
+    finish_scripted_job(session, *job);
+    *job = NULL;
+}
+
+/***********************************************
+*
+* @Finalitat: Esperar (mode script) que acabin totes les distorsions en curs.
+* @Parametres:
+*   in/out: session = sessió de Fleck.
+* @Retorn: ---
+*
+************************************************/
+void FLECK_wait_distortions(FleckSession* session) {
+    wait_scripted_distort(session, TEXT);
+    wait_scripted_distort(session, MEDIA);
+}
+
+/***********************************************
+*
+* @Finalitat: Inicialitzar l’estat d’una sessió de Fleck.
+* @Parametres:
+*   out: session  = sessió a inicialitzar.
+*   in:  config   = configuració de Fleck.
+*   in:  scripted = 1 en mode no interactiu (--script/--exec).
+*   in:  json_fd  = descriptor per a la sortida JSON (-1 si no s’utilitza).
+* @Retorn: ---
+*
+************************************************/
+void FLECK_init_session(FleckSession* session, FleckConfig* config, int scripted, int json_fd) {
+    memset(session, 0, sizeof(FleckSession));
+    session->config = config;
+    session->socket_gotham = -1;
+    session->scripted = scripted;
+    session->json_fd = json_fd;
+}
+
+/***********************************************
+*
+* @Finalitat: Executar la comanda distort: demanar Worker a Gotham i llançar el fil de distorsió.
+*             En mode interactiu es cancel·la si ja hi ha una distorsió del mateix tipus en curs;
+*             en mode script s’espera que acabi.
+* @Parametres:
+*   in/out: session = sessió de Fleck.
+*   in/out: saveptr = estat de strtok_r de la línia de comanda (després del nom de la comanda).
+* @Retorn: FLECK_CMD_OK o FLECK_CMD_ERROR.
+*
+************************************************/
+static int execute_distort(FleckSession* session, char** saveptr) {
+    if (session->socket_gotham == -1) {
+        printF("No estás conectado a Gotham. Usa el comando 'connect' primero.\n");
+        return FLECK_CMD_ERROR;
+    }
+
+    // Parsear partes comando separadas por espacios
+    char* filename = strtok_r(NULL, " \t\n", saveptr);
+    char* factor = strtok_r(NULL, " \t\n", saveptr);
+    char* priority_str = strtok_r(NULL, " \t\n", saveptr);    // Opcional
+    char* extra = strtok_r(NULL, " \t\n", saveptr);
+    int priority = (priority_str != NULL) ? atoi(priority_str) : 0;
+    if (filename == NULL || factor == NULL || extra != NULL || priority < 0 || priority > SCHED_MAX_PRIORITY
+        || (priority_str != NULL && !isdigit((unsigned char)priority_str[0]))) {
+        printF("Commando Incorrecto.\n");
+        printF("Uso: distort <filename> <factor> [<prioridad 0-9>]\n");
+        return FLECK_CMD_ERROR;
+    }
+    printF("Command OK\n");
+
+    // Obtener tipo de media del archivo
+    char* mediaType = file_type(filename);
+    if (mediaType == NULL) {
+        printF("Cancelando: Media type no reconocido.\n");
+        return FLECK_CMD_ERROR;
+    }
+
+    int is_media = strcmp(mediaType, MEDIA) == 0;
+    if (session->scripted) {
+        wait_scripted_distort(session, mediaType);
+    }
+    WorkerFleck** worker = is_media ? &session->worker_media : &session->worker_text;
+    if (*worker != NULL) {
+        printF(is_media ? "Cancelando: Ya hay una distorsión 'Media' en curso.\n"
+                        : "Cancelando: Ya hay una distorsión 'Text' en curso.\n");
+        return FLECK_CMD_ERROR;
+    }
+
+    DistortInfo* distortInfo = (DistortInfo *)malloc(sizeof(DistortInfo));
+    if (distortInfo == NULL) {
+        perror("Failed to allocate memory for distortInfo");
+        return FLECK_CMD_ERROR;
+    }
+    distortInfo->flag_distort_text_finished = &session->flag_distort_text_finished;
+    distortInfo->flag_distort_media_finished = &session->flag_distort_media_finished;
+    distortInfo->socket_gotham = session->socket_gotham; // Guardamos el socket de conexión con Gotham
+    distortInfo->gotham_job = 0;
+    distortInfo->job_done = 0;
+    distortInfo->priority = priority;
+    distortInfo->worker_ptr = worker;    // Sigue a NULL si Gotham no asigna Worker
+    distortInfo->username = strdup(session->config->username);
+    distortInfo->user_dir = strdup(session->config->user_dir);
+    distortInfo->filename = strdup(filename);
+    distortInfo->distortion_factor = strdup(factor);
+    distortInfo->job = session->scripted ? newFleckJob(filename, factor, mediaType) : NULL;
+
+    // Pedir el tipo concreto (Text, Image o Audio) para que Gotham escoja la clase de Workers adecuada
+    char* kind = is_media ? wich_media(filename) : TEXT;
+    if (kind == NULL) {
+        kind = MEDIA;
+    }
+
+    FleckJob* job = distortInfo->job;
+    if (request_distort_gotham(session->socket_gotham, kind, worker, distortInfo) <= 0) {
+        perror("Error solicitando distort a Gotham.\n");
+        freeDistortInfo(distortInfo);
+        if (job != NULL) finish_scripted_job(session, job);
+        return FLECK_CMD_OK;    // El comando es correcto: el trabajo cuenta como fallido
+    }
+
+    // Crear hilo para la distorsión
+    pthread_t thread_id;
+    if (pthread_create(&thread_id, NULL, session->scripted ? run_scripted_distort : handle_distort_worker, (void*)distortInfo) != 0) {
+        perror("Error al crear el hilo");
+        freeDistortInfo(distortInfo);
+        if (job != NULL) finish_scripted_job(session, job);
+        return FLECK_CMD_ERROR;
+    }
+
+    if (session->scripted) {
+        if (is_media) {
+            session->thread_media = thread_id;
+            session->job_media = job;
+        } else {
+            session->thread_text = thread_id;
+            session->job_text = job;
+        }
+    }
+    return FLECK_CMD_OK;
+}
+
+/***********************************************
+*
+* @Finalitat: Enviar la desconnexió a Gotham i tancar el socket.
+* @Parametres:
+*   in/out: session = sessió de Fleck.
+* @Retorn: ---
+*
+************************************************/
+static void logout_gotham(FleckSession* session) {
+    // Cerrar las conexiones persistentes con los Workers
+    FLECK_pool_close_all();
+
+    if (session->socket_gotham < 0) {
+        printF("No estás conectado a Gotham.\n");
+        return;
+    }
+
+    unsigned char *trama = crear_trama(TYPE_DISCONNECTION, (unsigned char*)"LOGOUT", strlen("LOGOUT"));
+    pthread_mutex_lock(&gotham_mutex);
+    int sent = transport_send_frame(session->socket_gotham, trama);
+    pthread_mutex_unlock(&gotham_mutex);
+    if (sent < 0) {
+        if (trama == 0) {
+            printF("Gotham se desconectó.\n");
+        } else {
+            perror("Error enviando comando de logout a Gotham");
+        }
+
+    } else {
+        printF("Desconexión enviada a Gotham.\n");
+        free(trama);
+        transport_close(session->socket_gotham);
+        session->socket_gotham = -1;
+    }
+}
+
+/***********************************************
+*
+* @Finalitat: Executar una comanda de Fleck: connect, list, distort, stats, check status [--timings],
+*             clear all, logout.
+* @Parametres:
+*   in/out: session = sessió de Fleck.
+*   in/out: line    = línia amb la comanda (es modifica en separar-la en paraules).
+* @Retorn: FLECK_CMD_OK, FLECK_CMD_ERROR si la comanda és incorrecta o falla, o FLECK_CMD_EXIT amb logout.
+*
+************************************************/
+int FLECK_execute_command(FleckSession* session, char* line) {
     char* buffer = NULL;
 
-    WorkerFleck* worker_text = NULL;
-    WorkerFleck* worker_media = NULL;
+    // Eliminar espacios adicionales y obtener el comando principal
+    char *saveptr = NULL;
+    char *cmd = strtok_r(line, " \t\n", &saveptr);
+    if (cmd == NULL) return FLECK_CMD_OK;
 
-    int flag_distort_text_finished = 0; // Indica si hay una distorsión de tipo Text acabada
-    int flag_distort_media_finished = 0; // Indica si hay una distorsión de tipo Media acabada
-    
-    int socket_gotham = -1; // Socket de conexión con Gotham
+    // Convertir el comando a minúsculas
+    for (int i = 0; cmd[i]; i++) {
+        cmd[i] = tolower(cmd[i]);
+    }
 
-    // pthread_t heartbeat_thread; // Hilo para el heartbeat
+    // CONNECT
+    if (strcmp(cmd, "connect") == 0) {
+        char *arg = strtok_r(NULL, " \t\n", &saveptr);
+        if (arg != NULL) {
+            printF("Unknown command\n");
+            return FLECK_CMD_ERROR;
+        }
+        printF("Command OK\n");
+
+        if (session->socket_gotham != -1) {
+            printF("Ya estás conectado a Gotham.\n");
+            return FLECK_CMD_OK;
+        }
+        session->socket_gotham = FLECK_connect_to_gotham(session->config);
+        if (session->socket_gotham < 0) {
+            printF("Error al conectar Fleck con Gotham.\n");
+            session->socket_gotham = -1;
+            return FLECK_CMD_ERROR;
+        }
+        // CONEXION EXITOSA
+        printF("Conexión establecida con Gotham.\n");
+        return FLECK_CMD_OK;
+
+    // LIST
+    } else if (strcmp(cmd, "list") == 0) {
+        char *arg = strtok_r(NULL, " \t\n", &saveptr);
+        if (!arg || (strcasecmp(arg, "media") != 0 && strcasecmp(arg, "text") != 0)) {
+            printF("Command KO\n");
+            printF("Uso: list <media|text>\n");
+            return FLECK_CMD_ERROR;
+        }
+        if (strtok_r(NULL, " \t\n", &saveptr) != NULL) {
+            printF("Unknown command\n");
+            return FLECK_CMD_ERROR;
+        }
+
+        if (strcasecmp(arg, "media") == 0) {
+            asprintf(&buffer, "Listando archivos multimedia en el directorio %s:\n", session->config->user_dir);
+            printF(buffer);
+            free(buffer);
+            list_files(session->config->user_dir, ".wav");
+            list_files(session->config->user_dir, ".jpg");
+            list_files(session->config->user_dir, ".png");
+        } else {
+            asprintf(&buffer, "Listando archivos de texto en el directorio %s:\n", session->config->user_dir);
+            printF(buffer);
+            free(buffer);
+            list_files(session->config->user_dir, ".txt");
+        }
+        return FLECK_CMD_OK;
+
+    // DISTORT
+    } else if (strcmp(cmd, "distort") == 0) {
+        return execute_distort(session, &saveptr);
+
+    // STATS
+    } else if (strcmp(cmd, "stats") == 0) {
+        if (strtok_r(NULL, " \t\n", &saveptr) != NULL) {
+            printF("Unknown command\n");
+            return FLECK_CMD_ERROR;
+        }
+        if (session->socket_gotham == -1) {
+            printF("No estás conectado a Gotham. Usa el comando 'connect' primero.\n");
+            return FLECK_CMD_ERROR;
+        }
+        printF("Command OK\n");
+        return (FLECK_request_stats(session->socket_gotham) > 0) ? FLECK_CMD_OK : FLECK_CMD_ERROR;
+
+    // CHECK STATUS
+    } else if (strcmp(cmd, "check") == 0) {
+        char *arg = strtok_r(NULL, " \t\n", &saveptr);
+        if (!arg || strcasecmp(arg, "status") != 0) {
+            printF("Command KO\n");
+            return FLECK_CMD_ERROR;
+        }
+
+        char *extra = strtok_r(NULL, " \t\n", &saveptr);
+        if (extra == NULL) {
+            printF("Command OK\n");
+            mostrar_estado_workers(session->worker_text, session->worker_media,
+                                   session->flag_distort_text_finished, session->flag_distort_media_finished);
+        } else if (strcasecmp(extra, "--timings") == 0 && strtok_r(NULL, " \t\n", &saveptr) == NULL) {
+            printF("Command OK\n");
+            mostrar_estado_workers(session->worker_text, session->worker_media,
+                                   session->flag_distort_text_finished, session->flag_distort_media_finished);
+            timings_print(&fleck_timings, 1);
+        } else {
+            printF("Unknown command\n");
+            return FLECK_CMD_ERROR;
+        }
+        return FLECK_CMD_OK;
+
+    // CLEAR
+    } else if (strcmp(cmd, "clear") == 0) {
+        char *arg = strtok_r(NULL, " \t\n", &saveptr);
+        if (!arg || strcasecmp(arg, "all") != 0) {
+            printF("Command KO\n");
+            return FLECK_CMD_ERROR;
+        }
+        if (strtok_r(NULL, " \t\n", &saveptr) != NULL) {
+            printF("Unknown command\n");
+            return FLECK_CMD_ERROR;
+        }
+        printF("Command OK\n");
+        session->flag_distort_text_finished = 0;
+        session->flag_distort_media_finished = 0;
+        return FLECK_CMD_OK;
+
+    // LOGOUT
+    } else if (strcmp(cmd, "logout") == 0) {
+        if (strtok_r(NULL, " \t\n", &saveptr) != NULL) {
+            printF("Unknown command\n");
+            return FLECK_CMD_ERROR;
+        }
+        printF("Thanks for using Mr. J System, see you soon, chaos lover :)\n");
+
+        // En modo script las distorsiones en curso todavía usan la conexión con Gotham (caídas de Worker)
+        if (session->scripted) {
+            FLECK_wait_distortions(session);
+        }
+        logout_gotham(session);
+        return FLECK_CMD_EXIT;
+    }
+
+    printF("Unknown command\n");
+    //printF("Comando desconocido. Intenta 'connect', 'distort', 'list', o 'logout'.\n");
+    return FLECK_CMD_ERROR;
+}
+
+/***********************************************
+*
+* @Finalitat: Processar el menú interactiu de Fleck, llegint comandes de l’entrada estàndard.
+* @Parametres:
+*   in: config = punter a FleckConfig amb dades de sessió.
+* @Retorn: ---
+*
+************************************************/
+void FLECK_handle_menu(FleckConfig *config) {
+    char input[64];     // Establecemos que el máximo de caracteres que se pueden introducir por terminal son 64
+    FleckSession session;
+    FLECK_init_session(&session, config, 0, -1);
 
     while (1) {
         printF("\n$ ");
 
         ssize_t bytes_read = read(0, input, 64-1);  // Leer input del usuario
+        if (bytes_read <= 0) {
+            bytes_read = 0;
+        }
         input[bytes_read] = '\0';
 
-        // Eliminar espacios adicionales y obtener el comando principal
-        char *cmd = strtok(input, " \t\n");
-        if (cmd == NULL) continue;
-
-        // Convertir el comando a minúsculas
-        for (int i = 0; cmd[i]; i++) {
-            cmd[i] = tolower(cmd[i]);
+        if (FLECK_execute_command(&session, input) == FLECK_CMD_EXIT) {
+            raise(SIGINT);
+            break;  // Salir del bucle y desconectar
         }
+    }
+}
 
-        // CONNECT
-        if (strcmp(cmd, "connect") == 0) {
-            char *arg = strtok(NULL, " \t\n");
-            if (arg == NULL) {
-                printF("Command OK\n");
-
-                if (socket_gotham == -1) {
-                    socket_gotham = FLECK_connect_to_gotham(config);
-                    if (socket_gotham < 0) {
-                        printF("Error al conectar Fleck con Gotham.\n");
-                        socket_gotham = -1;
-                    } else {
-                        // CONEXION EXITOSA
-                        printF("Conexión establecida con Gotham.\n");
-                        // if (pthread_create(&heartbeat_thread, NULL, handle_cierre_gotham, (void*)&socket_gotham) != 0) {
-                        //     perror("Error al crear el hilo de heartbeat");
-                        //     close(socket_gotham);
-                        //     socket_gotham = -1;
-                        // }
-                    }
-                } else {
-                    printF("Ya estás conectado a Gotham.\n");
-                }
-
-            } else {
-                printF("Unknown command\n");
-            }
-
-        // LIST
-        } else if (strcmp(cmd, "list") == 0) {
-            char *arg = strtok(NULL, " \t\n");
-            if (arg && (strcasecmp(arg, "media") == 0 || strcasecmp(arg, "text") == 0)) {
-                char *extra = strtok(NULL, " \t\n");
-                if (extra == NULL) {
-                    if (strcasecmp(arg, "media") == 0) {
-                        asprintf(&buffer, "Listando archivos multimedia en el directorio %s:\n", config->user_dir);
-                        printF(buffer);
-                        free(buffer);
-                        list_files(config->user_dir, ".wav");
-                        list_files(config->user_dir, ".jpg");
-                        list_files(config->user_dir, ".png");
-                    } else {
-                        asprintf(&buffer, "Listando archivos de texto en el directorio %s:\n", config->user_dir);
-                        printF(buffer);
-                        free(buffer);
-                        list_files(config->user_dir, ".txt");
-                    }
-                } else {
-                    printF("Unknown command\n");
-                }
-            } else {
-                printF("Command KO\n");
-                printF("Uso: list <media|text>\n");
-            }
-
-
-        // DISTORT
-        } else if (strcmp(cmd, "distort") == 0) {
-            
-            if (socket_gotham == -1) {
-                printF("No estás conectado a Gotham. Usa el comando 'connect' primero.\n");
-                continue;   // Pasamos a la siguiente iteración del bucle
-            }
-
-            // Parsear partes comando separadas por espacios
-            DistortInfo* distortInfo = (DistortInfo *)malloc(sizeof(DistortInfo));
-            if (distortInfo == NULL) {
-                perror("Failed to allocate memory for distortInfo");
-                continue;
-            }
-
-            distortInfo->filename = NULL;
-            distortInfo->distortion_factor = NULL;
-            distortInfo->flag_distort_text_finished = &flag_distort_text_finished; 
-            distortInfo->flag_distort_media_finished = &flag_distort_media_finished;
-            distortInfo->socket_gotham = socket_gotham; // Guardamos el socket de conexión con Gotham
-            distortInfo->username = strdup(config->username);
-            distortInfo->user_dir = strdup(config->user_dir);
-            distortInfo->filename = strdup(strtok(NULL, " \t\n"));
-            distortInfo->distortion_factor = strdup(strtok(NULL, " \t\n"));
-            char *extra = strtok(NULL, " \t\n");
-
-            if (distortInfo->filename && distortInfo->distortion_factor && extra == NULL) {
-                printF("Command OK\n");
-
-                // Obtener tipo de media del archivo
-                char* mediaType = file_type(distortInfo->filename);
-                if (mediaType == NULL) {
-                    printF("Cancelando: Media type no reconocido.\n");
-                    freeDistortInfo(distortInfo); 
-                    continue;
-                }
-
-                if (strcmp(mediaType, MEDIA) == 0 && worker_media != NULL)
-                {
-                    printF("Cancelando: Ya hay una distorsión 'Media' en curso.\n");
-                    freeDistortInfo(distortInfo);
-                    continue;
-                } else if (strcmp(mediaType, TEXT) == 0 && worker_text != NULL)
-                {
-                    printF("Cancelando: Ya hay una distorsión 'Text' en curso.\n");
-                    freeDistortInfo(distortInfo);
-                    continue;
-                } 
-
-                pthread_t thread_id;
-                // Crear hilo para enviar solicitud distort
-                if (strcmp(mediaType, MEDIA) == 0)
-                {
-                    if (request_distort_gotham(socket_gotham, mediaType, &worker_media, distortInfo) > 0)
-                    {
-                        if (pthread_create(&thread_id, NULL, handle_distort_worker, (void*)distortInfo) != 0) {
-                            perror("Error al crear el hilo");
-                        }
-                    } else {
-                        perror("Error solicitando distort a Gotham.\n");
-                        freeDistortInfo(distortInfo);
-                        continue;
-                    }
-                } else if (strcmp(mediaType, TEXT) == 0)
-                {
-                    if (request_distort_gotham(socket_gotham, mediaType, &worker_text, distortInfo) > 0)
-                    {
-                        if (pthread_create(&thread_id, NULL, handle_distort_worker, (void*)distortInfo) != 0) {
-                            perror("Error al crear el hilo");
-                        }
-                    } else {
-                        perror("Error solicitando distort a Gotham.\n");
-                        freeDistortInfo(distortInfo);
-                        continue;
-                    }
-                }
-                
-
-            } else {
-                freeDistortInfo(distortInfo); // Liberar memoria si los argumentos son incorrectos
-                printF("Commando Incorrecto.\n");
-                printF("Uso: distort <filename> <factor>\n");
-            }
-
-        // CHECK STATUS
-        } else if (strcmp(cmd, "check") == 0) {
-            char *arg = strtok(NULL, " \t\n");
-            if (arg && strcasecmp(arg, "status") == 0) {
-                char *extra = strtok(NULL, " \t\n");
-                if (extra == NULL) {
-                    printF("Command OK\n");
-                    mostrar_estado_workers(worker_text, worker_media, flag_distort_text_finished, flag_distort_media_finished);
-                } else {
-                    printF("Unknown command\n");
-                }
-            } else {
-                printF("Command KO\n");
-            }
-
-        // CLEAR
-        } else if (strcmp(cmd, "clear") == 0) {
-            char *arg = strtok(NULL, " \t\n");
-            if (arg && strcasecmp(arg, "all") == 0) {
-                char *extra = strtok(NULL, " \t\n");
-                if (extra == NULL) {
-                    printF("Command OK\n");
-                    flag_distort_text_finished = 0;
-                    flag_distort_media_finished = 0;
-                } else {
-                    printF("Unknown command\n");
-                }
-            } else {
-                printF("Command KO\n");
-            }
-
-        // LOGOUT
-        } else if (strcmp(cmd, "logout") == 0) {
-            char *arg = strtok(NULL, " \t\n");
-            if (arg == NULL) {
-                printF("Thanks for using Mr. J System, see you soon, chaos lover :)\n");
-
-                if (socket_gotham >= 0) {
-                    unsigned char *trama = crear_trama(TYPE_DISCONNECTION, (unsigned char*)"LOGOUT", strlen("LOGOUT"));
-                    if (send(socket_gotham, trama, BUFFER_SIZE, 0) < 0) {
-                        if (trama == 0) {
-                            printF("Gotham se desconectó.\n");
-                        } else {
-                            perror("Error enviando comando de logout a Gotham");
-                        }
-
-                    } else {
-                        printF("Desconexión enviada a Gotham.\n");
-                        free(trama);
-                        // pthread_cancel(heartbeat_thread);
-                        close(socket_gotham);
-                        socket_gotham = -1;
-                    }
-
-                } else {
-                    printF("No estás conectado a Gotham.\n");
-                }
-
-                raise(SIGINT); 
-                break;  // Salir del bucle y desconectar
-            } else {
-                printF("Unknown command\n");
-            }
+/***********************************************
+*
+* @Finalitat: Executar Fleck sense menú: executa les comandes una darrere l’altra (un ';' o un salt
+*             de línia les separa, '#' inicia un comentari), espera les distorsions pendents i fa
+*             logout si la seqüència no ho ha fet.
+* @Parametres:
+*   in: config   = configuració de Fleck.
+*   in: commands = text amb les comandes (es modifica).
+*   in: json_fd  = descriptor on escriure una línia JSON per distorsió (-1 per no fer-ho).
+* @Retorn: 0 si totes les comandes i distorsions han anat bé, 1 en cas contrari.
+*
+************************************************/
+int FLECK_run_commands(FleckConfig* config, char* commands, int json_fd) {
+    FleckSession session;
+    FLECK_init_session(&session, config, 1, json_fd);
+
+    int exit_requested = 0;
+    char* save_ptr = NULL;
+    for (char* line = strtok_r(commands, ";\n", &save_ptr); line != NULL && !exit_requested;
+         line = strtok_r(NULL, ";\n", &save_ptr)) {
+
+        while (isspace((unsigned char)*line)) line++;
+        if (*line == '\0' || *line == '#') continue;
+
+        char* echo;
+        asprintf(&echo, "\n$ %s\n", line);
+        printF(echo);
+        free(echo);
+
+        int ret = FLECK_execute_command(&session, line);
+        if (ret == FLECK_CMD_ERROR) session.commands_failed++;
+        if (ret == FLECK_CMD_EXIT) exit_requested = 1;
+    }
 
-        } else {
-            printF("Unknown command\n");
-            //printF("Comando desconocido. Intenta 'connect', 'distort', 'list', o 'logout'.\n");
+    if (!exit_requested) {
+        FLECK_wait_distortions(&session);
+        if (session.socket_gotham >= 0) {
+            logout_gotham(&session);
         }
     }
+
+    char* summary;
+    asprintf(&summary, "\nDistorsiones correctas: %d, fallidas: %d, comandos incorrectos: %d\n",
+             session.jobs_ok, session.jobs_failed, session.commands_failed);
+    printF(summary);
+    free(summary);
+
+    return (session.jobs_failed == 0 && session.commands_failed == 0) ? 0 : 1;
 }
 
+/***********************************************
+*
+* @Finalitat: Llegir un fitxer de comandes i executar-lo amb FLECK_run_commands.
+* @Parametres:
+*   in: config      = configuració de Fleck.
+*   in: script_file = ruta del fitxer de comandes.
+*   in: json_fd     = descriptor per a la sortida JSON (-1 per no fer-ho).
+* @Retorn: Codi de sortida (0 si tot ha anat bé, 1 si no).
+*
+************************************************/
+int FLECK_run_script(FleckConfig* config, const char* script_file, int json_fd) {
+    int fd = open(script_file, O_RDONLY);
+    if (fd < 0) {
+        perror("Error abriendo el script de comandos");
+        return 1;
+    }
+
+    // Leer el script entero (una línea por comando)
+    char* commands = NULL;
+    size_t length = 0;
+    char* line;
+    while ((line = read_until(fd, '\n')) != NULL) {
+        size_t line_length = strlen(line);
+        commands = realloc(commands, length + line_length + 2);
+        memcpy(commands + length, line, line_length);
+        length += line_length;
+        commands[length++] = '\n';
+        commands[length] = '\0';
+        free(line);
+    }
+    close(fd);
+
+    if (commands == NULL) {
+        printF("El script de comandos está vacío.\n");
+        return 1;
+    }
+
+    int ret = FLECK_run_commands(config, commands, json_fd);
+    free(commands);
+    return ret;
+}
@@ -11,12 +11,25 @@
 
 #include "structures.h"
 
+// Resultado de ejecutar un comando de Fleck
+#define FLECK_CMD_OK 0
+#define FLECK_CMD_ERROR -1
+#define FLECK_CMD_EXIT 1
+
 FleckConfig* FLECK_read_config(const char *config_file);
 
+void FLECK_init_session(FleckSession* session, FleckConfig* config, int scripted, int json_fd);
+int FLECK_execute_command(FleckSession* session, char* line);
+void FLECK_wait_distortions(FleckSession* session);
+
 void FLECK_handle_menu(FleckConfig *config);
+int FLECK_run_commands(FleckConfig* config, char* commands, int json_fd);
+int FLECK_run_script(FleckConfig* config, const char* script_file, int json_fd);
 
 int FLECK_connect_to_gotham(FleckConfig *config);
 
+int FLECK_request_stats(int socket_gotham);
+
 void FLECK_signal_handler();
 
 #endif
\ No newline at end of file
@@ -1,24 +1,39 @@
 #include "flecklib_distort.h"
 #include "../config/files.h"
 
+static const char* const FLECK_PHASE_NAMES[FLECK_NUM_PHASES] = {
+    "connect", "md5", "handshake", "upload", "wait_worker", "download", "md5_verify", "confirm", "total"
+};
+
+// Histogramas de latencia por fase y tipo de archivo de todas las distorsiones de este Fleck
+TimingTable fleck_timings = { .phase_names = FLECK_PHASE_NAMES, .num_phases = FLECK_NUM_PHASES };
+
+// Contador para los identificadores de distorsión
+static atomic_ulong next_job_id = 1;
+
+pthread_mutex_t gotham_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 /***********************************************
 *
 * @Finalitat: Preparar i enviar a Gotham una trama de petició de distorsió amb nom de fitxer i tipus de media.
 * @Parametres:
 *   in: filename      = nom del fitxer a distorsionar.
 *   in: socket_gotham = descriptor del socket Gotham.
-*   in: mediaType     = tipus de fitxer ("Media" o "Text").
+*   in: mediaType     = tipus concret de fitxer ("Text", "Image" o "Audio").
+*   in: fileSize      = mida del fitxer (0 si no se sap).
+*   in: job_id        = identificador de Gotham si ja s’havia assignat un Worker a la distorsió, 0 si és nova.
+*   in: priority      = prioritat de la distorsió (0 = normal).
 * @Retorn: ---
 *
 ************************************************/
-void sendDistortGotham(char* filename, int socket_gotham, char* mediaType) {
-    // Preparar trama de distorsión para Gotham
+void sendDistortGotham(char* filename, int socket_gotham, char* mediaType, long fileSize, unsigned long job_id, int priority) {
+    // Preparar trama de distorsión para Gotham (<mediaType>&<fileName>&<fileSize>&<job_id>&<priority>)
     char* data;
-    asprintf(&data, "%s&%s", mediaType, filename);
+    asprintf(&data, "%s&%s&%ld&%lu&%d", mediaType, filename, fileSize, job_id, priority);
     unsigned char* trama = crear_trama(TYPE_DISTORT_FLECK_GOTHAM, (unsigned char*)data, strlen(data));
 
     // Enviar trama de distorsión a Gotham
-    if (write(socket_gotham, trama, BUFFER_SIZE) < 0) {
+    if (transport_send_frame(socket_gotham, trama) < 0) {
         perror("Error enviando solicitud de distorsión a Gotham");
     } else {
         printF("Solicitud de distorsión enviada a Gotham.\n");
@@ -39,7 +54,7 @@ void sendDistortGotham(char* filename, int socket_gotham, char* mediaType) {
 TramaResult* receiveDistortGotham(int socket_gotham) {
     // Recibir respuesta de Gotham
     unsigned char buffer[BUFFER_SIZE];
-    int bytes_read = recv(socket_gotham, buffer, BUFFER_SIZE, 0);
+    int bytes_read = transport_recv_frame(socket_gotham, buffer);
     
     if (bytes_read <= 0) {
         if (bytes_read == 0) {
@@ -47,7 +62,7 @@ TramaResult* receiveDistortGotham(int socket_gotham) {
         } else {
             perror("Error leyendo mensaje de Gotham.\n");
         }
-        close(socket_gotham);
+        transport_close(socket_gotham);
         return NULL;
     }
     buffer[bytes_read] = '\0'; // Asegurar que está null-terminado
@@ -59,9 +74,9 @@ TramaResult* receiveDistortGotham(int socket_gotham) {
 *
 * @Finalitat: Emmagatzemar en el struct WorkerFleck la IP i port extrets de la trama rebuda per Gotham per distorsionar.
 * @Parametres:
-*   in:  result    = TramaResult amb "IP&Port".
+*   in:  result    = TramaResult amb "IP&Port[&job_id]".
 *   in/out: worker = punter a WorkerFleck* que es crea.
-*   in:  workerType = tipus de worker ("Media" o "Text").
+*   in:  workerType = tipus de fitxer que atén el worker ("Text", "Image" o "Audio").
 * @Retorn: 1 en èxit, 0 en error.
 *
 ************************************************/
@@ -79,11 +94,16 @@ int store_new_worker(TramaResult* result, WorkerFleck** worker, char* workerType
         return 0;
     }
 
-    // Procesar data con el formato <IP>&<port>
-    (*worker)->IP = strdup(strtok(result->data, "&"));
-    (*worker)->Port = strdup(strtok(NULL, "&"));
+    // Procesar data con el formato <IP>&<port>[&<job_id>]
+    char* saveptr = NULL;
+    (*worker)->IP = strdup(strtok_r(result->data, "&", &saveptr));
+    (*worker)->Port = strdup(strtok_r(NULL, "&", &saveptr));
+    char* job_id = strtok_r(NULL, "&", &saveptr);
+    (*worker)->job_id = job_id ? strtoul(job_id, NULL, 10) : 0;
     (*worker)->workerType = workerType;
     (*worker)->socket_fd = -1;     // No definido todavía
+    (*worker)->pooled = 0;
+    (*worker)->fd_passing = 0;
     
     free_tramaResult(result);
 
@@ -104,17 +124,53 @@ int store_new_worker(TramaResult* result, WorkerFleck** worker, char* workerType
 *   in:  mediaType     = tipus de fitxer.
 *   in/out: worker     = punter a WorkerFleck* on guardar resultats.
 *   in/out: distortInfo= informació de la distorsió.
+*          Si Gotham respon DISTORT_BUSY o DISTORT_LIMIT, s’espera el temps indicat (amb jitter) i es torna a demanar.
 * @Retorn: 1 si s’assigna worker, -1 en cas de KO o error.
 *
 ************************************************/
 int request_distort_gotham(int socket_gotham, char* mediaType, WorkerFleck** worker, DistortInfo* distortInfo) {
-    // Enviar petición de distort a Gotham (y guardar mediaType del archivo)
-    sendDistortGotham(distortInfo->filename, socket_gotham, mediaType);
-    //Leer respuesta de Gotham como trama
-    TramaResult* result = receiveDistortGotham(socket_gotham);
-    if (result == NULL) {
-        perror("Error leyendo trama.\n");
-        return -1;
+    TramaResult* result = NULL;
+    unsigned int seed = (unsigned int)(timings_now_ns() ^ getpid());
+
+    // Tamaño del archivo para el registro de distorsiones de Gotham
+    char file_path[256];
+    snprintf(file_path, sizeof(file_path), "users%s/%s", distortInfo->user_dir, distortInfo->filename);
+    char* size_str = get_string_file_size(file_path);
+    long file_size = size_str ? atol(size_str) : 0;
+    free(size_str);
+
+    for (int attempt = 0; ; attempt++) {
+        // Enviar petición de distort a Gotham (y guardar mediaType del archivo). La petición y su
+        // respuesta van bajo el mismo lock para que otro hilo no se lleve nuestra respuesta
+        pthread_mutex_lock(&gotham_mutex);
+        sendDistortGotham(distortInfo->filename, socket_gotham, mediaType, file_size, distortInfo->gotham_job, distortInfo->priority);
+        //Leer respuesta de Gotham como trama
+        result = receiveDistortGotham(socket_gotham);
+        pthread_mutex_unlock(&gotham_mutex);
+        if (result == NULL) {
+            perror("Error leyendo trama.\n");
+            return -1;
+        }
+
+        // Worker principal saturado (DISTORT_BUSY&<retry_after_ms>) o límite de peticiones superado (DISTORT_LIMIT&<retry_after_ms>)
+        int limited = (strncmp(result->data, DISTORT_LIMIT_MSG, strlen(DISTORT_LIMIT_MSG)) == 0);
+        if (result->type != TYPE_DISTORT_FLECK_GOTHAM
+            || (!limited && strncmp(result->data, "DISTORT_BUSY", strlen("DISTORT_BUSY")) != 0)) {
+            break;
+        }
+        char* retry = strchr(result->data, '&');
+        long retry_ms = (retry != NULL) ? atol(retry + 1) : FLECK_BUSY_BACKOFF_MS;
+        free_tramaResult(result);
+        if (attempt == FLECK_BUSY_RETRIES) {
+            printF(limited ? "Límite de peticiones de Gotham superado, inténtalo más tarde.\n"
+                           : "Workers saturados, inténtalo más tarde.\n");
+            return -1;
+        }
+
+        // Esperar lo indicado por Gotham más un jitter aleatorio (crece con cada intento) para que
+        // los Flecks rechazados a la vez no vuelvan todos al mismo tiempo
+        retry_ms += rand_r(&seed) % (retry_ms * (attempt + 1) / 2 + 1);
+        usleep(retry_ms * 1000);
     }
 
     char* buffer;
@@ -147,6 +203,9 @@ int request_distort_gotham(int socket_gotham, char* mediaType, WorkerFleck** wor
             return -1;
         }
         distortInfo->worker_ptr = worker;
+        if ((*worker)->job_id != 0) {
+            distortInfo->gotham_job = (*worker)->job_id;
+        }
 
         return 1;
 
@@ -181,7 +240,7 @@ void freeWorkerFleck(WorkerFleck** worker) {
 
         // Cerrar conexión socket con Worker
         if ((*worker)->socket_fd >= 0) {
-            close((*worker)->socket_fd);
+            transport_close((*worker)->socket_fd);
             (*worker)->socket_fd = -1; // Marcar como cerrado
         }
 
@@ -191,6 +250,34 @@ void freeWorkerFleck(WorkerFleck** worker) {
     }
 }
 
+/***********************************************
+*
+* @Finalitat: Informar Gotham de la fase d’una distorsió (trama TYPE_JOB_STATUS, sense resposta).
+* @Parametres:
+*   in: distortInfo = informació de la distorsió.
+*   in: phase       = fase (JOB_STATUS_*).
+* @Retorn: ---
+*
+************************************************/
+static void report_job_status(DistortInfo* distortInfo, const char* phase) {
+    if (distortInfo->gotham_job == 0 || distortInfo->socket_gotham < 0) {
+        return;     // Gotham no registra esta distorsión
+    }
+
+    char data[64];
+    snprintf(data, sizeof(data), "%lu&%s", distortInfo->gotham_job, phase);
+    unsigned char* trama = crear_trama(TYPE_JOB_STATUS, (unsigned char*)data, strlen(data));
+    if (trama == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&gotham_mutex);
+    if (transport_send_frame(distortInfo->socket_gotham, trama) < 0) {
+        perror("Error enviando estado de la distorsión a Gotham");
+    }
+    pthread_mutex_unlock(&gotham_mutex);
+    free(trama);
+}
+
 /***********************************************
 *
 * @Finalitat: Alliberar tots els camps de DistortInfo incloent WorkerFleck i la pròpia estructura.
@@ -203,6 +290,9 @@ void freeDistortInfo(DistortInfo* distortInfo) {
     if (distortInfo == NULL) {
         return;  // Si el puntero es NULL, no hacemos nada
     }
+
+    // Cerrar la distorsión en el registro de Gotham
+    report_job_status(distortInfo, distortInfo->job_done ? JOB_STATUS_DONE : JOB_STATUS_FAILED);
     
     if (distortInfo->username != NULL) {
         free(distortInfo->username);
@@ -221,11 +311,99 @@ void freeDistortInfo(DistortInfo* distortInfo) {
     free(distortInfo);
 }
 
+/***********************************************
+*
+* @Finalitat: Crear el resultat buit d’una distorsió en mode script.
+* @Parametres:
+*   in: filename   = nom del fitxer.
+*   in: factor     = factor de distorsió.
+*   in: media_type = tipus de media (Text o Media).
+* @Retorn: Punter a FleckJob (cal alliberar-lo amb freeFleckJob), o NULL en error.
+*
+************************************************/
+FleckJob* newFleckJob(const char* filename, const char* factor, const char* media_type) {
+    FleckJob* job = (FleckJob*)calloc(1, sizeof(FleckJob));
+    if (job == NULL) {
+        perror("Error en malloc de FleckJob");
+        return NULL;
+    }
+    job->filename = strdup(filename);
+    job->factor = strdup(factor);
+    job->media_type = strdup(media_type);
+    job->start_ns = timings_now_ns();
+    return job;
+}
+
+void freeFleckJob(FleckJob* job) {
+    if (job == NULL) return;
+
+    free(job->filename);
+    free(job->factor);
+    free(job->media_type);
+    free(job->worker);
+    free(job->result_path);
+    free(job);
+}
+
+/***********************************************
+*
+* @Finalitat: Escriure una cadena JSON escapant cometes, barres i caràcters de control.
+* @Parametres:
+*   in: fd    = descriptor on escriure.
+*   in: value = cadena (NULL s’escriu com a null).
+* @Retorn: ---
+*
+************************************************/
+static void print_json_string(int fd, const char* value) {
+    if (value == NULL) {
+        dprintf(fd, "null");
+        return;
+    }
+
+    dprintf(fd, "\"");
+    for (const char* c = value; *c; c++) {
+        if (*c == '"' || *c == '\\') dprintf(fd, "\\%c", *c);
+        else if ((unsigned char)*c < 0x20) dprintf(fd, "\\u%04x", *c);
+        else dprintf(fd, "%c", *c);
+    }
+    dprintf(fd, "\"");
+}
+
+/***********************************************
+*
+* @Finalitat: Escriure el resultat d’una distorsió com una línia JSON.
+* @Parametres:
+*   in: job = resultat de la distorsió.
+*   in: fd  = descriptor on escriure.
+* @Retorn: ---
+*
+************************************************/
+void print_fleck_job_json(FleckJob* job, int fd) {
+    dprintf(fd, "{\"file\": ");
+    print_json_string(fd, job->filename);
+    dprintf(fd, ", \"type\": ");
+    print_json_string(fd, job->media_type);
+    dprintf(fd, ", \"factor\": ");
+    print_json_string(fd, job->factor);
+    dprintf(fd, ", \"ok\": %s, \"worker\": ", job->ok ? "true" : "false");
+    print_json_string(fd, job->worker);
+    dprintf(fd, ", \"result\": ");
+    print_json_string(fd, job->result_path);
+    dprintf(fd, ", \"bytes_in\": %ld, \"bytes_out\": %ld, \"resumes\": %d, \"resume_offset\": %ld, "
+                "\"latency_ms\": %.3f, \"phases_ms\": {",
+            job->bytes_in, job->bytes_out, job->resumes, job->resume_offset, (job->end_ns - job->start_ns) / 1e6);
+    for (int i = 0; i < FLECK_NUM_PHASES; i++) {
+        dprintf(fd, "%s\"%s\": %.3f", (i > 0) ? ", " : "", FLECK_PHASE_NAMES[i], job->phase_ns[i] / 1e6);
+    }
+    dprintf(fd, "}}\n");
+}
+
 
 // ---- Conectar con servidor Worker ----
 /***********************************************
 *
-* @Finalitat: Establir connexió TCP amb el WorkerFleck a la seva IP i port.
+* @Finalitat: Establir connexió amb el WorkerFleck a la seva IP i port (o socket Unix), reutilitzant una
+*             connexió del pool si n’hi ha alguna d’oberta.
 * @Parametres:
 *   in: worker = punter a WorkerFleck amb IP i Port.
 * @Retorn: 1 en èxit, -1 en error.
@@ -236,29 +414,16 @@ int connect_with_worker(WorkerFleck* worker) {
     // DEBUGGING:
     //printf("Conectando a Worker en %s:%s...\n", worker->IP, worker->Port);
 
+    // Reutilizar una conexión persistente con este Worker si hay alguna libre
+    worker->pooled = FLECK_pool_acquire(worker);
+    if (worker->pooled) {
+        return 1;
+    }
     
-    // Crear socket de conexión con Worker
-    worker->socket_fd = socket(AF_INET, SOCK_STREAM, 0);
+    // Conectar al servidor Worker (IP y puerto, o unix:/ruta si está en el mismo host)
+    worker->socket_fd = connect_to_server(worker->IP, atoi(worker->Port));
     if (worker->socket_fd < 0) {
-        perror("Error al crear el socket");
-        return -1;
-    }
-
-    // Configurar la dirección del servidor (Worker)
-    struct sockaddr_in server_addr;
-    memset(&server_addr, 0, sizeof(server_addr)); // Poner a 0 toda la estructura
-    server_addr.sin_family = AF_INET;            // Familia de direcciones: IPv4
-    server_addr.sin_port = atoi(worker->Port); // Puerto del Worker (convertido a formato de red)
-
-    // Convertir la IP de string a formato binario y configurarla
-    if (inet_pton(AF_INET, worker->IP, &server_addr.sin_addr) <= 0) {
-        perror("Error al convertir la IP");
-        return -1;
-    }
-
-    // Conectar al servidor Worker
-    if (connect(worker->socket_fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
-        perror("Error al conectar con Worker");
+        perror(errno == EINVAL ? "Error al convertir la IP" : "Error al conectar con Worker");
         return -1;
     }
 
@@ -267,26 +432,32 @@ int connect_with_worker(WorkerFleck* worker) {
 
 /***********************************************
 *
-* @Finalitat: Enviar al Worker la trama inicial de distorsió, incloent user, file, MD5, factor.
+* @Finalitat: Enviar al Worker la trama inicial de distorsió, incloent user, file, MD5, factor i
+*             identificador de la distorsió.
 * @Parametres:
 *   in: worker       = descriptor i info del worker.
 *   in: distortInfo  = informació de la distorsió.
 *   in: fileSize     = cadena amb size del fitxer.
 *   in: fileMD5SUM   = MD5 sum del fitxer.
 *   in: init_notContinue = 1 per start, 0 per resume.
-* @Retorn: 1 en èxit, -1 en error.
+* @Retorn: 1 en èxit, 0 si el Worker és saturat (BUSY), -1 en error.
 *
 ************************************************/
 int send_start_distort(WorkerFleck* worker, DistortInfo* distortInfo, char* fileSize, char* fileMD5SUM, int init_notContinue) {
     
     // Preparar y enviar la trama inicial de distorsión para Worker
     unsigned char* data;
-    asprintf((char**)&data, "%s&%s&%s&%s&%s", distortInfo->username, distortInfo->filename, fileSize, fileMD5SUM, distortInfo->distortion_factor);
+    // El identificador de la distorsión indica al Worker que la conexión se mantendrá para más distorsiones;
+    // la prioridad le sirve para ordenar las conexiones en cola. Con un socket Unix se ofrece pasar los archivos como descriptor
+    int unix_socket = is_unix_socket(worker->socket_fd);
+    asprintf((char**)&data, "%s&%s&%s&%s&%s&%s&%d%s", distortInfo->username, distortInfo->filename, fileSize, fileMD5SUM,
+             distortInfo->distortion_factor, distortInfo->job_id, distortInfo->priority, unix_socket ? "&" FD_PASSING_MSG : "");
+    worker->fd_passing = 0;
     // printF((char*)data);
     // printF("\n");
     
     unsigned char* tramaEnviar = crear_trama((init_notContinue) ? TYPE_START_DISTORT_FLECK_WORKER : TYPE_RESUME_DISTORT_FLECK_WORKER, data, strlen((char*)data));
-    if (write(worker->socket_fd, tramaEnviar, BUFFER_SIZE) < 0) {
+    if (transport_send_frame(worker->socket_fd, tramaEnviar) < 0) {
         perror("Error enviando respuesta al cliente");
         return -1;
     }
@@ -296,7 +467,7 @@ int send_start_distort(WorkerFleck* worker, DistortInfo* distortInfo, char* file
 
     // Leer la respuesta inicial de distorsión 
     unsigned char response[BUFFER_SIZE];
-    int bytes_received = recv(worker->socket_fd, response, BUFFER_SIZE, 0);
+    int bytes_received = transport_recv_frame(worker->socket_fd, response);
     
     TramaResult *result;
     if (bytes_received > 0) {
@@ -308,10 +479,18 @@ int send_start_distort(WorkerFleck* worker, DistortInfo* distortInfo, char* file
             return -1;
         }
 
+        // Worker saturado: no ha aceptado la conexión y la cierra
+        if (strcmp(result->data, BUSY_MSG) == 0) {
+            printF("Worker saturado, no acepta más distorsiones.\n");
+            free_tramaResult(result);
+            return 0;
+        }
+
         // Comprobar si responde con OK
         if ((result->type == TYPE_START_DISTORT_FLECK_WORKER && strcmp(result->data, "CON_KO") != 0 && init_notContinue) ||
             (result->type == TYPE_RESUME_DISTORT_FLECK_WORKER && strcmp(result->data, "CON_KO") != 0 && !init_notContinue)) {
             printF("Worker ha aceptado la solicitud de distorsión.\n");
+            worker->fd_passing = unix_socket && strcmp(result->data, OK_MSG "&" FD_PASSING_MSG) == 0;
 
             if (result) free_tramaResult(result);
         } else {
@@ -340,7 +519,7 @@ int wait_confirm_file_received(WorkerFleck* worker) {
     
     // Leer la respuesta final de distorsión 
     unsigned char response[BUFFER_SIZE];
-    int bytes_received = recv(worker->socket_fd, response, BUFFER_SIZE, 0);
+    int bytes_received = transport_recv_frame(worker->socket_fd, response);
     
     TramaResult *result;
     if (bytes_received > 0) {
@@ -365,7 +544,7 @@ int wait_confirm_file_received(WorkerFleck* worker) {
 
         // Enviar confirmación de recepción (ACK) a Worker
         unsigned char *success_trama = crear_trama(TYPE_END_DISTORT_FLECK_WORKER, (unsigned char*)OK_MSG, strlen(OK_MSG));
-        if (write(worker->socket_fd, success_trama, BUFFER_SIZE) < 0) {
+        if (transport_send_frame(worker->socket_fd, success_trama) < 0) {
             perror("Error enviando confirmación de MD5");
             free(success_trama);
 
@@ -386,48 +565,81 @@ int wait_confirm_file_received(WorkerFleck* worker) {
 
 /***********************************************
 *
-* @Finalitat: Rebre la trama inicial de distorsió del Worker (conté filesize&md5sum) i enviar ACK inicial.
+* @Finalitat: Rebre la trama inicial de distorsió del Worker (conté filesize&md5sum&job_id) i enviar ACK inicial.
 * @Parametres:
 *   in:  socket_connection = socket del Worker.
 *   out: fileSize    = punter a cadena amb filesize.
 *   out: md5sum      = punter a cadena amb md5sum.
+*   in:  job_id      = identificador esperat de la distorsió.
+*   out: offset      = byte des del qual el Worker reprèn l’enviament (0 si no ho indica; pot ser NULL).
 * @Retorn: 1 en èxit, 0 si Worker tanca, -1 en error.
 *
 ************************************************/
-int receive_start_distort(int socket_connection, char** fileSize, char** md5sum) {
+int receive_start_distort(int socket_connection, char** fileSize, char** md5sum, const char* job_id, long* offset) {
     unsigned char response[BUFFER_SIZE];
     
-    int bytes_received = recv(socket_connection, response, BUFFER_SIZE, 0);
+    int bytes_received = transport_recv_frame(socket_connection, response);
     if (bytes_received <= 0) {
         if (bytes_received == 0) {
             // CAIDA de Worker durante distorsión
             return 0;
         }
         perror("Error al recibir solicitud inicial");
-        close(socket_connection);
+        transport_close(socket_connection);
         return -1;
     }
 
     // Procesar la trama inicial
     TramaResult *result = leer_trama(response);
+
+    // Si el Worker anterior cayó tras confirmar la subida pero antes de anotarla, el nuevo repite la
+    // confirmación del MD5: se responde como al acabar la subida y se espera la trama inicial
+    if (result && result->type == TYPE_END_DISTORT_FLECK_WORKER && strcmp(result->data, CHECK_OK) == 0) {
+        free_tramaResult(result);
+        unsigned char *confirm_trama = crear_trama(TYPE_END_DISTORT_FLECK_WORKER, (unsigned char*)OK_MSG, strlen(OK_MSG));
+        int sent = transport_send_frame(socket_connection, confirm_trama);
+        free(confirm_trama);
+        bytes_received = (sent < 0) ? -1 : transport_recv_frame(socket_connection, response);
+        if (bytes_received <= 0) {
+            if (bytes_received == 0) return 0;
+            perror("Error al recibir solicitud inicial");
+            transport_close(socket_connection);
+            return -1;
+        }
+        result = leer_trama(response);
+    }
+
     if (!result || (result->type != TYPE_START_DISTORT_WORKER_FLECK)) {
         perror("Trama inicial inválida");
         if (result) free_tramaResult(result);
-        close(socket_connection);
+        transport_close(socket_connection);
         return -1;
     }
 
-    // Guardar md5sum y filesize    // (filesize&md5sum)
+    // Guardar md5sum y filesize    // (filesize&md5sum&job_id&offset)
     if (fileSize && md5sum) {
-        *fileSize = strdup(strtok(result->data, "&"));
-        *md5sum = strdup(strtok(NULL, "&"));
+        char* saveptr = NULL;
+        *fileSize = strdup(strtok_r(result->data, "&", &saveptr));
+        *md5sum = strdup(strtok_r(NULL, "&", &saveptr));
+
+        // La respuesta debe pertenecer a esta distorsión (la conexión puede haber llevado otras antes)
+        char* received_job_id = strtok_r(NULL, "&", &saveptr);
+        if (received_job_id != NULL && job_id != NULL && strcmp(received_job_id, job_id) != 0) {
+            printF("Trama inicial de otra distorsión recibida del Worker.\n");
+            free(*fileSize);
+            free(*md5sum);
+            free_tramaResult(result);
+            return -1;
+        }
+        char* resume_offset = (received_job_id != NULL) ? strtok_r(NULL, "&", &saveptr) : NULL;
+        if (offset) *offset = resume_offset ? atol(resume_offset) : 0;
 
         if (!fileSize || !md5sum) {
             perror("Formato de datos trama distorsion inicial inválido");
             
             free(*fileSize);
             free(*md5sum);
-            close(socket_connection);
+            transport_close(socket_connection);
             return -1;
         }
     }
@@ -436,12 +648,12 @@ int receive_start_distort(int socket_connection, char** fileSize, char** md5sum)
 
     // Enviar ACK de recepción inicial
     unsigned char *ack_trama = crear_trama(TYPE_START_DISTORT_WORKER_FLECK, (unsigned char*)OK_MSG, strlen(OK_MSG));
-    if (write(socket_connection, ack_trama, BUFFER_SIZE) < 0) {
+    if (transport_send_frame(socket_connection, ack_trama) < 0) {
         perror("Error enviando confirmación inicial");
 
         if (fileSize) free(*fileSize);
         if (md5sum) free(*md5sum);
-        close(socket_connection);
+        transport_close(socket_connection);
         return -1;
     }
     free(ack_trama);
@@ -458,10 +670,11 @@ int receive_start_distort(int socket_connection, char** fileSize, char** md5sum)
 *   in/out: worker     = punter a WorkerFleck* actual.
 *   in/out: fileSize   = punter a cadena filesize.
 *   in/out: fileMD5SUM = punter a cadena md5sum.
+*   out:    offset     = byte des del qual el nou Worker reprèn l’enviament del resultat (pot ser NULL).
 * @Retorn: 1 si es recupera, -1 si no hi ha workers disponibles.
 *
 ************************************************/
-int handle_caida_worker(DistortInfo* distortInfo, WorkerFleck** worker, char** fileSize, char** fileMD5SUM) {
+int handle_caida_worker(DistortInfo* distortInfo, WorkerFleck** worker, char** fileSize, char** fileMD5SUM, long* offset) {
     // ---- CAIDA de Worker en RX----
     printF("Cierre de conexión de Worker, buscando nuevo Worker disponible...\n");
 
@@ -490,7 +703,7 @@ int handle_caida_worker(DistortInfo* distortInfo, WorkerFleck** worker, char** f
         }
 
         // Volvemos a recibir la trama inicial de distorsión
-        if (receive_start_distort((*worker)->socket_fd, fileSize, fileMD5SUM) < 1) {
+        if (receive_start_distort((*worker)->socket_fd, fileSize, fileMD5SUM, distortInfo->job_id, offset) < 1) {
             perror("Error al recibir trama inicial de distorsión de vuelta");
             free(wType);
             return -1;
@@ -520,7 +733,7 @@ int handle_caida_worker(DistortInfo* distortInfo, WorkerFleck** worker, char** f
 int send_confirm_file_received (int socket_connection) {
     // Enviar confirmación de que el archivo se recibió correctamente cxon MD5SUM correcto
     unsigned char *success_trama = crear_trama(TYPE_END_DISTORT_FLECK_WORKER, (unsigned char*)CHECK_OK, strlen(CHECK_OK));
-    if (write(socket_connection, success_trama, BUFFER_SIZE) < 0) {
+    if (transport_send_frame(socket_connection, success_trama) < 0) {
         perror("Error enviando confirmación de MD5");
         free(success_trama);
 
@@ -530,7 +743,7 @@ int send_confirm_file_received (int socket_connection) {
 
     // Esperar OK de Worker
     unsigned char response[BUFFER_SIZE];
-    int bytes_received = recv(socket_connection, response, BUFFER_SIZE, 0);
+    int bytes_received = transport_recv_frame(socket_connection, response);
     
     if (bytes_received > 0) {
         // Procesar la trama
@@ -558,7 +771,118 @@ int send_confirm_file_received (int socket_connection) {
     return 0;
 }
 
+/***********************************************
+*
+* @Finalitat: Passar al Worker del mateix host el descriptor del fitxer a distorsionar (SCM_RIGHTS)
+*             i esperar que l’hagi copiat.
+* @Parametres:
+*   in: worker   = Worker amb connexió per socket Unix.
+*   in: fd       = descriptor del fitxer obert per lectura.
+*   in: fileSize = cadena amb size del fitxer.
+* @Retorn: 1 si el Worker ha copiat el fitxer, -1 en error.
+*
+************************************************/
+static int send_file_fd(WorkerFleck* worker, int fd, char* fileSize) {
+    unsigned char* trama = crear_trama(TYPE_FILE_FD, (unsigned char*)fileSize, strlen(fileSize));
+    int sent = transport_send_frame_fd(worker->socket_fd, trama, fd);
+    free(trama);
+    if (sent != BUFFER_SIZE) {
+        return -1;
+    }
+
+    unsigned char response[BUFFER_SIZE];
+    if (transport_recv_frame(worker->socket_fd, response) <= 0) {
+        return -1;
+    }
+    TramaResult* result = leer_trama(response);
+    int ok = (result != NULL && result->type == TYPE_FILE_FD && strcmp(result->data, OK_MSG) == 0);
+    if (result) free_tramaResult(result);
+    if (!ok) {
+        printF("El Worker no ha podido copiar el archivo pasado por descriptor.\n");
+        return -1;
+    }
+    return 1;
+}
+
+/***********************************************
+*
+* @Finalitat: Copiar el fitxer distorsionat que el Worker del mateix host ha passat com a descriptor
+*             i confirmar-li la recepció.
+* @Parametres:
+*   in: socket_fd   = socket del Worker.
+*   in: received_fd = descriptor rebut (es tanca).
+*   in: offset      = bytes del fitxer que ja s’havien rebut.
+*   in: dst_fd      = fitxer distorsionat local.
+*   in: length      = bytes que falten.
+* @Retorn: 1 en èxit, -1 en error.
+*
+************************************************/
+static int receive_file_fd(int socket_fd, int received_fd, long offset, int dst_fd, long length) {
+    long copied = copy_file_fd(received_fd, offset, dst_fd, length);
+    close(received_fd);
+
+    const char* ack = (copied == length) ? OK_MSG : CHECK_KO;
+    unsigned char* ack_trama = crear_trama(TYPE_FILE_FD, (unsigned char*)ack, strlen(ack));
+    int sent = transport_send_frame(socket_fd, ack_trama);
+    free(ack_trama);
+    if (copied != length || sent < 0) {
+        perror("Error copiando el archivo distorsionado recibido por descriptor");
+        return -1;
+    }
+    return 1;
+}
+
+/***********************************************
+*
+* @Finalitat: Registrar la durada d’una fase a l’histograma del Fleck i, si la distorsió té un
+*             resultat associat (mode script), també al resultat.
+* @Parametres:
+*   in/out: distortInfo = informació de la distorsió.
+*   in:     phase       = índex de la fase (FLECK_PHASE_*).
+*   in:     kind        = tipus de fitxer (TIMING_KIND_*).
+*   in:     start_ns    = inici de la fase.
+* @Retorn: ---
+*
+************************************************/
+static void record_phase(DistortInfo* distortInfo, int phase, int kind, uint64_t start_ns) {
+    uint64_t elapsed = timings_now_ns() - start_ns;
+    timings_record(&fleck_timings, phase, kind, elapsed);
+    if (distortInfo->job != NULL) {
+        distortInfo->job->phase_ns[phase] = elapsed;
+    }
+}
+
 // Función para manejar la solicitud de distorsión
+/***********************************************
+*
+* @Finalitat: Tornar a demanar un Worker a Gotham quan l’assignat respon BUSY, esperant abans un
+*             temps creixent amb cada intent, i repetir-li la trama inicial de distorsió.
+* @Parametres:
+*   in/out: distortInfo = informació de la distorsió.
+*   in/out: worker      = punter al WorkerFleck actual (es substitueix pel nou).
+*   in: fileSize        = cadena amb size del fitxer.
+*   in: fileMD5SUM      = MD5 sum del fitxer.
+*   in: attempt         = número d’intent (1..FLECK_BUSY_RETRIES).
+* @Retorn: 1 si el nou Worker accepta, 0 si també és saturat, -1 en error.
+*
+************************************************/
+static int retry_busy_worker(DistortInfo* distortInfo, WorkerFleck** worker, char* fileSize, char* fileMD5SUM, int attempt) {
+    usleep(FLECK_BUSY_BACKOFF_MS * attempt * 1000);
+
+    // El tipo es una cadena estática: el nuevo WorkerFleck guarda el mismo puntero
+    char* wType = (*worker)->workerType;
+    freeWorkerFleck(distortInfo->worker_ptr);
+    if (request_distort_gotham(distortInfo->socket_gotham, wType, distortInfo->worker_ptr, distortInfo) < 1) {
+        return -1;
+    }
+    *worker = *distortInfo->worker_ptr;
+
+    if (connect_with_worker(*worker) < 1) {
+        return -1;
+    }
+    return send_start_distort(*worker, distortInfo, fileSize, fileMD5SUM, 1);
+}
+
 /***********************************************
 *
 * @Finalitat: Hilo principal per gestionar tot el flux de distorsió: connexió, envoi, recepció,
@@ -584,12 +908,25 @@ void* handle_distort_worker(void* arg) {
         return NULL;
     }
 
+    // Identificador único de la distorsión: el de Gotham o, si no lo envía, proceso y número de distorsión
+    if (distortInfo->gotham_job != 0) {
+        snprintf(distortInfo->job_id, sizeof(distortInfo->job_id), "%lu", distortInfo->gotham_job);
+    } else {
+        snprintf(distortInfo->job_id, sizeof(distortInfo->job_id), "%d-%lu", getpid(),
+                 atomic_fetch_add(&next_job_id, 1));
+    }
+
+    int kind = timings_kind(distortInfo->filename);
+    uint64_t job_start = timings_now_ns();
+    uint64_t phase_start = job_start;
+
     // ---- Conectar con servidor Worker ----
     if (connect_with_worker(worker) < 1) {
         perror("Error al conectar con Worker");
         freeDistortInfo(distortInfo);
         return NULL;
     }
+    record_phase(distortInfo, FLECK_PHASE_CONNECT, kind, phase_start);
 
     // ---- Enviar la solicitud de distorsión a Worker ----
     
@@ -599,6 +936,7 @@ void* handle_distort_worker(void* arg) {
     // printF(file_path);
 
     // Obtener filesize
+    phase_start = timings_now_ns();
     char* fileSize = get_string_file_size(file_path);
 
     // Calcular MD5SUM
@@ -608,14 +946,32 @@ void* handle_distort_worker(void* arg) {
         freeDistortInfo(distortInfo);
         return NULL;
     }
+    record_phase(distortInfo, FLECK_PHASE_MD5, kind, phase_start);
     
-    if (send_start_distort(worker, distortInfo, fileSize, fileMD5SUM, 1) < 1) {
+    phase_start = timings_now_ns();
+    int start_ok = send_start_distort(worker, distortInfo, fileSize, fileMD5SUM, 1);
+    if (start_ok < 1 && worker->pooled) {
+        // El Worker puede haber cerrado la conexión reutilizada por inactividad: reintentar con una nueva
+        transport_close(worker->socket_fd);
+        worker->socket_fd = -1;
+        worker->pooled = 0;
+        if (connect_with_worker(worker) == 1) {
+            start_ok = send_start_distort(worker, distortInfo, fileSize, fileMD5SUM, 1);
+        }
+    }
+    // Worker saturado: pedir de nuevo un Worker a Gotham
+    for (int attempt = 1; start_ok == 0 && attempt <= FLECK_BUSY_RETRIES; attempt++) {
+        start_ok = retry_busy_worker(distortInfo, &worker, fileSize, fileMD5SUM, attempt);
+    }
+    if (start_ok < 1) {
         perror("Error al enviar la solicitud de distorsión al Worker");
         free(fileSize);
         free(fileMD5SUM);
         freeDistortInfo(distortInfo);
         return NULL;
     }
+    record_phase(distortInfo, FLECK_PHASE_HANDSHAKE, kind, phase_start);
+    report_job_status(distortInfo, JOB_STATUS_UPLOADING);
 
     long file_size = atol(fileSize);  // Tamaño total del archivo en bytes
 
@@ -639,6 +995,16 @@ void* handle_distort_worker(void* arg) {
     int bytes_received;
 
     worker->status = 0;
+    phase_start = timings_now_ns();
+
+    // Worker en el mismo host: pasarle el descriptor del archivo en vez de enviarlo en tramas.
+    // Si falla, el bucle de tramas empieza desde el principio (y detecta la caída del Worker)
+    if (worker->fd_passing && send_file_fd(worker, fd, fileSize) == 1) {
+        bytes_sent = file_size;
+        worker->status = 50;
+        lseek(fd, 0, SEEK_END);
+    }
+
     while ((bytes_read = read(fd, buffer, sizeof(buffer))) > 0) {
 
         // Enviar trama con fragmento del archivo
@@ -651,7 +1017,7 @@ void* handle_distort_worker(void* arg) {
             return NULL;
         }
 
-        if (write(worker->socket_fd, trama, BUFFER_SIZE) != BUFFER_SIZE/*< 0*/) {
+        if (transport_send_frame(worker->socket_fd, trama) != BUFFER_SIZE/*< 0*/) {
             perror("Error al enviar trama al Worker");
             free(trama);
             close(fd);
@@ -661,7 +1027,7 @@ void* handle_distort_worker(void* arg) {
         free(trama);
 
         // Comprobar si Worker lo recibió correctamente
-        bytes_received = recv(worker->socket_fd, response, BUFFER_SIZE, 0);
+        bytes_received = transport_recv_frame(worker->socket_fd, response);
         if (bytes_received <= 0) {
 
             // ---- CAIDA de Worker en TX ----
@@ -742,29 +1108,40 @@ void* handle_distort_worker(void* arg) {
         freeDistortInfo(distortInfo);
         return NULL;
     }
+    record_phase(distortInfo, FLECK_PHASE_UPLOAD, kind, phase_start);
 
     bytes_sent = 0;
     
     // ---- Recepción del archivo distorsionado ----
 
     // Recibir trama inicial envio archivo distorsionado
-    free(fileSize);
-    free(fileMD5SUM);
-    int result_func = receive_start_distort(worker->socket_fd, &fileSize, &fileMD5SUM);
+    // (el tamaño y el MD5 del original se conservan hasta recibirla: si el Worker cae se reenvían al nuevo)
+    char* originalSize = fileSize;
+    char* originalMD5SUM = fileMD5SUM;
+    phase_start = timings_now_ns();
+    int result_func = receive_start_distort(worker->socket_fd, &fileSize, &fileMD5SUM, distortInfo->job_id, NULL);
     if (result_func < 0) {
         perror("Error al recibir trama inicial de distorsión");
+        free(originalSize);
+        free(originalMD5SUM);
         freeDistortInfo(distortInfo);
         return NULL;
 
     } else if (result_func == 0) {
         
         // CAIDA de Worker mientras distorsionaba
-        if (handle_caida_worker(distortInfo, &worker, &fileSize, &fileMD5SUM) < 1) {
+        if (handle_caida_worker(distortInfo, &worker, &fileSize, &fileMD5SUM, NULL) < 1) {
             // perror("Error al manejar la caída del Worker");
+            free(originalSize);
+            free(originalMD5SUM);
             freeDistortInfo(distortInfo);
             return NULL;
         }
     }
+    free(originalSize);
+    free(originalMD5SUM);
+
+    record_phase(distortInfo, FLECK_PHASE_WAIT_WORKER, kind, phase_start);
 
     char* distorted_file_path = NULL;
     asprintf(&distorted_file_path, "users%s/%s_distorted", distortInfo->user_dir, distortInfo->filename);
@@ -783,23 +1160,60 @@ void* handle_distort_worker(void* arg) {
     long total_bytes_received = 0;
     long distorted_filesize = atol(fileSize);
     
+    phase_start = timings_now_ns();
     while (total_bytes_received < distorted_filesize) {
-        bytes_received = recv(worker->socket_fd, response, BUFFER_SIZE, 0);
+        // El Worker del mismo host puede pasar el descriptor del archivo distorsionado en vez de tramas
+        int received_fd = -1;
+        bytes_received = worker->fd_passing ? transport_recv_frame_fd(worker->socket_fd, response, &received_fd)
+                                           : transport_recv_frame(worker->socket_fd, response);
         if (bytes_received <= 0) {
 
             // ---- CAIDA de Worker en RX----
-            if (handle_caida_worker(distortInfo, &worker, &fileSize, &fileMD5SUM) < 1) {
+            long offset = 0;
+            if (handle_caida_worker(distortInfo, &worker, &fileSize, &fileMD5SUM, &offset) < 1) {
                 // perror("Error al manejar la caída del Worker");
-                close(fd);
+                close(fd_distorted);
+                free(distorted_file_path);
                 freeDistortInfo(distortInfo);
 
                 return NULL;
             }
 
+            // Continuar desde donde reanuda el nuevo Worker (puede repetir la última trama recibida)
+            if (offset < 0 || offset > total_bytes_received || ftruncate(fd_distorted, offset) < 0
+                || lseek(fd_distorted, offset, SEEK_SET) < 0) {
+                perror("Error al reanudar la recepción del archivo distorsionado");
+                close(fd_distorted);
+                free(distorted_file_path);
+                freeDistortInfo(distortInfo);
+                return NULL;
+            }
+            total_bytes_received = offset;
+            if (distortInfo->job != NULL) {
+                distortInfo->job->resumes++;
+                distortInfo->job->resume_offset = offset;
+            }
+
             continue; 
         }
 
         result = leer_trama(response);
+        if (result && result->type == TYPE_FILE_FD && received_fd >= 0) {
+            free_tramaResult(result);
+            if (receive_file_fd(worker->socket_fd, received_fd, total_bytes_received, fd_distorted,
+                                distorted_filesize - total_bytes_received) < 0) {
+                close(fd_distorted);
+                free(distorted_file_path);
+                freeDistortInfo(distortInfo);
+                return NULL;
+            }
+            total_bytes_received = distorted_filesize;
+            worker->status = 100;
+            continue;
+        }
+        if (received_fd >= 0) {
+            close(received_fd);
+        }
         if (!result || result->type != TYPE_FILE_DATA) {
             perror("Trama de datos distorsionados inválida");
             // printF(result->data);
@@ -823,7 +1237,7 @@ void* handle_distort_worker(void* arg) {
 
         // Enviar confirmación de recepción
         unsigned char* ack_trama = crear_trama(TYPE_FILE_DATA, (unsigned char*)OK_MSG, strlen(OK_MSG));
-        if (write(worker->socket_fd, ack_trama, BUFFER_SIZE) < 0) {
+        if (transport_send_frame(worker->socket_fd, ack_trama) < 0) {
             perror("Error enviando confirmación de recepción");
             free(ack_trama);
             close(fd_distorted);
@@ -837,14 +1251,16 @@ void* handle_distort_worker(void* arg) {
         worker->status = 50 + (int)((total_bytes_received)*50 / distorted_filesize); // 50-100%
 
         // DEBUGGING: Bajar velocidad de recepción
-        usleep(1000000);
+        // usleep(1000000);
     }
 
     close(fd_distorted);
+    record_phase(distortInfo, FLECK_PHASE_DOWNLOAD, kind, phase_start);
 
 
     // ---- Comprobar MD5 del archivo recibido ----
 
+    phase_start = timings_now_ns();
     char *calculated_md5 = calculate_md5sum(distorted_file_path);
     if (calculated_md5 == NULL) {
         perror("Error calculando MD5 del archivo recibido");
@@ -853,7 +1269,7 @@ void* handle_distort_worker(void* arg) {
     // Enviar trama al cliente en base al resultado del MD5
     if (!calculated_md5 || strcmp(calculated_md5, fileMD5SUM) != 0) {
         unsigned char *error_trama = crear_trama(TYPE_END_DISTORT_FLECK_WORKER, (unsigned char*)CHECK_KO, strlen(CHECK_KO));
-        if (write(worker->socket_fd, error_trama, BUFFER_SIZE) < 0) {
+        if (transport_send_frame(worker->socket_fd, error_trama) < 0) {
             perror("Error enviando mensaje de MD5 no coincidente");
         } else {
             printF("Enviado: MD5 del archivo recibido no coincide con el esperado\n");
@@ -868,31 +1284,45 @@ void* handle_distort_worker(void* arg) {
         return NULL;
     }
 
+    if (distortInfo->job != NULL) {
+        distortInfo->job->result_path = strdup(distorted_file_path);
+        distortInfo->job->bytes_in = file_size;
+        distortInfo->job->bytes_out = distorted_filesize;
+    }
     free(fileMD5SUM);
     free(calculated_md5);
     free(distorted_file_path);
     free(fileSize);
+    record_phase(distortInfo, FLECK_PHASE_MD5_VERIFY, kind, phase_start);
 
+    phase_start = timings_now_ns();
     if (send_confirm_file_received(worker->socket_fd) != 0) {
         perror("Error enviando confirmación de recepción del archivo con MD5SUM correcto");
         freeDistortInfo(distortInfo);
         return NULL;
     }
+    record_phase(distortInfo, FLECK_PHASE_CONFIRM, kind, phase_start);
+    record_phase(distortInfo, FLECK_PHASE_TOTAL, kind, job_start);
 
 
     // ---- Final ----
 
     // Se finalizó la distorsión del archivo
     worker->status = 100;  // Suponemos que el trabajo se completó con éxito
-    if (strcmp(worker->workerType, MEDIA) == 0) {
+    distortInfo->job_done = 1;
+    if (distortInfo->job != NULL) {
+        distortInfo->job->ok = 1;
+        asprintf(&distortInfo->job->worker, "%s:%s", worker->IP, worker->Port);
+    }
+    if (strcmp(worker->workerType, TEXT) != 0) {
         *(distortInfo->flag_distort_media_finished) = 1;
     } else {
         *(distortInfo->flag_distort_text_finished) = 1;
     }
 
-    // Cerrar la conexión
-    close(worker->socket_fd);
-    printF("Success: Archivo distorsionado correctamente y conexión cerrada con Worker\n$ ");
+    // Guardar la conexión en el pool para la siguiente distorsión con este Worker
+    FLECK_pool_release(worker);
+    printF("Success: Archivo distorsionado correctamente\n$ ");
     freeDistortInfo(distortInfo);
     return NULL;
 }
\ No newline at end of file
@@ -9,21 +9,65 @@
 
 #include "../config/config.h"
 #include "../config/connections.h"
+#include "../config/transport.h"
 #include "../gotham/gothamlib.h"
+#include "../config/timings.h"
+#include "../config/sched.h"
 #include "structures.h"
+#include "flecklib_pool.h"
 
 
 #define READ_FILE_BUFFER_SIZE 4096 // Tamaño del buffer para leer el archivo
 
 #define O_BINARY 0
 
+#define FLECK_BUSY_RETRIES 5        // Nuevas peticiones a Gotham cuando el Worker responde BUSY
+#define FLECK_BUSY_BACKOFF_MS 200   // Espera antes de cada petición (se multiplica por el número de intento)
 
-void sendDistortGotham(char* filename, int socket_gotham, char* mediaType);
+// Fases medidas de cada distorsión (histogramas de fleck_timings)
+#define FLECK_PHASE_CONNECT 0       // Conexión con el Worker
+#define FLECK_PHASE_MD5 1           // Tamaño y MD5SUM del archivo original
+#define FLECK_PHASE_HANDSHAKE 2     // Trama inicial de distorsión y su ACK
+#define FLECK_PHASE_UPLOAD 3        // Envío del archivo y confirmación del MD5 por el Worker
+#define FLECK_PHASE_WAIT_WORKER 4   // Espera mientras el Worker distorsiona
+#define FLECK_PHASE_DOWNLOAD 5      // Recepción del archivo distorsionado
+#define FLECK_PHASE_MD5_VERIFY 6    // MD5SUM del archivo distorsionado recibido
+#define FLECK_PHASE_CONFIRM 7       // Confirmación final con el Worker
+#define FLECK_PHASE_TOTAL 8         // Distorsión completa
+#define FLECK_NUM_PHASES 9
+
+extern TimingTable fleck_timings;
+
+// Serializa los intercambios petición/respuesta por el único socket con Gotham (menú, script e hilos de distorsión)
+extern pthread_mutex_t gotham_mutex;
+
+// Resultado de una distorsión en modo script (se emite como una línea JSON al terminar)
+struct FleckJob {
+    char* filename;
+    char* factor;
+    char* media_type;
+    int ok;                                 // 1 si la distorsión terminó con el MD5SUM correcto
+    char* worker;                           // <IP>:<Puerto> del último Worker utilizado
+    char* result_path;                      // Ruta del archivo distorsionado (NULL si falla)
+    long bytes_in;                          // Tamaño del archivo original
+    long bytes_out;                         // Tamaño del archivo distorsionado
+    int resumes;                            // Descargas del resultado reanudadas tras caer el Worker
+    long resume_offset;                     // Byte desde el que se reanudó la última (indicado por el Worker)
+    uint64_t start_ns;                      // Inicio (antes de pedir Worker a Gotham)
+    uint64_t end_ns;
+    uint64_t phase_ns[FLECK_NUM_PHASES];    // Duración de cada fase (0 si no se llegó a ella)
+};
+
+
+void sendDistortGotham(char* filename, int socket_gotham, char* mediaType, long fileSize, unsigned long job_id, int priority);
 TramaResult* receiveDistortGotham(int socket_gotham);
 int store_new_worker(TramaResult* result, WorkerFleck** worker, char* workerType);
 int request_distort_gotham(int socket_gotham, char* mediaType, WorkerFleck** worker, DistortInfo* distortInfo);
 
 void freeDistortInfo(DistortInfo* distortInfo);
+FleckJob* newFleckJob(const char* filename, const char* factor, const char* media_type);
+void freeFleckJob(FleckJob* job);
+void print_fleck_job_json(FleckJob* job, int fd);
 void* handle_distort_worker(void* arg);
 
 
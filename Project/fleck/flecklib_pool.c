@@ -0,0 +1,130 @@
+#include <errno.h>
+
+#include "flecklib_pool.h"
+
+// Conexiones inactivas hacia un Worker (<IP>:<Puerto>)
+typedef struct {
+    char* IP;
+    char* Port;
+    int sockets[FLECK_POOL_MAX_IDLE];
+    int num_idle;
+} PoolEndpoint;
+
+static PoolEndpoint endpoints[FLECK_POOL_MAX_ENDPOINTS];
+static int num_endpoints = 0;
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+/***********************************************
+*
+* @Finalitat: Buscar l’entrada del pool d’un Worker i, opcionalment, crear-la si no existeix.
+* @Parametres:
+*   in: worker = Worker amb IP i port.
+*   in: create = 1 per crear l’entrada si no existeix.
+* @Retorn: Punter a l’entrada, o NULL si no existeix (o el pool és ple).
+*
+************************************************/
+static PoolEndpoint* find_endpoint(WorkerFleck* worker, int create) {
+    for (int i = 0; i < num_endpoints; i++) {
+        if (strcmp(endpoints[i].IP, worker->IP) == 0 && strcmp(endpoints[i].Port, worker->Port) == 0) {
+            return &endpoints[i];
+        }
+    }
+
+    if (!create || num_endpoints == FLECK_POOL_MAX_ENDPOINTS) {
+        return NULL;
+    }
+    PoolEndpoint* endpoint = &endpoints[num_endpoints++];
+    endpoint->IP = strdup(worker->IP);
+    endpoint->Port = strdup(worker->Port);
+    endpoint->num_idle = 0;
+    return endpoint;
+}
+
+/***********************************************
+*
+* @Finalitat: Comprovar sense bloquejar que una connexió inactiva segueix oberta pel Worker
+*             (una connexió tancada es llegeix com a EOF; una inactiva no té dades pendents).
+* @Parametres:
+*   in: socket_fd = connexió a comprovar.
+* @Retorn: 1 si es pot reutilitzar, 0 si no.
+*
+************************************************/
+static int connection_alive(int socket_fd) {
+    unsigned char trama[BUFFER_SIZE];
+    return transport_peek_frame(socket_fd, trama) < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+/***********************************************
+*
+* @Finalitat: Obtenir del pool una connexió oberta amb el Worker indicat.
+* @Parametres:
+*   in/out: worker = Worker destí; si hi ha connexió disponible es guarda a socket_fd.
+* @Retorn: 1 si s’ha reutilitzat una connexió, 0 si cal obrir-ne una de nova.
+*
+************************************************/
+int FLECK_pool_acquire(WorkerFleck* worker) {
+    int socket_fd = -1;
+
+    pthread_mutex_lock(&pool_mutex);
+    PoolEndpoint* endpoint = find_endpoint(worker, 0);
+    while (endpoint != NULL && endpoint->num_idle > 0 && socket_fd < 0) {
+        int candidate = endpoint->sockets[--endpoint->num_idle];
+        if (connection_alive(candidate)) {
+            socket_fd = candidate;
+        } else {
+            transport_close(candidate);   // El Worker cerró la conexión inactiva
+        }
+    }
+    pthread_mutex_unlock(&pool_mutex);
+
+    if (socket_fd < 0) {
+        return 0;
+    }
+    worker->socket_fd = socket_fd;
+    return 1;
+}
+
+/***********************************************
+*
+* @Finalitat: Retornar al pool la connexió d’un Worker després d’una distorsió correcta. Si el pool
+*             és ple es tanca. En tots dos casos el Worker deixa de tenir la connexió assignada.
+* @Parametres:
+*   in/out: worker = Worker amb la connexió a retornar.
+* @Retorn: ---
+*
+************************************************/
+void FLECK_pool_release(WorkerFleck* worker) {
+    if (worker->socket_fd < 0) return;
+
+    pthread_mutex_lock(&pool_mutex);
+    PoolEndpoint* endpoint = find_endpoint(worker, 1);
+    if (endpoint != NULL && endpoint->num_idle < FLECK_POOL_MAX_IDLE) {
+        endpoint->sockets[endpoint->num_idle++] = worker->socket_fd;
+    } else {
+        transport_close(worker->socket_fd);
+    }
+    pthread_mutex_unlock(&pool_mutex);
+
+    worker->socket_fd = -1;
+}
+
+/***********************************************
+*
+* @Finalitat: Tancar totes les connexions inactives del pool (logout o sortida de Fleck).
+* @Parametres: ---
+* @Retorn: ---
+*
+************************************************/
+void FLECK_pool_close_all(void) {
+    pthread_mutex_lock(&pool_mutex);
+    for (int i = 0; i < num_endpoints; i++) {
+        for (int j = 0; j < endpoints[i].num_idle; j++) {
+            transport_close(endpoints[i].sockets[j]);
+        }
+        free(endpoints[i].IP);
+        free(endpoints[i].Port);
+    }
+    num_endpoints = 0;
+    pthread_mutex_unlock(&pool_mutex);
+}
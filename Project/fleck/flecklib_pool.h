@@ -0,0 +1,22 @@
+#ifndef FLECKLIB_POOL_H
+#define FLECKLIB_POOL_H
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+
+#include "../config/config.h"
+#include "../config/connections.h"
+#include "../config/transport.h"
+#include "structures.h"
+
+// Pool de conexiones persistentes Fleck-Worker: las conexiones se reutilizan para distorsiones consecutivas
+#define FLECK_POOL_MAX_ENDPOINTS 8      // Workers distintos con conexiones guardadas
+#define FLECK_POOL_MAX_IDLE 2           // Conexiones inactivas guardadas por Worker
+
+
+int FLECK_pool_acquire(WorkerFleck* worker);
+void FLECK_pool_release(WorkerFleck* worker);
+void FLECK_pool_close_all(void);
+
+#endif
@@ -1,6 +1,12 @@
 #ifndef STRUCTURES_H
 #define STRUCTURES_H
 
+#include <pthread.h>
+#include <stdint.h>
+
+// Resultado de una distorsión lanzada en modo script (definido en flecklib_distort.h)
+typedef struct FleckJob FleckJob;
+
 // Estructura para almacenar la configuración de Fleck
 typedef struct {
     char *username;   // Nombre de usuario 
@@ -15,6 +21,9 @@ typedef struct {
     char* Port;  // Puerto de Worker
     char* workerType;
     int socket_fd;
+    int pooled;     // 1 si la conexión se ha reutilizado del pool (puede haberla cerrado el Worker)
+    int fd_passing; // 1 si el Worker acepta los archivos como descriptor (mismo host, socket Unix)
+    unsigned long job_id;   // Identificador de la distorsión en Gotham (0 si Gotham no lo envía)
 
     int status; // Estado de la distorsión en marcha [0-100%]
 } WorkerFleck;
@@ -32,6 +41,34 @@ typedef struct {
 
     int socket_gotham; // Socket de conexión con Gotham
 
+    char job_id[32];    // Identificador de la distorsión en las tramas con el Worker (id de Gotham o <pid>-<n>)
+    unsigned long gotham_job;   // Identificador de la distorsión en el registro de Gotham (0 si no tiene)
+    int job_done;               // 1 cuando el archivo distorsionado se ha verificado
+    int priority;               // Prioridad pedida en el comando (0 = normal, hasta SCHED_MAX_PRIORITY)
+    FleckJob* job;      // Resultado a rellenar (modo script), NULL en modo interactivo
+
 } DistortInfo;
 
+// Estado de la sesión de Fleck compartido por todos los comandos
+typedef struct {
+    FleckConfig* config;
+    int socket_gotham;              // Socket de conexión con Gotham (-1 si no hay conexión)
+
+    WorkerFleck* worker_text;
+    WorkerFleck* worker_media;
+    int flag_distort_text_finished;     // Indica si hay una distorsión de tipo Text acabada
+    int flag_distort_media_finished;    // Indica si hay una distorsión de tipo Media acabada
+
+    // Modo no interactivo (--script / --exec)
+    int scripted;
+    int json_fd;                    // Descriptor para la salida JSON (-1 si no se usa)
+    pthread_t thread_text;
+    pthread_t thread_media;
+    FleckJob* job_text;             // Distorsión Text en curso (NULL si no hay)
+    FleckJob* job_media;            // Distorsión Media en curso (NULL si no hay)
+    int jobs_ok;
+    int jobs_failed;
+    int commands_failed;
+} FleckSession;
+
 #endif
\ No newline at end of file
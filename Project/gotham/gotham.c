@@ -38,6 +38,7 @@ void handle_sigint(/*int sig*/) {
     // CONFIG
     free(globalInfo->config->ip_fleck);
     free(globalInfo->config->ip_workers);
+    free(globalInfo->config->capture);
     free(globalInfo->config);
 
 
@@ -54,6 +55,7 @@ void handle_sigint(/*int sig*/) {
     pthread_mutex_unlock(&globalInfo->worker_mutex);
 
     pthread_mutex_destroy(&globalInfo->worker_mutex);   // Destruir el mutex
+    pthread_cond_destroy(&globalInfo->pull_cond);
     printF("Memoria de los Workers liberada correctamente.\n\n");
 
 
@@ -75,6 +77,11 @@ void handle_sigint(/*int sig*/) {
 
     // THREADS
     cancel_and_wait_threads(globalInfo);
+    job_ledger_destroy(&globalInfo->jobs);
+    sched_model_destroy(&globalInfo->sched);
+    rate_limiter_destroy(&globalInfo->user_limits);
+    rate_limiter_destroy(&globalInfo->ip_limits);
+    transport_capture_close();
     free(globalInfo);
 
 
@@ -191,11 +198,13 @@ void* fleck_server(/*void* arg*/) {
             globalInfo->fleck_sockets[globalInfo->num_flecks] = args->socket_connection;
             globalInfo->num_flecks++;
             pthread_mutex_unlock(&globalInfo->fleck_mutex);
+            STATS_INC(globalInfo->stats.current_flecks);
             
 
             // Crear un thread para manejar la conexión con el cliente
             pthread_t thread_id;
             if (pthread_create(&thread_id, NULL, handle_fleck_connection, (void*)args) != 0) {
+                STATS_DEC(globalInfo->stats.current_flecks);
                 free(args);
                 perror("Error al crear el hilo");
                 continue;
@@ -292,12 +301,13 @@ int main(int argc, char *argv[]) {
         return -1;
     }
 
-    // Creamos struct GlobalInfoGotham para info general de gotham
-    globalInfo = malloc(sizeof(GlobalInfoGotham));
+    // Creamos struct GlobalInfoGotham para info general de gotham (alineado para los contadores de estadísticas)
+    globalInfo = aligned_alloc(_Alignof(GlobalInfoGotham), sizeof(GlobalInfoGotham));
     if (globalInfo == NULL) {
         perror("Error al asignar memoria para GlobalInfoGotham");
         return -1;
     }
+    memset(globalInfo, 0, sizeof(GlobalInfoGotham));    // Contadores de estadísticas a 0
 
     // Leer el archivo de configuración
     globalInfo->config = GOTHAM_read_config(argv[1]);
@@ -316,13 +326,29 @@ int main(int argc, char *argv[]) {
     // Mostrar configuración
     GOTHAM_show_config(globalInfo->config);
 
+    // Captura de tramas (después de crear Arkham para que el proceso hijo no la herede)
+    if (globalInfo->config->capture != NULL && transport_capture_open(globalInfo->config->capture) < 0) {
+        perror("Error al abrir el archivo de captura de tramas");
+    }
+
 
     /// Inicializamos toda la información general en GlobalInfo
     globalInfo->workers = 0;
     globalInfo->num_workers = 0;
-    globalInfo->enigma_pworker_index = -1;    //Inicializamos en -1 indicando que no hay
-    globalInfo->harley_pworker_index = -1;    //Inicializamos en -1 indicando que no hay 
+    // Clases de Workers conocidas (los Workers pueden registrar otras nuevas)
+    globalInfo->num_worker_classes = 0;
+    GOTHAM_add_worker_class(globalInfo, TEXT);
+    GOTHAM_add_worker_class(globalInfo, IMAGE);
+    GOTHAM_add_worker_class(globalInfo, AUDIO);
+    if (job_ledger_init(&globalInfo->jobs, JOB_LEDGER_SIZE) < 0) {
+        perror("Error al asignar memoria para el registro de distorsiones");
+        exit(EXIT_FAILURE);
+    }
+    sched_model_init(&globalInfo->sched);
+    rate_limiter_init(&globalInfo->user_limits, globalInfo->config->rate_user, globalInfo->config->rate_user_kb);
+    rate_limiter_init(&globalInfo->ip_limits, globalInfo->config->rate_ip, globalInfo->config->rate_ip_kb);
     pthread_mutex_init(&globalInfo->worker_mutex, NULL);
+    pthread_cond_init(&globalInfo->pull_cond, NULL);
 
     globalInfo->fleck_sockets = (int*)malloc(1 * sizeof(int));  //Inicializamos mem dinámica (para después poder hacer simplemente realloc)
     globalInfo->num_flecks = 0;
@@ -3,6 +3,9 @@
 #include <string.h>
 #include <arpa/inet.h>
 #include <stdarg.h>
+#include <math.h>
+#include <errno.h>
+#include <time.h>
 
 #include "../worker/worker.h"
 #include "gothamlib.h"
@@ -15,10 +18,90 @@ void GOTHAM_free_config(GothamConfig* config) {
     if (config) {
         free(config->ip_fleck);
         free(config->ip_workers);
+        free(config->capture);
         free(config);
     }
 }
 
+/***********************************************
+*
+* @Finalitat: Aplicar una opció <clau>=<valor> del fitxer de configuració de Gotham.
+* @Paràmetres: in/out: config = configuració a modificar.
+*             in: option = línia amb l’opció.
+* @Retorn: 1 si l’opció és vàlida, 0 si no.
+*
+************************************************/
+int GOTHAM_set_option(GothamConfig* config, char* option) {
+    char* value = strchr(option, '=');
+    if (value == NULL) {
+        value = "";
+    } else {
+        *value++ = '\0';
+    }
+    RateLimit limit;
+
+    if (strcmp(option, "phi_suspect") == 0 && atof(value) > 0) {
+        config->phi_suspect = atof(value);
+    } else if (strcmp(option, "phi_dead") == 0 && atof(value) > 0) {
+        config->phi_dead = atof(value);
+    } else if (strcmp(option, "phi_min_stddev_ms") == 0 && atoi(value) > 0) {
+        config->phi_min_stddev_ms = atoi(value);
+    } else if (strcmp(option, "phi_pause_ms") == 0 && atoi(value) >= 0) {
+        config->phi_pause_ms = atoi(value);
+    } else if (strcmp(option, "routing") == 0 && strcmp(value, "principal") == 0) {
+        config->routing = GOTHAM_ROUTING_PRINCIPAL;
+    } else if (strcmp(option, "routing") == 0 && strcmp(value, "affinity") == 0) {
+        config->routing = GOTHAM_ROUTING_AFFINITY;
+    } else if (strcmp(option, "routing") == 0 && strcmp(value, "pull") == 0) {
+        config->routing = GOTHAM_ROUTING_PULL;
+    } else if (strcmp(option, "max_workers") == 0 && atoi(value) > 0) {
+        config->max_workers = atoi(value);
+    } else if (strcmp(option, "user_max_inflight") == 0 && atoi(value) >= 0) {
+        config->user_max_inflight = atoi(value);
+    } else if (strcmp(option, "rate_user") == 0 && rate_limit_parse(value, &limit)) {
+        config->rate_user = limit;
+    } else if (strcmp(option, "rate_user_kb") == 0 && rate_limit_parse(value, &limit)) {
+        config->rate_user_kb = limit;
+    } else if (strcmp(option, "rate_ip") == 0 && rate_limit_parse(value, &limit)) {
+        config->rate_ip = limit;
+    } else if (strcmp(option, "rate_ip_kb") == 0 && rate_limit_parse(value, &limit)) {
+        config->rate_ip_kb = limit;
+    } else if (strcmp(option, "capture") == 0 && value[0] != '\0') {
+        free(config->capture);
+        config->capture = strdup(value);
+    } else {
+        char* buffer;
+        asprintf(&buffer, "Opción de configuración inválida: '%s'\n", option);
+        printF(buffer);
+        free(buffer);
+        return 0;
+    }
+    return 1;
+}
+
+/***********************************************
+*
+* @Finalitat: Posar els valors per defecte de les opcions <clau>=<valor> de Gotham.
+* @Paràmetres: out: config = configuració a inicialitzar.
+* @Retorn: ----
+*
+************************************************/
+void GOTHAM_default_options(GothamConfig* config) {
+    config->phi_suspect = GOTHAM_PHI_SUSPECT;
+    config->phi_dead = GOTHAM_PHI_DEAD;
+    config->phi_min_stddev_ms = GOTHAM_PHI_MIN_STDDEV_MS;
+    config->phi_pause_ms = GOTHAM_PHI_PAUSE_MS;
+    config->routing = GOTHAM_ROUTING_PRINCIPAL;
+    config->max_workers = MAX_WORKERS;
+    config->user_max_inflight = 0;
+    RateLimit no_limit = { .rate = 0, .burst = 0 };
+    config->rate_user = no_limit;
+    config->rate_user_kb = no_limit;
+    config->rate_ip = no_limit;
+    config->rate_ip_kb = no_limit;
+    config->capture = NULL;
+}
+
 /***********************************************
 *
 * @Finalitat: Llegir i parsejar el fitxer de configuració de Gotham.
@@ -86,6 +169,19 @@ GothamConfig* GOTHAM_read_config(const char *config_file) {
     config->port_workers = atoi(buffer); // Convertir string a entero
     free(buffer); // Liberar el buffer del puerto
 
+    // Opciones: valores por defecto y líneas <clave>=<valor> opcionales
+    GOTHAM_default_options(config);
+    while ((buffer = read_until(fd, '\n')) != NULL) {
+        if (buffer[0] != '\0' && buffer[0] != '#') {
+            GOTHAM_set_option(config, buffer);
+        }
+        free(buffer);
+    }
+    if (config->phi_dead < config->phi_suspect) {
+        printF("Aviso: phi_dead menor que phi_suspect, se usa phi_suspect.\n");
+        config->phi_dead = config->phi_suspect;
+    }
+
     close(fd);
     return config; // Devolver la configuración
 }
@@ -110,7 +206,27 @@ void GOTHAM_show_config(GothamConfig* config) {
     asprintf(&buffer, "IP Workers (Harley/Enigma): %s\n", config->ip_workers);
     printF(buffer);
     free(buffer);
-    asprintf(&buffer, "Puerto Workers (Harley/Enigma): %d\n\n", config->port_workers);
+    asprintf(&buffer, "Puerto Workers (Harley/Enigma): %d\n", config->port_workers);
+    printF(buffer);
+    free(buffer);
+    asprintf(&buffer, "Detector de fallos: phi_suspect=%.1f phi_dead=%.1f phi_min_stddev_ms=%d phi_pause_ms=%d\n",
+             config->phi_suspect, config->phi_dead, config->phi_min_stddev_ms, config->phi_pause_ms);
+    printF(buffer);
+    free(buffer);
+    const char* routing_names[] = { "principal", "affinity", "pull" };
+    asprintf(&buffer, "Encaminamiento de DISTORT: %s, max_workers=%d, user_max_inflight=%d (0 = sin límite)\n",
+             routing_names[config->routing], config->max_workers, config->user_max_inflight);
+    printF(buffer);
+    free(buffer);
+    if (config->capture != NULL) {
+        asprintf(&buffer, "Captura de tramas: %s\n", config->capture);
+        printF(buffer);
+        free(buffer);
+    }
+    asprintf(&buffer, "Límites de DISTORT (por segundo:ráfaga, 0 = sin límite): rate_user=%g:%g rate_user_kb=%g:%g "
+             "rate_ip=%g:%g rate_ip_kb=%g:%g\n\n",
+             config->rate_user.rate, config->rate_user.burst, config->rate_user_kb.rate, config->rate_user_kb.burst,
+             config->rate_ip.rate, config->rate_ip.burst, config->rate_ip_kb.rate, config->rate_ip_kb.burst);
     printF(buffer);
     free(buffer);
 }
@@ -131,7 +247,7 @@ void liberar_memoria_worker(Worker worker) {
     free(worker.Port);  
     
     if (worker.socket_fd > 0) {
-        close(worker.socket_fd);    // Cerrar socket Gotham-Worker
+        transport_close(worker.socket_fd);    // Cerrar socket Gotham-Worker
     }
 
 }
@@ -171,7 +287,7 @@ void liberar_memoria_flecks(GlobalInfoGotham* globalInfo) {
 
     for (int i = 0; i < globalInfo->num_flecks; i++) {
         if (globalInfo->fleck_sockets[i] > 0) {
-            close(globalInfo->fleck_sockets[i]);    // Cerrar socket Gotham-Fleck
+            transport_close(globalInfo->fleck_sockets[i]);    // Cerrar socket Gotham-Fleck
         }
     }
 
@@ -221,10 +337,641 @@ void* heartbeat_func(void* void_fd) {
     enviar_heartbeat_constantemente(*socket_fd);
     
 
-    close(*socket_fd); // Cerrar socket al finalizar el hilo
+    transport_close(*socket_fd); // Cerrar socket al finalizar el hilo
     return NULL;
 }
 
+/***********************************************
+*
+* @Finalitat: Estimar la càrrega d’un Worker: el màxim entre la informada al darrer HEARTBEAT i les
+*             distorsions en curs que Gotham li ha assignat (que inclou les assignades des de llavors).
+*             Cal cridar-la amb worker_mutex bloquejat.
+* @Paràmetres: in: globalInfo = punter a l’estat global de Gotham.
+*             in: worker = Worker.
+* @Retorn: Nombre estimat de distorsions en curs o en cua.
+*
+************************************************/
+static int worker_load(GlobalInfoGotham* globalInfo, Worker* worker) {
+    int reported = worker->queued_jobs + worker->active_jobs;
+    int assigned = job_ledger_active(&globalInfo->jobs, worker->key);
+    return (assigned > reported) ? assigned : reported;
+}
+
+/***********************************************
+*
+* @Finalitat: Decidir si s’admet una nova distorsió a un Worker segons la seva càrrega (worker_load, la
+*             mateixa que usa l’encaminament per afinitat) i la sospita del detector de fallos. Les
+*             distorsions que no estan en curs al Worker es consideren a la seva cua.
+*             Cal cridar-la amb worker_mutex bloquejat.
+* @Paràmetres: in: globalInfo = punter a l’estat global de Gotham.
+*             in: index = índex del Worker.
+*             in: load = càrrega del Worker (worker_load).
+*             in: small = 1 si la distorsió és petita o prioritària (s’admet fins que la cua és plena).
+* @Retorn: 0 si s’admet, o mil·lisegons que Fleck ha d’esperar abans de tornar-ho a provar
+*          (fins al proper HEARTBEAT, quan la càrrega s’actualitzi, o fins que es confirmi la caiguda).
+*
+************************************************/
+static long worker_busy_retry_ms(GlobalInfoGotham* globalInfo, int index, int load, int small) {
+    Worker* worker = &globalInfo->workers[index];
+    uint64_t now = timings_now_ns();
+
+    // Worker sospechoso de caída: reintentar cuando se haya confirmado (y reasignado el principal) o recuperado
+    if (worker->suspect) {
+        long retry_ms = (worker->dead_estimate_ns > now) ? (long)((worker->dead_estimate_ns - now) / 1000000) : 0;
+        return retry_ms + GOTHAM_BUSY_MIN_RETRY_MS;
+    }
+
+    int high_water_pct = small ? 100 : GOTHAM_BUSY_HIGH_WATER_PCT;
+    int queued = load - worker->active_jobs;
+    if (worker->queue_capacity <= 0 || queued * 100 < worker->queue_capacity * high_water_pct) {
+        return 0;
+    }
+
+    long elapsed_ms = (long)((now - worker->load_updated_ns) / 1000000);
+    long retry_ms = HEARTBEAT_SLEEP_TIME * 1000L - elapsed_ms;
+    return (retry_ms < GOTHAM_BUSY_MIN_RETRY_MS) ? GOTHAM_BUSY_MIN_RETRY_MS : retry_ms;
+}
+
+/***********************************************
+*
+* @Finalitat: Comprovar si un Worker atén un tipus de fitxer (la seva llista de tipus registrada).
+* @Paràmetres: in: worker = Worker a comprovar.
+*             in: kind = tipus de fitxer ("Text", "Image", "Audio"...).
+* @Retorn: 1 si l’atén, 0 si no.
+*
+************************************************/
+static int worker_serves(Worker* worker, const char* kind) {
+    // workerType: tipos separados por comas (p.e. "Image,Audio")
+    size_t len = strlen(kind);
+    const char* type = worker->workerType;
+    while (type != NULL) {
+        if (strncmp(type, kind, len) == 0 && (type[len] == ',' || type[len] == '\0')) {
+            return 1;
+        }
+        type = strchr(type, ',');
+        if (type != NULL) type++;
+    }
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalitat: Cercar una classe de Workers pel tipus de fitxer que atén.
+*             Cal cridar-la amb worker_mutex bloquejat.
+* @Paràmetres: in: globalInfo = punter a l’estat global de Gotham.
+*             in: kind = tipus de fitxer.
+* @Retorn: Índex a worker_classes o -1 si no existeix.
+*
+************************************************/
+static int find_worker_class(GlobalInfoGotham* globalInfo, const char* kind) {
+    for (int i = 0; i < globalInfo->num_worker_classes; i++) {
+        if (strcmp(globalInfo->worker_classes[i].kind, kind) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/***********************************************
+*
+* @Finalitat: Afegir una classe de Workers (si no existeix) per a un tipus de fitxer. Les classes
+*             es creen a l’inici de Gotham; els Workers només es poden registrar a les existents.
+*             Cal cridar-la abans de crear els fils.
+* @Paràmetres: in: globalInfo = punter a l’estat global de Gotham.
+*             in: kind = tipus de fitxer.
+* @Retorn: Índex a worker_classes, o -1 si la taula és plena o el tipus no és vàlid.
+*
+************************************************/
+int GOTHAM_add_worker_class(GlobalInfoGotham* globalInfo, const char* kind) {
+    int index = find_worker_class(globalInfo, kind);
+    if (index >= 0) {
+        return index;
+    }
+    if (globalInfo->num_worker_classes >= MAX_WORKER_CLASSES || kind[0] == '\0' || strlen(kind) >= sizeof(globalInfo->worker_classes[0].kind)) {
+        return -1;
+    }
+
+    index = globalInfo->num_worker_classes++;
+    strcpy(globalInfo->worker_classes[index].kind, kind);
+    globalInfo->worker_classes[index].pworker_index = -1;
+    globalInfo->worker_classes[index].pull_head = NULL;
+    globalInfo->worker_classes[index].pull_tail = NULL;
+    return index;
+}
+
+/***********************************************
+*
+* @Finalitat: Formatejar l’identificador <IP>:<Port> d’un Worker (el que s’usa al registre de distorsions).
+* @Paràmetres: in: worker = Worker.
+*             out: key = buffer de destí.
+*             in: size = mida del buffer.
+* @Retorn: ----
+*
+************************************************/
+static void worker_key(Worker* worker, char* key, size_t size) {
+    snprintf(key, size, "%s:%s", worker->IP, worker->Port);
+}
+
+/***********************************************
+*
+* @Finalitat: Calcular la puntuació de rendezvous (HRW) d’una clau per a un Worker: el Worker amb
+*             la puntuació més alta és el propietari de la clau, i en afegir o treure Workers
+*             només canvien de propietari les claus del Worker afectat.
+* @Paràmetres: in: key = clau d’afinitat (<usuari>/<fitxer>).
+*             in: worker = Worker candidat.
+* @Retorn: Puntuació de 64 bits.
+*
+************************************************/
+static uint64_t affinity_score(const char* key, Worker* worker) {
+    // FNV-1a sobre <clave>@<IP>:<Puerto>
+    uint64_t hash = 1469598103934665603ULL;
+    const char* parts[] = { key, "@", worker->IP, ":", worker->Port };
+    for (size_t p = 0; p < sizeof(parts) / sizeof(parts[0]); p++) {
+        for (const char* c = parts[p]; *c != '\0'; c++) {
+            hash ^= (unsigned char)*c;
+            hash *= 1099511628211ULL;
+        }
+    }
+
+    // Mezcla final (splitmix64) para repartir bien claves que sólo difieren al final
+    hash ^= hash >> 30;
+    hash *= 0xbf58476d1ce4e5b9ULL;
+    hash ^= hash >> 27;
+    hash *= 0x94d049bb133111ebULL;
+    hash ^= hash >> 31;
+    return hash;
+}
+
+/***********************************************
+*
+* @Finalitat: Escollir el Worker que atendrà una distorsió i aplicar-hi el control d’admissió. Amb
+*             routing=principal és el Worker principal del tipus; amb routing=affinity és el Worker no
+*             sospitós i no saturat amb més puntuació HRW per a <usuari>/<fitxer> (el que ja té el fitxer
+*             a uploads/<usuari>/), saltant als següents si la seva càrrega supera
+*             GOTHAM_AFFINITY_LOAD_FACTOR vegades la mitjana. Cal cridar-la amb worker_mutex bloquejat.
+* @Paràmetres: in: globalInfo = punter a l’estat global de Gotham.
+*             in: mediaType = tipus de fitxer (classe de Workers).
+*             in: username = usuari del Fleck (pot ser NULL si no ha fet CONNECT).
+*             in: fileName = fitxer a distorsionar.
+*             in: small = 1 si la distorsió és petita o prioritària.
+*             out: is_owner = 1 si el Worker escollit és el propietari de la clau, 0 si s’ha desviat.
+*             out: retry_ms = 0 si s’admet, o l’espera més curta indicada pels candidats si tots estan saturats.
+* @Retorn: Índex del Worker a l’array de workers, o -1 si no n’hi ha cap de la classe.
+*
+************************************************/
+static int select_worker(GlobalInfoGotham* globalInfo, const char* mediaType, const char* username, const char* fileName,
+                         int small, int* is_owner, long* retry_ms) {
+    int class_index = find_worker_class(globalInfo, mediaType);
+    int principal = (class_index >= 0) ? globalInfo->worker_classes[class_index].pworker_index : -1;
+    *is_owner = 1;
+    *retry_ms = 0;
+    if (principal < 0) {
+        return principal;
+    }
+    // Con routing=principal el único candidato es el principal
+    int* loads = (globalInfo->config->routing == GOTHAM_ROUTING_AFFINITY) ? malloc(globalInfo->num_workers * sizeof(int)) : NULL;
+    if (loads == NULL) {
+        *retry_ms = worker_busy_retry_ms(globalInfo, principal, worker_load(globalInfo, &globalInfo->workers[principal]), small);
+        return principal;
+    }
+
+    // Carga media de los Workers del tipo que pueden recibir Flecks (incluyendo la nueva distorsión).
+    // La carga de cada candidato se calcula una sola vez (-1 si no es candidato) y sirve también para
+    // la admisión: los saturados no pueden recibir la distorsión
+    int candidates = 0;
+    int total_load = 0;
+    for (int i = 0; i < globalInfo->num_workers; i++) {
+        Worker* worker = &globalInfo->workers[i];
+        loads[i] = -1;
+        if (!worker->suspect && worker_serves(worker, mediaType)) {
+            loads[i] = worker_load(globalInfo, worker);
+            candidates++;
+            total_load += loads[i];
+        }
+    }
+    if (candidates == 0) {
+        free(loads);
+        // Todos sospechosos: reintentar cuando se confirme la caída del principal o se recupere
+        *retry_ms = worker_busy_retry_ms(globalInfo, principal, worker_load(globalInfo, &globalInfo->workers[principal]), small);
+        return principal;
+    }
+    double max_load = ceil(GOTHAM_AFFINITY_LOAD_FACTOR * (total_load + 1) / candidates);
+
+    char* key;
+    asprintf(&key, "%s/%s", username ? username : "", fileName ? fileName : "");
+
+    // owner: propietario de la clave entre todos los candidatos; chosen: el mejor con carga acotada;
+    // fallback: el mejor no saturado aunque supere la carga máxima
+    int owner = -1, chosen = -1, fallback = -1;
+    uint64_t owner_score = 0, chosen_score = 0, fallback_score = 0;
+    long min_retry_ms = -1;
+    for (int i = 0; i < globalInfo->num_workers; i++) {
+        if (loads[i] < 0) {
+            continue;
+        }
+        uint64_t score = affinity_score(key, &globalInfo->workers[i]);
+        if (owner < 0 || score > owner_score) {
+            owner = i;
+            owner_score = score;
+        }
+        long busy_ms = worker_busy_retry_ms(globalInfo, i, loads[i], small);
+        if (busy_ms > 0) {
+            if (min_retry_ms < 0 || busy_ms < min_retry_ms) {
+                min_retry_ms = busy_ms;
+            }
+            continue;
+        }
+        if (fallback < 0 || score > fallback_score) {
+            fallback = i;
+            fallback_score = score;
+        }
+        if (loads[i] + 1 <= max_load && (chosen < 0 || score > chosen_score)) {
+            chosen = i;
+            chosen_score = score;
+        }
+    }
+    free(key);
+    free(loads);
+
+    if (chosen < 0) {
+        chosen = fallback;
+    }
+    if (chosen < 0) {
+        // Todos los candidatos saturados: reintentar cuando se espera que el primero tenga hueco
+        *retry_ms = min_retry_ms;
+        return owner;
+    }
+    *is_owner = (chosen == owner);
+    return chosen;
+}
+
+/***********************************************
+*
+* @Finalitat: Treure un DISTORT de la cua de la seva classe.
+* @Paràmetres: in/out: worker_class = classe de Workers.
+*             in: request = DISTORT a treure.
+*             in: prev = element anterior de la cua (NULL si és el primer).
+* @Retorn: ----
+*
+************************************************/
+static void unlink_pull_request(WorkerClass* worker_class, PullRequest* request, PullRequest* prev) {
+    if (prev != NULL) {
+        prev->next = request->next;
+    } else {
+        worker_class->pull_head = request->next;
+    }
+    if (worker_class->pull_tail == request) {
+        worker_class->pull_tail = prev;
+    }
+    request->next = NULL;
+}
+
+/***********************************************
+*
+* @Finalitat: Assignar a un Worker amb huecos lliures les distorsions en espera de les classes que
+*             atén (routing=pull), començant per la de menor cost esperat amb envelliment (SEJF).
+*             Cal cridar-la amb worker_mutex bloquejat.
+* @Paràmetres: in: globalInfo = punter a l’estat global de Gotham.
+*             in: index = índex del Worker.
+* @Retorn: Nombre de distorsions reclamades.
+*
+************************************************/
+static int claim_pull_requests(GlobalInfoGotham* globalInfo, int index) {
+    Worker* worker = &globalInfo->workers[index];
+    int claimed = 0;
+
+    uint64_t now = timings_now_ns();
+    while (worker->pull_slots > 0 && !worker->suspect) {
+        // Entre las clases que atiende, el DISTORT con menor puntuación (a igualdad, el más antiguo)
+        WorkerClass* best_class = NULL;
+        PullRequest* best = NULL;
+        PullRequest* best_prev = NULL;
+        double best_score = 0;
+        for (int c = 0; c < globalInfo->num_worker_classes; c++) {
+            WorkerClass* worker_class = &globalInfo->worker_classes[c];
+            if (!worker_serves(worker, worker_class->kind)) {
+                continue;
+            }
+            PullRequest* prev = NULL;
+            for (PullRequest* it = worker_class->pull_head; it != NULL; prev = it, it = it->next) {
+                double score = sched_score(it->expected_ms, it->priority, it->enqueued_ns, now);
+                if (best == NULL || score < best_score || (score == best_score && it->enqueued_ns < best->enqueued_ns)) {
+                    best_class = worker_class;
+                    best = it;
+                    best_prev = prev;
+                    best_score = score;
+                }
+            }
+        }
+        if (best == NULL) {
+            break;
+        }
+
+        unlink_pull_request(best_class, best, best_prev);
+        worker_key(worker, best->worker, sizeof(best->worker));
+        worker->pull_slots--;
+        claimed++;
+    }
+
+    if (claimed > 0) {
+        pthread_cond_broadcast(&globalInfo->pull_cond);
+    }
+    return claimed;
+}
+
+/***********************************************
+*
+* @Finalitat: Encuar un DISTORT a la cua de la seva classe i esperar que un Worker lliure el
+*             reclami (routing=pull). Si hi ha Workers amb huecos lliures, el reclamen de seguida.
+*             Cal cridar-la amb worker_mutex bloquejat (s’allibera mentre s’espera).
+* @Paràmetres: in: globalInfo = punter a l’estat global de Gotham.
+*             in: class_index = classe de Workers del fitxer.
+*             in: expected_ms = durada esperada de la distorsió.
+*             in: priority = prioritat demanada per Fleck.
+*             out: retry_ms = temps que ha d’esperar Fleck abans de tornar-ho a demanar si ningú
+*                             reclama la distorsió (0 si s’ha reclamat).
+* @Retorn: Índex del Worker que l’ha reclamada, o -1 si cap ho ha fet a temps.
+*
+************************************************/
+static int wait_pull_worker(GlobalInfoGotham* globalInfo, int class_index, double expected_ms, int priority, long* retry_ms) {
+    WorkerClass* worker_class = &globalInfo->worker_classes[class_index];
+    PullRequest request = { .worker = "", .expected_ms = expected_ms, .priority = priority,
+                            .enqueued_ns = timings_now_ns(), .next = NULL };
+    if (worker_class->pull_tail != NULL) {
+        worker_class->pull_tail->next = &request;
+    } else {
+        worker_class->pull_head = &request;
+    }
+    worker_class->pull_tail = &request;
+
+    // Workers con huecos libres: empezando por el que tiene más (cada uno reclama por puntuación)
+    while (request.worker[0] == '\0') {
+        int idlest = -1;
+        for (int i = 0; i < globalInfo->num_workers; i++) {
+            Worker* worker = &globalInfo->workers[i];
+            if (worker->pull_slots > 0 && !worker->suspect && worker_serves(worker, worker_class->kind)
+                && (idlest < 0 || worker->pull_slots > globalInfo->workers[idlest].pull_slots)) {
+                idlest = i;
+            }
+        }
+        if (idlest < 0 || claim_pull_requests(globalInfo, idlest) == 0) {
+            break;
+        }
+    }
+
+    // Esperar a que algún Worker lo reclame con TYPE_JOB_REQUEST
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += GOTHAM_PULL_WAIT_MS / 1000;
+    deadline.tv_nsec += (GOTHAM_PULL_WAIT_MS % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    while (request.worker[0] == '\0') {
+        if (pthread_cond_timedwait(&globalInfo->pull_cond, &globalInfo->worker_mutex, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+
+    *retry_ms = 0;
+    if (request.worker[0] == '\0') {
+        // Nadie la ha reclamado: sacarla de la cola
+        PullRequest* prev = NULL;
+        for (PullRequest* it = worker_class->pull_head; it != NULL; prev = it, it = it->next) {
+            if (it == &request) {
+                unlink_pull_request(worker_class, &request, prev);
+                break;
+            }
+        }
+        *retry_ms = GOTHAM_BUSY_MIN_RETRY_MS;
+        return -1;
+    }
+
+    // El Worker que la ha reclamado puede haber cambiado de índice (o haber caído) mientras se esperaba
+    char key[64];
+    for (int i = 0; i < globalInfo->num_workers; i++) {
+        worker_key(&globalInfo->workers[i], key, sizeof(key));
+        if (strcmp(key, request.worker) == 0) {
+            return i;
+        }
+    }
+    *retry_ms = GOTHAM_BUSY_MIN_RETRY_MS;
+    return -1;
+}
+
+/***********************************************
+*
+* @Finalitat: Processar una trama TYPE_JOB_STATUS (<id>&<fase>) i actualitzar el registre de
+*             distorsions. Quan una distorsió acaba, mostra i registra la durada de cada fase.
+* @Paràmetres: in: globalInfo = punter a l’estat global de Gotham.
+*             in: data = dades de la trama.
+*             in: worker = <IP>:<Port> del Worker que informa, o NULL si informa Fleck.
+* @Retorn: ----
+*
+************************************************/
+void handle_job_status(GlobalInfoGotham* globalInfo, char* data, const char* worker) {
+    char* saveptr = NULL;
+    char* id_str = strtok_r(data, "&", &saveptr);
+    char* phase_str = strtok_r(NULL, "&", &saveptr);
+    if (id_str == NULL || phase_str == NULL) {
+        return;
+    }
+
+    JobEntry job;
+    int phase = job_ledger_phase(phase_str);
+    if (!job_ledger_update(&globalInfo->jobs, strtoul(id_str, NULL, 10), phase, worker, &job)) {
+        return;
+    }
+    if (phase != JOB_PHASE_DONE && phase != JOB_PHASE_FAILED) {
+        return;
+    }
+    if (phase == JOB_PHASE_DONE) {
+        // Ajustar el coste esperado de su tipo para ordenar las próximas distorsiones
+        sched_model_record(&globalInfo->sched, timings_kind(job.filename), job.size,
+                           (job.phase_start_ns[JOB_PHASE_DONE] - job.created_ns) / 1e6);
+    }
+
+    // Duración de cada fase alcanzada: desde su inicio hasta el inicio de la siguiente alcanzada
+    char phases[128] = "";
+    size_t len = 0;
+    for (int p = JOB_PHASE_ASSIGNED; p < JOB_PHASE_DONE; p++) {
+        if (job.phase_start_ns[p] == 0) {
+            continue;
+        }
+        uint64_t end = job.phase_start_ns[phase];
+        for (int next = p + 1; next < JOB_PHASE_DONE; next++) {
+            if (job.phase_start_ns[next] != 0) {
+                end = job.phase_start_ns[next];
+                break;
+            }
+        }
+        len += snprintf(phases + len, sizeof(phases) - len, " %s=%.1fms", job_ledger_phase_name(p),
+                        (end - job.phase_start_ns[p]) / 1e6);
+        if (len >= sizeof(phases)) {
+            break;
+        }
+    }
+
+    char* buffer;
+    asprintf(&buffer, "Distorsión %lu (%s/%s, %s, %ld bytes, prioridad %d) %s en %.1fms:%s, reasignaciones=%d\n",
+             job.job_id, job.username, job.filename, job.kind, job.size, job.priority,
+             phase == JOB_PHASE_DONE ? "completada" : "fallida",
+             (job.phase_start_ns[phase] - job.created_ns) / 1e6, phases, job.reassignments);
+    printF(buffer);
+    log_event(globalInfo, buffer);
+    free(buffer);
+}
+
+/***********************************************
+*
+* @Finalitat: Descomptar les fitxes d’un DISTORT als límits de la IP d’origen i de l’usuari. Cada
+*             limitador ho comprova i descompta sota el seu bloqueig; si l’usuari no en té prou es
+*             retornen les de la IP.
+* @Paràmetres: in: globalInfo = punter a l’estat global de Gotham.
+*             in: request = petició de Fleck.
+* @Retorn: 0 si s’han descomptat, o mil·lisegons fins que hi haurà fitxes suficients.
+*
+************************************************/
+static long charge_rate_limits(GlobalInfoGotham* globalInfo, const DistortRequest* request) {
+    uint64_t now = timings_now_ns();
+    double kb = request->file_size / 1024.0;
+    long limit_ms = rate_limiter_try_consume(&globalInfo->ip_limits, request->source_ip, kb, now);
+    if (limit_ms == 0 && request->username != NULL) {
+        limit_ms = rate_limiter_try_consume(&globalInfo->user_limits, request->username, kb, now);
+        if (limit_ms > 0) {
+            rate_limiter_refund(&globalInfo->ip_limits, request->source_ip, kb, now);
+        }
+    }
+    return limit_ms;
+}
+
+/***********************************************
+*
+* @Finalitat: Decidir la resposta a un DISTORT d’un Fleck: límits de peticions per usuari i IP,
+*             classe de Workers del fitxer, límit de distorsions en curs per usuari, elecció del
+*             Worker segons el routing i control d’admissió. Si s’assigna un Worker es registra la
+*             distorsió. Actualitza les estadístiques de Gotham però no envia res a Fleck (amb
+*             routing=pull pot bloquejar fins a GOTHAM_PULL_WAIT_MS esperant que un Worker la reclami).
+* @Paràmetres: in: globalInfo = punter a l’estat global de Gotham.
+*             in: request = petició de Fleck.
+*             out: route = decisió: estat, Worker assignat i resposta, o espera indicada a Fleck.
+* @Retorn: Estat de la decisió (GOTHAM_ROUTE_*).
+*
+************************************************/
+int GOTHAM_route_distort(GlobalInfoGotham* globalInfo, const DistortRequest* request, DistortRoute* route) {
+    route->job_id = request->job_id;
+    route->retry_ms = 0;
+    route->worker[0] = '\0';
+    route->reply[0] = '\0';
+
+    // Un tamaño negativo o mal formado se rechaza: no puede adelantar a las distorsiones en cola ni sumar fichas
+    if (request->file_size < 0) {
+        snprintf(route->kind, sizeof(route->kind), "%s", request->media_type);
+        STATS_INC(globalInfo->stats.media_ko);
+        return route->status = GOTHAM_ROUTE_MEDIA_KO;
+    }
+
+    // Límites de peticiones y KB declarados por usuario y por IP de origen (no se aplican al pedir
+    // otro Worker para una distorsión en curso del mismo Fleck: un job_id desconocido o ajeno cuenta
+    // como distorsión nueva). Aquí sólo se consultan: las fichas se descuentan al asignar Worker, así
+    // que las respuestas MEDIA_KO, DISTORT_KO o DISTORT_BUSY no las gastan
+    int reassignment = job_ledger_is_reassignment(&globalInfo->jobs, request->job_id, request->owner);
+    if (!reassignment) {
+        uint64_t now = timings_now_ns();
+        double kb = request->file_size / 1024.0;
+        long limit_ms = rate_limiter_wait_ms(&globalInfo->ip_limits, request->source_ip, kb, now);
+        if (request->username != NULL) {
+            long user_ms = rate_limiter_wait_ms(&globalInfo->user_limits, request->username, kb, now);
+            limit_ms = (user_ms > limit_ms) ? user_ms : limit_ms;
+        }
+        if (limit_ms > 0) {
+            snprintf(route->kind, sizeof(route->kind), "%s", request->media_type);
+            route->retry_ms = limit_ms;
+            STATS_INC(globalInfo->stats.distort_limited);
+            return route->status = GOTHAM_ROUTE_LIMITED;
+        }
+    }
+
+    // Fleck antiguos piden "Media": concretar la clase (Image o Audio) a partir de la extensión
+    const char* kind = request->media_type;
+    if (strcmp(kind, MEDIA) == 0 && request->file_name != NULL && wich_media(request->file_name) != NULL) {
+        kind = wich_media(request->file_name);
+    }
+    snprintf(route->kind, sizeof(route->kind), "%s", kind);
+
+    // Comprobar si la clase existe y si tiene Workers para el archivo solicitado
+    pthread_mutex_lock(&globalInfo->worker_mutex);
+    int class_index = find_worker_class(globalInfo, kind);
+    int has_workers = (class_index >= 0 && globalInfo->worker_classes[class_index].pworker_index >= 0);
+    pthread_mutex_unlock(&globalInfo->worker_mutex);
+
+    if (class_index < 0) {
+        STATS_INC(globalInfo->stats.media_ko);
+        return route->status = GOTHAM_ROUTE_MEDIA_KO;
+    }
+    if (!has_workers) {
+        STATS_INC(globalInfo->stats.distort_ko);
+        return route->status = GOTHAM_ROUTE_NO_WORKERS;
+    }
+
+    // Escoger Worker y aplicar el control de admisión: si está saturado, indicar a Fleck cuándo reintentar.
+    // Con routing=pull, esperar a que un Worker libre reclame la distorsión
+    double expected_ms = sched_expected_ms(&globalInfo->sched, timings_kind(request->file_name), request->file_size);
+    int small = (expected_ms <= SCHED_SMALL_JOB_MS || request->priority > 0);
+    // Límite de distorsiones en curso por usuario (no se aplica al pedir otro Worker para una ya asignada)
+    JobEntry oldest;
+    int user_limited = globalInfo->config->user_max_inflight > 0 && request->username != NULL
+        && job_ledger_user_active(&globalInfo->jobs, request->username, reassignment ? request->job_id : 0, &oldest) >= globalInfo->config->user_max_inflight;
+    pthread_mutex_lock(&globalInfo->worker_mutex);
+    int is_owner = 1;
+    int index;
+    long retry_ms;
+    if (user_limited) {
+        // Reintentar cuando se espera que acabe su distorsión más antigua
+        index = -1;
+        retry_ms = (long)(sched_expected_ms(&globalInfo->sched, timings_kind(oldest.filename), oldest.size)
+                          - (timings_now_ns() - oldest.created_ns) / 1e6);
+        if (retry_ms < GOTHAM_USER_LIMIT_RETRY_MS) {
+            retry_ms = GOTHAM_USER_LIMIT_RETRY_MS;
+        }
+    } else if (globalInfo->config->routing == GOTHAM_ROUTING_PULL) {
+        index = wait_pull_worker(globalInfo, class_index, expected_ms, request->priority, &retry_ms);
+    } else {
+        index = select_worker(globalInfo, kind, request->username, request->file_name, small, &is_owner, &retry_ms);
+    }
+    long limit_ms = (index >= 0 && retry_ms == 0 && !reassignment) ? charge_rate_limits(globalInfo, request) : 0;
+    if (limit_ms > 0) {
+        // Otro DISTORT del mismo usuario o IP ha gastado las fichas desde la consulta
+        route->status = GOTHAM_ROUTE_LIMITED;
+        route->retry_ms = limit_ms;
+        STATS_INC(globalInfo->stats.distort_limited);
+    } else if (index >= 0 && retry_ms == 0) {
+        // Registrar la distorsión (cuenta como carga del Worker hasta que acabe)
+        Worker* worker = &globalInfo->workers[index];
+        worker_key(worker, route->worker, sizeof(route->worker));
+        route->job_id = job_ledger_assign(&globalInfo->jobs, request->job_id, request->owner, request->username,
+                                          request->file_name, kind, request->file_size, request->priority, route->worker);
+        snprintf(route->reply, sizeof(route->reply), "%s&%s&%lu", worker->IP, worker->Port, route->job_id);
+        route->status = GOTHAM_ROUTE_ASSIGNED;
+        if (globalInfo->config->routing == GOTHAM_ROUTING_AFFINITY) {
+            if (is_owner) {
+                STATS_INC(globalInfo->stats.affinity_hits);
+            } else {
+                STATS_INC(globalInfo->stats.affinity_spills);
+            }
+        }
+    } else {
+        // Sin Worker disponible ahora mismo (saturado, sospechoso o recién caído)
+        route->status = user_limited ? GOTHAM_ROUTE_USER_BUSY : GOTHAM_ROUTE_BUSY;
+        route->retry_ms = (retry_ms > 0) ? retry_ms : GOTHAM_BUSY_MIN_RETRY_MS;
+        STATS_INC(globalInfo->stats.distort_busy);
+    }
+    pthread_mutex_unlock(&globalInfo->worker_mutex);
+
+    return route->status;
+}
+
 /***********************************************
 *
 * @Finalitat: Gestionar la connexió d’un Fleck entrant:
@@ -244,9 +991,23 @@ void* handle_fleck_connection(void* void_args) {
 
     unsigned char buffer[BUFFER_SIZE];
     int bytes_read;
+    char* fleck_username = NULL;    // Usuario del CONNECT (clave de afinidad de sus distorsiones)
+
+    // IP de origen de la conexión (clave de los límites por IP: la del CONNECT la declara el propio Fleck).
+    // Los Flecks conectados por socket Unix comparten la clave "unix" (mismo host)
+    char fleck_ip[INET6_ADDRSTRLEN] = "";
+    struct sockaddr_storage peer;
+    socklen_t peer_len = sizeof(peer);
+    if (getpeername(socket_fd, (struct sockaddr*)&peer, &peer_len) == 0) {
+        if (peer.ss_family == AF_INET) {
+            inet_ntop(AF_INET, &((struct sockaddr_in*)&peer)->sin_addr, fleck_ip, sizeof(fleck_ip));
+        } else if (peer.ss_family == AF_UNIX) {
+            snprintf(fleck_ip, sizeof(fleck_ip), "unix");
+        }
+    }
 
     // Leer constantemente las tramas de Fleck (hasta que desconecte)
-    while ((bytes_read = recv(socket_fd, buffer, BUFFER_SIZE, 0)) > 0) {
+    while ((bytes_read = transport_recv_frame(socket_fd, buffer)) > 0) {
         // Procesar la trama
         TramaResult *result = leer_trama(buffer);
         if (result == NULL || result->data == NULL) {
@@ -263,11 +1024,13 @@ void* handle_fleck_connection(void* void_args) {
         {  
             // Comando CONNECT
             printF("Comando CONNECT recibido de Fleck.\n");
+            STATS_INC(globalInfo->stats.connects);
 
             // Parsear los datos: <username>&<IP>&<Port> (duplicándolos para poder liberar memoria de result)
-            char *username = strdup(strtok(result->data, "&"));
-            char *ip = strdup(strtok(NULL, "&"));
-            char *port = strdup(strtok(NULL, "&"));
+            char *saveptr = NULL;
+            char *username = strdup(strtok_r(result->data, "&", &saveptr));
+            char *ip = strdup(strtok_r(NULL, "&", &saveptr));
+            char *port = strdup(strtok_r(NULL, "&", &saveptr));
 
             if (username && ip && port) {
                 //PRINTF
@@ -276,10 +1039,12 @@ void* handle_fleck_connection(void* void_args) {
                 printf(mensaje);
                 log_event(globalInfo, mensaje);
                 free(mensaje);
+                free(fleck_username);
+                fleck_username = username;
 
                 // Responder con OK
                 unsigned char *response = crear_trama(TYPE_CONNECT_FLECK_GOTHAM, (unsigned char*)"", strlen(""));  // DATA vacío
-                if (write(socket_fd, response, BUFFER_SIZE) < 0) {
+                if (transport_send_frame(socket_fd, response) < 0) {
                     perror("Error enviando respuesta OK a Fleck");
                 }
                 free(response);
@@ -288,7 +1053,7 @@ void* handle_fleck_connection(void* void_args) {
             } else {
                 // Responder con CON_KO si el formato es incorrecto
                 unsigned char *response = crear_trama(TYPE_CONNECT_FLECK_GOTHAM, (unsigned char*)"CON_KO", strlen("CON_KO"));
-                if (write(socket_fd, response, BUFFER_SIZE) < 0) {
+                if (transport_send_frame(socket_fd, response) < 0) {
                     perror("Error enviando respuesta CON_KO a Fleck");
                 }
                 free(response);
@@ -299,78 +1064,106 @@ void* handle_fleck_connection(void* void_args) {
             // Comando DISTORT
             printF("Comando DISTORT recibido de Fleck.\n");
             log_event(globalInfo, "Comando DISTORT recibido de Fleck.");
+            STATS_INC(globalInfo->stats.distort_requests);
             
-            // Parsear los datos: <mediaType>&<fileName> (duplicándolos para poder liberar memoria de result)
-            char *mediaType = strdup(strtok(result->data, "&"));
-            char *fileName = strdup(strtok(NULL, "&"));
+            // Parsear los datos: <mediaType>&<fileName>[&<fileSize>&<job_id>[&<priority>]] (duplicándolos para poder
+            // liberar memoria de result); job_id distinto de 0 cuando Fleck vuelve a pedir Worker para una distorsión ya asignada
+            char *saveptr = NULL;
+            char *mediaType = strdup(strtok_r(result->data, "&", &saveptr));
+            char *fileName = strdup(strtok_r(NULL, "&", &saveptr));
+            char *size_str = strtok_r(NULL, "&", &saveptr);
+            char *job_str = strtok_r(NULL, "&", &saveptr);
+            char *priority_str = strtok_r(NULL, "&", &saveptr);
+            long fileSize = size_str ? sched_parse_size(size_str) : 0;
+            unsigned long request_job = job_str ? strtoul(job_str, NULL, 10) : 0;
+            int priority = priority_str ? atoi(priority_str) : 0;
+            if (priority < 0 || priority > SCHED_MAX_PRIORITY) {
+                priority = 0;
+            }
 
             free_tramaResult(result); // Liberar la trama procesada
 
-            // Comprobar si hay Workers para el archivo solicitado
-            if ((strcmp(mediaType, MEDIA) == 0 && globalInfo->harley_pworker_index < 0) || (strcmp(mediaType, TEXT) == 0 && globalInfo->enigma_pworker_index < 0))
-            {
-                // Responder con DISTORT_KO
-                unsigned char *response = crear_trama(TYPE_DISTORT_FLECK_GOTHAM, (unsigned char*)"DISTORT_KO", strlen("DISTORT_KO")); 
-                if (write(socket_fd, response, BUFFER_SIZE) < 0) {
-                    perror("Error enviando respuesta DISTORT_KO a Fleck");
-                }
-                free(response);
-                printF("Sin Workers disponibles. Respuesta de DISTORT_KO enviada a Fleck.\n");
-                log_event(globalInfo, "Sin Workers disponibles. Respuesta de DISTORT_KO enviada a Fleck.");
-
-                continue;
+            DistortRequest request = { .owner = socket_fd, .username = fleck_username, .source_ip = fleck_ip,
+                                       .media_type = mediaType, .file_name = fileName, .file_size = fileSize,
+                                       .job_id = request_job, .priority = priority };
+            DistortRoute route;
+            GOTHAM_route_distort(globalInfo, &request, &route);
+
+            // Responder a Fleck con el Worker escogido (<IP>&<Port>&<job_id>) o con el motivo del rechazo
+            char* data = NULL;
+            char* message = NULL;
+            switch (route.status) {
+                case GOTHAM_ROUTE_ASSIGNED:
+                    data = strdup(route.reply);
+                    asprintf(&message, "Worker de tipo '%s' enviado a Fleck.\n", route.kind);
+                    break;
+                case GOTHAM_ROUTE_LIMITED:
+                    // DISTORT_LIMIT&<ms hasta tener fichas suficientes>
+                    asprintf(&data, "%s&%ld", DISTORT_LIMIT_MSG, route.retry_ms);
+                    asprintf(&message, "Límite de DISTORT superado por '%s' (%s). Respuesta de DISTORT_LIMIT enviada a Fleck (%ldms).\n",
+                             fleck_username ? fleck_username : "", fleck_ip, route.retry_ms);
+                    break;
+                case GOTHAM_ROUTE_MEDIA_KO:
+                    data = strdup("MEDIA_KO");
+                    asprintf(&message, "Media type '%s' no reconocido. Respuesta de MEDIA_KO enviada a Fleck.\n", route.kind);
+                    break;
+                case GOTHAM_ROUTE_NO_WORKERS:
+                    data = strdup("DISTORT_KO");
+                    message = strdup("Sin Workers disponibles. Respuesta de DISTORT_KO enviada a Fleck.\n");
+                    break;
+                default:
+                    // Sin Worker disponible ahora mismo (saturado, sospechoso o recién caído): reintentar más tarde
+                    asprintf(&data, "DISTORT_BUSY&%ld", route.retry_ms);
+                    if (route.status == GOTHAM_ROUTE_USER_BUSY) {
+                        asprintf(&message, "Usuario '%s' con %d distorsiones en curso. Respuesta de DISTORT_BUSY enviada a Fleck.\n",
+                                 fleck_username, globalInfo->config->user_max_inflight);
+                    } else {
+                        message = strdup("Worker saturado o sospechoso. Respuesta de DISTORT_BUSY enviada a Fleck.\n");
+                    }
+                    break;
             }
+            unsigned char *response = crear_trama(TYPE_DISTORT_FLECK_GOTHAM, (unsigned char*)data, strlen(data));
+            free(data);
+            if (transport_send_frame(socket_fd, response) < 0) {
+                perror("Error enviando respuesta DISTORT a Fleck");
+            }
+            free(response);
 
-            // Enviar datos Worker
-            if (strcmp(mediaType, MEDIA) == 0)
-            {
-                // Responder con datos Worker Harley principal
-                char* data;
-                asprintf(&data, "%s&%s", globalInfo->workers[globalInfo->harley_pworker_index].IP, globalInfo->workers[globalInfo->harley_pworker_index].Port);
-                unsigned char *response = crear_trama(TYPE_DISTORT_FLECK_GOTHAM, (unsigned char*)data, strlen(data)); 
-                free(data);
-
-                if (write(socket_fd, response, BUFFER_SIZE) < 0) {
-                    perror("Error enviando respuesta DISTORT a Fleck");
-                }
-                free(response);
-                printF("Worker Harley pricipal enviado a Fleck.\n");
-                log_event(globalInfo, "Respuesta con Worker Harley pricipal enviado a Fleck.");
-            } else if (strcmp(mediaType, TEXT) == 0)
-            {
-                // Responder con datos Worker Enigma principal
-                char* data;
-                asprintf(&data, "%s&%s", globalInfo->workers[globalInfo->enigma_pworker_index].IP, globalInfo->workers[globalInfo->enigma_pworker_index].Port);
-                unsigned char *response = crear_trama(TYPE_DISTORT_FLECK_GOTHAM, (unsigned char*)data, strlen(data)); 
-                free(data);
-
-                if (write(socket_fd, response, BUFFER_SIZE) < 0) {
-                    perror("Error enviando respuesta DISTORT a Fleck");
-                }
-                free(response);
-                printF("Worker Enigma pricipal enviado a Fleck.\n");
-                log_event(globalInfo, "Respuesta con Worker Enigma pricipal enviado a Fleck.");
-            } else {
-                // Responder con MEDIA_KO
-                unsigned char *response = crear_trama(TYPE_DISTORT_FLECK_GOTHAM, (unsigned char*)"MEDIA_KO", strlen("MEDIA_KO")); 
-                if (write(socket_fd, response, BUFFER_SIZE) < 0) {
-                    perror("Error enviando respuesta MEDIA_KO a Fleck");
-                }
-                free(response);
-
-                char* buffer;
-                asprintf(&buffer, "Media type '%s' no reconocido. Respuesta de MEDIA_KO enviada a Fleck.\n", mediaType);
-                printF(buffer);
-                free(buffer);
+            printF(message);
+            if (route.status == GOTHAM_ROUTE_MEDIA_KO) {
                 log_event(globalInfo, "Media del comando DISTORT de Fleck no reconocida.");
+            } else {
+                log_event(globalInfo, message);
             }
+            free(message);
             free(mediaType);
             free(fileName);
             
+        } else if (result->type == TYPE_JOB_STATUS) {
+            // Estado de una distorsión informado por Fleck (no se responde)
+            handle_job_status(globalInfo, result->data, NULL);
+            free_tramaResult(result);
+
+        } else if (result->type == TYPE_STATS) {
+            // Comando STATS: responder con los contadores actuales
+            free_tramaResult(result);
+
+            char* data = GOTHAM_format_stats(globalInfo);
+            unsigned char *response = crear_trama(TYPE_STATS, (unsigned char*)data, strlen(data));
+            free(data);
+
+            if (transport_send_frame(socket_fd, response) < 0) {
+                perror("Error enviando estadísticas a Fleck");
+            }
+            free(response);
+
         } else if (result->type == TYPE_DISCONNECTION) {
             printF("Fleck desconectado.\n");
             log_event(globalInfo, "Fleck desconectado.");
-            close(socket_fd);
+            STATS_DEC(globalInfo->stats.current_flecks);
+            job_ledger_owner_gone(&globalInfo->jobs, socket_fd);
+            free(fleck_username);
+            transport_close(socket_fd);
             return NULL;
         }
         
@@ -383,7 +1176,10 @@ void* handle_fleck_connection(void* void_args) {
         perror("Error al recibir datos de Fleck");
     }
 
-    close(socket_fd);
+    STATS_DEC(globalInfo->stats.current_flecks);
+    job_ledger_owner_gone(&globalInfo->jobs, socket_fd);
+    free(fleck_username);
+    transport_close(socket_fd);
     return NULL;
 }
 
@@ -404,6 +1200,44 @@ int find_worker_bySocket(GlobalInfoGotham* globalInfo, int socket_fd) {
     return -1; // No se encontró el Worker
 }
 
+/***********************************************
+*
+* @Finalitat: Comprovar els tipus de fitxer que declara un Worker contra les classes configurades.
+*             "Media" (Harley sense tipus concrets) s’expandeix a Image i Audio; els tipus desconeguts
+*             s’ignoren (un Worker no pot ocupar classes noves). Cal cridar-la amb worker_mutex bloquejat.
+* @Paràmetres: in: globalInfo = punter a l’estat global de Gotham.
+*             in: types = tipus separats per comes rebuts a la trama de connexió (pot ser NULL).
+* @Retorn: Cadena dinàmica amb els tipus acceptats separats per comes, o NULL si no n’hi ha cap.
+*
+************************************************/
+static char* register_worker_kinds(GlobalInfoGotham* globalInfo, const char* types) {
+    if (types == NULL) {
+        return NULL;
+    }
+
+    char* copy = strdup(types);
+    char* kinds = NULL;
+    char* saveptr = NULL;
+    for (char* kind = strtok_r(copy, ",", &saveptr); kind != NULL; kind = strtok_r(NULL, ",", &saveptr)) {
+        const char* media_kinds[] = { IMAGE, AUDIO, NULL };
+        const char* single_kind[] = { kind, NULL };
+        const char** expanded = (strcmp(kind, MEDIA) == 0) ? media_kinds : single_kind;
+
+        for (int i = 0; expanded[i] != NULL; i++) {
+            if (find_worker_class(globalInfo, expanded[i]) < 0) {
+                log_event(globalInfo, "Tipo de Worker '%s' ignorado: no es un tipo configurado.", expanded[i]);
+                continue;
+            }
+            char* aux;
+            asprintf(&aux, "%s%s%s", kinds ? kinds : "", kinds ? "," : "", expanded[i]);
+            free(kinds);
+            kinds = aux;
+        }
+    }
+    free(copy);
+    return kinds;
+}
+
 /***********************************************
 *
 * @Finalitat: Emmagatzemar un nou Worker a la llista global:
@@ -411,25 +1245,36 @@ int find_worker_bySocket(GlobalInfoGotham* globalInfo, int socket_fd) {
 *             - Parsejar les dades de la trama rebuda
 *             - Actualitzar comptadors i notificar l’esdeveniment
 * @Paràmetres: in: globalInfo = punter a l’estat global de Gotham.
-*             in: result = TramaResult amb les dades del Worker.
-* @Retorn: 1 si té èxit, 0 en cas d’error.
+*             in: result = TramaResult amb les dades del Worker (l’allibera qui crida).
+* @Retorn: 1 si té èxit, 0 en cas d’error (amb worker_mutex ja desbloquejat).
 *
 ************************************************/
 int store_new_worker(GlobalInfoGotham* globalInfo, TramaResult* result) {
     
     // Comprobar que no se supere número máximo de Workers
-    if (globalInfo->num_workers >= MAX_WORKERS) {
+    if (globalInfo->num_workers >= globalInfo->config->max_workers) {
         pthread_mutex_unlock(&globalInfo->worker_mutex);
         printF("Error: No se pudo agregar el worker. Límite de workers alcanzado.\n");
         log_event(globalInfo, "Error: No se pudo agregar el worker. Límite de workers alcanzado.\n");
         return 0;
     }
+
+    // Procesar data con el formato <workerType>&<IP>&<Port> (workerType: tipos separados por comas).
+    // Un Worker sin ningún tipo configurado no se registra
+    char* saveptr = NULL;
+    char* kinds = register_worker_kinds(globalInfo, strtok_r(result->data, "&", &saveptr));
+    if (kinds == NULL) {
+        pthread_mutex_unlock(&globalInfo->worker_mutex);
+        printF("Not known type\n");
+        return 0;
+    }
     
     // Crear nuevo worker dinámico
     if (globalInfo->workers == NULL)
     {
         globalInfo->workers = (Worker *)malloc(sizeof(Worker));
         if (globalInfo->workers == NULL) {
+            free(kinds);
             pthread_mutex_unlock(&globalInfo->worker_mutex);
             perror("Failed to allocate memory for new worker");
             return 0;
@@ -439,6 +1284,7 @@ int store_new_worker(GlobalInfoGotham* globalInfo, TramaResult* result) {
         Worker* temp = realloc(globalInfo->workers, (globalInfo->num_workers + 1) * sizeof(Worker));
         if (globalInfo->workers == NULL) {
             free(globalInfo->workers);
+            free(kinds);
             pthread_mutex_unlock(&globalInfo->worker_mutex);
             perror("Failed to reallocate memory for workers array");
             return 0;
@@ -446,14 +1292,27 @@ int store_new_worker(GlobalInfoGotham* globalInfo, TramaResult* result) {
         globalInfo->workers = temp;
     }
 
-    // Procesar data con el formato <workerType>&<IP>&<Port>
-    globalInfo->workers[globalInfo->num_workers].workerType = strdup(strtok(result->data, "&"));
-    globalInfo->workers[globalInfo->num_workers].IP = strdup(strtok(NULL, "&"));
-    globalInfo->workers[globalInfo->num_workers].Port = strdup(strtok(NULL, "&"));
-    free_tramaResult(result);
+    globalInfo->workers[globalInfo->num_workers].IP = strdup(strtok_r(NULL, "&", &saveptr));
+    globalInfo->workers[globalInfo->num_workers].Port = strdup(strtok_r(NULL, "&", &saveptr));
+    worker_key(&globalInfo->workers[globalInfo->num_workers], globalInfo->workers[globalInfo->num_workers].key,
+               sizeof(globalInfo->workers[globalInfo->num_workers].key));
+    globalInfo->workers[globalInfo->num_workers].workerType = kinds;
+    globalInfo->workers[globalInfo->num_workers].queued_jobs = 0;
+    globalInfo->workers[globalInfo->num_workers].active_jobs = 0;
+    globalInfo->workers[globalInfo->num_workers].queue_capacity = 0;
+    globalInfo->workers[globalInfo->num_workers].load_avg = 0;
+    globalInfo->workers[globalInfo->num_workers].disk_free_mb = 0;
+    globalInfo->workers[globalInfo->num_workers].service_ms = 0;
+    globalInfo->workers[globalInfo->num_workers].load_updated_ns = timings_now_ns();
+    globalInfo->workers[globalInfo->num_workers].suspect = 0;
+    globalInfo->workers[globalInfo->num_workers].dead_estimate_ns = 0;
+    globalInfo->workers[globalInfo->num_workers].pull_slots = 0;
+    globalInfo->workers[globalInfo->num_workers].socket_fd = -1;   // Lo asigna quien llama
 
     // check and print worker info
     if (globalInfo->workers[globalInfo->num_workers].workerType == NULL || globalInfo->workers[globalInfo->num_workers].IP == NULL || globalInfo->workers[globalInfo->num_workers].Port == NULL) {
+        liberar_memoria_worker(globalInfo->workers[globalInfo->num_workers]);
+        pthread_mutex_unlock(&globalInfo->worker_mutex);
         printF("Error: Formato de datos inválido.\n");
         return 0;
     }
@@ -466,6 +1325,7 @@ int store_new_worker(GlobalInfoGotham* globalInfo, TramaResult* result) {
     free(aux);
 
     globalInfo->num_workers++;
+    STATS_INC(globalInfo->stats.current_workers);
     
     return 1;
 }
@@ -491,6 +1351,19 @@ void remove_worker(GlobalInfoGotham* globalInfo, int socket_fd) {
         return;
     }
 
+    // Sus distorsiones en curso quedan perdidas (Fleck pedirá otro Worker con el mismo id)
+    char key[64];
+    worker_key(&globalInfo->workers[index], key, sizeof(key));
+    int lost = job_ledger_worker_lost(&globalInfo->jobs, key);
+    if (lost > 0) {
+        STATS_ADD(globalInfo->stats.jobs_lost, lost);
+        char* buffer;
+        asprintf(&buffer, "Worker %s caído con %d distorsiones en curso.\n", key, lost);
+        log_event(globalInfo, buffer);
+        printF(buffer);
+        free(buffer);
+    }
+
     liberar_memoria_worker(globalInfo->workers[index]);
     // Mover los elementos restantes hacia adelante para rellenar hueco
     for (int i = index; i < globalInfo->num_workers - 1; i++) {
@@ -498,6 +1371,7 @@ void remove_worker(GlobalInfoGotham* globalInfo, int socket_fd) {
     }
 
     globalInfo->num_workers--;
+    STATS_DEC(globalInfo->stats.current_workers);
     Worker* temp = realloc(globalInfo->workers, globalInfo->num_workers * sizeof(Worker));
     if (globalInfo->workers == NULL && globalInfo->num_workers > 0) {
         free(globalInfo->workers);
@@ -507,38 +1381,44 @@ void remove_worker(GlobalInfoGotham* globalInfo, int socket_fd) {
     }
     globalInfo->workers = temp;
 
-    // Comprobar si era un Worker principal, y en dicho caso asignar a uno nuevo
-    if (index == globalInfo->enigma_pworker_index) {
-        globalInfo->enigma_pworker_index = -1;  // Borrar el índice de Enigma Principal Worker
+    // Comprobar si era un Worker principal, y en dicho caso asignar a uno nuevo de cada clase
+    int was_principal = 0;
+    for (int c = 0; c < globalInfo->num_worker_classes; c++) {
+        WorkerClass* worker_class = &globalInfo->worker_classes[c];
+        if (worker_class->pworker_index > index) {
+            worker_class->pworker_index--;  // Los Workers posteriores se han desplazado una posición
+            continue;
+        }
+        if (worker_class->pworker_index != index) {
+            continue;
+        }
+        was_principal = 1;
+        worker_class->pworker_index = -1;  // Borrar el índice del Principal Worker
 
-        // Buscar un nuevo worker de tipo "Text"
+        // Buscar un nuevo worker que atienda este tipo
         for (int i = 0; i < globalInfo->num_workers; i++) {
-            if (strcmp(globalInfo->workers[i].workerType, "Text") == 0) {
+            if (worker_serves(&globalInfo->workers[i], worker_class->kind)) {
 
                 // WORKER ENCONTRADO
-                globalInfo->enigma_pworker_index = i;
+                worker_class->pworker_index = i;
 
                 // Crear trama informando que es el nuevo Principal Worker
                 unsigned char* trama;
                 trama = crear_trama(TYPE_PRINCIPAL_WORKER, (unsigned char*)"", strlen(""));
                 if (trama == NULL) {
                     printF("Error en malloc para trama\n");
-                    pthread_mutex_unlock(&globalInfo->worker_mutex);
-                    return;
+                    break;
                 }
 
-                // Enviar la trama a Worker
-                if (write(globalInfo->workers[i].socket_fd, trama, BUFFER_SIZE) < 0) {
+                // Enviar la trama a Worker (si falla, su propio hilo lo eliminará y se buscará otro)
+                if (transport_send_frame(globalInfo->workers[i].socket_fd, trama) < 0) {
                     printF("Error enviando la trama de conexión a Gotham\n");
-                    free(trama);
-                    pthread_mutex_unlock(&globalInfo->worker_mutex);
-                    return;
                 }
                 free(trama);
 
                 // Mostrar mensaje indicando que encontramos un nuevo Principal Worker
                 char* buffer;
-                asprintf(&buffer, "Nuevo Principal Worker de tipo 'Text' encontrado en el índice %d.\n", globalInfo->enigma_pworker_index);
+                asprintf(&buffer, "Nuevo Principal Worker de tipo '%s' encontrado en el índice %d.\n", worker_class->kind, i);
                 log_event(globalInfo, buffer);
                 printF(buffer);
                 free(buffer);
@@ -546,56 +1426,73 @@ void remove_worker(GlobalInfoGotham* globalInfo, int socket_fd) {
             }
         }
 
-        if (globalInfo->enigma_pworker_index == -1) {
-            printF("No hay Workers de tipo 'Text' para asignar como Principal Worker.\n");
-            log_event(globalInfo, "No hay Workers de tipo 'Text' para asignar como Principal Worker.");
-            
+        if (worker_class->pworker_index == -1) {
+            char* buffer;
+            asprintf(&buffer, "No hay Workers de tipo '%s' para asignar como Principal Worker.\n", worker_class->kind);
+            log_event(globalInfo, buffer);
+            printF(buffer);
+            free(buffer);
         }
-    } else if (index == globalInfo->harley_pworker_index) {
-        globalInfo->harley_pworker_index = -1;  // Borrar el índice de Harley Principal Worker
-
-        // Buscar un nuevo worker de tipo "Media"
-        for (int i = 0; i < globalInfo->num_workers; i++) {
-            if (strcmp(globalInfo->workers[i].workerType, "Media") == 0) {
-                
-                // WORKER ENCONTRADO
-                globalInfo->harley_pworker_index = i;
-
-                // Crear trama informando que es el nuevo Principal Worker
-                unsigned char* trama;
-                trama = crear_trama(TYPE_PRINCIPAL_WORKER, (unsigned char*)"", strlen(""));
-                if (trama == NULL) {
-                    printF("Error en malloc para trama\n");
-                    pthread_mutex_unlock(&globalInfo->worker_mutex);
-                    return;
-                }
+    }
+    if (was_principal) {
+        STATS_INC(globalInfo->stats.failovers);
+    }
 
-                // Enviar la trama a Worker
-                if (write(globalInfo->workers[i].socket_fd, trama, BUFFER_SIZE) < 0) {
-                    printF("Error enviando la trama de conexión a Gotham\n");
-                    free(trama);
-                    pthread_mutex_unlock(&globalInfo->worker_mutex);
-                    return;
-                }
-                free(trama);
+    // printf("Worker en índice %d eliminado correctamente.\n", index);
+    pthread_mutex_unlock(&globalInfo->worker_mutex);
+}
 
-                // Mostrar mensaje indicando que encontramos un nuevo Principal Worker
-                char* buffer;
-                asprintf(&buffer, "Nuevo pworker de tipo 'Media' encontrado en el índice %d.\n", globalInfo->harley_pworker_index);
-                log_event(globalInfo, buffer);
-                printF(buffer);
-                free(buffer);
-                break;
-            }
+/***********************************************
+*
+* @Finalitat: Registrar un Worker que s’acaba de connectar: guardar-lo a la llista global, fer-lo
+*             principal de les seves classes que no en tenen i preparar la trama de resposta.
+* @Paràmetres: in: globalInfo = punter a l’estat global de Gotham.
+*             in: result = trama de connexió del Worker (<tipus>&<IP>&<Port>; l’allibera qui crida).
+*             in: socket_fd = connexió del Worker.
+* @Retorn: Trama de resposta (TYPE_PRINCIPAL_WORKER o TYPE_CONNECT_WORKER_GOTHAM, s’ha de fer free())
+*          o NULL si no s’ha pogut registrar.
+*
+************************************************/
+unsigned char* GOTHAM_register_worker(GlobalInfoGotham* globalInfo, TramaResult* result, int socket_fd) {
+    pthread_mutex_lock(&globalInfo->worker_mutex);
+    int index_worker = globalInfo->num_workers;     // Indice del worker con el que estamos trabajando
+    if (!store_new_worker(globalInfo, result)) {    // Si falla, ya ha desbloqueado worker_mutex
+        return NULL;
+    }
+    globalInfo->workers[index_worker].socket_fd = socket_fd;   // Guardar socket del Worker
+    
+    /* Comprobar si se debe asignar como worker principal de alguna de sus clases */
+    unsigned char *trama;
+    int is_principal = 0;
+    for (int i = 0; i < globalInfo->num_worker_classes; i++) {
+        WorkerClass* worker_class = &globalInfo->worker_classes[i];
+        if (!worker_serves(&globalInfo->workers[index_worker], worker_class->kind)) {
+            continue;
         }
-        if (globalInfo->harley_pworker_index == -1) {
-            printF("No hay Workers de tipo 'Media' para asignar como Principal Worker.\n");
-            log_event(globalInfo, "No hay Workers de tipo 'Text' para asignar como Principal Worker.");
+        if (worker_class->pworker_index == -1) {
+            worker_class->pworker_index = index_worker;
+            log_event(globalInfo, "Nuevo Worker asignado como Principal de tipo '%s'.", worker_class->kind);
+        }
+        if (worker_class->pworker_index == index_worker) {
+            is_principal = 1;
         }
     }
-
-    // printf("Worker en índice %d eliminado correctamente.\n", index);
+    if (globalInfo->config->routing == GOTHAM_ROUTING_PULL) {
+        // Con la cola de distorsiones todos atienden Flecks y reclaman distorsiones con TYPE_JOB_REQUEST
+        trama = crear_trama(TYPE_PRINCIPAL_WORKER, (unsigned char*)PULL_MODE, strlen(PULL_MODE));
+    } else if (is_principal || globalInfo->config->routing == GOTHAM_ROUTING_AFFINITY) {
+        // Se le indica que es el worker principal en la trama (con afinidad todos atienden Flecks)
+        trama = crear_trama(TYPE_PRINCIPAL_WORKER, (unsigned char*)"", strlen(""));
+    } else {
+        // Se le indica que no es el worker principal en la trama
+        trama = crear_trama(TYPE_CONNECT_WORKER_GOTHAM, (unsigned char*)"", strlen(""));
+    }
     pthread_mutex_unlock(&globalInfo->worker_mutex);
+
+    if (trama == NULL) {
+        printF("Error en malloc para trama\n");
+    }
+    return trama;
 }
 
 /***********************************************
@@ -618,10 +1515,10 @@ void *handle_worker_connection(void *void_args) {
 
     unsigned char buffer[BUFFER_SIZE]; 
     // Esperar mensaje de Worker
-    int bytes_read = recv(socket_connection, buffer, BUFFER_SIZE, 0);
+    int bytes_read = transport_recv_frame(socket_connection, buffer);
     if (bytes_read <= 0) {
         perror("Error leyendo data de worker");
-        close(socket_connection);
+        transport_close(socket_connection);
         return NULL;
     }
 
@@ -629,71 +1526,31 @@ void *handle_worker_connection(void *void_args) {
     if (result == NULL)
     {
         perror("Error con la trama enviada por Worker.");
-        close(socket_connection);
+        transport_close(socket_connection);
         return NULL;
     }
 
     // Parsear la informacion del nuevo Worker dentro de nuestro array global de workers
-    pthread_mutex_lock(&globalInfo->worker_mutex);
-    int index_worker = globalInfo->num_workers;     // Indice del worker con el que estamos trabajando
-    if (store_new_worker(globalInfo, result) == 0) {
-        free_tramaResult(result);
-        close(socket_connection);
-    }
-    globalInfo->workers[index_worker].socket_fd = socket_connection;   // Guardar socket del Worker
-    
-    /* Comprobar si se debe asignar como worker principal */
-    unsigned char *trama;
-    // Comprobar tipo de Worker
-    if (strcmp(globalInfo->workers[index_worker].workerType, "Text") == 0) {
-        if (globalInfo->enigma_pworker_index == -1) {
-            globalInfo->enigma_pworker_index = index_worker;
-            // Se le indica que es el worker principal en la trama
-            trama = crear_trama(TYPE_PRINCIPAL_WORKER, (unsigned char*)"", strlen(""));
-            // log_event(globalInfo, "Nuevo Worker asignado como Principal.");
-        } else {
-            // Se le indica que no es el worker principal en la trama
-            trama = crear_trama(TYPE_CONNECT_WORKER_GOTHAM, (unsigned char*)"", strlen(""));
-        }
-
-    } else if (strcmp(globalInfo->workers[index_worker].workerType, "Media") == 0) {
-        if (globalInfo->harley_pworker_index == -1) {
-            globalInfo->harley_pworker_index = index_worker;
-            // Se le indica que es el worker principal en la trama
-            trama = crear_trama(TYPE_PRINCIPAL_WORKER, (unsigned char*)"", strlen(""));
-            // log_event(globalInfo, "Nuevo Worker asignado como Principal.");
-        } else {
-            // Se le indica que no es el worker principal en la trama
-            trama = crear_trama(TYPE_CONNECT_WORKER_GOTHAM, (unsigned char*)"", strlen(""));
-        }
-    } else {
-        printF("Not known type\n");
-        pthread_mutex_unlock(&globalInfo->worker_mutex);
-        return NULL;
-    }
-    pthread_mutex_unlock(&globalInfo->worker_mutex);
-
+    unsigned char* trama = GOTHAM_register_worker(globalInfo, result, socket_connection);
+    free_tramaResult(result);
     if (trama == NULL) {
-        printF("Error en malloc para trama\n");
-        free_tramaResult(result);
-        close(socket_connection);
+        transport_close(socket_connection);
         return NULL;
     }
 
     // Enviar a Worker confirmación de que hemos guardado su información 
     // Enviar la trama a Worker
-    if (write(socket_connection, trama, BUFFER_SIZE) < 0) {
+    if (transport_send_frame(socket_connection, trama) < 0) {
         printF("Error enviando la trama de conexión a Gotham\n");
         free(trama);
-        free_tramaResult(result);
-        close(socket_connection);
+        transport_close(socket_connection);
         return NULL;
     }
     free(trama);
 
     
-    // Mantenerse respondiendo heartbeats constantemente
-    enviar_heartbeat_constantemente(socket_connection);
+    // Mantenerse enviando heartbeats constantemente
+    GOTHAM_heartbeat_worker(globalInfo, socket_connection);
 
     // Si acaba HEARTBEAT es porque se cerró la conexión y debemos limpiar el worker de la lista
     remove_worker(globalInfo, socket_connection);   // Se indica Socket en vez de index porque el index puede variar si se elimina otro Worker antes
@@ -739,4 +1596,298 @@ void log_event(GlobalInfoGotham *g, const char *fmt, ...) {
         perror("Error escribiendo en pipe de Arkham");
     }
     free(frame);
-}
\ No newline at end of file
+}
+
+/***********************************************
+*
+* @Finalitat: Processar una trama TYPE_JOB_REQUEST d’un Worker (routing=pull): guardar els huecos
+*             que té lliures, descomptant les distorsions que ja té assignades i encara no li han
+*             arribat, i assignar-li les distorsions que esperen a les cues.
+* @Paràmetres: in: globalInfo = punter a l’estat global de Gotham.
+*             in: socket_fd = descriptor de socket del Worker.
+*             in: data = dades de la trama (<huecos lliures>).
+* @Retorn: ----
+*
+************************************************/
+static void handle_job_request(GlobalInfoGotham* globalInfo, int socket_fd, char* data) {
+    if (globalInfo->config->routing != GOTHAM_ROUTING_PULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&globalInfo->worker_mutex);
+    int index = find_worker_bySocket(globalInfo, socket_fd);
+    if (index >= 0) {
+        char key[64];
+        worker_key(&globalInfo->workers[index], key, sizeof(key));
+        int slots = atoi(data) - job_ledger_pending(&globalInfo->jobs, key);
+        globalInfo->workers[index].pull_slots = (slots > 0) ? slots : 0;
+        claim_pull_requests(globalInfo, index);
+    }
+    pthread_mutex_unlock(&globalInfo->worker_mutex);
+}
+
+/***********************************************
+*
+* @Finalitat: Guardar la càrrega que un Worker informa a la resposta d’un HEARTBEAT.
+* @Paràmetres: in: globalInfo = punter a l’estat global de Gotham.
+*             in: socket_fd = descriptor de socket del Worker.
+*             in: data = dades de la resposta: <encuades>&<en curs>&<capacitat de la cua>&<loadavg>&
+*                        <MB lliures>&<temps de servei ms> (buides si el Worker no informa de la seva càrrega).
+* @Retorn: ----
+*
+************************************************/
+static void store_worker_load(GlobalInfoGotham* globalInfo, int socket_fd, char* data) {
+    int queued, active, capacity;
+    double load_avg = 0, service_ms = 0;
+    long disk_free_mb = 0;
+    if (sscanf(data, "%d&%d&%d&%lf&%ld&%lf", &queued, &active, &capacity, &load_avg, &disk_free_mb, &service_ms) < 3) {
+        return;
+    }
+
+    pthread_mutex_lock(&globalInfo->worker_mutex);
+    int index = find_worker_bySocket(globalInfo, socket_fd);
+    if (index >= 0) {
+        globalInfo->workers[index].queued_jobs = queued;
+        globalInfo->workers[index].active_jobs = active;
+        globalInfo->workers[index].queue_capacity = capacity;
+        globalInfo->workers[index].load_avg = load_avg;
+        globalInfo->workers[index].disk_free_mb = disk_free_mb;
+        globalInfo->workers[index].service_ms = service_ms;
+        globalInfo->workers[index].load_updated_ns = timings_now_ns();
+    }
+    pthread_mutex_unlock(&globalInfo->worker_mutex);
+}
+
+/***********************************************
+*
+* @Finalitat: Marcar o desmarcar un Worker com a sospitós segons el seu phi.
+* @Paràmetres: in: globalInfo = punter a l’estat global de Gotham.
+*             in: socket_fd = descriptor de socket del Worker.
+*             in: suspect = 1 per marcar-lo, 0 per desmarcar-lo.
+*             in: dead_in_ms = temps estimat fins que es donarà per caigut.
+* @Retorn: ----
+*
+************************************************/
+static void set_worker_suspect(GlobalInfoGotham* globalInfo, int socket_fd, int suspect, double dead_in_ms) {
+    pthread_mutex_lock(&globalInfo->worker_mutex);
+    int index = find_worker_bySocket(globalInfo, socket_fd);
+    if (index >= 0) {
+        globalInfo->workers[index].suspect = suspect;
+        globalInfo->workers[index].dead_estimate_ns = timings_now_ns() + (uint64_t)(dead_in_ms * 1e6);
+
+        char* buffer;
+        asprintf(&buffer, suspect ? "Worker %s:%s sospechoso de caída, deja de recibir Flecks.\n"
+                                  : "Worker %s:%s vuelve a responder.\n",
+                 globalInfo->workers[index].IP, globalInfo->workers[index].Port);
+        printF(buffer);
+        log_event(globalInfo, buffer);
+        free(buffer);
+    }
+    pthread_mutex_unlock(&globalInfo->worker_mutex);
+}
+
+/***********************************************
+*
+* @Finalitat: Començar a vigilar un Worker acabat de registrar.
+* @Paràmetres: in: globalInfo = punter a l’estat global de Gotham.
+*             out: watch = estat de la vigilància.
+*             in: now_ns = instant actual.
+* @Retorn: ----
+*
+************************************************/
+void GOTHAM_watch_init(GlobalInfoGotham* globalInfo, WorkerWatch* watch, uint64_t now_ns) {
+    GothamConfig* config = globalInfo->config;
+    phi_init(&watch->detector, now_ns, HEARTBEAT_SLEEP_TIME * 1000.0, config->phi_min_stddev_ms, config->phi_pause_ms);
+    watch->next_heartbeat_ns = now_ns;
+    watch->awaiting_reply = 0;
+    watch->suspect = 0;
+}
+
+/***********************************************
+*
+* @Finalitat: Decidir si toca enviar un HEARTBEAT al Worker i comptabilitzar-lo a les estadístiques
+*             (enviat, i sense resposta si l’anterior encara no s’ha respost).
+* @Paràmetres: in: globalInfo = punter a l’estat global de Gotham.
+*             in/out: watch = estat de la vigilància.
+*             in: now_ns = instant actual.
+* @Retorn: 1 si cal enviar-lo ara, 0 si no.
+*
+************************************************/
+int GOTHAM_watch_heartbeat_due(GlobalInfoGotham* globalInfo, WorkerWatch* watch, uint64_t now_ns) {
+    if (now_ns < watch->next_heartbeat_ns) {
+        return 0;
+    }
+    if (watch->awaiting_reply) {
+        STATS_INC(globalInfo->stats.heartbeats_missed);
+    }
+    STATS_INC(globalInfo->stats.heartbeats_sent);
+    watch->awaiting_reply = 1;
+    watch->next_heartbeat_ns = now_ns + HEARTBEAT_SLEEP_TIME * 1000000000ULL;
+    return 1;
+}
+
+/***********************************************
+*
+* @Finalitat: Processar una trama rebuda d’un Worker: qualsevol trama és prova de vida, les respostes
+*             a HEARTBEAT porten la seva càrrega, i també pot reclamar distorsions (routing=pull) o
+*             informar de l’estat d’una distorsió.
+* @Paràmetres: in: globalInfo = punter a l’estat global de Gotham.
+*             in/out: watch = estat de la vigilància.
+*             in: socket_fd = descriptor de socket del Worker.
+*             in: trama = trama rebuda (BUFFER_SIZE bytes).
+*             in: now_ns = instant de recepció.
+* @Retorn: 0 si el Worker es desconnecta (TYPE_DISCONNECTION), 1 si no.
+*
+************************************************/
+int GOTHAM_watch_frame(GlobalInfoGotham* globalInfo, WorkerWatch* watch, int socket_fd, unsigned char* trama, uint64_t now_ns) {
+    // Cualquier trama demuestra que el Worker sigue vivo (solo las respuestas a HEARTBEAT son intervalos)
+    phi_alive(&watch->detector, now_ns);
+
+    TramaResult* result = leer_trama(trama);
+    if (result == NULL) {
+        STATS_INC(globalInfo->stats.heartbeats_missed);
+        return 1;
+    }
+    if (result->type == TYPE_DISCONNECTION) {
+        printF("El Worker ha cerrado la conexión...\n");
+        free_tramaResult(result);
+        return 0;
+    }
+
+    if (result->type == TYPE_HEARTBEAT) {
+        phi_heartbeat(&watch->detector, now_ns);
+        store_worker_load(globalInfo, socket_fd, result->data);
+        watch->awaiting_reply = 0;
+    } else if (result->type == TYPE_JOB_REQUEST) {
+        // Worker con huecos libres que reclama distorsiones (routing=pull)
+        handle_job_request(globalInfo, socket_fd, result->data);
+    } else if (result->type == TYPE_JOB_STATUS) {
+        // Estado de una distorsión informado por el Worker
+        char key[64] = "";
+        pthread_mutex_lock(&globalInfo->worker_mutex);
+        int index = find_worker_bySocket(globalInfo, socket_fd);
+        if (index >= 0) {
+            worker_key(&globalInfo->workers[index], key, sizeof(key));
+        }
+        pthread_mutex_unlock(&globalInfo->worker_mutex);
+        if (index >= 0) {
+            handle_job_status(globalInfo, result->data, key);
+        }
+    }
+    free_tramaResult(result);
+    return 1;
+}
+
+/***********************************************
+*
+* @Finalitat: Avaluar la sospita de caiguda d’un Worker: amb phi >= phi_suspect deixa de rebre
+*             Flecks (i els torna a rebre si baixa) i amb phi >= phi_dead es dona per caigut.
+* @Paràmetres: in: globalInfo = punter a l’estat global de Gotham.
+*             in/out: watch = estat de la vigilància.
+*             in: socket_fd = descriptor de socket del Worker.
+*             in: now_ns = instant actual.
+* @Retorn: 1 si es dona per caigut, 0 si no.
+*
+************************************************/
+int GOTHAM_watch_check(GlobalInfoGotham* globalInfo, WorkerWatch* watch, int socket_fd, uint64_t now_ns) {
+    GothamConfig* config = globalInfo->config;
+    double phi = phi_value(&watch->detector, now_ns);
+    if (phi >= config->phi_dead) {
+        char* aux;
+        asprintf(&aux, "Worker sin responder (phi=%.1f), se da por caído.\n", phi);
+        printF(aux);
+        log_event(globalInfo, aux);
+        free(aux);
+        STATS_INC(globalInfo->stats.heartbeats_missed);
+        return 1;
+    }
+    if (phi >= config->phi_suspect && !watch->suspect) {
+        watch->suspect = 1;
+        set_worker_suspect(globalInfo, socket_fd, 1, phi_time_to_reach(&watch->detector, now_ns, config->phi_dead));
+    } else if (phi < config->phi_suspect && watch->suspect) {
+        watch->suspect = 0;
+        set_worker_suspect(globalInfo, socket_fd, 0, 0);
+    }
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalitat: Enviar heartbeats periòdics a un Worker i vigilar-lo amb un detector phi-accrual
+*             (GOTHAM_watch_*): qualsevol trama rebuda és prova de vida; amb phi >= phi_suspect el
+*             Worker deixa de rebre Flecks i amb phi >= phi_dead es dona per caigut.
+* @Paràmetres: in: globalInfo = punter a l’estat global de Gotham.
+*             in: socket_fd = descriptor de socket del Worker.
+* @Retorn: Retorna quan el Worker tanca la connexió, hi ha error o es dona per caigut.
+*
+************************************************/
+void GOTHAM_heartbeat_worker(GlobalInfoGotham* globalInfo, int socket_fd) {
+    unsigned char buffer[BUFFER_SIZE];
+    WorkerWatch watch;
+    GOTHAM_watch_init(globalInfo, &watch, timings_now_ns());
+
+    while (1) {
+        // Enviar el mensaje de heartbeat cuando toque
+        if (GOTHAM_watch_heartbeat_due(globalInfo, &watch, timings_now_ns())) {
+            unsigned char* tramaEnviar = crear_trama(TYPE_HEARTBEAT, (unsigned char*)HEARTBEAT, strlen(HEARTBEAT));
+            if (tramaEnviar == NULL) {
+                return;
+            }
+            if (transport_send_frame(socket_fd, tramaEnviar) < 0) {
+                perror("Error enviando heartbeat");
+                free(tramaEnviar);
+                return;
+            }
+            free(tramaEnviar);
+        }
+
+        // Esperar tramas del Worker (como mucho hasta el siguiente recálculo de phi)
+        if (transport_poll(socket_fd, GOTHAM_PHI_CHECK_MS) > 0) {
+            int bytes_read = transport_recv_frame(socket_fd, buffer);
+            if (bytes_read <= 0) {
+                STATS_INC(globalInfo->stats.heartbeats_missed);
+                if (bytes_read == 0) {
+                    printF("El Worker ha cerrado la conexión..\n");
+                } else {
+                    perror("Error leyendo respuesta del Worker");
+                }
+                return;
+            }
+            if (!GOTHAM_watch_frame(globalInfo, &watch, socket_fd, buffer, timings_now_ns())) {
+                return;
+            }
+        }
+
+        // Evaluar la sospecha de caída
+        if (GOTHAM_watch_check(globalInfo, &watch, socket_fd, timings_now_ns())) {
+            return;
+        }
+    }
+}
+
+/***********************************************
+*
+* @Finalitat: Formatejar els comptadors d’estadístiques de Gotham per enviar-los en una trama TYPE_STATS.
+* @Paràmetres: in: globalInfo = punter a l’estat global de Gotham.
+* @Retorn: Cadena dinàmica amb el format
+*          <connects>&<distort>&<distort_ko>&<media_ko>&<failovers>&<hb_sent>&<hb_missed>&<flecks>&<workers>&<busy>
+*          &<affinity_hits>&<affinity_spills>&<jobs_in_flight>&<jobs_lost>&<distort_limited>
+*          (s’ha de fer free()).
+*
+************************************************/
+char* GOTHAM_format_stats(GlobalInfoGotham* globalInfo) {
+    GothamStats* st = &globalInfo->stats;
+    char* data = NULL;
+
+    asprintf(&data, "%ld&%ld&%ld&%ld&%ld&%ld&%ld&%ld&%ld&%ld&%ld&%ld&%d&%ld&%ld",
+             STATS_GET(st->connects), STATS_GET(st->distort_requests),
+             STATS_GET(st->distort_ko), STATS_GET(st->media_ko),
+             STATS_GET(st->failovers),
+             STATS_GET(st->heartbeats_sent), STATS_GET(st->heartbeats_missed),
+             STATS_GET(st->current_flecks), STATS_GET(st->current_workers),
+             STATS_GET(st->distort_busy),
+             STATS_GET(st->affinity_hits), STATS_GET(st->affinity_spills),
+             job_ledger_in_flight(&globalInfo->jobs), STATS_GET(st->jobs_lost), STATS_GET(st->distort_limited));
+
+    return data;
+}
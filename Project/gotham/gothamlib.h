@@ -6,12 +6,60 @@
 #include <unistd.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
+#include <stdatomic.h>
+#include <poll.h>
 
 #include "../config/config.h"
 #include "../config/connections.h"
-
-
-#define MAX_WORKERS 10
+#include "../config/transport.h"
+#include "../config/sched.h"
+#include "phi_accrual.h"
+#include "rate_limit.h"
+#include "job_ledger.h"
+
+
+#define MAX_WORKERS 10           // Valor por defecto de la opción max_workers
+#define MAX_WORKER_CLASSES 8    // Tipos de archivo distintos atendidos por Workers (Text, Image, Audio...)
+#define CACHE_LINE_SIZE 64
+
+// Control de admisión: DISTORT_BUSY cuando la cola del Worker (o, con routing=affinity, la de todos los
+// candidatos) supera este porcentaje
+// (las distorsiones pequeñas o con prioridad se admiten hasta llenar la cola)
+#define GOTHAM_BUSY_HIGH_WATER_PCT 75
+#define GOTHAM_BUSY_MIN_RETRY_MS 100    // Espera mínima indicada a Fleck en DISTORT_BUSY
+#define GOTHAM_USER_LIMIT_RETRY_MS 500  // Espera mínima indicada a un usuario con el máximo de distorsiones en curso
+
+// Detector de fallos de Workers: valores por defecto de las opciones de gotham.dat
+#define GOTHAM_PHI_SUSPECT 3.0          // phi a partir del cual no se envían Flecks al Worker
+#define GOTHAM_PHI_DEAD 8.0             // phi a partir del cual el Worker se da por caído
+#define GOTHAM_PHI_MIN_STDDEV_MS 500
+#define GOTHAM_PHI_PAUSE_MS 1000
+#define GOTHAM_PHI_CHECK_MS 200         // Cada cuánto se recalcula phi si no llegan tramas
+
+// Encaminamiento de los DISTORT (opción routing de gotham.dat)
+#define GOTHAM_ROUTING_PRINCIPAL 0      // Siempre el Worker principal del tipo
+#define GOTHAM_ROUTING_AFFINITY 1       // El Worker afín a <usuario>/<archivo>
+#define GOTHAM_ROUTING_PULL 2           // Cola por tipo de la que los Workers libres reclaman distorsiones
+
+// Encaminamiento por afinidad (routing=affinity): carga máxima de un Worker respecto a la media de su tipo
+#define GOTHAM_AFFINITY_LOAD_FACTOR 1.25
+
+// Cola de distorsiones (routing=pull): espera máxima de un DISTORT a que un Worker lo reclame
+#define GOTHAM_PULL_WAIT_MS 3000
+
+// Decisión de Gotham sobre un DISTORT (GOTHAM_route_distort)
+#define GOTHAM_ROUTE_ASSIGNED 0         // Worker asignado: se responde <IP>&<Port>&<job_id>
+#define GOTHAM_ROUTE_LIMITED 1          // DISTORT_LIMIT: límite de peticiones superado
+#define GOTHAM_ROUTE_MEDIA_KO 2         // MEDIA_KO: ninguna clase de Workers atiende el tipo
+#define GOTHAM_ROUTE_NO_WORKERS 3       // DISTORT_KO: la clase no tiene Workers
+#define GOTHAM_ROUTE_BUSY 4             // DISTORT_BUSY: Worker saturado o sospechoso de caída
+#define GOTHAM_ROUTE_USER_BUSY 5        // DISTORT_BUSY: usuario con user_max_inflight distorsiones en curso
+
+// Operaciones sobre los contadores de estadísticas (no necesitan mutex)
+#define STATS_INC(c) atomic_fetch_add_explicit(&(c).value, 1, memory_order_relaxed)
+#define STATS_DEC(c) atomic_fetch_sub_explicit(&(c).value, 1, memory_order_relaxed)
+#define STATS_ADD(c, n) atomic_fetch_add_explicit(&(c).value, (n), memory_order_relaxed)
+#define STATS_GET(c) atomic_load_explicit(&(c).value, memory_order_relaxed)
 
 
 // Estructura para almacenar la configuración de Gotham
@@ -20,16 +68,83 @@ typedef struct {
     int port_fleck;   // Puerto para Fleck
     char* ip_workers; // Dirección IP del servidor para conectar con Harley/Enigma
     int port_workers; // Puerto para Harley/Enigma
+
+    // Opciones <clave>=<valor> (líneas opcionales tras las cuatro anteriores)
+    double phi_suspect;         // phi_suspect: umbral de sospecha del detector de fallos
+    double phi_dead;            // phi_dead: umbral de caída
+    int phi_min_stddev_ms;      // phi_min_stddev_ms: desviación mínima de los intervalos entre tramas
+    int phi_pause_ms;           // phi_pause_ms: pausa aceptable entre tramas
+    int routing;                // routing: GOTHAM_ROUTING_PRINCIPAL, GOTHAM_ROUTING_AFFINITY o GOTHAM_ROUTING_PULL
+    int max_workers;            // max_workers: Workers registrados a la vez
+    int user_max_inflight;      // user_max_inflight: distorsiones en curso máximas por usuario (0 = sin límite)
+    RateLimit rate_user;        // rate_user=<DISTORT/s>[:<ráfaga>]: peticiones por usuario
+    RateLimit rate_user_kb;     // rate_user_kb=<KB/s>[:<ráfaga>]: KB declarados por usuario
+    RateLimit rate_ip;          // rate_ip=<DISTORT/s>[:<ráfaga>]: peticiones por IP de origen
+    RateLimit rate_ip_kb;       // rate_ip_kb=<KB/s>[:<ráfaga>]: KB declarados por IP de origen
+    char* capture;              // capture=<archivo>: captura de las tramas enviadas y recibidas (NULL si no se captura)
 } GothamConfig;
 
 typedef struct {
-    char* workerType;
+    char* workerType;   // Tipos de archivo que atiende, separados por comas (p.e. "Image,Audio")
     char* IP;
     char* Port;         // Puerto del servidor de Worker (utilizado para recibir conexiones de Flecks)
+    char key[48];       // <IP>:<Puerto> (identifica al Worker en el registro de distorsiones)
     int socket_fd;
+    // Carga informada en la última respuesta a HEARTBEAT
+    int queued_jobs;        // Conexiones de Fleck en cola
+    int active_jobs;        // Conexiones de Fleck en curso
+    int queue_capacity;     // Capacidad de la cola (0 si el Worker no informa de su carga)
+    double load_avg;        // Carga media de CPU del último minuto
+    long disk_free_mb;      // Espacio libre en el directorio de archivos recibidos
+    double service_ms;      // Media móvil del tiempo de servicio de las distorsiones
+    uint64_t load_updated_ns;
+    int suspect;            // 1 si el detector de fallos sospecha del Worker (no se le envían Flecks)
+    uint64_t dead_estimate_ns;  // Instante estimado en que se dará por caído si sigue sin responder
+    int pull_slots;         // Distorsiones que el Worker puede reclamar todavía (routing=pull)
 } Worker;
 
+// DISTORT esperando en la cola de su clase a que un Worker lo reclame (routing=pull)
+typedef struct PullRequest {
+    char worker[64];            // <IP>:<Port> del Worker que la ha reclamado ("" mientras espera)
+    double expected_ms;         // Duración esperada según el tipo y tamaño del archivo
+    int priority;
+    uint64_t enqueued_ns;
+    struct PullRequest* next;
+} PullRequest;
+
+// Clase de Workers: los que atienden un tipo de archivo, con su propio Worker principal
+typedef struct {
+    char kind[16];          // Tipo de archivo ("Text", "Image", "Audio"...)
+    int pworker_index;      // Índice del Worker principal dentro del array de 'workers' (-1 si no hay)
+    PullRequest* pull_head; // Cola de DISTORT sin Worker, por orden de llegada (routing=pull)
+    PullRequest* pull_tail;
+} WorkerClass;
+
+// Contador atómico que ocupa una línea de caché entera (evita false sharing entre threads)
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) atomic_long value;
+} PaddedCounter;
+
+// Estadísticas de carga de Gotham (consultables por Fleck con TYPE_STATS)
+typedef struct {
+    PaddedCounter connects;             // Comandos CONNECT recibidos de Flecks
+    PaddedCounter distort_requests;     // Comandos DISTORT recibidos de Flecks
+    PaddedCounter distort_ko;           // Respuestas DISTORT_KO enviadas
+    PaddedCounter media_ko;             // Respuestas MEDIA_KO enviadas
+    PaddedCounter failovers;            // Caídas de un Worker principal
+    PaddedCounter heartbeats_sent;      // HEARTBEATs enviados a Workers
+    PaddedCounter heartbeats_missed;    // HEARTBEATs sin respuesta
+    PaddedCounter current_flecks;       // Flecks conectados actualmente
+    PaddedCounter current_workers;      // Workers registrados actualmente
+    PaddedCounter distort_busy;         // Respuestas DISTORT_BUSY enviadas
+    PaddedCounter affinity_hits;        // DISTORT encaminados al Worker afín al archivo
+    PaddedCounter affinity_spills;      // DISTORT desviados a otro Worker por exceso de carga del afín
+    PaddedCounter jobs_lost;            // Distorsiones en curso en un Worker que ha caído
+    PaddedCounter distort_limited;      // Respuestas DISTORT_LIMIT enviadas (límite de peticiones superado)
+} GothamStats;
+
 typedef struct {
+    GothamStats stats;              // Primer campo para mantener la alineación a línea de caché
     GothamConfig* config;           // Global para poder liberarse con SIGINT
     Server* server_fleck;
     Server* server_worker;
@@ -37,10 +152,17 @@ typedef struct {
     // WORKER
     Worker* workers;           // Array donde almacenaremos los Workers conectados a Gotham
     int num_workers;
-    int enigma_pworker_index;    // Indice del worker(Enigma) principal dentro del array de 'workers' (-1 si no hay)
-    int harley_pworker_index;    // Indice del worker(Harley) principal dentro del array de 'workers' (-1 si no hay)
+    WorkerClass worker_classes[MAX_WORKER_CLASSES];     // Un Worker principal por tipo de archivo
+    int num_worker_classes;
     // Mutex para cuando se modifiquen o lean las variables globales relacionadas con workers
     pthread_mutex_t worker_mutex;
+    pthread_cond_t pull_cond;   // Avisa a los DISTORT en cola de que un Worker ha reclamado distorsiones
+
+    // Distorsiones asignadas (actualizadas con las tramas TYPE_JOB_STATUS)
+    JobLedger jobs;
+    SchedModel sched;           // Coste por KB de cada tipo medido con las distorsiones acabadas
+    RateLimiter user_limits;    // Cubetas de fichas de DISTORT por usuario
+    RateLimiter ip_limits;      // Cubetas de fichas de DISTORT por IP de origen
 
     // FLECK
     int* fleck_sockets;         //Lista de sockets de flecks
@@ -68,7 +190,39 @@ typedef struct {
     GlobalInfoGotham* global_info;
 } ThreadArgsGotham;
 
+// Petición DISTORT de un Fleck
+typedef struct {
+    int owner;                  // Conexión del Fleck (propietario de la distorsión en el registro)
+    const char* username;       // Usuario del CONNECT (NULL si no lo ha hecho)
+    const char* source_ip;      // IP de origen de la conexión (clave de los límites por IP)
+    const char* media_type;
+    const char* file_name;
+    long file_size;             // 0 si Fleck no lo envía, -1 si no es válido
+    unsigned long job_id;       // Distinto de 0 al pedir otro Worker para una distorsión ya asignada
+    int priority;
+} DistortRequest;
+
+// Decisión de Gotham sobre un DISTORT
+typedef struct {
+    int status;                 // GOTHAM_ROUTE_*
+    char kind[16];              // Clase de Workers ("Media" concretado a Image o Audio)
+    char worker[64];            // <IP>:<Port> del Worker asignado
+    char reply[BUFFER_SIZE];    // Respuesta para Fleck: <IP>&<Port>&<job_id>
+    unsigned long job_id;
+    long retry_ms;              // Espera indicada en DISTORT_LIMIT y DISTORT_BUSY
+} DistortRoute;
+
+// Vigilancia de un Worker: HEARTBEAT pendiente y detector de fallos phi-accrual
+typedef struct {
+    PhiDetector detector;
+    uint64_t next_heartbeat_ns;     // Cuándo toca enviar el siguiente HEARTBEAT
+    int awaiting_reply;             // 1 si el último HEARTBEAT no tiene respuesta
+    int suspect;                    // 1 si phi ha superado phi_suspect
+} WorkerWatch;
 
+
+void GOTHAM_default_options(GothamConfig* config);
+int GOTHAM_set_option(GothamConfig* config, char* option);
 GothamConfig* GOTHAM_read_config(const char *config_file);
 void GOTHAM_show_config(GothamConfig* config);
 
@@ -76,10 +230,24 @@ void liberar_memoria_workers(GlobalInfoGotham* globalInfo);
 void liberar_memoria_flecks(GlobalInfoGotham* globalInfo);
 void cancel_and_wait_threads(GlobalInfoGotham* globalInfo);
 
+int GOTHAM_add_worker_class(GlobalInfoGotham* globalInfo, const char* kind);
+
+int GOTHAM_route_distort(GlobalInfoGotham* globalInfo, const DistortRequest* request, DistortRoute* route);
+void handle_job_status(GlobalInfoGotham* globalInfo, char* data, const char* worker);
 void* handle_fleck_connection(void* client_socket);
+
+unsigned char* GOTHAM_register_worker(GlobalInfoGotham* globalInfo, TramaResult* result, int socket_fd);
+void remove_worker(GlobalInfoGotham* globalInfo, int socket_fd);
 void* handle_worker_connection(void* client_socket);
 
 void log_event(GlobalInfoGotham *g, const char *fmt, ...);
 
+char* GOTHAM_format_stats(GlobalInfoGotham* globalInfo);
+void GOTHAM_watch_init(GlobalInfoGotham* globalInfo, WorkerWatch* watch, uint64_t now_ns);
+int GOTHAM_watch_heartbeat_due(GlobalInfoGotham* globalInfo, WorkerWatch* watch, uint64_t now_ns);
+int GOTHAM_watch_frame(GlobalInfoGotham* globalInfo, WorkerWatch* watch, int socket_fd, unsigned char* trama, uint64_t now_ns);
+int GOTHAM_watch_check(GlobalInfoGotham* globalInfo, WorkerWatch* watch, int socket_fd, uint64_t now_ns);
+void GOTHAM_heartbeat_worker(GlobalInfoGotham* globalInfo, int socket_fd);
+
 
 #endif
\ No newline at end of file
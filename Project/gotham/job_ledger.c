@@ -0,0 +1,462 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "../config/timings.h"
+#include "job_ledger.h"
+
+static const char* const JOB_PHASE_NAMES[JOB_NUM_PHASES] = {
+    "assigned", "uploading", "distorting", "downloading", "done", "failed", "lost"
+};
+
+
+/***********************************************
+*
+* @Finalitat: Copiar una cadena a un camp de mida fixa (truncant-la si cal).
+* @Paràmetres: out: dest = camp de destí.
+*             in: size = mida del camp.
+*             in: src = cadena a copiar (pot ser NULL).
+* @Retorn: ----
+*
+************************************************/
+static void copy_field(char* dest, size_t size, const char* src) {
+    snprintf(dest, size, "%s", src ? src : "");
+}
+
+/***********************************************
+*
+* @Finalitat: Indicar si una distorsió ja ha acabat (correctament o no).
+* @Paràmetres: in: entry = entrada del registre.
+* @Retorn: 1 si ha acabat o l’entrada és lliure, 0 si està en curs.
+*
+************************************************/
+static int job_finished(JobEntry* entry) {
+    return entry->job_id == 0 || entry->phase == JOB_PHASE_DONE || entry->phase == JOB_PHASE_FAILED;
+}
+
+/***********************************************
+*
+* @Finalitat: Indicar si una entrada és la distorsió en curs 'job_id' del Fleck 'owner'.
+* @Paràmetres: in: entry = entrada del registre on cau l’identificador.
+*             in: job_id = identificador enviat per Fleck (0 per a una distorsió nova).
+*             in: owner = socket de la connexió del Fleck.
+* @Retorn: 1 si ho és, 0 si no.
+*
+************************************************/
+static int job_reassignable(JobEntry* entry, unsigned long job_id, int owner) {
+    return job_id != 0 && entry->job_id == job_id && entry->owner == owner && !job_finished(entry);
+}
+
+/***********************************************
+*
+* @Finalitat: Indicar si una distorsió compta com a càrrega del seu Worker (en curs i no perduda).
+* @Paràmetres: in: entry = entrada del registre.
+* @Retorn: 1 si compta, 0 si no.
+*
+************************************************/
+static int job_active(JobEntry* entry) {
+    return !job_finished(entry) && entry->phase != JOB_PHASE_LOST;
+}
+
+/***********************************************
+*
+* @Finalitat: Calcular el hash FNV-1a de l’identificador d’un Worker (posició a l’índex de càrrega).
+* @Paràmetres: in: worker = <IP>:<Port> del Worker.
+* @Retorn: Hash de 64 bits.
+*
+************************************************/
+static uint64_t worker_hash(const char* worker) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (const char* c = worker; *c != '\0'; c++) {
+        hash = (hash ^ (unsigned char)*c) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+/***********************************************
+*
+* @Finalitat: Refer l’índex de càrrega dels Workers deixant només els que tenen distorsions en curs
+*             (n’hi ha com a molt 'capacity', la meitat de la taula).
+* @Paràmetres: in/out: ledger = registre.
+* @Retorn: ----
+*
+************************************************/
+static void compact_counts(JobLedger* ledger) {
+    memset(ledger->counts, 0, ledger->counts_size * sizeof(JobWorkerCount));
+    for (int i = 0; i < ledger->capacity; i++) {
+        JobEntry* entry = &ledger->entries[i];
+        if (!job_active(entry)) {
+            continue;
+        }
+        uint64_t hash = worker_hash(entry->worker);
+        for (int probe = 0; probe < ledger->counts_size; probe++) {
+            JobWorkerCount* count = &ledger->counts[(hash + probe) % ledger->counts_size];
+            if (count->worker[0] == '\0' || strcmp(count->worker, entry->worker) == 0) {
+                copy_field(count->worker, sizeof(count->worker), entry->worker);
+                count->active++;
+                break;
+            }
+        }
+    }
+}
+
+/***********************************************
+*
+* @Finalitat: Cercar l’entrada d’un Worker a l’índex de càrrega (FNV-1a i sondeig lineal). Les
+*             entrades no s’esborren: si la taula és plena es compacta i es torna a provar.
+* @Paràmetres: in/out: ledger = registre.
+*             in: worker = <IP>:<Port> del Worker.
+*             out: compacted = es posa a 1 si s’ha compactat la taula (NULL per no crear l’entrada si no existeix).
+* @Retorn: Entrada del Worker, o NULL si no existeix (i no s’ha demanat crear-la).
+*
+************************************************/
+static JobWorkerCount* worker_count(JobLedger* ledger, const char* worker, int* compacted) {
+    // Clave truncada igual que el campo 'worker' de las entradas
+    char key[sizeof(ledger->counts[0].worker)];
+    copy_field(key, sizeof(key), worker);
+    uint64_t hash = worker_hash(key);
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        for (int probe = 0; probe < ledger->counts_size; probe++) {
+            JobWorkerCount* count = &ledger->counts[(hash + probe) % ledger->counts_size];
+            if (count->worker[0] == '\0') {
+                if (compacted == NULL) {
+                    return NULL;
+                }
+                copy_field(count->worker, sizeof(count->worker), key);
+                count->active = 0;
+                return count;
+            }
+            if (strcmp(count->worker, key) == 0) {
+                return count;
+            }
+        }
+        if (compacted == NULL) {
+            return NULL;
+        }
+        compact_counts(ledger);
+        *compacted = 1;
+    }
+    return NULL;
+}
+
+/***********************************************
+*
+* @Finalitat: Sumar o restar una distorsió a la càrrega del seu Worker si compta com a càrrega.
+*             Es crida amb -1 abans de modificar l’entrada i amb +1 després (si cal compactar l’índex,
+*             ja es recompta l’entrada en el seu estat actual).
+* @Paràmetres: in/out: ledger = registre.
+*             in: entry = entrada del registre.
+*             in: delta = +1 o -1.
+* @Retorn: ----
+*
+************************************************/
+static void count_job(JobLedger* ledger, JobEntry* entry, int delta) {
+    if (!job_active(entry)) {
+        return;
+    }
+    int compacted = 0;
+    JobWorkerCount* count = worker_count(ledger, entry->worker, &compacted);
+    if (count != NULL && !(compacted && delta > 0)) {
+        count->active += delta;
+    }
+}
+
+/***********************************************
+*
+* @Finalitat: Inicialitzar un registre de distorsions buit.
+* @Paràmetres: out: ledger = registre a inicialitzar.
+*             in: capacity = distorsions recordades (JOB_LEDGER_SIZE a Gotham).
+* @Retorn: 0 si té èxit, -1 si no hi ha memòria.
+*
+************************************************/
+int job_ledger_init(JobLedger* ledger, int capacity) {
+    ledger->entries = calloc(capacity, sizeof(JobEntry));
+    ledger->counts = calloc(2 * capacity, sizeof(JobWorkerCount));
+    if (ledger->entries == NULL || ledger->counts == NULL) {
+        free(ledger->entries);
+        free(ledger->counts);
+        return -1;
+    }
+    ledger->capacity = capacity;
+    ledger->counts_size = 2 * capacity;
+    ledger->next_id = 1;
+    pthread_mutex_init(&ledger->mutex, NULL);
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalitat: Alliberar els recursos del registre.
+* @Paràmetres: in/out: ledger = registre.
+* @Retorn: ----
+*
+************************************************/
+void job_ledger_destroy(JobLedger* ledger) {
+    free(ledger->entries);
+    free(ledger->counts);
+    pthread_mutex_destroy(&ledger->mutex);
+}
+
+/***********************************************
+*
+* @Finalitat: Registrar l’assignació d’un Worker a una distorsió. Si 'job_id' correspon a una
+*             distorsió en curs (Fleck torna a demanar Worker després d’una caiguda o d’un BUSY),
+*             s’actualitza el Worker i es compta la reassignació; si no, es crea una entrada nova.
+* @Paràmetres: in/out: ledger = registre.
+*             in: job_id = identificador enviat per Fleck (0 per a una distorsió nova).
+*             in: owner = socket de la connexió del Fleck.
+*             in: username, filename, kind = dades de la petició.
+*             in: size = mida del fitxer original (0 si no se sap).
+*             in: priority = prioritat demanada per Fleck.
+*             in: worker = <IP>:<Port> del Worker assignat.
+* @Retorn: Identificador de la distorsió.
+*
+************************************************/
+unsigned long job_ledger_assign(JobLedger* ledger, unsigned long job_id, int owner, const char* username,
+                                const char* filename, const char* kind, long size, int priority, const char* worker) {
+    uint64_t now = timings_now_ns();
+
+    pthread_mutex_lock(&ledger->mutex);
+    JobEntry* entry = &ledger->entries[job_id % ledger->capacity];
+    if (job_reassignable(entry, job_id, owner)) {
+        // Se conserva el inicio de cada fase: el tiempo perdido con el Worker anterior cuenta en la fase en que cayó
+        count_job(ledger, entry, -1);
+        entry->reassignments++;
+    } else {
+        // Distorsión nueva: ocupa la entrada de su id (descartando la distorsión más antigua que la ocupaba)
+        job_id = ledger->next_id++;
+        entry = &ledger->entries[job_id % ledger->capacity];
+        count_job(ledger, entry, -1);
+        memset(entry, 0, sizeof(JobEntry));
+        entry->job_id = job_id;
+        entry->owner = owner;
+        copy_field(entry->username, sizeof(entry->username), username);
+        copy_field(entry->filename, sizeof(entry->filename), filename);
+        copy_field(entry->kind, sizeof(entry->kind), kind);
+        entry->created_ns = now;
+        entry->phase_start_ns[JOB_PHASE_ASSIGNED] = now;
+    }
+    if (size > 0) {
+        entry->size = size;
+    }
+    entry->priority = priority;
+    copy_field(entry->worker, sizeof(entry->worker), worker);
+    entry->phase = JOB_PHASE_ASSIGNED;
+    count_job(ledger, entry, 1);
+    pthread_mutex_unlock(&ledger->mutex);
+
+    return job_id;
+}
+
+/***********************************************
+*
+* @Finalitat: Indicar si un DISTORT amb 'job_id' demana un altre Worker per a una distorsió en curs
+*             del mateix Fleck (job_ledger_assign la reassignarà) o si comptarà com una distorsió nova.
+* @Paràmetres: in: ledger = registre.
+*             in: job_id = identificador enviat per Fleck (0 per a una distorsió nova).
+*             in: owner = socket de la connexió del Fleck.
+* @Retorn: 1 si és una reassignació, 0 si no.
+*
+************************************************/
+int job_ledger_is_reassignment(JobLedger* ledger, unsigned long job_id, int owner) {
+    pthread_mutex_lock(&ledger->mutex);
+    int reassigned = job_reassignable(&ledger->entries[job_id % ledger->capacity], job_id, owner);
+    pthread_mutex_unlock(&ledger->mutex);
+    return reassigned;
+}
+
+/***********************************************
+*
+* @Finalitat: Actualitzar la fase d’una distorsió segons una trama d’estat.
+* @Paràmetres: in/out: ledger = registre.
+*             in: job_id = identificador de la distorsió.
+*             in: phase = nova fase (JOB_PHASE_*).
+*             in: worker = <IP>:<Port> del Worker que informa, o NULL si informa Fleck
+*                         (s’ignoren els estats de Workers als quals ja no està assignada).
+*             out: copy = còpia de l’entrada actualitzada (pot ser NULL).
+* @Retorn: 1 si s’ha actualitzat, 0 si la distorsió no existeix, ja ha acabat o l’estat no és vàlid.
+*
+************************************************/
+int job_ledger_update(JobLedger* ledger, unsigned long job_id, int phase, const char* worker, JobEntry* copy) {
+    if (job_id == 0 || phase <= JOB_PHASE_ASSIGNED || phase >= JOB_NUM_PHASES) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&ledger->mutex);
+    JobEntry* entry = &ledger->entries[job_id % ledger->capacity];
+    if (entry->job_id != job_id || job_finished(entry) || (worker != NULL && strcmp(entry->worker, worker) != 0)) {
+        pthread_mutex_unlock(&ledger->mutex);
+        return 0;
+    }
+    count_job(ledger, entry, -1);
+    entry->phase = phase;
+    entry->phase_start_ns[phase] = timings_now_ns();
+    count_job(ledger, entry, 1);
+    if (copy != NULL) {
+        *copy = *entry;
+    }
+    pthread_mutex_unlock(&ledger->mutex);
+    return 1;
+}
+
+/***********************************************
+*
+* @Finalitat: Comptar les distorsions en curs assignades a un Worker.
+* @Paràmetres: in: ledger = registre.
+*             in: worker = <IP>:<Port> del Worker.
+* @Retorn: Nombre de distorsions en curs.
+*
+************************************************/
+int job_ledger_active(JobLedger* ledger, const char* worker) {
+    pthread_mutex_lock(&ledger->mutex);
+    JobWorkerCount* count = worker_count(ledger, worker, NULL);
+    int active = (count != NULL) ? count->active : 0;
+    pthread_mutex_unlock(&ledger->mutex);
+    return active;
+}
+
+/***********************************************
+*
+* @Finalitat: Comptar les distorsions assignades a un Worker que encara no li han arribat
+*             (Fleck no ha informat que comença a enviar el fitxer).
+* @Paràmetres: in: ledger = registre.
+*             in: worker = <IP>:<Port> del Worker.
+* @Retorn: Nombre de distorsions pendents de començar.
+*
+************************************************/
+int job_ledger_pending(JobLedger* ledger, const char* worker) {
+    int count = 0;
+    pthread_mutex_lock(&ledger->mutex);
+    for (int i = 0; i < ledger->capacity; i++) {
+        JobEntry* entry = &ledger->entries[i];
+        if (entry->job_id != 0 && entry->phase == JOB_PHASE_ASSIGNED && strcmp(entry->worker, worker) == 0) {
+            count++;
+        }
+    }
+    pthread_mutex_unlock(&ledger->mutex);
+    return count;
+}
+
+/***********************************************
+*
+* @Finalitat: Comptar les distorsions en curs d’un usuari (incloses les que esperen un nou Worker).
+* @Paràmetres: in: ledger = registre.
+*             in: username = nom de l’usuari.
+*             in: exclude_job = distorsió que no es compta (0 per comptar-les totes).
+*             out: oldest = còpia de la distorsió en curs més antiga de l’usuari (pot ser NULL).
+* @Retorn: Nombre de distorsions en curs de l’usuari.
+*
+************************************************/
+int job_ledger_user_active(JobLedger* ledger, const char* username, unsigned long exclude_job, JobEntry* oldest) {
+    int count = 0;
+    pthread_mutex_lock(&ledger->mutex);
+    for (int i = 0; i < ledger->capacity; i++) {
+        JobEntry* entry = &ledger->entries[i];
+        if (!job_finished(entry) && entry->job_id != exclude_job && strcmp(entry->username, username) == 0) {
+            if (oldest != NULL && (count == 0 || entry->created_ns < oldest->created_ns)) {
+                *oldest = *entry;
+            }
+            count++;
+        }
+    }
+    pthread_mutex_unlock(&ledger->mutex);
+    return count;
+}
+
+/***********************************************
+*
+* @Finalitat: Comptar totes les distorsions en curs.
+* @Paràmetres: in: ledger = registre.
+* @Retorn: Nombre de distorsions en curs (incloses les que esperen un nou Worker).
+*
+************************************************/
+int job_ledger_in_flight(JobLedger* ledger) {
+    int count = 0;
+    pthread_mutex_lock(&ledger->mutex);
+    for (int i = 0; i < ledger->capacity; i++) {
+        if (!job_finished(&ledger->entries[i])) {
+            count++;
+        }
+    }
+    pthread_mutex_unlock(&ledger->mutex);
+    return count;
+}
+
+/***********************************************
+*
+* @Finalitat: Marcar com a perdudes les distorsions en curs d’un Worker caigut.
+* @Paràmetres: in/out: ledger = registre.
+*             in: worker = <IP>:<Port> del Worker.
+* @Retorn: Nombre de distorsions afectades.
+*
+************************************************/
+int job_ledger_worker_lost(JobLedger* ledger, const char* worker) {
+    int count = 0;
+    uint64_t now = timings_now_ns();
+    pthread_mutex_lock(&ledger->mutex);
+    for (int i = 0; i < ledger->capacity; i++) {
+        JobEntry* entry = &ledger->entries[i];
+        if (job_active(entry) && strcmp(entry->worker, worker) == 0) {
+            count_job(ledger, entry, -1);
+            entry->phase = JOB_PHASE_LOST;
+            entry->phase_start_ns[JOB_PHASE_LOST] = now;
+            count++;
+        }
+    }
+    pthread_mutex_unlock(&ledger->mutex);
+    return count;
+}
+
+/***********************************************
+*
+* @Finalitat: Marcar com a fallides les distorsions en curs d’un Fleck que s’ha desconnectat.
+* @Paràmetres: in/out: ledger = registre.
+*             in: owner = socket de la connexió del Fleck.
+* @Retorn: Nombre de distorsions afectades.
+*
+************************************************/
+int job_ledger_owner_gone(JobLedger* ledger, int owner) {
+    int count = 0;
+    uint64_t now = timings_now_ns();
+    pthread_mutex_lock(&ledger->mutex);
+    for (int i = 0; i < ledger->capacity; i++) {
+        JobEntry* entry = &ledger->entries[i];
+        if (!job_finished(entry) && entry->owner == owner) {
+            count_job(ledger, entry, -1);
+            entry->phase = JOB_PHASE_FAILED;
+            entry->phase_start_ns[JOB_PHASE_FAILED] = now;
+            count++;
+        }
+    }
+    pthread_mutex_unlock(&ledger->mutex);
+    return count;
+}
+
+/***********************************************
+*
+* @Finalitat: Convertir el nom d’una fase de les trames d’estat en el seu índex.
+* @Paràmetres: in: name = nom de la fase ("uploading", "done"...).
+* @Retorn: JOB_PHASE_* o -1 si no es coneix.
+*
+************************************************/
+int job_ledger_phase(const char* name) {
+    for (int i = 0; i < JOB_NUM_PHASES; i++) {
+        if (name != NULL && strcasecmp(name, JOB_PHASE_NAMES[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/***********************************************
+*
+* @Finalitat: Obtenir el nom d’una fase.
+* @Paràmetres: in: phase = JOB_PHASE_*.
+* @Retorn: Nom de la fase ("?" si no és vàlida).
+*
+************************************************/
+const char* job_ledger_phase_name(int phase) {
+    return (phase >= 0 && phase < JOB_NUM_PHASES) ? JOB_PHASE_NAMES[phase] : "?";
+}
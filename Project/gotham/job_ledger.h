@@ -0,0 +1,67 @@
+#ifndef JOB_LEDGER_H
+#define JOB_LEDGER_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+// Registro de distorsiones de Gotham: una entrada por DISTORT asignado, actualizada con las tramas
+// TYPE_JOB_STATUS que envían Fleck y los Workers
+#define JOB_LEDGER_SIZE 256         // Distorsiones recordadas por defecto (la entrada del id N es N % capacidad)
+
+// Fases de una distorsión
+#define JOB_PHASE_ASSIGNED 0        // Gotham ha respondido al DISTORT con un Worker
+#define JOB_PHASE_UPLOADING 1       // Fleck envía el archivo (lo informa Fleck)
+#define JOB_PHASE_DISTORTING 2      // El Worker distorsiona (lo informa el Worker)
+#define JOB_PHASE_DOWNLOADING 3     // El Worker devuelve el archivo distorsionado (lo informa el Worker)
+#define JOB_PHASE_DONE 4            // Fleck ha verificado el resultado
+#define JOB_PHASE_FAILED 5          // Fleck ha abandonado la distorsión
+#define JOB_PHASE_LOST 6            // Su Worker ha caído (Fleck puede pedir otro con el mismo id)
+#define JOB_NUM_PHASES 7
+
+typedef struct {
+    unsigned long job_id;                       // 0 si la entrada está libre
+    char username[32];
+    char filename[64];
+    char kind[16];                              // Tipo de archivo (clase de Workers)
+    long size;                                  // Tamaño del archivo original (0 si Fleck no lo envía)
+    int priority;                               // Prioridad pedida por Fleck (0 = normal)
+    char worker[48];                            // <IP>:<Puerto> del Worker asignado
+    int phase;
+    int reassignments;                          // Veces que se ha pedido otro Worker para la distorsión
+    int owner;                                  // Socket de la conexión del Fleck que la pidió
+    uint64_t created_ns;
+    uint64_t phase_start_ns[JOB_NUM_PHASES];    // Inicio de cada fase (0 si no se ha llegado a ella)
+} JobEntry;
+
+// Distorsiones en curso de un Worker (índice para no recorrer el registro al estimar su carga)
+typedef struct {
+    char worker[48];                            // <IP>:<Puerto> ("" si la entrada está libre)
+    int active;
+} JobWorkerCount;
+
+typedef struct {
+    JobEntry* entries;
+    int capacity;
+    JobWorkerCount* counts;                     // Tabla hash (sondeo lineal) de 2 * capacity entradas
+    int counts_size;
+    unsigned long next_id;
+    pthread_mutex_t mutex;
+} JobLedger;
+
+
+int job_ledger_init(JobLedger* ledger, int capacity);
+void job_ledger_destroy(JobLedger* ledger);
+unsigned long job_ledger_assign(JobLedger* ledger, unsigned long job_id, int owner, const char* username,
+                                const char* filename, const char* kind, long size, int priority, const char* worker);
+int job_ledger_is_reassignment(JobLedger* ledger, unsigned long job_id, int owner);
+int job_ledger_update(JobLedger* ledger, unsigned long job_id, int phase, const char* worker, JobEntry* copy);
+int job_ledger_active(JobLedger* ledger, const char* worker);
+int job_ledger_pending(JobLedger* ledger, const char* worker);
+int job_ledger_user_active(JobLedger* ledger, const char* username, unsigned long exclude_job, JobEntry* oldest);
+int job_ledger_in_flight(JobLedger* ledger);
+int job_ledger_worker_lost(JobLedger* ledger, const char* worker);
+int job_ledger_owner_gone(JobLedger* ledger, int owner);
+int job_ledger_phase(const char* name);
+const char* job_ledger_phase_name(int phase);
+
+#endif
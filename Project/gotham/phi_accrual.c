@@ -0,0 +1,153 @@
+#include <math.h>
+
+#include "phi_accrual.h"
+
+
+/***********************************************
+*
+* @Finalitat: Afegir un interval a la finestra del detector.
+* @Paràmetres: in/out: detector = detector phi-accrual.
+*             in: interval_ms = interval entre dues trames.
+* @Retorn: ----
+*
+************************************************/
+static void add_interval(PhiDetector* detector, double interval_ms) {
+    if (detector->num_intervals == PHI_WINDOW) {
+        double old = detector->intervals_ms[detector->next];
+        detector->sum_ms -= old;
+        detector->sum_sq_ms -= old * old;
+    } else {
+        detector->num_intervals++;
+    }
+    detector->intervals_ms[detector->next] = interval_ms;
+    detector->next = (detector->next + 1) % PHI_WINDOW;
+    detector->sum_ms += interval_ms;
+    detector->sum_sq_ms += interval_ms * interval_ms;
+}
+
+/***********************************************
+*
+* @Finalitat: Inicialitzar el detector amb l’interval esperat com a única mostra i l’origen dels
+*             temps a 'now_ns'. La primera resposta rebuda només torna a fixar l’origen.
+* @Paràmetres: out: detector = detector a inicialitzar.
+*             in: now_ns = instant actual (timings_now_ns()).
+*             in: expected_interval_ms = interval esperat entre trames.
+*             in: min_stddev_ms = desviació mínima considerada.
+*             in: pause_ms = pausa acceptable sumada a la mitjana.
+* @Retorn: ----
+*
+************************************************/
+void phi_init(PhiDetector* detector, uint64_t now_ns, double expected_interval_ms, double min_stddev_ms, double pause_ms) {
+    detector->num_intervals = 0;
+    detector->next = 0;
+    detector->sum_ms = 0;
+    detector->sum_sq_ms = 0;
+    detector->min_stddev_ms = min_stddev_ms;
+    detector->pause_ms = pause_ms;
+
+    // Arranque: una muestra con el intervalo esperado (la desviación será la mínima)
+    add_interval(detector, expected_interval_ms);
+    detector->last_arrival_ns = now_ns;
+    detector->last_heartbeat_ns = now_ns;
+    detector->started = 0;
+}
+
+/***********************************************
+*
+* @Finalitat: Registrar l’arribada d’una resposta a HEARTBEAT (afegeix l’interval des de l’anterior).
+* @Paràmetres: in/out: detector = detector phi-accrual.
+*             in: now_ns = instant de l’arribada.
+* @Retorn: ----
+*
+************************************************/
+void phi_heartbeat(PhiDetector* detector, uint64_t now_ns) {
+    if (detector->started) {
+        add_interval(detector, (now_ns - detector->last_heartbeat_ns) / 1e6);
+    }
+    detector->started = 1;
+    detector->last_heartbeat_ns = now_ns;
+    detector->last_arrival_ns = now_ns;
+}
+
+/***********************************************
+*
+* @Finalitat: Registrar l’arribada d’una trama qualsevol: és prova de vida però no és una mostra de
+*             l’interval (les trames de les distorsions arriben en ràfegues i escurçarien la mitjana).
+* @Paràmetres: in/out: detector = detector phi-accrual.
+*             in: now_ns = instant de l’arribada.
+* @Retorn: ----
+*
+************************************************/
+void phi_alive(PhiDetector* detector, uint64_t now_ns) {
+    detector->last_arrival_ns = now_ns;
+}
+
+/***********************************************
+*
+* @Finalitat: Calcular la mitjana (amb la pausa acceptable) i la desviació dels intervals.
+* @Paràmetres: in: detector = detector phi-accrual.
+*             out: mean = mitjana en ms.
+*             out: stddev = desviació en ms (com a mínim min_stddev_ms).
+* @Retorn: ----
+*
+************************************************/
+static void interval_stats(PhiDetector* detector, double* mean, double* stddev) {
+    double n = detector->num_intervals;
+    double avg = detector->sum_ms / n;
+    double variance = detector->sum_sq_ms / n - avg * avg;
+    *stddev = sqrt(variance > 0 ? variance : 0);
+    if (*stddev < detector->min_stddev_ms) {
+        *stddev = detector->min_stddev_ms;
+    }
+    *mean = avg + detector->pause_ms;
+}
+
+/***********************************************
+*
+* @Finalitat: Calcular el nivell de sospita phi = -log10(P(interval > temps sense trames)), suposant
+*             intervals amb distribució normal.
+* @Paràmetres: in: detector = detector phi-accrual.
+*             in: now_ns = instant actual.
+* @Retorn: Valor de phi (0 just després d’una trama, creix mentre no n’arriben).
+*
+************************************************/
+double phi_value(PhiDetector* detector, uint64_t now_ns) {
+    double mean, stddev;
+    interval_stats(detector, &mean, &stddev);
+
+    double elapsed_ms = (now_ns - detector->last_arrival_ns) / 1e6;
+    double p_later = 0.5 * erfc((elapsed_ms - mean) / (stddev * M_SQRT2));
+    if (p_later <= 0) {
+        return PHI_MAX;
+    }
+    double phi = -log10(p_later);
+    return (phi > PHI_MAX) ? PHI_MAX : phi;
+}
+
+/***********************************************
+*
+* @Finalitat: Estimar quant de temps falta, sense noves trames, perquè phi arribi a un llindar.
+* @Paràmetres: in: detector = detector phi-accrual.
+*             in: now_ns = instant actual.
+*             in: threshold = llindar de phi.
+* @Retorn: Mil·lisegons fins al llindar (0 si ja s’ha superat).
+*
+************************************************/
+double phi_time_to_reach(PhiDetector* detector, uint64_t now_ns, double threshold) {
+    double mean, stddev;
+    interval_stats(detector, &mean, &stddev);
+
+    // Cerca binaria del tiempo sin tramas en el que phi alcanza el umbral (phi crece con el tiempo)
+    double elapsed_ms = (now_ns - detector->last_arrival_ns) / 1e6;
+    double low = elapsed_ms, high = elapsed_ms + mean + 40 * stddev;
+    for (int i = 0; i < 40; i++) {
+        double mid = (low + high) / 2;
+        double p_later = 0.5 * erfc((mid - mean) / (stddev * M_SQRT2));
+        if (p_later <= 0 || -log10(p_later) >= threshold) {
+            high = mid;
+        } else {
+            low = mid;
+        }
+    }
+    return high - elapsed_ms;
+}
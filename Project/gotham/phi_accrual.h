@@ -0,0 +1,31 @@
+#ifndef PHI_ACCRUAL_H
+#define PHI_ACCRUAL_H
+
+#include <stdint.h>
+
+// Detector de fallos phi-accrual: el nivel de sospecha (phi) crece con el tiempo transcurrido desde
+// la última trama recibida, según la distribución de los intervalos entre respuestas a HEARTBEAT
+#define PHI_WINDOW 64               // Intervalos recordados
+#define PHI_MAX 50.0                // Valor máximo de phi (evita infinitos al redondear a 0 la probabilidad)
+
+typedef struct {
+    double intervals_ms[PHI_WINDOW];    // Ventana circular de intervalos entre tramas
+    int num_intervals;
+    int next;
+    double sum_ms;
+    double sum_sq_ms;
+    uint64_t last_arrival_ns;           // Última trama de cualquier tipo (prueba de vida)
+    uint64_t last_heartbeat_ns;         // Última respuesta a HEARTBEAT (origen del siguiente intervalo)
+    int started;                        // 0 hasta recibir la primera respuesta
+    double min_stddev_ms;               // Desviación mínima (evita sospechas por intervalos demasiado regulares)
+    double pause_ms;                    // Pausa aceptable que se suma a la media
+} PhiDetector;
+
+
+void phi_init(PhiDetector* detector, uint64_t now_ns, double expected_interval_ms, double min_stddev_ms, double pause_ms);
+void phi_heartbeat(PhiDetector* detector, uint64_t now_ns);
+void phi_alive(PhiDetector* detector, uint64_t now_ns);
+double phi_value(PhiDetector* detector, uint64_t now_ns);
+double phi_time_to_reach(PhiDetector* detector, uint64_t now_ns, double threshold);
+
+#endif
@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "rate_limit.h"
+
+
+/***********************************************
+*
+* @Finalitat: Obtenir l’entrada d’una clau amb les cubetes rellenades fins a l’instant actual; si la
+*             clau no hi és, s’ocupa una entrada lliure (o la menys usada) amb les cubetes plenes.
+*             Cal cridar-la amb el mutex bloquejat.
+* @Paràmetres: in/out: limiter = limitador.
+*             in: key = usuari o IP.
+*             in: now_ns = instant actual.
+* @Retorn: Entrada de la clau.
+*
+************************************************/
+static RateEntry* refill_entry(RateLimiter* limiter, const char* key, uint64_t now_ns) {
+    RateEntry* entry = NULL;
+    RateEntry* victim = &limiter->entries[0];
+    for (int i = 0; i < RATE_LIMIT_KEYS; i++) {
+        RateEntry* it = &limiter->entries[i];
+        if (it->key[0] != '\0' && strcmp(it->key, key) == 0) {
+            entry = it;
+            break;
+        }
+        if (victim->key[0] != '\0' && (it->key[0] == '\0' || it->last_ns < victim->last_ns)) {
+            victim = it;
+        }
+    }
+
+    if (entry == NULL) {
+        entry = victim;
+        snprintf(entry->key, sizeof(entry->key), "%s", key);
+        entry->request_tokens = limiter->requests.burst;
+        entry->kb_tokens = limiter->kb.burst;
+        entry->last_ns = now_ns;
+        return entry;
+    }
+
+    double elapsed_s = (now_ns > entry->last_ns) ? (now_ns - entry->last_ns) / 1e9 : 0;
+    entry->request_tokens = fmin(limiter->requests.burst, entry->request_tokens + limiter->requests.rate * elapsed_s);
+    entry->kb_tokens = fmin(limiter->kb.burst, entry->kb_tokens + limiter->kb.rate * elapsed_s);
+    entry->last_ns = now_ns;
+    return entry;
+}
+
+/***********************************************
+*
+* @Finalitat: Calcular quant falta perquè una cubeta tingui les fitxes necessàries.
+* @Paràmetres: in: limit = ritme i capacitat de la cubeta.
+*             in: tokens = fitxes actuals.
+*             in: needed = fitxes necessàries (es limiten a la capacitat perquè sempre s’acabin admetent).
+* @Retorn: Segons d’espera (0 si ja n’hi ha prou o la cubeta no limita).
+*
+************************************************/
+static double bucket_wait_s(RateLimit limit, double tokens, double needed) {
+    if (limit.rate <= 0) {
+        return 0;
+    }
+    needed = fmin(needed, limit.burst);
+    return (tokens >= needed) ? 0 : (needed - tokens) / limit.rate;
+}
+
+/***********************************************
+*
+* @Finalitat: Inicialitzar un limitador amb totes les cubetes buides de claus.
+* @Paràmetres: out: limiter = limitador.
+*             in: requests = límit de DISTORT per segon (rate 0 = sense límit).
+*             in: kb = límit de KB declarats per segon (rate 0 = sense límit).
+* @Retorn: ----
+*
+************************************************/
+void rate_limiter_init(RateLimiter* limiter, RateLimit requests, RateLimit kb) {
+    memset(limiter->entries, 0, sizeof(limiter->entries));
+    limiter->requests = requests;
+    limiter->kb = kb;
+    pthread_mutex_init(&limiter->mutex, NULL);
+}
+
+/***********************************************
+*
+* @Finalitat: Alliberar els recursos del limitador.
+* @Paràmetres: in/out: limiter = limitador.
+* @Retorn: ----
+*
+************************************************/
+void rate_limiter_destroy(RateLimiter* limiter) {
+    pthread_mutex_destroy(&limiter->mutex);
+}
+
+/***********************************************
+*
+* @Finalitat: Indicar si el limitador té algun límit configurat.
+* @Paràmetres: in: limiter = limitador.
+* @Retorn: 1 si limita peticions o KB, 0 si no.
+*
+************************************************/
+int rate_limiter_enabled(RateLimiter* limiter) {
+    return limiter->requests.rate > 0 || limiter->kb.rate > 0;
+}
+
+/***********************************************
+*
+* @Finalitat: Consultar (sense consumir fitxes) si una clau pot fer un DISTORT.
+* @Paràmetres: in/out: limiter = limitador.
+*             in: key = usuari o IP.
+*             in: kb = KB declarats a la petició.
+*             in: now_ns = instant actual.
+* @Retorn: 0 si s’admet, o mil·lisegons fins que tindrà fitxes suficients.
+*
+************************************************/
+long rate_limiter_wait_ms(RateLimiter* limiter, const char* key, double kb, uint64_t now_ns) {
+    if (!rate_limiter_enabled(limiter)) {
+        return 0;
+    }
+
+    kb = fmax(kb, 0);
+
+    pthread_mutex_lock(&limiter->mutex);
+    RateEntry* entry = refill_entry(limiter, key, now_ns);
+    double wait_s = fmax(bucket_wait_s(limiter->requests, entry->request_tokens, 1),
+                         bucket_wait_s(limiter->kb, entry->kb_tokens, kb));
+    pthread_mutex_unlock(&limiter->mutex);
+
+    return (wait_s > 0) ? (long)ceil(wait_s * 1000) : 0;
+}
+
+/***********************************************
+*
+* @Finalitat: Descomptar d’una clau les fitxes d’un DISTORT si en té prou, comprovant-ho i
+*             descomptant-les sota el mateix bloqueig (cap cubeta queda en negatiu).
+* @Paràmetres: in/out: limiter = limitador.
+*             in: key = usuari o IP.
+*             in: kb = KB declarats a la petició.
+*             in: now_ns = instant actual.
+* @Retorn: 0 si s’han descomptat, o mil·lisegons fins que tindrà fitxes suficients (no es descompta res).
+*
+************************************************/
+long rate_limiter_try_consume(RateLimiter* limiter, const char* key, double kb, uint64_t now_ns) {
+    if (!rate_limiter_enabled(limiter)) {
+        return 0;
+    }
+
+    kb = fmax(kb, 0);       // Un tamaño negativo no puede sumar fichas
+
+    pthread_mutex_lock(&limiter->mutex);
+    RateEntry* entry = refill_entry(limiter, key, now_ns);
+    double wait_s = fmax(bucket_wait_s(limiter->requests, entry->request_tokens, 1),
+                         bucket_wait_s(limiter->kb, entry->kb_tokens, kb));
+    if (wait_s <= 0) {
+        if (limiter->requests.rate > 0) {
+            entry->request_tokens -= 1;
+        }
+        if (limiter->kb.rate > 0) {
+            entry->kb_tokens -= fmin(kb, limiter->kb.burst);
+        }
+    }
+    pthread_mutex_unlock(&limiter->mutex);
+
+    return (wait_s > 0) ? (long)ceil(wait_s * 1000) : 0;
+}
+
+/***********************************************
+*
+* @Finalitat: Retornar a una clau les fitxes d’un DISTORT que finalment no s’ha admès (sense superar
+*             la capacitat de les cubetes).
+* @Paràmetres: in/out: limiter = limitador.
+*             in: key = usuari o IP.
+*             in: kb = KB declarats a la petició.
+*             in: now_ns = instant actual.
+* @Retorn: ----
+*
+************************************************/
+void rate_limiter_refund(RateLimiter* limiter, const char* key, double kb, uint64_t now_ns) {
+    if (!rate_limiter_enabled(limiter)) {
+        return;
+    }
+
+    kb = fmax(kb, 0);
+
+    pthread_mutex_lock(&limiter->mutex);
+    RateEntry* entry = refill_entry(limiter, key, now_ns);
+    if (limiter->requests.rate > 0) {
+        entry->request_tokens = fmin(limiter->requests.burst, entry->request_tokens + 1);
+    }
+    if (limiter->kb.rate > 0) {
+        entry->kb_tokens = fmin(limiter->kb.burst, entry->kb_tokens + fmin(kb, limiter->kb.burst));
+    }
+    pthread_mutex_unlock(&limiter->mutex);
+}
+
+/***********************************************
+*
+* @Finalitat: Llegir un límit <ritme>[:<ràfega>] d’una opció de configuració (la ràfega per defecte
+*             és un segon de ritme, com a mínim 1).
+* @Paràmetres: in: value = text de l’opció.
+*             out: limit = límit llegit.
+* @Retorn: 1 si és vàlid, 0 si no.
+*
+************************************************/
+int rate_limit_parse(const char* value, RateLimit* limit) {
+    char* end;
+    double rate = strtod(value, &end);
+    if (end == value || rate < 0) {
+        return 0;
+    }
+    double burst = fmax(rate, 1);
+    if (*end == ':') {
+        char* burst_str = end + 1;
+        burst = strtod(burst_str, &end);
+        if (end == burst_str || burst < 1) {
+            return 0;
+        }
+    }
+    if (*end != '\0') {
+        return 0;
+    }
+    limit->rate = rate;
+    limit->burst = burst;
+    return 1;
+}
@@ -0,0 +1,39 @@
+#ifndef RATE_LIMIT_H
+#define RATE_LIMIT_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+// Limitación de DISTORT por clave (usuario o IP de origen) con cubetas de fichas: cada clave tiene una
+// cubeta de peticiones y otra de KB declarados, que se rellenan a ritmo constante hasta su capacidad
+#define RATE_LIMIT_KEYS 128         // Claves recordadas (con la tabla llena se reutiliza la menos usada)
+
+typedef struct {
+    double rate;                    // Fichas por segundo (0 = sin límite)
+    double burst;                   // Capacidad de la cubeta
+} RateLimit;
+
+typedef struct {
+    char key[48];                   // "" si la entrada está libre
+    double request_tokens;
+    double kb_tokens;
+    uint64_t last_ns;               // Último relleno de las cubetas
+} RateEntry;
+
+typedef struct {
+    RateLimit requests;             // DISTORT por segundo
+    RateLimit kb;                   // KB declarados por segundo
+    RateEntry entries[RATE_LIMIT_KEYS];
+    pthread_mutex_t mutex;
+} RateLimiter;
+
+
+void rate_limiter_init(RateLimiter* limiter, RateLimit requests, RateLimit kb);
+void rate_limiter_destroy(RateLimiter* limiter);
+int rate_limiter_enabled(RateLimiter* limiter);
+long rate_limiter_wait_ms(RateLimiter* limiter, const char* key, double kb, uint64_t now_ns);
+long rate_limiter_try_consume(RateLimiter* limiter, const char* key, double kb, uint64_t now_ns);
+void rate_limiter_refund(RateLimiter* limiter, const char* key, double kb, uint64_t now_ns);
+int rate_limit_parse(const char* value, RateLimit* limit);
+
+#endif
@@ -10,9 +10,7 @@ Server* server_flecks = NULL;
 volatile int gotham_connection_alive = 0;
 volatile int distort_in_progress = 0;
 
-ClientThread* threads = NULL;           // Threads generados por cada conexión Fleck
-// pthread_t* subthreads = NULL;      // Threads generados por cada conexión Fleck
-int num_threads = 0;
+WorkerPool* fleck_pool = NULL;          // Hilos que atienden las conexiones Fleck
 int server_running = 0;
 
 /***********************************************
@@ -47,7 +45,11 @@ void handle_sigint(/*int sig*/) {
     // CERRAR CONEXIONES FLECKS
 
     // CERRAR THREADS
-    WORKER_cancel_and_wait_threads(threads, num_threads);
+    WORKER_pool_destroy(fleck_pool);
+    transport_capture_close();
+
+    // Volcar los tiempos de las distorsiones realizadas
+    timings_print(&worker_timings, 1);
     
     // Salir del programa
     signal(SIGINT, SIG_DFL);
@@ -71,6 +73,23 @@ int main(int argc, char *argv[]) {
 
     printF("\nWorker Config Enigma:\n");
     WORKER_print_config(config);
+    if (config->capture[0] != '\0' && transport_capture_open(config->capture) < 0) {
+        perror("Error al abrir el archivo de captura de tramas");
+    }
+
+    /* SERVIDOR WORKER-FLECKS */
+    // Preparar el servidor de Flecks y sus hilos antes de registrarse en Gotham: un Worker secundario
+    // queda en espera con todo listo y al ser promocionado sólo tiene que empezar a aceptar conexiones
+    server_flecks = create_server(config->ip_fleck, config->port_fleck, 10);
+    start_server(server_flecks);
+    mkdir(WORKER_SPOOL_DIR, 0755);
+
+    // Crear los hilos que atenderán las conexiones de Fleck
+    fleck_pool = WORKER_pool_create(&gotham_connection_alive, &distort_in_progress, &config->fairness);
+    if (fleck_pool == NULL) {
+        printF("Error al crear el pool de hilos.\n");
+        return -1;
+    }
 
     // Conectar con Gotham
     int isPrincipalWorker = 0;     // Puntero entero que nos indica si somos el worker principal o no
@@ -78,6 +97,8 @@ int main(int argc, char *argv[]) {
     if (gotham_sock_fd < 0) {
         printF("Error al conectar Enigma con Gotham.\n");
         // Liberar la memoria antes de salir
+        WORKER_pool_destroy(fleck_pool);
+        close_server(server_flecks);
         free(config->ip_gotham);
         free(config->ip_fleck);
         free(config->worker_dir);
@@ -85,45 +106,28 @@ int main(int argc, char *argv[]) {
         free(config);
         return -1;
     }
+    if (isPrincipalWorker) {
+        WORKER_set_principal();
+    }
 
-    // Creamos thread para responder Heartbeats o asignación_principal_worker de Gotham
+    // Creamos thread para responder Heartbeats y asignación_principal_worker de Gotham (durante toda la ejecución)
     pthread_t thread_id;
     if (pthread_create(&thread_id, NULL, responder_gotham, (void *)&gotham_sock_fd) != 0) {
         perror("Error creando el hilo para heartbeat");
         return -1;
     }
-
-    if (isPrincipalWorker == 0) {
-        // Esperar a que el thread termine (cuando nos asignen como Worker principal)
-        // void* retval;
-        if (pthread_join(thread_id, NULL) != 0) {
-            perror("Error en pthread_join");
-            exit(EXIT_FAILURE);
-        }
-        printF("Principal Worker desconectado, ahora nosotros somos Principal.\n");
-        // Actualizamos el valor de isPrincipalWorker
-        isPrincipalWorker = 1;
-
-        // Volver a crear thread para responder HEARTBEATs
-        if (pthread_create(&thread_id, NULL, responder_gotham, (void *)&gotham_sock_fd) != 0) {
-            perror("Error creando el hilo para heartbeat");
-            return -1;
-        }
-    }
-    // Desvincular el thread para que no necesite ser unido posteriormente y se use para HEARTBEATs
     if (pthread_detach(thread_id) != 0) {
         perror("Error desvinculando el hilo");
         return -1;
     }
-    
-    /* SERVIDOR WORKER-FLECKS */
-    // Crear nuevo servidor para conexiones con Fleck
-    
-    // Configurar servidor    
-    server_flecks = create_server(config->ip_fleck, config->port_fleck, 10);
-    start_server(server_flecks);
-    
-    
+
+    // Worker secundario: esperar a que Gotham nos asigne como Worker principal
+    if (isPrincipalWorker == 0) {
+        WORKER_wait_principal();
+        printF("Principal Worker desconectado, ahora nosotros somos Principal.\n");
+    }
+
+
     //Bucle para leer cada conexion que nos llegue de un fleck
     int socket_connection;
     server_running = 1;
@@ -132,27 +136,12 @@ int main(int argc, char *argv[]) {
         printF("Esperando conexiones de Flecks...\n");
         socket_connection = accept_connection(server_flecks);
 
-        ClientThread* new_threads = realloc(threads, (num_threads + 1) * sizeof(ClientThread));
-        if (!new_threads) {
-            close(socket_connection);
+        if (socket_connection < 0) {
             continue;
         }
 
-        threads = new_threads;
-        threads[num_threads].socket = socket_connection;
-        threads[num_threads].active = 1;
-        threads[num_threads].gotham_connection_alive = &gotham_connection_alive;
-        threads[num_threads].distort_in_progress = &distort_in_progress;
-
-        // Crear un hilo para manejar la conexión con el cliente(Fleck)
-        if (pthread_create(&threads[num_threads].thread_id, NULL, handle_fleck_connection, &threads[num_threads]) != 0) {
-            close(threads[num_threads].socket);
-            perror("Error al crear el hilo");
-            continue;
-        }
-
-        num_threads++;
-
+        // Encolar la conexión para un hilo del pool (con la cola llena se responde BUSY a Fleck)
+        WORKER_pool_submit(fleck_pool, socket_connection);
     }
     close_server(server_flecks);
 
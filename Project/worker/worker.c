@@ -4,9 +4,60 @@
 
 #include "../gotham/gothamlib.h"
 #include <errno.h>
+#include <sys/statvfs.h>
 
 #include "worker.h"
 
+// Promoción de Worker secundario a principal (la notifica el hilo que responde a Gotham)
+static int is_principal = 0;
+static pthread_mutex_t principal_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t principal_cond = PTHREAD_COND_INITIALIZER;
+
+// Conexión con Gotham compartida por el hilo de HEARTBEATs y los estados de distorsión de los hilos del pool
+static int gotham_fd = -1;
+static pthread_mutex_t gotham_write_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// 1 si Gotham reparte las distorsiones con una cola de la que los Workers libres las reclaman (routing=pull)
+static int pull_mode = 0;
+
+/***********************************************
+*
+* @Finalitat: Aplicar una opció <clau>=<valor> del fitxer de configuració del Worker.
+* @Parametres:
+*   in/out: config = configuració a modificar.
+*   in: option = línia amb l’opció.
+* @Retorn: 1 si l’opció és vàlida, 0 si no.
+*
+************************************************/
+int WORKER_set_option(Enigma_HarleyConfig* config, char* option) {
+    char* value = strchr(option, '=');
+    if (value == NULL) {
+        value = "";
+    } else {
+        *value++ = '\0';
+    }
+    char* weight = strrchr(value, ':');
+    PoolFairness* fairness = &config->fairness;
+
+    if (strcmp(option, "user_weight") == 0 && weight != NULL && weight != value && atoi(weight + 1) > 0
+        && fairness->num_weights < WORKER_MAX_USER_WEIGHTS) {
+        UserWeight* user_weight = &fairness->weights[fairness->num_weights++];
+        snprintf(user_weight->username, sizeof(user_weight->username), "%.*s", (int)(weight - value), value);
+        user_weight->weight = atoi(weight + 1);
+    } else if (strcmp(option, "user_max_inflight") == 0 && atoi(value) >= 0) {
+        fairness->max_user_inflight = atoi(value);
+    } else if (strcmp(option, "capture") == 0 && value[0] != '\0' && strlen(value) < sizeof(config->capture)) {
+        strcpy(config->capture, value);
+    } else {
+        char* buffer;
+        asprintf(&buffer, "Opción de configuración inválida: '%s'\n", option);
+        printF(buffer);
+        free(buffer);
+        return 0;
+    }
+    return 1;
+}
+
 /***********************************************
 *
 * @Finalitat: Llegir i parsejar el fitxer de configuració per a un Worker (Enigma o Harley), obtenint
@@ -106,6 +157,18 @@ Enigma_HarleyConfig* WORKER_read_config(const char *config_file) {
     // Eliminar caracteres invisibes de la IP
     eliminar_caracteres(config->worker_type);
 
+    // Opciones: valores por defecto y líneas <clave>=<valor> opcionales
+    memset(&config->fairness, 0, sizeof(PoolFairness));
+    config->capture[0] = '\0';
+    char* buffer;
+    while ((buffer = read_until(fd, '\n')) != NULL) {
+        eliminar_caracteres(buffer);
+        if (buffer[0] != '\0' && buffer[0] != '#') {
+            WORKER_set_option(config, buffer);
+        }
+        free(buffer);
+    }
+
     close(fd);
     return config; // Devolver la configuración leída
 }
@@ -145,48 +208,27 @@ void WORKER_print_config(Enigma_HarleyConfig* config) {
     printF(buffer);
     free(buffer);
 
+    asprintf(&buffer, "Reparto por usuario: user_max_inflight=%d (0 = sin límite)\n", config->fairness.max_user_inflight);
+    printF(buffer);
+    free(buffer);
+    for (int i = 0; i < config->fairness.num_weights; i++) {
+        asprintf(&buffer, "Peso de '%s': %d\n", config->fairness.weights[i].username, config->fairness.weights[i].weight);
+        printF(buffer);
+        free(buffer);
+    }
+    if (config->capture[0] != '\0') {
+        asprintf(&buffer, "Captura de tramas: %s\n", config->capture);
+        printF(buffer);
+        free(buffer);
+    }
+
     printF("\n");
 }
 
 
-// LIBERAR MEMORIA 
-
-/***********************************************
-*
-* @Finalitat: Tancar i alliberar subthreads de Flecks
-* @Parametres:
-*   in/out: threads     = array de ClientThread.
-*   in:     num_threads = nombre de fils actius.
-* @Retorn: --- (allibera tot i posa num_threads a 0).
-*
-************************************************/
-void WORKER_cancel_and_wait_threads(ClientThread* threads, int num_threads) {
-    for (int i = 0; i < num_threads; i++) {
-        if (threads[i].active) {
-            threads[i].active = 0; // Indica al hilo que debe terminar
-            
-            if (threads[i].thread_id <= 0) {
-                continue;
-            }
-            
-            // enviar señal al socket para desbloquear accept/read
-            shutdown(threads[i].socket, SHUT_RDWR);
-            
-            // Esperamos a que el thread se cierre de forma segura
-            int join_result = pthread_join(threads[i].thread_id, NULL);
-            if (join_result != 0) {
-                // perror("Error al esperar el thread");
-            }
-            close(threads[i].socket);
-        }
-    }
-    free(threads);
-    num_threads = 0;
-}
-
 /***********************************************
 *
-* @Finalitat: Establir connexió TCP amb el servidor Gotham, enviar la trama de connect i
+* @Finalitat: Establir connexió (TCP o socket Unix) amb el servidor Gotham, enviar la trama de connect i
 *             determinar si el Worker és principal.
 * @Parametres:
 *   in: config            = punter a Enigma_HarleyConfig.
@@ -201,34 +243,16 @@ int WORKER_connect_to_gotham(Enigma_HarleyConfig *config, int* isPrincipalWorker
 
     if (strcmp(config->worker_type, "Text") == 0) {
         printF ("Connecting Enigma worker to the system..\n");
-    }
-
-    if (strcmp(config->worker_type, "Media") == 0) {
+    } else {
+        // Harley: "Media" o una lista de tipos concretos ("Image", "Audio", "Image,Audio"...)
         printF ("Connecting Harley worker to the system..\n");
     }
 
 
-    // Crear socket
-    int sock_fd = socket(AF_INET, SOCK_STREAM, 0);
+    // Conectar al servidor Gotham (IP y puerto, o unix:/ruta si está en el mismo host)
+    int sock_fd = connect_to_server(config->ip_gotham, config->port_gotham);
     if (sock_fd < 0) {
-        printF("Error al crear el socket\n");
-        return -1;
-    }
-
-    // Configurar dirección de Gotham
-    struct sockaddr_in gotham_address;
-    gotham_address.sin_family = AF_INET;
-    gotham_address.sin_port = config->port_gotham;
-    if (inet_pton(AF_INET, config->ip_gotham, &gotham_address.sin_addr) <= 0) {
-        printF("Dirección IP de Gotham no válida\n");
-        close(sock_fd);
-        return -1;
-    }
-
-    // Conectar al servidor Gotham
-    if (connect(sock_fd, (struct sockaddr *)&gotham_address, sizeof(gotham_address)) < 0) {
-        printF("Error al conectar con Gotham\n");
-        close(sock_fd);
+        printF(errno == EINVAL ? "Dirección IP de Gotham no válida\n" : "Error al conectar con Gotham\n");
         return -1;
     }
 
@@ -237,7 +261,7 @@ int WORKER_connect_to_gotham(Enigma_HarleyConfig *config, int* isPrincipalWorker
     asprintf(&data, "%s&%s&%d", config->worker_type, config->ip_fleck, config->port_fleck);    // Se envía port_fleck para que Gotham sepa el puerto al que se tendrán que conectar los Flecks con el Worker
     if (data == NULL) {
         printF("Error en malloc para data\n");
-        close(sock_fd);
+        transport_close(sock_fd);
         return -1;
     }
     
@@ -246,16 +270,16 @@ int WORKER_connect_to_gotham(Enigma_HarleyConfig *config, int* isPrincipalWorker
     if (trama == NULL) {
         printF("Error creando la trama\n");
         free(data);
-        close(sock_fd);
+        transport_close(sock_fd);
         return -1;
     }
 
     // Enviar la trama a Gotham
-    if (write(sock_fd, trama, BUFFER_SIZE) < 0) {
+    if (transport_send_frame(sock_fd, trama) < 0) {
         printF("Error enviando la trama de conexión a Gotham\n");
         free(data);
         free(trama);
-        close(sock_fd);
+        transport_close(sock_fd);
         return -1;
     }
 
@@ -265,16 +289,16 @@ int WORKER_connect_to_gotham(Enigma_HarleyConfig *config, int* isPrincipalWorker
         printF("Error en malloc para response\n");
         free(data);
         free(trama);
-        close(sock_fd);
+        transport_close(sock_fd);
         return -1;
     }
-    int bytes_read = read(sock_fd, response, BUFFER_SIZE);
+    int bytes_read = transport_recv_frame(sock_fd, (unsigned char*)response);
     if (bytes_read < 0) {
         printF("Error leyendo la respuesta de Gotham\n");
         free(data);
         free(trama);
         free(response);
-        close(sock_fd);
+        transport_close(sock_fd);
         return -1;
     }
 
@@ -284,16 +308,25 @@ int WORKER_connect_to_gotham(Enigma_HarleyConfig *config, int* isPrincipalWorker
     } else if (response[0] ==  TYPE_PRINCIPAL_WORKER ) {//&& response[3] == '\0'
         printF("Connected to Mr. J System as PRINCIPAL Worker, ready to listen to Fleck petitions\n");
         *isPrincipalWorker = 1;
+
+        TramaResult* result = leer_trama((unsigned char*)response);
+        if (result != NULL && strcmp(result->data, PULL_MODE) == 0) {
+            printF("Gotham reparte las distorsiones bajo demanda: se reclamarán al quedar hilos libres\n");
+            pull_mode = 1;
+        }
+        if (result != NULL) free_tramaResult(result);
     } else {
         printF("Conexión rechazada por Gotham.\n");
         free(data);
         free(trama);
         free(response);
-        close(sock_fd);
+        transport_close(sock_fd);
         return -1;
     }    
 
     gotham_connection_alive = 1;
+    gotham_fd = sock_fd;
+    WORKER_request_jobs();
 
     // Liberar memoria dinámica
     free(data);
@@ -306,10 +339,70 @@ int WORKER_connect_to_gotham(Enigma_HarleyConfig *config, int* isPrincipalWorker
 
 /***********************************************
 *
-* @Finalitat: Hilo que respon a trames de Gotham: HEARTBEAT amb OK i detecta assignació com a worker principal.
+* @Finalitat: Marcar el Worker com a principal i despertar el fil que espera la promoció.
+* @Parametres: ---
+* @Retorn: ---
+*
+************************************************/
+void WORKER_set_principal(void) {
+    pthread_mutex_lock(&principal_mutex);
+    is_principal = 1;
+    pthread_cond_broadcast(&principal_cond);
+    pthread_mutex_unlock(&principal_mutex);
+}
+
+/***********************************************
+*
+* @Finalitat: Esperar (Worker secundari) fins que Gotham l’assigni com a Worker principal.
+* @Parametres: ---
+* @Retorn: ---
+*
+************************************************/
+void WORKER_wait_principal(void) {
+    pthread_mutex_lock(&principal_mutex);
+    while (!is_principal) {
+        pthread_cond_wait(&principal_cond, &principal_mutex);
+    }
+    pthread_mutex_unlock(&principal_mutex);
+}
+
+/***********************************************
+*
+* @Finalitat: Formatejar la càrrega del Worker per a la resposta a un HEARTBEAT:
+*             <encuades>&<en curs>&<capacitat de la cua>&<loadavg 1 min>&<MB lliures al spool>&<temps de servei ms>
+* @Parametres:
+*   out: buffer = cadena on s’escriu la càrrega.
+*   in:  size   = mida del buffer.
+* @Retorn: ---
+*
+************************************************/
+static void format_load(char* buffer, size_t size) {
+    int active, queued;
+    WORKER_pool_load(fleck_pool, &active, &queued);
+
+    double load_avg = 0;
+    if (getloadavg(&load_avg, 1) < 1) {
+        load_avg = 0;
+    }
+
+    // Espacio libre en el directorio de archivos recibidos (o en el directorio actual si aún no existe)
+    struct statvfs fs;
+    long disk_free_mb = 0;
+    if (statvfs(WORKER_SPOOL_DIR, &fs) == 0 || statvfs(".", &fs) == 0) {
+        disk_free_mb = (long)((unsigned long long)fs.f_bavail * fs.f_frsize / (1024 * 1024));
+    }
+
+    snprintf(buffer, size, "%d&%d&%d&%.2f&%ld&%.1f", queued, active, WORKER_POOL_QUEUE, load_avg,
+             disk_free_mb, WORKER_service_time_ms());
+}
+
+/***********************************************
+*
+* @Finalitat: Hilo que respon a trames de Gotham: HEARTBEAT amb la càrrega del pool i assignació
+*             com a worker principal (avisa el fil principal amb WORKER_set_principal).
 * @Parametres:
 *   in: arg = punter a descriptor de socket.
-* @Retorn: NULL al finalitzar (p.e. al rebre TYPE_PRINCIPAL_WORKER).
+* @Retorn: NULL al finalitzar (en tancar-se la connexió amb Gotham).
 *
 ************************************************/
 void* responder_gotham(void *arg) {
@@ -319,7 +412,7 @@ void* responder_gotham(void *arg) {
 
     while (1) {
         // Recibir mensaje del cliente
-        int bytes_read = recv(socket_fd, buffer, BUFFER_SIZE, 0);
+        int bytes_read = transport_recv_frame(socket_fd, buffer);
         
         if (bytes_read <= 0) {
             if (bytes_read == 0) {
@@ -335,7 +428,7 @@ void* responder_gotham(void *arg) {
                 // Error en recv
                 perror("Error leyendo mensaje de Gotham.\n");
             }
-            close(socket_fd);
+            transport_close(socket_fd);
             return NULL;  // Terminar el thread si ocurre un error
         }
         buffer[bytes_read] = '\0'; // Asegurar que está null-terminado
@@ -352,26 +445,36 @@ void* responder_gotham(void *arg) {
             //Si la trama es un mensaje HEARTBEAT responder
             if (result->type == TYPE_HEARTBEAT)
             {
-                // Responder al cliente
-                tramaEnviar = crear_trama(TYPE_HEARTBEAT, (unsigned char*)"", strlen(""));
+                // Responder con la carga actual del Worker
+                char load[128];
+                format_load(load, sizeof(load));
+                tramaEnviar = crear_trama(TYPE_HEARTBEAT, (unsigned char*)load, strlen(load));
                 if (socket_fd >= 0) {
-                    if (write(socket_fd, tramaEnviar, BUFFER_SIZE) < 0) {
+                    pthread_mutex_lock(&gotham_write_mutex);
+                    ssize_t written = transport_send_frame(socket_fd, tramaEnviar);
+                    pthread_mutex_unlock(&gotham_write_mutex);
+                    if (written < 0) {
                         perror("Error enviando respuesta al cliente");
-                        close(socket_fd);
+                        transport_close(socket_fd);
                         if (tramaEnviar) free(tramaEnviar);
                         return NULL;  // Terminar el hilo si ocurre un error
                     }
                 }
                 free(tramaEnviar);
+
+                // Volver a informar de los huecos libres (corrige los asignados que nunca llegaron)
+                WORKER_request_jobs();
             }
 
             //Si la trama es un mensaje Asignación de Worker principal
             else if (result->type == TYPE_PRINCIPAL_WORKER)
             {
                 printF("Somos principal\n");
-                // Salimos para crear servidor de Flecks y convertirnos en Worker principal (Gestionado en harley.c o enigma.c)
-                return NULL;   
+                // Despertar al hilo principal, que ya tiene el servidor de Flecks preparado (harley.c o enigma.c);
+                // este hilo sigue respondiendo HEARTBEATs
+                WORKER_set_principal();
             }
+            free_tramaResult(result);
             
         }
         
@@ -380,6 +483,71 @@ void* responder_gotham(void *arg) {
     return NULL;
 }
 
+/***********************************************
+*
+* @Finalitat: Informar Gotham de la fase d’una distorsió (trama TYPE_JOB_STATUS, sense resposta).
+*             Només s’envia si l’identificador és el del registre de Gotham (numèric).
+* @Parametres:
+*   in: job_id = identificador de la distorsió enviat per Fleck.
+*   in: phase  = fase (JOB_STATUS_*).
+* @Retorn: ---
+*
+************************************************/
+void WORKER_report_job(const char* job_id, const char* phase) {
+    if (job_id == NULL || job_id[0] == '\0' || gotham_fd < 0 || !gotham_connection_alive) {
+        return;
+    }
+    for (const char* c = job_id; *c != '\0'; c++) {
+        if (!isdigit((unsigned char)*c)) {
+            return;     // Identificador propio de Fleck (<pid>-<n>): Gotham no lo conoce
+        }
+    }
+
+    char data[64];
+    snprintf(data, sizeof(data), "%s&%s", job_id, phase);
+    unsigned char* trama = crear_trama(TYPE_JOB_STATUS, (unsigned char*)data, strlen(data));
+    if (trama == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&gotham_write_mutex);
+    if (transport_send_frame(gotham_fd, trama) < 0) {
+        perror("Error enviando estado de la distorsión a Gotham");
+    }
+    pthread_mutex_unlock(&gotham_write_mutex);
+    free(trama);
+}
+
+/***********************************************
+*
+* @Finalitat: Reclamar distorsions a Gotham (trama TYPE_JOB_REQUEST amb els fils lliures del pool).
+*             Només s’envia si Gotham fa servir routing=pull.
+* @Parametres: ---
+* @Retorn: ---
+*
+************************************************/
+void WORKER_request_jobs(void) {
+    if (!pull_mode || gotham_fd < 0 || !gotham_connection_alive || fleck_pool == NULL) {
+        return;
+    }
+
+    int active, queued;
+    WORKER_pool_load(fleck_pool, &active, &queued);
+    int free_slots = WORKER_POOL_THREADS - WORKER_running_jobs() - queued;
+
+    char data[16];
+    snprintf(data, sizeof(data), "%d", (free_slots > 0) ? free_slots : 0);
+    unsigned char* trama = crear_trama(TYPE_JOB_REQUEST, (unsigned char*)data, strlen(data));
+    if (trama == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&gotham_write_mutex);
+    if (transport_send_frame(gotham_fd, trama) < 0) {
+        perror("Error reclamando distorsiones a Gotham");
+    }
+    pthread_mutex_unlock(&gotham_write_mutex);
+    free(trama);
+}
+
 /***********************************************
 *
 * @Finalitat: Enviar a Gotham la trama de desconexió i tancar el socket de comunicació.
@@ -399,7 +567,11 @@ int WORKER_disconnect_from_gotham(int sock_fd, Enigma_HarleyConfig *config) {
     }
 
     // Enviar la trama de desconexión a Gotham
-    if (write(sock_fd, trama, BUFFER_SIZE) < 0) {
+    pthread_mutex_lock(&gotham_write_mutex);
+    ssize_t written = transport_send_frame(sock_fd, trama);
+    gotham_fd = -1;
+    pthread_mutex_unlock(&gotham_write_mutex);
+    if (written < 0) {
         printF("Error enviando la trama de desconexión a Gotham\n");
         free(trama);
         return -1;
@@ -409,7 +581,7 @@ int WORKER_disconnect_from_gotham(int sock_fd, Enigma_HarleyConfig *config) {
 
     // Cerrar el socket
     if (sock_fd >= 0) {
-        close(sock_fd);
+        transport_close(sock_fd);
     }
 
     printF("Disconnected from Gotham\n");
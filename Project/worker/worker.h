@@ -5,8 +5,10 @@
 #include <pthread.h>
 
 #include "../config/connections.h"
+#include "../config/transport.h"
 #include "../config/config.h"
 #include "worker_distort.h"
+#include "worker_pool.h"
 
 typedef struct {
     char *ip_gotham;     // Dirección IP para Gotham (dinámico)
@@ -15,19 +17,27 @@ typedef struct {
     int port_fleck;      // Puerto para Fleck
     char *worker_dir;    // Directorio de trabajo para Enigma/Harley (dinámico)
     char *worker_type;   // Tipo de worker ("Media" o "Text") (dinámico)
+
+    // Opciones <clave>=<valor> (líneas opcionales tras las seis anteriores)
+    PoolFairness fairness;  // user_weight=<usuario>:<peso> (repetible) y user_max_inflight=<n>
+    char capture[256];      // capture=<archivo>: captura de las tramas enviadas y recibidas ("" si no se captura)
 } Enigma_HarleyConfig;
 
 extern volatile int gotham_connection_alive;
 extern volatile int distort_in_progress;
+extern WorkerPool* fleck_pool;
 
 
 Enigma_HarleyConfig* WORKER_read_config(const char *config_file);
+int WORKER_set_option(Enigma_HarleyConfig* config, char* option);
 void WORKER_print_config(Enigma_HarleyConfig* config);
 
-void WORKER_cancel_and_wait_threads(ClientThread* threads, int num_threads);
-
 int WORKER_connect_to_gotham(Enigma_HarleyConfig *config, int* isPrincipalWorker);
 void* responder_gotham(void *arg);
+void WORKER_set_principal(void);
+void WORKER_wait_principal(void);
+void WORKER_report_job(const char* job_id, const char* phase);
+void WORKER_request_jobs(void);
 int WORKER_disconnect_from_gotham(int sock_fd, Enigma_HarleyConfig *config);
 
 #endif
\ No newline at end of file
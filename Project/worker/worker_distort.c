@@ -1,9 +1,34 @@
 #define _GNU_SOURCE
 
 #include "worker_distort.h"
+#include "worker.h"
 #include "enigma/enigmalib.h"
 #include "harley/so_compression.h"
 
+static const char* const WORKER_PHASE_NAMES[WORKER_NUM_PHASES] = {
+    "receive", "md5_verify", "distort", "md5", "send", "confirm", "total"
+};
+
+// Histogramas de latencia por fase y tipo de archivo de todas las distorsiones de este Worker
+TimingTable worker_timings = { .phase_names = WORKER_PHASE_NAMES, .num_phases = WORKER_NUM_PHASES };
+
+// Coste por KB de cada tipo medido en este Worker (ordena las conexiones en cola del pool)
+SchedModel worker_sched = {
+    .ms_per_kb = {
+        [TIMING_KIND_TEXT] = SCHED_TEXT_MS_PER_KB,
+        [TIMING_KIND_IMAGE] = SCHED_IMAGE_MS_PER_KB,
+        [TIMING_KIND_AUDIO] = SCHED_AUDIO_MS_PER_KB,
+    },
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+// Media móvil exponencial del tiempo de servicio de las distorsiones (informada a Gotham en los HEARTBEATs)
+static double service_time_ms = 0;
+static pthread_mutex_t service_time_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Distorsiones en curso (las conexiones persistentes inactivas no cuentan)
+static atomic_int running_jobs = 0;
+
 // Estructura para memoria compartida
 typedef struct {
     int transfer_flag;  // 0=recibiendo, 1=distorsionando, 2=enviando
@@ -11,27 +36,67 @@ typedef struct {
 } SharedData;
 
 
+/***********************************************
+*
+* @Finalitat: Actualitzar la mitjana mòbil del temps de servei amb una distorsió acabada.
+* @Parametres:
+*   in: elapsed_ms = durada de la distorsió en ms.
+* @Retorn: ---
+*
+************************************************/
+static void record_service_time(double elapsed_ms) {
+    pthread_mutex_lock(&service_time_mutex);
+    if (service_time_ms == 0) {
+        service_time_ms = elapsed_ms;
+    } else {
+        service_time_ms += WORKER_SERVICE_EWMA_ALPHA * (elapsed_ms - service_time_ms);
+    }
+    pthread_mutex_unlock(&service_time_mutex);
+}
+
+/***********************************************
+*
+* @Finalitat: Consultar la mitjana mòbil del temps de servei de les distorsions recents.
+* @Parametres: ---
+* @Retorn: Temps de servei en ms (0 si encara no s’ha acabat cap distorsió).
+*
+************************************************/
+double WORKER_service_time_ms(void) {
+    pthread_mutex_lock(&service_time_mutex);
+    double value = service_time_ms;
+    pthread_mutex_unlock(&service_time_mutex);
+    return value;
+}
+
 /***********************************************
 *
 * @Finalitat: Enviar al client Fleck la trama inicial de retorn de fitxer distorsionat amb
-*             tamany i checksum, i validar la seva resposta.
+*             tamany, checksum i identificador de distorsió, i validar la seva resposta.
 * @Parametres:
 *   in: socket_fd    = descriptor del socket amb Fleck.
 *   in: fileSize     = cadena amb el nombre de bytes del fitxer.
 *   in: fileMD5SUM   = cadena amb el MD5 sum del fitxer.
+*   in: job_id       = identificador de la distorsió ("" si Fleck no n’ha enviat).
+*   in: offset       = byte des del qual es reprèn l’enviament (0 si no és una represa).
 * @Retorn: 1 en èxit, -1 en cas d’error.
 *
 ************************************************/
-int start_send_back_distort(int socket_fd, char* fileSize, char* fileMD5SUM) {
+int start_send_back_distort(int socket_fd, char* fileSize, char* fileMD5SUM, char* job_id, long offset) {
     
-    // Preparar y enviar la trama inicial de archivo distorsionado para Fleck
+    // Preparar y enviar la trama inicial de archivo distorsionado para Fleck (filesize&md5sum[&job_id&offset])
     unsigned char* data;
-    asprintf((char**)&data, "%s&%s", fileSize, fileMD5SUM);
+    if (job_id[0] != '\0') {
+        // Al reanudar, Fleck descarta lo que recibió más allá de offset (el Worker anterior pudo caer
+        // entre enviar una trama y anotarla en la memoria compartida)
+        asprintf((char**)&data, "%s&%s&%s&%ld", fileSize, fileMD5SUM, job_id, offset);
+    } else {
+        asprintf((char**)&data, "%s&%s", fileSize, fileMD5SUM);
+    }
     // printF((char*)data);
     // printF("\n");
     
     unsigned char* tramaEnviar = crear_trama(TYPE_START_DISTORT_WORKER_FLECK, data, strlen((char*)data));
-    if (write(socket_fd, tramaEnviar, BUFFER_SIZE) < 0) {
+    if (transport_send_frame(socket_fd, tramaEnviar) < 0) {
         perror("Error enviando respuesta al cliente");
         return -1;
     }
@@ -41,7 +106,7 @@ int start_send_back_distort(int socket_fd, char* fileSize, char* fileMD5SUM) {
 
     // Leer la respuesta inicial de distorsión 
     unsigned char response[BUFFER_SIZE];
-    int bytes_received = recv(socket_fd, response, BUFFER_SIZE, 0);
+    int bytes_received = transport_recv_frame(socket_fd, response);
     
     TramaResult *result;
     if (bytes_received > 0) {
@@ -206,7 +271,7 @@ int tancar_mem_compartida(SharedData **shared, int fd_shared, char* filename, in
 int send_confirm_file_received (int socket_connection) {
     // Enviar confirmación de que el archivo se recibió correctamente cxon MD5SUM correcto
     unsigned char *success_trama = crear_trama(TYPE_END_DISTORT_FLECK_WORKER, (unsigned char*)CHECK_OK, strlen(CHECK_OK));
-    if (write(socket_connection, success_trama, BUFFER_SIZE) < 0) {
+    if (transport_send_frame(socket_connection, success_trama) < 0) {
         perror("Error enviando confirmación de MD5");
         free(success_trama);
 
@@ -216,7 +281,7 @@ int send_confirm_file_received (int socket_connection) {
 
     // Esperar OK de Fleck
     unsigned char response[BUFFER_SIZE];
-    int bytes_received = recv(socket_connection, response, BUFFER_SIZE, 0);
+    int bytes_received = transport_recv_frame(socket_connection, response);
     
     if (bytes_received > 0) {
         // Procesar la trama
@@ -256,7 +321,7 @@ int wait_confirm_file_received(int socket_connection) {
     
     // Leer la respuesta final de distorsión 
     unsigned char response[BUFFER_SIZE];
-    int bytes_received = recv(socket_connection, response, BUFFER_SIZE, 0);
+    int bytes_received = transport_recv_frame(socket_connection, response);
     
     TramaResult *result;
     if (bytes_received > 0) {
@@ -281,7 +346,7 @@ int wait_confirm_file_received(int socket_connection) {
 
         // Enviar confirmación de recepción (ACK) a Fleck
         unsigned char *success_trama = crear_trama(TYPE_END_DISTORT_FLECK_WORKER, (unsigned char*)OK_MSG, strlen(OK_MSG));
-        if (write(socket_connection, success_trama, BUFFER_SIZE) < 0) {
+        if (transport_send_frame(socket_connection, success_trama) < 0) {
             perror("Error enviando confirmación de MD5");
             free(success_trama);
 
@@ -300,17 +365,16 @@ int wait_confirm_file_received(int socket_connection) {
 
 /***********************************************
 *
-* @Finalitat: Controlar tot el flux de distorsió pel client Fleck: rebre, emmagatzemar,
-*             distorsionar i reenviar.
+* @Finalitat: Controlar el flux d’una distorsió del client Fleck: rebre, emmagatzemar, distorsionar
+*             i reenviar. No tanca la connexió (se n’encarrega serve_fleck_connection).
 * @Parametres:
-*   in: arg = punter a ClientThread amb socket i estat.
-* @Retorn: NULL al final o en error.
+*   in:  client            = punter a ClientThread amb l’estat del fil.
+*   in:  socket_connection = socket de Fleck.
+*   out: keep_alive = 1 si Fleck ha enviat identificador de distorsió (manté la connexió oberta).
+* @Retorn: 1 si la distorsió ha acabat correctament, -1 en error.
 *
 ************************************************/
-void* handle_fleck_connection(void* arg) {
-    ClientThread* client = (ClientThread*)arg;
-
-    int socket_connection = client->socket;
+static int handle_distort_job(ClientThread* client, int socket_connection, int* keep_alive) {
     unsigned char response[BUFFER_SIZE];
     int bytes_received = 0;
     TramaResult *result;
@@ -319,19 +383,17 @@ void* handle_fleck_connection(void* arg) {
     
     // Punto Control
     if (!client->active) {
-        close(socket_connection);
-        return NULL;
+        return -1;
     }
 
     *(client->distort_in_progress) = 1;
 
     // ---- 1. Recibir la solicitud inicial de distorsión ----
 
-    bytes_received = recv(socket_connection, response, BUFFER_SIZE, 0);
+    bytes_received = transport_recv_frame(socket_connection, response);
     if (bytes_received <= 0) {
         perror("Error al recibir solicitud inicial");
-        close(socket_connection);
-        return NULL;
+        return -1;
     }
 
     // Procesar la trama inicial
@@ -339,18 +401,26 @@ void* handle_fleck_connection(void* arg) {
     if (!result || (result->type != TYPE_START_DISTORT_FLECK_WORKER && result->type != TYPE_RESUME_DISTORT_FLECK_WORKER)) {
         perror("Trama inicial inválida");
         if (result) free_tramaResult(result);
-        close(socket_connection);
-        return NULL;
+        return -1;
     }
 
-    // Parsear los datos de la trama inicial (username&filename&filesize&md5sum)
-    char *username = strdup(strtok(result->data, "&"));
-    char *filename = strdup(strtok(NULL, "&"));
-    char *filesize_str = strdup(strtok(NULL, "&"));
-    char *md5sum = strdup(strtok(NULL, "&"));
-    char *distort_factor_str = strdup(strtok(NULL, "&"));
+    // Parsear los datos de la trama inicial (username&filename&filesize&md5sum&factor[&job_id&prioridad[&FD]])
+    // (strtok_r: varios hilos del pool parsean tramas a la vez)
+    char *saveptr = NULL;
+    char *username = strdup(strtok_r(result->data, "&", &saveptr));
+    char *filename = strdup(strtok_r(NULL, "&", &saveptr));
+    char *filesize_str = strdup(strtok_r(NULL, "&", &saveptr));
+    char *md5sum = strdup(strtok_r(NULL, "&", &saveptr));
+    char *distort_factor_str = strdup(strtok_r(NULL, "&", &saveptr));
+    char *job_id = strtok_r(NULL, "&", &saveptr);   // Opcional: sólo lo envían los Flecks con conexiones persistentes
+    *keep_alive = (job_id != NULL);
+    // Fleck en el mismo host: los archivos se pasan como descriptor en vez de en tramas (campo tras la prioridad)
+    char *priority_field = (job_id != NULL) ? strtok_r(NULL, "&", &saveptr) : NULL;
+    char *fd_flag = (priority_field != NULL) ? strtok_r(NULL, "&", &saveptr) : NULL;
+    int fd_passing = (fd_flag != NULL && strcmp(fd_flag, FD_PASSING_MSG) == 0 && is_unix_socket(socket_connection));
+    job_id = strdup(job_id ? job_id : "");
     
-    if (!username || !filename || !filesize_str || !md5sum || !distort_factor_str) {
+    if (!username || !filename || !filesize_str || !md5sum || !distort_factor_str || sched_parse_size(filesize_str) < 0) {
         perror("Formato de datos distorsion inicial inválido");
 
         free(username);
@@ -359,19 +429,21 @@ void* handle_fleck_connection(void* arg) {
         free(md5sum);
         free(distort_factor_str);
         free_tramaResult(result);
-        close(socket_connection);
-        return NULL;
+        return -1;
     }
     
     long filesize = atol(filesize_str);
     int distort_factor = atoi(distort_factor_str);
+    int kind = timings_kind(filename);
+    uint64_t job_start = timings_now_ns();
+    uint64_t phase_start = job_start;
 
     free(filesize_str);
     free(distort_factor_str);
 
     // Crear directorio para el usuario si no existe
     char* user_dir;
-    asprintf(&user_dir, "uploads/%s", username);
+    asprintf(&user_dir, WORKER_SPOOL_DIR "/%s", username);
     mkdir(user_dir, 0755);
     
     // Preparar path archivo de destino
@@ -386,15 +458,15 @@ void* handle_fleck_connection(void* arg) {
     int fd_shared;
     crear_abrir_mem_compartida(&shared, &fd_shared, filename, (result->type == TYPE_START_DISTORT_FLECK_WORKER) ? 0 : 1);
 
-    // Enviar ACK de recepción inicial
-    unsigned char *ack_trama = crear_trama(result->type, (unsigned char*)OK_MSG, strlen(OK_MSG));
-    if (write(socket_connection, ack_trama, BUFFER_SIZE) < 0) {
+    // Enviar ACK de recepción inicial (indicando si aceptamos el archivo por descriptor)
+    const char* ack_data = fd_passing ? OK_MSG "&" FD_PASSING_MSG : OK_MSG;
+    unsigned char *ack_trama = crear_trama(result->type, (unsigned char*)ack_data, strlen(ack_data));
+    if (transport_send_frame(socket_connection, ack_trama) < 0) {
         perror("Error enviando confirmación inicial");
 
         free(md5sum);
         free(filepath);
-        close(socket_connection);
-        return NULL;
+        return -1;
     }
     free(ack_trama);
     
@@ -402,15 +474,15 @@ void* handle_fleck_connection(void* arg) {
     if (!client->active) {
         free(md5sum);
         free(filepath);
-        close(socket_connection);
         tancar_mem_compartida(&shared, fd_shared, filename, 0);
-        return NULL;
+        return -1;
     }
 
     char* fileType = file_type(filepath);
 
     if (shared->transfer_flag == 0) {
         printF("Recibiendo archivo de Fleck.\n");
+        phase_start = timings_now_ns();
         
         // ---- Recibir archivo ----
         
@@ -421,8 +493,7 @@ void* handle_fleck_connection(void* arg) {
             perror("Error al abrir/crear archivo");
             free(md5sum);
             free(filepath);
-            close(socket_connection);
-            return NULL;
+            return -1;
         }
 
         free_tramaResult(result);
@@ -431,35 +502,58 @@ void* handle_fleck_connection(void* arg) {
         if (!client->active) {
             free(md5sum);
             free(filepath);
-            close(socket_connection);
             tancar_mem_compartida(&shared, fd_shared, filename, 0);
-            return NULL;
+            return -1;
         }
 
-        // 2. Recibir el archivo en fragmentos y guardarlo
+        // 2. Recibir el archivo en fragmentos y guardarlo (o de una vez si Fleck pasa el descriptor)
         while (shared->total_bytes_received < filesize) {
 
-            bytes_received = recv(socket_connection, response, BUFFER_SIZE, 0);
+            int received_fd = -1;
+            bytes_received = fd_passing ? transport_recv_frame_fd(socket_connection, response, &received_fd)
+                                        : transport_recv_frame(socket_connection, response);
             if (bytes_received != BUFFER_SIZE/*<= 0*/) {
                 perror("Error al recibir fragmento de archivo, Fleck cerró la conexión.");
                 printF("Cancelando distorsión.\n");
+                if (received_fd >= 0) close(received_fd);
                 free(md5sum);
                 close(fd_file);
                 free(filepath);
-                close(socket_connection);
-                return NULL;
+                return -1;
             }
 
             // Procesar la trama de datos
             result = leer_trama(response);
+            if (result && result->type == TYPE_FILE_FD && received_fd >= 0) {
+                // Copiar desde el archivo de Fleck lo que falte (sin pasar los datos por el socket)
+                long copied = copy_file_fd(received_fd, shared->total_bytes_received, fd_file,
+                                           filesize - shared->total_bytes_received);
+                close(received_fd);
+                free_tramaResult(result);
+                const char* fd_ack = (copied < 0) ? CHECK_KO : OK_MSG;
+                ack_trama = crear_trama(TYPE_FILE_FD, (unsigned char*)fd_ack, strlen(fd_ack));
+                if (transport_send_frame(socket_connection, ack_trama) < 0 || copied < 0) {
+                    perror("Error al copiar el archivo recibido por descriptor");
+                    free(ack_trama);
+                    free(md5sum);
+                    close(fd_file);
+                    free(filepath);
+                    return -1;
+                }
+                free(ack_trama);
+                shared->total_bytes_received += copied;
+                continue;
+            }
+            if (received_fd >= 0) {
+                close(received_fd);
+            }
             if (!result || result->type != TYPE_FILE_DATA) {
                 perror("Trama de datos inválida");
                 if (result) free_tramaResult(result);
                 free(md5sum);
                 close(fd_file);
                 free(filepath);
-                close(socket_connection);
-                return NULL;
+                return -1;
             }
             // printF(result->data);
 
@@ -473,22 +567,20 @@ void* handle_fleck_connection(void* arg) {
                 free(md5sum);
                 close(fd_file);
                 free(filepath);
-                close(socket_connection);
-                return NULL;
+                return -1;
             }
             free_tramaResult(result);
 
             // Enviar confirmación de recepción (ACK)
             ack_trama = crear_trama(TYPE_FILE_DATA, (unsigned char*)OK_MSG, strlen(OK_MSG));
-            if (write(socket_connection, ack_trama, BUFFER_SIZE) < 0) {
+            if (transport_send_frame(socket_connection, ack_trama) < 0) {
                 perror("Error enviando confirmación de recepción");
                 free(ack_trama);
 
                 free(md5sum);
                 close(fd_file);
                 free(filepath);
-                close(socket_connection);
-                return NULL;
+                return -1;
             }
             
             shared->total_bytes_received += bytes_written;
@@ -499,14 +591,16 @@ void* handle_fleck_connection(void* arg) {
                 free(md5sum);
                 close(fd_file);
                 free(filepath);
-                close(socket_connection);
                 tancar_mem_compartida(&shared, fd_shared, filename, 0);
-                return NULL;
+                return -1;
             }
         }
 
+        timings_record_since(&worker_timings, WORKER_PHASE_RECEIVE, kind, phase_start);
+
         // ---- Comprobar MD5 del archivo recibido ----
 
+        phase_start = timings_now_ns();
         char *calculated_md5 = calculate_md5sum(filepath);
         if (calculated_md5 == NULL) {
             perror("Error calculando MD5 del archivo recibido");
@@ -515,7 +609,7 @@ void* handle_fleck_connection(void* arg) {
         // Enviar trama al cliente en base al resultado del MD5
         if (!calculated_md5 || strcmp(calculated_md5, md5sum) != 0) {
             unsigned char *error_trama = crear_trama(TYPE_END_DISTORT_FLECK_WORKER, (unsigned char*)CHECK_KO, strlen(CHECK_KO));
-            if (write(socket_connection, error_trama, BUFFER_SIZE) < 0) {
+            if (transport_send_frame(socket_connection, error_trama) < 0) {
                 perror("Error enviando mensaje de MD5 no coincidente");
             } else {
                 printF("Enviado: MD5 del archivo recibido no coincide con el esperado\n");
@@ -526,8 +620,7 @@ void* handle_fleck_connection(void* arg) {
             free(md5sum);
             close(fd_file);
             free(filepath);
-            close(socket_connection);
-            return NULL;
+            return -1;
         }
 
         if (send_confirm_file_received(socket_connection) != 0) {
@@ -536,8 +629,7 @@ void* handle_fleck_connection(void* arg) {
             free(md5sum);
             close(fd_file);
             free(filepath);
-            close(socket_connection);
-            return NULL;
+            return -1;
         }
         
         free(md5sum);
@@ -545,15 +637,15 @@ void* handle_fleck_connection(void* arg) {
 
         close(fd_file);
         shared->transfer_flag = 1;
+        timings_record_since(&worker_timings, WORKER_PHASE_MD5_VERIFY, kind, phase_start);
 
         printF("Archivo de Fleck recibido correctamente.\n");
 
         // Punto Control
         if (!client->active) {
             free(filepath);
-            close(socket_connection);
             tancar_mem_compartida(&shared, fd_shared, filename, 0);
-            return NULL;
+            return -1;
         }
 
     } else {
@@ -565,6 +657,8 @@ void* handle_fleck_connection(void* arg) {
     if (shared->transfer_flag == 1) {
 
         // 3. Distorsionar archivo
+        phase_start = timings_now_ns();
+        WORKER_report_job(job_id, JOB_STATUS_DISTORTING);
 
         if (strcmp(fileType, MEDIA) == 0) {
             // MEDIA: AUDIO o IMAGE
@@ -574,50 +668,46 @@ void* handle_fleck_connection(void* arg) {
                 if (SO_compressAudio(filepath, distort_factor) != 0) {
                     printF("Error distorsionando archivo de audio.\n");
                     free(filepath);
-                    close(socket_connection);
-                    return NULL;
+                    return -1;
                 }
             } else if (strcmp(wich_media(filepath), IMAGE) == 0) {
                 printF("Distorsionando archivo de tipo IMAGE.\n");
                 if (SO_compressImage(filepath, distort_factor) != 0) {
                     printF("Error distorsionando archivo de imagen.\n");
                     free(filepath);
-                    close(socket_connection);
-                    return NULL;
+                    return -1;
                 }
             } else {
                 printF("Tipo de archivo multimedia no soportado.\n");
                 free(filepath);
-                close(socket_connection);
-                return NULL;
+                return -1;
             }
         } else {
             // TEXT
             // Crear nombre del archivo de salida
             if (asprintf(&distorted_file_path, "%s_distorted", filepath) < 0) {
                 printF("Filename generation failed\n");
-                return NULL;
+                return -1;
             }
 
             printF("Distorsionando archivo de tipo TEXT.\n");
             if (distort_file_text(filepath, distorted_file_path, distort_factor) != 0) {
                 free(filepath);
-                close(socket_connection);
-                return NULL;
+                return -1;
             }
             free(filepath);
         } 
 
         shared->transfer_flag = 2;  // Cambiar flag a enviando
         shared->total_bytes_received = 0;  // Reiniciar contador de bytes recibidos
+        timings_record_since(&worker_timings, WORKER_PHASE_DISTORT, kind, phase_start);
 
 
         // Punto Control
         if (!client->active) {
             free(distorted_file_path);
-            close(socket_connection);
             tancar_mem_compartida(&shared, fd_shared, filename, 0);
-            return NULL;
+            return -1;
         }
 
 
@@ -629,7 +719,7 @@ void* handle_fleck_connection(void* arg) {
             // Crear nombre del archivo de salida
             if (asprintf(&distorted_file_path, "%s_distorted", filepath) < 0) {
                 printF("Filename generation failed\n");
-                return NULL;
+                return -1;
             }
             free(filepath);
         }
@@ -638,6 +728,8 @@ void* handle_fleck_connection(void* arg) {
 
     // ---- 4. Enviar archivo distorsionado de vuelta a Fleck ----
 
+    WORKER_report_job(job_id, JOB_STATUS_DOWNLOADING);
+    phase_start = timings_now_ns();
     filesize_str = get_string_file_size(distorted_file_path);
     
     md5sum = calculate_md5sum(distorted_file_path);
@@ -645,19 +737,20 @@ void* handle_fleck_connection(void* arg) {
         perror("Error: Error en Fleck calculando el MD5SUM del archivo.\n");
         free(distorted_file_path);
         free(filesize_str);
-        close(socket_connection);
-        return NULL;
+        return -1;
     }
     
+    timings_record_since(&worker_timings, WORKER_PHASE_MD5, kind, phase_start);
+
     // Enviar trama inicial
 
-    if (start_send_back_distort(socket_connection, filesize_str, md5sum) < 1) {
+    phase_start = timings_now_ns();
+    if (start_send_back_distort(socket_connection, filesize_str, md5sum, job_id, shared->total_bytes_received) < 1) {
         perror("Error al enviar la solicitud de distorsión al Worker");
         free(distorted_file_path);
         free(filesize_str);
         free(md5sum);
-        close(socket_connection);
-        return NULL;
+        return -1;
     }
 
     // Comenzar a enviar el archivo distorsionado en fragmentos
@@ -668,8 +761,29 @@ void* handle_fleck_connection(void* arg) {
         free(distorted_file_path);
         free(filesize_str);
         free(md5sum);
-        close(socket_connection);
-        return NULL;
+        return -1;
+    }
+
+    // Fleck en el mismo host: pasarle el descriptor del archivo distorsionado en vez de enviarlo en tramas
+    if (fd_passing) {
+        unsigned char* trama = crear_trama(TYPE_FILE_FD, (unsigned char*)filesize_str, strlen(filesize_str));
+        int sent = transport_send_frame_fd(socket_connection, trama, fd_file);
+        free(trama);
+        result = NULL;
+        if (sent == BUFFER_SIZE && transport_recv_frame(socket_connection, response) > 0) {
+            result = leer_trama(response);
+        }
+        if (!result || result->type != TYPE_FILE_FD || strcmp(result->data, OK_MSG) != 0) {
+            perror("Error pasando el archivo distorsionado por descriptor");
+            if (result) free_tramaResult(result);
+            close(fd_file);
+            free(distorted_file_path);
+            free(filesize_str);
+            free(md5sum);
+            return -1;
+        }
+        free_tramaResult(result);
+        shared->total_bytes_received = atol(filesize_str);
     }
 
     // Posicionar el puntero de lectura en el byte donde se quedó
@@ -679,8 +793,7 @@ void* handle_fleck_connection(void* arg) {
         free(distorted_file_path);
         free(filesize_str);
         free(md5sum);
-        close(socket_connection);
-        return NULL;
+        return -1;
     }
 
     // Enviar archivo en fragmentos
@@ -697,33 +810,30 @@ void* handle_fleck_connection(void* arg) {
             free(distorted_file_path);
             free(filesize_str);
             free(md5sum);
-            close(socket_connection);
-            return NULL;
+            return -1;
         }
 
-        if (write(socket_connection, trama, BUFFER_SIZE) < 0) {
+        if (transport_send_frame(socket_connection, trama) < 0) {
             perror("Error enviando fragmento de archivo");
             free(trama);
             close(fd_file);
             free(distorted_file_path);
             free(filesize_str);
             free(md5sum);
-            close(socket_connection);
-            return NULL;
+            return -1;
         }
         free(trama);
         shared->total_bytes_received += bytes_read;
 
         // Esperar confirmación de recepción
-        bytes_received = recv(socket_connection, response, BUFFER_SIZE, 0);
+        bytes_received = transport_recv_frame(socket_connection, response);
         if (bytes_received <= 0) {
             perror("Error recibiendo confirmación de recepción");
             close(fd_file);
             free(distorted_file_path);
             free(filesize_str);
             free(md5sum);
-            close(socket_connection);
-            return NULL;
+            return -1;
         }
 
         result = leer_trama(response);
@@ -734,8 +844,7 @@ void* handle_fleck_connection(void* arg) {
             free(distorted_file_path);
             free(filesize_str);
             free(md5sum);
-            close(socket_connection);
-            return NULL;
+            return -1;
         }
         free_tramaResult(result);
 
@@ -747,9 +856,8 @@ void* handle_fleck_connection(void* arg) {
         if (!client->active) {
             free(md5sum);
             free(filepath);
-            close(socket_connection);
             tancar_mem_compartida(&shared, fd_shared, filename, 0);
-            return NULL;
+            return -1;
         }
         
         
@@ -759,19 +867,24 @@ void* handle_fleck_connection(void* arg) {
     free(distorted_file_path);
     free(filesize_str);
     free(md5sum);
+    timings_record_since(&worker_timings, WORKER_PHASE_SEND, kind, phase_start);
 
     // Recibir trama final de confirmación
+    phase_start = timings_now_ns();
     if (wait_confirm_file_received(socket_connection) < 1) {
         perror("Error al esperar confirmación de archivo recibido por Worker");
-        close(socket_connection);
-        return NULL;
+        return -1;
     }
+    timings_record_since(&worker_timings, WORKER_PHASE_CONFIRM, kind, phase_start);
+    timings_record_since(&worker_timings, WORKER_PHASE_TOTAL, kind, job_start);
+    record_service_time((timings_now_ns() - job_start) / 1e6);
+    sched_model_record(&worker_sched, kind, filesize, (timings_now_ns() - job_start) / 1e6);
 
     printF("Distosión FINALIZADA correctamente.\n");
-    close(socket_connection);
 
     tancar_mem_compartida(&shared, fd_shared, filename, 1);
     free(filename);
+    free(job_id);
 
     if (*(client->gotham_connection_alive) == 0) {
         printF("Gotham connection is not alive, sending SIGINT to main thread.\n");
@@ -780,7 +893,72 @@ void* handle_fleck_connection(void* arg) {
 
     *(client->distort_in_progress) = 0;
 
+    return 1;
+}
 
-    return NULL;
+/***********************************************
+*
+* @Finalitat: Esperar la següent distorsió en una connexió persistent amb Fleck. Si hi ha
+*             connexions esperant un fil del pool, la connexió inactiva cedeix el seu fil.
+* @Parametres:
+*   in: client            = estat de la connexió.
+*   in: socket_connection = socket de Fleck.
+* @Retorn: 1 si Fleck ha enviat una nova trama, 0 si s’ha de tancar la connexió.
+*
+************************************************/
+static int wait_next_job(ClientThread* client, int socket_connection) {
+    int waited_ms = 0;
+    int ready = 0;
+    while (ready == 0 && waited_ms < WORKER_IDLE_TIMEOUT_S * 1000) {
+        // Fleck detecta el cierre al reutilizar la conexión y abre una nueva
+        if (*(client->queued_connections) > 0) {
+            return 0;
+        }
+        ready = transport_poll(socket_connection, WORKER_IDLE_POLL_MS);
+        waited_ms += WORKER_IDLE_POLL_MS;
+    }
+    if (ready <= 0) {
+        return 0;
+    }
 
-}
\ No newline at end of file
+    // Una conexión cerrada por Fleck se lee como EOF (una trama a medias sí es una nueva distorsión)
+    unsigned char next[BUFFER_SIZE];
+    int peeked = transport_peek_frame(socket_connection, next);
+    return peeked == BUFFER_SIZE || (peeked < 0 && errno == EAGAIN);
+}
+
+/***********************************************
+*
+* @Finalitat: Atendre una connexió de Fleck: executar les distorsions que arribin per la connexió
+*             (una rere l’altra mentre Fleck la mantingui). El pool tanca el socket en acabar.
+* @Parametres:
+*   in: client = posició del pool amb el socket i l’estat de la connexió.
+* @Retorn: ---
+*
+************************************************/
+void serve_fleck_connection(ClientThread* client) {
+    // Para cerrar la conexión, el Worker hace shutdown() del socket, que desbloquea cualquier recv/poll de este hilo
+    int socket_connection = client->socket;
+    int keep_alive = 0;
+
+    int job_ok;
+    do {
+        atomic_fetch_add(&running_jobs, 1);
+        job_ok = handle_distort_job(client, socket_connection, &keep_alive);
+        atomic_fetch_sub(&running_jobs, 1);
+
+        // Hueco libre: con routing=pull, reclamar la siguiente distorsión a Gotham
+        WORKER_request_jobs();
+    } while (job_ok == 1 && keep_alive && client->active && wait_next_job(client, socket_connection));
+}
+
+/***********************************************
+*
+* @Finalitat: Obtenir el nombre de distorsions en curs al Worker.
+* @Parametres: ---
+* @Retorn: Distorsions en curs.
+*
+************************************************/
+int WORKER_running_jobs(void) {
+    return atomic_load(&running_jobs);
+}
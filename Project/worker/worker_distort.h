@@ -4,13 +4,37 @@
 #include <stdio.h>
 #include <sys/mman.h>
 #include <sys/stat.h>    // para mkdir
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 #include "../../config/config.h"
 #include "../../config/connections.h"
+#include "../../config/transport.h"
 #include "../../config/files.h"
+#include "../../config/timings.h"
+#include "../../config/sched.h"
 
 #define O_BINARY 0      // Para archivos binarios (en sistema linux no se detecta)
 
+#define WORKER_IDLE_TIMEOUT_S 30    // Tiempo máximo de una conexión persistente de Fleck sin distorsiones
+#define WORKER_IDLE_POLL_MS 200     // Cada cuánto una conexión inactiva comprueba si hay conexiones en cola
+#define WORKER_SERVICE_EWMA_ALPHA 0.2   // Peso de la última distorsión en la media del tiempo de servicio
+#define WORKER_SPOOL_DIR "uploads"      // Directorio donde se guardan los archivos recibidos
+
+// Fases medidas de cada distorsión (histogramas de worker_timings)
+#define WORKER_PHASE_RECEIVE 0      // Recepción del archivo de Fleck
+#define WORKER_PHASE_MD5_VERIFY 1   // Comprobación del MD5SUM del archivo recibido
+#define WORKER_PHASE_DISTORT 2      // Distorsión del archivo
+#define WORKER_PHASE_MD5 3          // Tamaño y MD5SUM del archivo distorsionado
+#define WORKER_PHASE_SEND 4         // Envío del archivo distorsionado a Fleck
+#define WORKER_PHASE_CONFIRM 5      // Confirmación final de Fleck
+#define WORKER_PHASE_TOTAL 6        // Distorsión completa
+#define WORKER_NUM_PHASES 7
+
+extern TimingTable worker_timings;
+extern SchedModel worker_sched;
+
 
 // Estructura para manejar las conexiones de los Flecks
 typedef struct {
@@ -19,10 +43,13 @@ typedef struct {
     int active;
     volatile int* gotham_connection_alive;
     volatile int* distort_in_progress;
+    volatile int* queued_connections;   // Conexiones esperando un hilo libre del pool
 } ClientThread;
 
 
 // Función para manejar la conexión del cliente 
-void* handle_fleck_connection(void* client_socket);
+void serve_fleck_connection(ClientThread* client);
+double WORKER_service_time_ms(void);
+int WORKER_running_jobs(void);
 
 #endif
\ No newline at end of file
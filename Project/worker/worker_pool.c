@@ -0,0 +1,432 @@
+#include "worker_pool.h"
+
+
+/***********************************************
+*
+* @Finalitat: Rebutjar una connexió de Fleck quan el Worker és saturat: llegir la trama inicial
+*             (amb temps màxim) i respondre BUSY perquè Fleck demani un altre Worker a Gotham.
+* @Parametres:
+*   in: socket_connection = connexió a rebutjar (es tanca).
+* @Retorn: ---
+*
+************************************************/
+static void reject_busy(int socket_connection) {
+    // Leer la trama inicial antes de responder: cerrar con datos sin leer provoca un RST que
+    // puede descartar la respuesta antes de que Fleck la lea
+    // (sólo si ya ha llegado entera: una trama a medias no puede bloquear el hilo de accept)
+    unsigned char request[BUFFER_SIZE];
+    if (transport_poll(socket_connection, WORKER_BUSY_WAIT_MS) > 0 && transport_peek_frame(socket_connection, request) == BUFFER_SIZE
+        && transport_recv_frame(socket_connection, request) == BUFFER_SIZE) {
+        // Responder con el mismo tipo de trama (inicio o continuación de distorsión)
+        unsigned char* trama = crear_trama(request[0], (unsigned char*)BUSY_MSG, strlen(BUSY_MSG));
+        if (transport_send_frame(socket_connection, trama) < 0) {
+            perror("Error enviando BUSY a Fleck");
+        }
+        free(trama);
+    }
+    transport_close(socket_connection);
+}
+
+/***********************************************
+*
+* @Finalitat: Obtenir el registre d’un usuari amb connexions al pool, creant-lo si no en té cap.
+*             Cal cridar-la amb el mutex del pool bloquejat.
+* @Parametres:
+*   in/out: pool = pool del Worker.
+*   in: username = nom de l’usuari.
+* @Retorn: Índex a 'users'.
+*
+************************************************/
+static int find_user(WorkerPool* pool, const char* username) {
+    int free_index = -1;
+    for (int i = 0; i < WORKER_POOL_SLOTS; i++) {
+        PoolUser* user = &pool->users[i];
+        if (user->queued + user->in_flight == 0) {
+            if (free_index < 0) {
+                free_index = i;
+            }
+        } else if (strcmp(user->username, username) == 0) {
+            return i;
+        }
+    }
+
+    // Hay un registro por conexión, así que siempre queda uno libre
+    PoolUser* user = &pool->users[free_index];
+    snprintf(user->username, sizeof(user->username), "%s", username);
+    user->weight = 1;
+    for (int i = 0; i < pool->fairness.num_weights; i++) {
+        if (strcmp(pool->fairness.weights[i].username, username) == 0) {
+            user->weight = pool->fairness.weights[i].weight;
+        }
+    }
+    user->deficit = 0;
+    return free_index;
+}
+
+/***********************************************
+*
+* @Finalitat: Classificar una connexió en cua amb la seva trama inicial, si Fleck ja l’ha enviada
+*             (es llegeix amb MSG_PEEK: el fil que l’atengui la torna a llegir sencera).
+* @Parametres:
+*   in: pool  = pool del Worker.
+*   in/out: entry = connexió en cua.
+* @Retorn: ---
+*
+************************************************/
+static void classify_entry(WorkerPool* pool, PoolEntry* entry) {
+    unsigned char request[BUFFER_SIZE];
+    int bytes = transport_peek_frame(pool->slots[entry->slot].socket, request);
+    if (bytes < 0) {
+        return;     // La trama todavía no ha llegado entera
+    }
+
+    // Conexión cerrada o trama inválida: el hilo que la atienda la descartará enseguida
+    entry->classified = 1;
+    entry->expected_ms = 0;
+    entry->priority = 0;
+    TramaResult* result = (bytes == BUFFER_SIZE) ? leer_trama(request) : NULL;
+    if (result == NULL) {
+        entry->user = find_user(pool, "");
+        pool->users[entry->user].queued++;
+        return;
+    }
+    const char* username = "";
+    if (result->type == TYPE_START_DISTORT_FLECK_WORKER || result->type == TYPE_RESUME_DISTORT_FLECK_WORKER) {
+        // username&filename&filesize&md5sum&factor[&job_id&prioridad]
+        char* fields[7] = { NULL };
+        char* saveptr = NULL;
+        char* token = strtok_r(result->data, "&", &saveptr);
+        for (int i = 0; i < 7 && token != NULL; i++) {
+            fields[i] = token;
+            token = strtok_r(NULL, "&", &saveptr);
+        }
+        if (fields[0] != NULL) {
+            username = fields[0];
+        }
+        // Un tamaño inválido deja la conexión como trama inválida (el hilo que la atienda la descarta)
+        long size = sched_parse_size(fields[2]);
+        if (fields[1] != NULL && size >= 0) {
+            entry->expected_ms = sched_expected_ms(&worker_sched, timings_kind(fields[1]), size);
+        }
+        if (fields[6] != NULL) {
+            entry->priority = atoi(fields[6]);
+            if (entry->priority < 0 || entry->priority > SCHED_MAX_PRIORITY) {
+                entry->priority = 0;
+            }
+        }
+    }
+    entry->user = find_user(pool, username);
+    pool->users[entry->user].queued++;
+    free_tramaResult(result);
+}
+
+/***********************************************
+*
+* @Finalitat: Repartir els torns entre usuaris (deficit round robin): el primer usuari, a partir del
+*             torn actual, amb crèdit suficient per a la seva millor connexió en cua.
+* @Parametres:
+*   in/out: pool = pool del Worker.
+*   in: candidate = millor connexió elegible de cada usuari (posició a 'queue', o -1).
+* @Retorn: Posició a 'queue' de la connexió triada, o -1 si cap usuari en té d’elegible.
+*
+************************************************/
+static int drr_next(WorkerPool* pool, const int* candidate) {
+    int any = 0;
+    for (int u = 0; u < WORKER_POOL_SLOTS; u++) {
+        any |= (candidate[u] >= 0);
+    }
+    if (!any) {
+        return -1;
+    }
+
+    // Cada vuelta suma crédito a todos los usuarios con candidata, así que acaba
+    while (1) {
+        int u = pool->drr_cursor;
+        if (candidate[u] >= 0) {
+            PoolUser* user = &pool->users[u];
+            if (!pool->drr_credited) {
+                user->deficit += (double)WORKER_DRR_QUANTUM_MS * user->weight;
+                pool->drr_credited = 1;
+            }
+            double cost = pool->queue[candidate[u]].expected_ms;
+            if (cost < 1) {
+                cost = 1;
+            }
+            if (user->deficit >= cost) {
+                user->deficit -= cost;
+                return candidate[u];
+            }
+        }
+        pool->drr_cursor = (u + 1) % WORKER_POOL_SLOTS;
+        pool->drr_credited = 0;
+    }
+}
+
+/***********************************************
+*
+* @Finalitat: Triar la connexió en cua que ha d’atendre un fil: els usuaris es reparteixen els torns
+*             (deficit round robin) i de cada usuari s’agafa la de menor cost esperat amb envelliment
+*             (SEJF). Els fils del carril ràpid només agafen distorsions petites o amb prioritat, i els
+*             usuaris al límit de connexions en curs esperen. Cal cridar-la amb el mutex bloquejat.
+* @Parametres:
+*   in: pool       = pool del Worker.
+*   in: small_lane = 1 si el fil és del carril ràpid.
+* @Retorn: Posició a 'queue' de la connexió triada, o -1 si no n’hi ha cap d’elegible.
+*
+************************************************/
+static int pick_entry(WorkerPool* pool, int small_lane) {
+    uint64_t now = timings_now_ns();
+    int candidate[WORKER_POOL_SLOTS];
+    double candidate_score[WORKER_POOL_SLOTS];
+    int unclassified = -1;
+    for (int u = 0; u < WORKER_POOL_SLOTS; u++) {
+        candidate[u] = -1;
+    }
+
+    for (int i = 0; i < pool->queued; i++) {
+        PoolEntry* entry = &pool->queue[i];
+        if (!entry->classified) {
+            classify_entry(pool, entry);
+        }
+        if (!entry->classified) {
+            // Sin trama inicial todavía: sólo la atiende un hilo general si no hay nada más
+            if (!small_lane && (unclassified < 0 || entry->enqueued_ns < pool->queue[unclassified].enqueued_ns)) {
+                unclassified = i;
+            }
+            continue;
+        }
+        int small = (entry->expected_ms <= SCHED_SMALL_JOB_MS || entry->priority > 0);
+        if (small_lane && !small) {
+            continue;
+        }
+        int u = entry->user;
+        if (pool->fairness.max_user_inflight > 0 && pool->users[u].in_flight >= pool->fairness.max_user_inflight) {
+            continue;
+        }
+        double score = sched_score(entry->expected_ms, entry->priority, entry->enqueued_ns, now);
+        if (candidate[u] < 0 || score < candidate_score[u]
+            || (score == candidate_score[u] && entry->enqueued_ns < pool->queue[candidate[u]].enqueued_ns)) {
+            candidate[u] = i;
+            candidate_score[u] = score;
+        }
+    }
+
+    int best = drr_next(pool, candidate);
+    return (best >= 0) ? best : unclassified;
+}
+
+/***********************************************
+*
+* @Finalitat: Bucle d’un fil del pool: treure connexions de la cua i atendre-les fins que el
+*             pool s’aturi.
+* @Parametres:
+*   in: arg = punter al WorkerPool.
+* @Retorn: NULL en aturar-se el pool.
+*
+************************************************/
+static void* pool_thread(void* arg) {
+    WorkerPool* pool = (WorkerPool*)arg;
+
+    pthread_mutex_lock(&pool->mutex);
+    int small_lane = (pool->next_thread++ < WORKER_SMALL_LANE_THREADS);
+    pthread_mutex_unlock(&pool->mutex);
+
+    while (1) {
+        pthread_mutex_lock(&pool->mutex);
+        int position = -1;
+        while (!pool->stopping && (position = pick_entry(pool, small_lane)) < 0) {
+            if (pool->queued == 0) {
+                pthread_cond_wait(&pool->not_empty, &pool->mutex);
+            } else {
+                // Hay conexiones en cola pero ninguna elegible: volver a clasificar al cabo de un rato
+                struct timespec deadline;
+                clock_gettime(CLOCK_REALTIME, &deadline);
+                deadline.tv_nsec += WORKER_IDLE_POLL_MS * 1000000L;
+                deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+                deadline.tv_nsec %= 1000000000L;
+                pthread_cond_timedwait(&pool->not_empty, &pool->mutex, &deadline);
+            }
+        }
+        if (pool->stopping) {
+            pthread_mutex_unlock(&pool->mutex);
+            return NULL;
+        }
+        PoolEntry* entry = &pool->queue[position];
+        int index = entry->slot;
+        pool->slot_user[index] = entry->classified ? entry->user : -1;
+        if (entry->classified) {
+            PoolUser* user = &pool->users[entry->user];
+            user->queued--;
+            user->in_flight++;
+            if (user->queued == 0) {
+                user->deficit = 0;      // Sin conexiones en cola no acumula crédito
+            }
+        }
+        pool->queue[position] = pool->queue[pool->queued - 1];
+        pool->queued--;
+        pool->active++;
+        ClientThread* client = &pool->slots[index];
+        client->thread_id = pthread_self();
+        pthread_mutex_unlock(&pool->mutex);
+
+        serve_fleck_connection(client);
+
+        // Liberar la posición antes de cerrar: WORKER_pool_destroy sólo hace shutdown() de sockets abiertos
+        pthread_mutex_lock(&pool->mutex);
+        int socket_connection = client->socket;
+        client->active = 0;
+        pool->slot_used[index] = 0;
+        pool->active--;
+        if (pool->slot_user[index] >= 0) {
+            pool->users[pool->slot_user[index]].in_flight--;
+            if (pool->queued > 0) {
+                // Puede haber conexiones de este usuario esperando por el límite de conexiones en curso
+                pthread_cond_broadcast(&pool->not_empty);
+            }
+        }
+        pthread_mutex_unlock(&pool->mutex);
+        transport_close(socket_connection);
+    }
+}
+
+/***********************************************
+*
+* @Finalitat: Crear el pool de fils que atén les connexions de Fleck.
+* @Parametres:
+*   in: gotham_connection_alive = estat de la connexió amb Gotham (compartit amb els fils).
+*   in: distort_in_progress     = marca de distorsió en curs (compartida amb els fils).
+*   in: fairness                = pesos i límits per usuari.
+* @Retorn: Punter al WorkerPool, o NULL en error.
+*
+************************************************/
+WorkerPool* WORKER_pool_create(volatile int* gotham_connection_alive, volatile int* distort_in_progress,
+                               const PoolFairness* fairness) {
+    WorkerPool* pool = calloc(1, sizeof(WorkerPool));
+    if (pool == NULL) {
+        return NULL;
+    }
+    pool->fairness = *fairness;
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->not_empty, NULL);
+
+    for (int i = 0; i < WORKER_POOL_SLOTS; i++) {
+        pool->slots[i].socket = -1;
+        pool->slots[i].gotham_connection_alive = gotham_connection_alive;
+        pool->slots[i].distort_in_progress = distort_in_progress;
+        pool->slots[i].queued_connections = &pool->queued;
+    }
+
+    for (int i = 0; i < WORKER_POOL_THREADS; i++) {
+        if (pthread_create(&pool->threads[i], NULL, pool_thread, pool) != 0) {
+            perror("Error al crear el hilo del pool");
+            break;
+        }
+        pool->num_threads++;
+    }
+    if (pool->num_threads == 0) {
+        WORKER_pool_destroy(pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+/***********************************************
+*
+* @Finalitat: Encuar una connexió acceptada de Fleck per a un fil lliure (la classificarà el primer
+*             fil que consulti la cua); si la cua és plena, respondre BUSY i tancar-la.
+* @Parametres:
+*   in: pool              = pool del Worker.
+*   in: socket_connection = connexió acceptada.
+* @Retorn: 0 si s’ha encuat, -1 si s’ha rebutjat.
+*
+************************************************/
+int WORKER_pool_submit(WorkerPool* pool, int socket_connection) {
+    pthread_mutex_lock(&pool->mutex);
+    if (pool->stopping || pool->queued == WORKER_POOL_QUEUE) {
+        pthread_mutex_unlock(&pool->mutex);
+        reject_busy(socket_connection);
+        return -1;
+    }
+
+    // Con la cola no llena siempre queda una posición libre (hay una por hilo y una por hueco de la cola)
+    int index = 0;
+    while (pool->slot_used[index]) {
+        index++;
+    }
+    pool->slot_used[index] = 1;
+    pool->slots[index].socket = socket_connection;
+    pool->slots[index].active = 1;
+
+    PoolEntry* entry = &pool->queue[pool->queued];
+    memset(entry, 0, sizeof(PoolEntry));
+    entry->slot = index;
+    entry->enqueued_ns = timings_now_ns();
+    pool->queued++;
+    // Todos los hilos libres: sólo algunos pueden ser elegibles para esta conexión
+    pthread_cond_broadcast(&pool->not_empty);
+    pthread_mutex_unlock(&pool->mutex);
+    return 0;
+}
+
+/***********************************************
+*
+* @Finalitat: Aturar el pool: desbloquejar les connexions en curs, esperar els fils, tancar
+*             les connexions en cua i alliberar-lo.
+* @Parametres:
+*   in/out: pool = pool a destruir (pot ser NULL).
+* @Retorn: ---
+*
+************************************************/
+void WORKER_pool_destroy(WorkerPool* pool) {
+    if (pool == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->stopping = 1;
+    for (int i = 0; i < WORKER_POOL_SLOTS; i++) {
+        if (pool->slot_used[i]) {
+            pool->slots[i].active = 0;      // Indica al hilo que debe terminar
+            // Desbloquear recv/poll del hilo que atiende la conexión
+            shutdown(pool->slots[i].socket, SHUT_RDWR);
+        }
+    }
+    pthread_cond_broadcast(&pool->not_empty);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (int i = 0; i < pool->num_threads; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    // Conexiones que nunca llegaron a un hilo
+    for (int i = 0; i < pool->queued; i++) {
+        transport_close(pool->slots[pool->queue[i].slot].socket);
+    }
+
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_cond_destroy(&pool->not_empty);
+    free(pool);
+}
+
+/***********************************************
+*
+* @Finalitat: Consultar la càrrega actual del pool (per informar-ne Gotham als HEARTBEATs).
+* @Parametres:
+*   in:  pool   = pool del Worker (pot ser NULL si encara no s’ha creat).
+*   out: active = connexions ateses per un fil.
+*   out: queued = connexions a la cua.
+* @Retorn: ---
+*
+************************************************/
+void WORKER_pool_load(WorkerPool* pool, int* active, int* queued) {
+    *active = 0;
+    *queued = 0;
+    if (pool == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&pool->mutex);
+    *active = pool->active;
+    *queued = pool->queued;
+    pthread_mutex_unlock(&pool->mutex);
+}
@@ -0,0 +1,79 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+
+#include "worker_distort.h"
+
+// Pool de hilos del Worker: conexiones de Fleck atendidas por hilos creados al arrancar
+#define WORKER_POOL_THREADS 8       // Hilos que atienden conexiones de Fleck
+#define WORKER_POOL_QUEUE 16        // Conexiones aceptadas a la espera de un hilo libre
+#define WORKER_POOL_SLOTS (WORKER_POOL_THREADS + WORKER_POOL_QUEUE)
+#define WORKER_BUSY_WAIT_MS 200     // Espera máxima de la trama inicial de una conexión rechazada
+#define WORKER_SMALL_LANE_THREADS 2 // Hilos reservados a distorsiones pequeñas o con prioridad (carril rápido)
+
+// Reparto entre usuarios (deficit round robin): cada turno suma al crédito del usuario su peso por este
+// cuanto, y se le atiende mientras el crédito cubra la duración esperada de su siguiente distorsión
+#define WORKER_DRR_QUANTUM_MS 1000
+#define WORKER_MAX_USER_WEIGHTS 16  // Usuarios con peso propio en la configuración (el resto pesa 1)
+
+typedef struct {
+    char username[32];
+    int weight;
+} UserWeight;
+
+// Opciones de reparto entre usuarios (de la configuración del Worker)
+typedef struct {
+    UserWeight weights[WORKER_MAX_USER_WEIGHTS];
+    int num_weights;
+    int max_user_inflight;                  // Conexiones en curso máximas por usuario (0 = sin límite)
+} PoolFairness;
+
+// Usuario con conexiones en cola o en curso (libre si no tiene ninguna)
+typedef struct {
+    char username[32];
+    int weight;
+    double deficit;                         // Crédito en ms de distorsión esperada
+    int queued;
+    int in_flight;
+} PoolUser;
+
+// Conexión en cola: se clasifica (sin consumirla) con la trama inicial que ya haya enviado Fleck
+typedef struct {
+    int slot;                               // Índice en 'slots'
+    int classified;                         // 1 cuando ya se ha leído la trama inicial
+    int user;                               // Índice en 'users' (sólo si está clasificada)
+    double expected_ms;                     // Duración esperada según el tipo y tamaño del archivo
+    int priority;
+    uint64_t enqueued_ns;
+} PoolEntry;
+
+typedef struct {
+    ClientThread slots[WORKER_POOL_SLOTS];  // Conexiones en cola o en curso (posiciones fijas)
+    int slot_used[WORKER_POOL_SLOTS];
+    int slot_user[WORKER_POOL_SLOTS];       // Usuario de cada conexión en curso (-1 si no se llegó a clasificar)
+    PoolEntry queue[WORKER_POOL_QUEUE];     // Conexiones en cola (sin orden: cada hilo elige según usuario y puntuación)
+    PoolUser users[WORKER_POOL_SLOTS];      // Como mucho un usuario por conexión
+    int drr_cursor;                         // Usuario al que le toca turno
+    int drr_credited;                       // 1 si el usuario del turno ya ha recibido su cuanto
+    PoolFairness fairness;
+    volatile int queued;                    // Conexiones en cola
+    volatile int active;                    // Conexiones atendidas por un hilo
+    pthread_t threads[WORKER_POOL_THREADS];
+    int num_threads;
+    int next_thread;                        // Los primeros WORKER_SMALL_LANE_THREADS hilos forman el carril rápido
+    int stopping;
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty;
+} WorkerPool;
+
+
+WorkerPool* WORKER_pool_create(volatile int* gotham_connection_alive, volatile int* distort_in_progress,
+                               const PoolFairness* fairness);
+int WORKER_pool_submit(WorkerPool* pool, int socket_connection);
+void WORKER_pool_destroy(WorkerPool* pool);
+void WORKER_pool_load(WorkerPool* pool, int* active, int* queued);
+
+#endif